@@ -0,0 +1,126 @@
+#define __BENCHMARK_BACKGROUND_MAP_SCHEME_IMPL_CPP__
+
+#include <thread>
+#include <sstream>
+
+#include "encoders/background_map_scheme_impl.hpp"
+#include "encoders/remove_estimated_background_scheme_impl.hpp"
+#include "encoders/lz4.hpp"
+#include "benchmark_fixtures.hpp"
+
+typedef sqeazy::benchmark::dynamic_synthetic_data<> dynamic_default_fixture;
+
+BENCHMARK_DEFINE_F(dynamic_default_fixture, single_thread)(benchmark::State& state) {
+
+  if (state.thread_index == 0) {
+    SetUp(state);
+  }
+
+  sqeazy::background_map_scheme<std::uint16_t> local;
+  local.set_n_threads(1);
+
+  local.encode(embryo_.data(),
+               output_.data(),
+               shape_);
+
+  while (state.KeepRunning()) {
+
+    local.encode(embryo_.data(),
+                 output_.data(),
+                 shape_);
+  }
+
+  state.SetBytesProcessed(int64_t(state.iterations()) *
+                          int64_t(size_in_bytes()));
+}
+
+BENCHMARK_REGISTER_F(dynamic_default_fixture, single_thread)->Arg({256 << 10})->Arg({64 << 20});
+
+BENCHMARK_DEFINE_F(dynamic_default_fixture, max_threads)(benchmark::State& state) {
+
+  if (state.thread_index == 0) {
+    SetUp(state);
+  }
+
+  sqeazy::background_map_scheme<std::uint16_t> local;
+  local.set_n_threads(std::thread::hardware_concurrency());
+
+  local.encode(embryo_.data(),
+               output_.data(),
+               shape_);
+
+  while (state.KeepRunning()) {
+
+    local.encode(embryo_.data(),
+                 output_.data(),
+                 shape_);
+  }
+
+  state.SetBytesProcessed(int64_t(state.iterations()) *
+                          int64_t(size_in_bytes()));
+}
+
+BENCHMARK_REGISTER_F(dynamic_default_fixture, max_threads)->UseRealTime()->Arg({256 << 10})->Arg({64 << 20});
+
+/*
+  a background that follows the illumination leaves more zeros than one global level,
+  the benchmarks below run background removal and lz4 on the embryo and report the compression ratio as label
+*/
+template <typename filter_t>
+static void remove_then_lz4(dynamic_default_fixture& _fixture,
+                            benchmark::State& state,
+                            filter_t& _filter){
+
+  sqeazy::lz4_scheme<std::uint16_t> lz4;
+  _filter.set_n_threads(1);
+  lz4.set_n_threads(1);
+
+  std::vector<std::uint16_t> reduced(_fixture.size_);
+  std::vector<char> compressed(lz4.max_encoded_size(_fixture.size_in_bytes()));
+
+  char* end = compressed.data();
+  while (state.KeepRunning()) {
+
+    _filter.encode(_fixture.embryo_.data(),
+                   reduced.data(),
+                   _fixture.shape_);
+
+    end = lz4.encode(reduced.data(),
+                     compressed.data(),
+                     _fixture.shape_);
+  }
+
+  std::ostringstream msg;
+  msg << "ratio = " << double(_fixture.size_in_bytes())/(end - compressed.data())
+      << ", zeros = " << double(std::count(reduced.begin(), reduced.end(), 0))/reduced.size();
+  state.SetLabel(msg.str());
+
+  state.SetBytesProcessed(int64_t(state.iterations()) *
+                          int64_t(_fixture.size_in_bytes()));
+}
+
+BENCHMARK_DEFINE_F(dynamic_default_fixture, map_then_lz4)(benchmark::State& state) {
+
+  if (state.thread_index == 0) {
+    SetUp(state);
+  }
+
+  sqeazy::background_map_scheme<std::uint16_t> local;
+  remove_then_lz4(*this, state, local);
+}
+
+BENCHMARK_REGISTER_F(dynamic_default_fixture, map_then_lz4)->Arg({256 << 10})->Arg({64 << 20});
+
+BENCHMARK_DEFINE_F(dynamic_default_fixture, estimated_then_lz4)(benchmark::State& state) {
+
+  if (state.thread_index == 0) {
+    SetUp(state);
+  }
+
+  sqeazy::remove_estimated_background_scheme<std::uint16_t> local;
+  remove_then_lz4(*this, state, local);
+}
+
+BENCHMARK_REGISTER_F(dynamic_default_fixture, estimated_then_lz4)->Arg({256 << 10})->Arg({64 << 20});
+
+BENCHMARK_MAIN();
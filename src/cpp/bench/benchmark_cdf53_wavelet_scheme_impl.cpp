@@ -0,0 +1,199 @@
+#define __BENCHMARK_CDF53_WAVELET_SCHEME_IMPL_CPP__
+
+#include <thread>
+#include <sstream>
+
+#include "encoders/cdf53_wavelet_scheme_impl.hpp"
+#include "encoders/med_predict_scheme_impl.hpp"
+#include "encoders/lz4.hpp"
+#include "benchmark_fixtures.hpp"
+
+typedef sqeazy::benchmark::dynamic_synthetic_data<> dynamic_default_fixture;
+
+BENCHMARK_DEFINE_F(dynamic_default_fixture, single_thread)(benchmark::State& state) {
+
+
+  if (state.thread_index == 0) {
+    SetUp(state);
+  }
+
+  sqeazy::cdf53_wavelet_scheme<std::uint16_t> local;
+  local.set_n_threads(1);
+
+
+  local.encode(sinus_.data(),
+               output_.data(),
+               shape_);
+
+  while (state.KeepRunning()) {
+
+    local.encode(sinus_.data(),
+               output_.data(),
+               shape_);
+  }
+
+  state.SetBytesProcessed(int64_t(state.iterations()) *
+                          int64_t(size_)*sizeof(sinus_.front()));
+}
+
+BENCHMARK_REGISTER_F(dynamic_default_fixture, single_thread)->Arg({1<<16})->Arg({256 << 10})->Arg({64 << 20});
+
+BENCHMARK_DEFINE_F(dynamic_default_fixture, max_threads)(benchmark::State& state) {
+
+
+  if (state.thread_index == 0) {
+    SetUp(state);
+  }
+
+  int nthreads = std::thread::hardware_concurrency();
+  sqeazy::cdf53_wavelet_scheme<std::uint16_t> local;
+  local.set_n_threads(nthreads);
+
+
+  local.encode(sinus_.data(),
+               output_.data(),
+               shape_);
+
+  while (state.KeepRunning()) {
+
+    local.encode(sinus_.data(),
+               output_.data(),
+               shape_);
+  }
+
+  state.SetBytesProcessed(int64_t(state.iterations()) *
+                          int64_t(size_)*sizeof(sinus_.front()));
+}
+
+BENCHMARK_REGISTER_F(dynamic_default_fixture, max_threads)->UseRealTime()->Arg({1<<16})->Arg({256 << 10})->Arg({64 << 20});
+
+BENCHMARK_DEFINE_F(dynamic_default_fixture, decode_single_thread)(benchmark::State& state) {
+
+
+  if (state.thread_index == 0) {
+    SetUp(state);
+  }
+
+  sqeazy::cdf53_wavelet_scheme<std::uint16_t> local;
+  local.set_n_threads(1);
+
+  std::vector<std::uint16_t> encoded(sinus_.size());
+  local.encode(sinus_.data(),
+               encoded.data(),
+               shape_);
+
+  while (state.KeepRunning()) {
+
+    local.decode(encoded.data(),
+                 output_.data(),
+                 shape_);
+  }
+
+  state.SetBytesProcessed(int64_t(state.iterations()) *
+                          int64_t(size_)*sizeof(sinus_.front()));
+}
+
+BENCHMARK_REGISTER_F(dynamic_default_fixture, decode_single_thread)->Arg({1<<16})->Arg({256 << 10})->Arg({64 << 20});
+
+BENCHMARK_DEFINE_F(dynamic_default_fixture, decode_max_threads)(benchmark::State& state) {
+
+
+  if (state.thread_index == 0) {
+    SetUp(state);
+  }
+
+  int nthreads = std::thread::hardware_concurrency();
+  sqeazy::cdf53_wavelet_scheme<std::uint16_t> local;
+  local.set_n_threads(nthreads);
+
+  std::vector<std::uint16_t> encoded(sinus_.size());
+  local.encode(sinus_.data(),
+               encoded.data(),
+               shape_);
+
+  while (state.KeepRunning()) {
+
+    local.decode(encoded.data(),
+                 output_.data(),
+                 shape_);
+  }
+
+  state.SetBytesProcessed(int64_t(state.iterations()) *
+                          int64_t(size_)*sizeof(sinus_.front()));
+}
+
+BENCHMARK_REGISTER_F(dynamic_default_fixture, decode_max_threads)->UseRealTime()->Arg({1<<16})->Arg({256 << 10})->Arg({64 << 20});
+
+/*
+  the transform only pays off if lz4 finds more matches in the coefficients,
+  the benchmarks below run transform (or predictor) and lz4 on the embryo and report the compression ratio as label
+*/
+template <typename predict_t>
+static void predict_then_lz4(dynamic_default_fixture& _fixture,
+                             benchmark::State& state,
+                             predict_t& _predict){
+
+  sqeazy::lz4_scheme<std::uint16_t> lz4;
+  _predict.set_n_threads(1);
+  lz4.set_n_threads(1);
+
+  std::vector<std::uint16_t> residuals(_fixture.size_);
+  std::vector<char> compressed(lz4.max_encoded_size(_fixture.size_in_bytes()));
+
+  char* end = compressed.data();
+  while (state.KeepRunning()) {
+
+    _predict.encode(_fixture.embryo_.data(),
+                    residuals.data(),
+                    _fixture.shape_);
+
+    end = lz4.encode(residuals.data(),
+                     compressed.data(),
+                     _fixture.shape_);
+  }
+
+  std::ostringstream msg;
+  msg << "ratio = " << double(_fixture.size_in_bytes())/(end - compressed.data());
+  state.SetLabel(msg.str());
+
+  state.SetBytesProcessed(int64_t(state.iterations()) *
+                          int64_t(_fixture.size_in_bytes()));
+}
+
+BENCHMARK_DEFINE_F(dynamic_default_fixture, cdf53_then_lz4)(benchmark::State& state) {
+
+  if (state.thread_index == 0) {
+    SetUp(state);
+  }
+
+  sqeazy::cdf53_wavelet_scheme<std::uint16_t> local("levels=2,mode=2d");
+  predict_then_lz4(*this, state, local);
+}
+
+BENCHMARK_REGISTER_F(dynamic_default_fixture, cdf53_then_lz4)->Arg({256 << 10})->Arg({64 << 20});
+
+BENCHMARK_DEFINE_F(dynamic_default_fixture, cdf53_3d_then_lz4)(benchmark::State& state) {
+
+  if (state.thread_index == 0) {
+    SetUp(state);
+  }
+
+  sqeazy::cdf53_wavelet_scheme<std::uint16_t> local("levels=2,mode=3d");
+  predict_then_lz4(*this, state, local);
+}
+
+BENCHMARK_REGISTER_F(dynamic_default_fixture, cdf53_3d_then_lz4)->Arg({256 << 10})->Arg({64 << 20});
+
+BENCHMARK_DEFINE_F(dynamic_default_fixture, med_then_lz4)(benchmark::State& state) {
+
+  if (state.thread_index == 0) {
+    SetUp(state);
+  }
+
+  sqeazy::med_predict_scheme<std::uint16_t> local;
+  predict_then_lz4(*this, state, local);
+}
+
+BENCHMARK_REGISTER_F(dynamic_default_fixture, med_then_lz4)->Arg({256 << 10})->Arg({64 << 20});
+
+BENCHMARK_MAIN();
@@ -161,4 +161,61 @@ BENCHMARK_DEFINE_F(dynamic_default_fixture, max_threads)(benchmark::State& state
 
 BENCHMARK_REGISTER_F(dynamic_default_fixture, max_threads)->UseRealTime()->Range(1 << 16,1 << 25);
 
+BENCHMARK_DEFINE_F(dynamic_default_fixture, decode_single_thread)(benchmark::State& state) {
+
+
+  if (state.thread_index == 0) {
+    SetUp(state);
+  }
+
+  sqeazy::diff_scheme<std::uint16_t> local;
+  local.set_n_threads(1);
+
+  std::vector<std::uint16_t> encoded(sinus_.size(),0);
+  local.encode(sinus_.data(),
+               encoded.data(),
+               shape_);
+
+  while (state.KeepRunning()) {
+
+    local.decode(encoded.data(),
+                 output_.data(),
+                 shape_);
+  }
+
+  state.SetBytesProcessed(int64_t(state.iterations()) *
+                          int64_t(size_)*sizeof(sinus_.front()));
+}
+
+BENCHMARK_REGISTER_F(dynamic_default_fixture, decode_single_thread)->Range(1 << 16,1 << 25);
+
+BENCHMARK_DEFINE_F(dynamic_default_fixture, decode_max_threads)(benchmark::State& state) {
+
+
+  if (state.thread_index == 0) {
+    SetUp(state);
+  }
+
+  int nthreads = std::thread::hardware_concurrency();
+  sqeazy::diff_scheme<std::uint16_t> local;
+  local.set_n_threads(nthreads);
+
+  std::vector<std::uint16_t> encoded(sinus_.size(),0);
+  local.encode(sinus_.data(),
+               encoded.data(),
+               shape_);
+
+  while (state.KeepRunning()) {
+
+    local.decode(encoded.data(),
+                 output_.data(),
+                 shape_);
+  }
+
+  state.SetBytesProcessed(int64_t(state.iterations()) *
+                          int64_t(size_)*sizeof(sinus_.front()));
+}
+
+BENCHMARK_REGISTER_F(dynamic_default_fixture, decode_max_threads)->UseRealTime()->Range(1 << 16,1 << 25);
+
 BENCHMARK_MAIN();
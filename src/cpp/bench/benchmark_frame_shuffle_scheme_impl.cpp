@@ -124,6 +124,37 @@ BENCHMARK_DEFINE_F(dynamic_default_fixture, single_thread)(benchmark::State& sta
 
 BENCHMARK_REGISTER_F(dynamic_default_fixture, single_thread)->Range(1 << 16,1 << 25);
 
+BENCHMARK_DEFINE_F(dynamic_default_fixture, metric_stride_4_single_thread)(benchmark::State& state) {
+
+
+  if (state.thread_index == 0) {
+    SetUp(state);
+  }
+
+  sqeazy::frame_shuffle_scheme<std::uint16_t> local("metric_stride=4");
+  local.set_n_threads(1);
+
+
+  local.encode(sinus_.data(),
+               output_.data(),
+               shape_);
+
+  while (state.KeepRunning()) {
+    state.PauseTiming();
+    std::fill(output_.begin(), output_.end(),0);
+    state.ResumeTiming();
+
+    local.encode(sinus_.data(),
+               output_.data(),
+               shape_);
+  }
+
+  state.SetBytesProcessed(int64_t(state.iterations()) *
+                          int64_t(size_)*sizeof(sinus_.front()));
+}
+
+BENCHMARK_REGISTER_F(dynamic_default_fixture, metric_stride_4_single_thread)->Range(1 << 16,1 << 25);
+
 BENCHMARK_DEFINE_F(dynamic_default_fixture, two_threads)(benchmark::State& state) {
 
 
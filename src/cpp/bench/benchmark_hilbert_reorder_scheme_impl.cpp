@@ -0,0 +1,200 @@
+#define __BENCHMARK_HILBERT_REORDER_SCHEME_IMPL_CPP__
+
+#include <thread>
+#include <sstream>
+
+#include "encoders/hilbert_reorder_scheme_impl.hpp"
+#include "encoders/zcurve_reorder_scheme_impl.hpp"
+#include "encoders/tile_shuffle_scheme_impl.hpp"
+#include "encoders/lz4.hpp"
+#include "benchmark_fixtures.hpp"
+
+typedef sqeazy::benchmark::dynamic_synthetic_data<> dynamic_default_fixture;
+
+BENCHMARK_DEFINE_F(dynamic_default_fixture, single_thread)(benchmark::State& state) {
+
+
+  if (state.thread_index == 0) {
+    SetUp(state);
+  }
+
+  sqeazy::hilbert_reorder_scheme<std::uint16_t> local;
+  local.set_n_threads(1);
+
+
+  local.encode(sinus_.data(),
+               output_.data(),
+               shape_);
+
+  while (state.KeepRunning()) {
+
+    local.encode(sinus_.data(),
+               output_.data(),
+               shape_);
+  }
+
+  state.SetBytesProcessed(int64_t(state.iterations()) *
+                          int64_t(size_)*sizeof(sinus_.front()));
+}
+
+BENCHMARK_REGISTER_F(dynamic_default_fixture, single_thread)->Arg({1<<16})->Arg({256 << 10})->Arg({64 << 20});
+
+BENCHMARK_DEFINE_F(dynamic_default_fixture, max_threads)(benchmark::State& state) {
+
+
+  if (state.thread_index == 0) {
+    SetUp(state);
+  }
+
+  int nthreads = std::thread::hardware_concurrency();
+  sqeazy::hilbert_reorder_scheme<std::uint16_t> local;
+  local.set_n_threads(nthreads);
+
+
+  local.encode(sinus_.data(),
+               output_.data(),
+               shape_);
+
+  while (state.KeepRunning()) {
+
+    local.encode(sinus_.data(),
+               output_.data(),
+               shape_);
+  }
+
+  state.SetBytesProcessed(int64_t(state.iterations()) *
+                          int64_t(size_)*sizeof(sinus_.front()));
+}
+
+BENCHMARK_REGISTER_F(dynamic_default_fixture, max_threads)->UseRealTime()->Arg({1<<16})->Arg({256 << 10})->Arg({64 << 20});
+
+BENCHMARK_DEFINE_F(dynamic_default_fixture, decode_single_thread)(benchmark::State& state) {
+
+
+  if (state.thread_index == 0) {
+    SetUp(state);
+  }
+
+  sqeazy::hilbert_reorder_scheme<std::uint16_t> local;
+  local.set_n_threads(1);
+
+  std::vector<std::uint16_t> encoded(sinus_.size());
+  local.encode(sinus_.data(),
+               encoded.data(),
+               shape_);
+
+  while (state.KeepRunning()) {
+
+    local.decode(encoded.data(),
+                 output_.data(),
+                 shape_);
+  }
+
+  state.SetBytesProcessed(int64_t(state.iterations()) *
+                          int64_t(size_)*sizeof(sinus_.front()));
+}
+
+BENCHMARK_REGISTER_F(dynamic_default_fixture, decode_single_thread)->Arg({1<<16})->Arg({256 << 10})->Arg({64 << 20});
+
+BENCHMARK_DEFINE_F(dynamic_default_fixture, decode_max_threads)(benchmark::State& state) {
+
+
+  if (state.thread_index == 0) {
+    SetUp(state);
+  }
+
+  int nthreads = std::thread::hardware_concurrency();
+  sqeazy::hilbert_reorder_scheme<std::uint16_t> local;
+  local.set_n_threads(nthreads);
+
+  std::vector<std::uint16_t> encoded(sinus_.size());
+  local.encode(sinus_.data(),
+               encoded.data(),
+               shape_);
+
+  while (state.KeepRunning()) {
+
+    local.decode(encoded.data(),
+                 output_.data(),
+                 shape_);
+  }
+
+  state.SetBytesProcessed(int64_t(state.iterations()) *
+                          int64_t(size_)*sizeof(sinus_.front()));
+}
+
+BENCHMARK_REGISTER_F(dynamic_default_fixture, decode_max_threads)->UseRealTime()->Arg({1<<16})->Arg({256 << 10})->Arg({64 << 20});
+
+/*
+  the reorder stages only pay off if lz4 finds longer matches afterwards,
+  the benchmarks below run reorder and lz4 on the embryo and report the compression ratio as label
+*/
+template <typename reorder_t>
+static void reorder_then_lz4(dynamic_default_fixture& _fixture,
+                             benchmark::State& state,
+                             reorder_t& _reorder){
+
+  sqeazy::lz4_scheme<std::uint16_t> lz4;
+  _reorder.set_n_threads(1);
+  lz4.set_n_threads(1);
+
+  std::vector<std::uint16_t> reordered(_fixture.size_);
+  std::vector<char> compressed(lz4.max_encoded_size(_fixture.size_in_bytes()));
+
+  char* end = compressed.data();
+  while (state.KeepRunning()) {
+
+    _reorder.encode(_fixture.embryo_.data(),
+                    reordered.data(),
+                    _fixture.shape_);
+
+    end = lz4.encode(reordered.data(),
+                     compressed.data(),
+                     _fixture.shape_);
+  }
+
+  std::ostringstream msg;
+  msg << "ratio = " << double(_fixture.size_in_bytes())/(end - compressed.data());
+  state.SetLabel(msg.str());
+
+  state.SetBytesProcessed(int64_t(state.iterations()) *
+                          int64_t(_fixture.size_in_bytes()));
+}
+
+BENCHMARK_DEFINE_F(dynamic_default_fixture, hilbert_then_lz4)(benchmark::State& state) {
+
+  if (state.thread_index == 0) {
+    SetUp(state);
+  }
+
+  sqeazy::hilbert_reorder_scheme<std::uint16_t> local;
+  reorder_then_lz4(*this, state, local);
+}
+
+BENCHMARK_REGISTER_F(dynamic_default_fixture, hilbert_then_lz4)->Arg({256 << 10})->Arg({64 << 20});
+
+BENCHMARK_DEFINE_F(dynamic_default_fixture, zcurve_then_lz4)(benchmark::State& state) {
+
+  if (state.thread_index == 0) {
+    SetUp(state);
+  }
+
+  sqeazy::zcurve_reorder_scheme<std::uint16_t> local("tile_size=16");
+  reorder_then_lz4(*this, state, local);
+}
+
+BENCHMARK_REGISTER_F(dynamic_default_fixture, zcurve_then_lz4)->Arg({256 << 10})->Arg({64 << 20});
+
+BENCHMARK_DEFINE_F(dynamic_default_fixture, tile_shuffle_then_lz4)(benchmark::State& state) {
+
+  if (state.thread_index == 0) {
+    SetUp(state);
+  }
+
+  sqeazy::tile_shuffle_scheme<std::uint16_t> local;
+  reorder_then_lz4(*this, state, local);
+}
+
+BENCHMARK_REGISTER_F(dynamic_default_fixture, tile_shuffle_then_lz4)->Arg({256 << 10})->Arg({64 << 20});
+
+BENCHMARK_MAIN();
@@ -257,4 +257,146 @@ BENCHMARK_DEFINE_F(dynamic_default_fixture, max_threads_weighted)(benchmark::Sta
 BENCHMARK_REGISTER_F(dynamic_default_fixture, max_threads_weighted)->UseRealTime()->Range(1 << 16,1 << 25);
 
 
+BENCHMARK_DEFINE_F(dynamic_default_fixture, apply_encode_lut_scalar)(benchmark::State& state) {
+
+
+  if (state.thread_index == 0) {
+    SetUp(state);
+  }
+
+  sqeazy::quantiser<std::uint16_t, char> shrinker(sinus_.data(), sinus_.data() + size_);
+  std::vector<char> encoded(size_,0);
+
+  while (state.KeepRunning()) {
+    sqeazy::detail::lut::apply_scalar(sinus_.data(), size_,
+                                      shrinker.lut_encode_,
+                                      encoded.data());
+  }
+
+  state.SetBytesProcessed(int64_t(state.iterations()) *
+                          int64_t(size_)*sizeof(sinus_.front()));
+}
+
+BENCHMARK_REGISTER_F(dynamic_default_fixture, apply_encode_lut_scalar)->Range(1 << 16,1 << 25);
+
+BENCHMARK_DEFINE_F(dynamic_default_fixture, apply_encode_lut)(benchmark::State& state) {
+
+
+  if (state.thread_index == 0) {
+    SetUp(state);
+  }
+
+  sqeazy::quantiser<std::uint16_t, char> shrinker(sinus_.data(), sinus_.data() + size_);
+  std::vector<char> encoded(size_,0);
+
+  while (state.KeepRunning()) {
+    sqeazy::detail::lut::apply(sinus_.data(), size_,
+                               shrinker.lut_encode_,
+                               encoded.data());
+  }
+
+  state.SetBytesProcessed(int64_t(state.iterations()) *
+                          int64_t(size_)*sizeof(sinus_.front()));
+}
+
+BENCHMARK_REGISTER_F(dynamic_default_fixture, apply_encode_lut)->Range(1 << 16,1 << 25);
+
+BENCHMARK_DEFINE_F(dynamic_default_fixture, apply_decode_lut_scalar)(benchmark::State& state) {
+
+
+  if (state.thread_index == 0) {
+    SetUp(state);
+  }
+
+  sqeazy::quantiser<std::uint16_t, char> shrinker(sinus_.data(), sinus_.data() + size_);
+  std::vector<char> encoded(size_,0);
+  shrinker.encode(sinus_.data(), size_, encoded.data());
+
+  while (state.KeepRunning()) {
+    sqeazy::detail::lut::apply_scalar(encoded.data(), size_,
+                                      shrinker.lut_decode_,
+                                      output_.data());
+  }
+
+  state.SetBytesProcessed(int64_t(state.iterations()) *
+                          int64_t(size_)*sizeof(sinus_.front()));
+}
+
+BENCHMARK_REGISTER_F(dynamic_default_fixture, apply_decode_lut_scalar)->Range(1 << 16,1 << 25);
+
+BENCHMARK_DEFINE_F(dynamic_default_fixture, apply_decode_lut)(benchmark::State& state) {
+
+
+  if (state.thread_index == 0) {
+    SetUp(state);
+  }
+
+  sqeazy::quantiser<std::uint16_t, char> shrinker(sinus_.data(), sinus_.data() + size_);
+  std::vector<char> encoded(size_,0);
+  shrinker.encode(sinus_.data(), size_, encoded.data());
+
+  while (state.KeepRunning()) {
+    sqeazy::detail::lut::apply(encoded.data(), size_,
+                               shrinker.lut_decode_,
+                               output_.data());
+  }
+
+  state.SetBytesProcessed(int64_t(state.iterations()) *
+                          int64_t(size_)*sizeof(sinus_.front()));
+}
+
+BENCHMARK_REGISTER_F(dynamic_default_fixture, apply_decode_lut)->Range(1 << 16,1 << 25);
+
+BENCHMARK_DEFINE_F(dynamic_default_fixture, pack_10bit_codes)(benchmark::State& state) {
+
+
+  if (state.thread_index == 0) {
+    SetUp(state);
+  }
+
+  sqeazy::quantiser<std::uint16_t, std::uint16_t> shrinker;
+  shrinker.set_bits(10);
+  shrinker.setup_com(sinus_.data(), sinus_.data() + size_);
+  std::vector<char> encoded(sqeazy::detail::bitpack::packed_bytes(size_,10),0);
+
+  while (state.KeepRunning()) {
+    sqeazy::detail::bitpack::encode(sinus_.data(), size_,
+                                    shrinker.lut_encode_,
+                                    10,
+                                    encoded.data());
+  }
+
+  state.SetBytesProcessed(int64_t(state.iterations()) *
+                          int64_t(size_)*sizeof(sinus_.front()));
+}
+
+BENCHMARK_REGISTER_F(dynamic_default_fixture, pack_10bit_codes)->Range(1 << 16,1 << 25);
+
+BENCHMARK_DEFINE_F(dynamic_default_fixture, unpack_10bit_codes)(benchmark::State& state) {
+
+
+  if (state.thread_index == 0) {
+    SetUp(state);
+  }
+
+  sqeazy::quantiser<std::uint16_t, std::uint16_t> shrinker;
+  shrinker.set_bits(10);
+  shrinker.setup_com(sinus_.data(), sinus_.data() + size_);
+  std::vector<char> encoded(sqeazy::detail::bitpack::packed_bytes(size_,10),0);
+  sqeazy::detail::bitpack::encode(sinus_.data(), size_, shrinker.lut_encode_, 10, encoded.data());
+
+  while (state.KeepRunning()) {
+    sqeazy::detail::bitpack::decode(encoded.data(), size_,
+                                    shrinker.lut_decode_,
+                                    10,
+                                    output_.data());
+  }
+
+  state.SetBytesProcessed(int64_t(state.iterations()) *
+                          int64_t(size_)*sizeof(sinus_.front()));
+}
+
+BENCHMARK_REGISTER_F(dynamic_default_fixture, unpack_10bit_codes)->Range(1 << 16,1 << 25);
+
+
 BENCHMARK_MAIN();
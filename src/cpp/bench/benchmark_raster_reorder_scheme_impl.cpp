@@ -92,6 +92,68 @@ BENCHMARK_DEFINE_F(dynamic_default_fixture, single_thread)(benchmark::State& sta
 
 BENCHMARK_REGISTER_F(dynamic_default_fixture, single_thread)->Arg({1<<16})->Arg({256 << 10})->Arg({64 << 20});
 
+BENCHMARK_DEFINE_F(dynamic_default_fixture, tile_of_32_single_thread_cached)(benchmark::State& state) {
+
+
+  if (state.thread_index == 0) {
+    SetUp(state);
+  }
+
+  sqeazy::raster_reorder_scheme<std::uint16_t> local("tile_size=32,stores=cached");
+  local.set_n_threads(1);
+
+
+  local.encode(sinus_.data(),
+               output_.data(),
+               shape_);
+
+  while (state.KeepRunning()) {
+    state.PauseTiming();
+    std::fill(output_.begin(), output_.end(),0);
+    state.ResumeTiming();
+
+    local.encode(sinus_.data(),
+               output_.data(),
+               shape_);
+  }
+
+  state.SetBytesProcessed(int64_t(state.iterations()) *
+                          int64_t(size_)*sizeof(sinus_.front()));
+}
+
+BENCHMARK_REGISTER_F(dynamic_default_fixture, tile_of_32_single_thread_cached)->Arg({1<<16})->Arg({256 << 10})->Arg({64 << 20});
+
+BENCHMARK_DEFINE_F(dynamic_default_fixture, tile_of_32_single_thread_streaming)(benchmark::State& state) {
+
+
+  if (state.thread_index == 0) {
+    SetUp(state);
+  }
+
+  sqeazy::raster_reorder_scheme<std::uint16_t> local("tile_size=32,stores=streaming");
+  local.set_n_threads(1);
+
+
+  local.encode(sinus_.data(),
+               output_.data(),
+               shape_);
+
+  while (state.KeepRunning()) {
+    state.PauseTiming();
+    std::fill(output_.begin(), output_.end(),0);
+    state.ResumeTiming();
+
+    local.encode(sinus_.data(),
+               output_.data(),
+               shape_);
+  }
+
+  state.SetBytesProcessed(int64_t(state.iterations()) *
+                          int64_t(size_)*sizeof(sinus_.front()));
+}
+
+BENCHMARK_REGISTER_F(dynamic_default_fixture, tile_of_32_single_thread_streaming)->Arg({1<<16})->Arg({256 << 10})->Arg({64 << 20});
+
 BENCHMARK_DEFINE_F(dynamic_default_fixture, two_threads)(benchmark::State& state) {
 
 
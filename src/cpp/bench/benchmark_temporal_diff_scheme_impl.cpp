@@ -0,0 +1,167 @@
+#define __BENCHMARK_TEMPORAL_DIFF_SCHEME_IMPL_CPP__
+
+#include <thread>
+#include <sstream>
+
+#include "encoders/temporal_diff_scheme_impl.hpp"
+#include "encoders/lz4.hpp"
+#include "benchmark_fixtures.hpp"
+
+typedef sqeazy::benchmark::dynamic_synthetic_data<> dynamic_default_fixture;
+
+/*
+  the embryo is the keyframe, the noisy embryo is the timepoint after it: with reference=keyframe every
+  iteration encodes the same residuals
+*/
+static void encode_timepoints(dynamic_default_fixture& _fixture,
+                              benchmark::State& state,
+                              int _nthreads){
+
+  const std::string sequence = "bench" + std::to_string(_nthreads);
+  sqeazy::temporal_diff_scheme<std::uint16_t>::reset(sequence);
+  sqeazy::temporal_diff_scheme<std::uint16_t> local("interval=0,reference=keyframe,sequence=" + sequence);
+  local.set_n_threads(_nthreads);
+
+  local.encode(_fixture.embryo_.data(),
+               _fixture.output_.data(),
+               _fixture.shape_);
+
+  while (state.KeepRunning()) {
+
+    local.encode(_fixture.noisy_embryo_.data(),
+                 _fixture.output_.data(),
+                 _fixture.shape_);
+  }
+
+  state.SetBytesProcessed(int64_t(state.iterations()) *
+                          int64_t(_fixture.size_in_bytes()));
+}
+
+BENCHMARK_DEFINE_F(dynamic_default_fixture, single_thread)(benchmark::State& state) {
+
+  if (state.thread_index == 0) {
+    SetUp(state);
+  }
+
+  encode_timepoints(*this, state, 1);
+}
+
+BENCHMARK_REGISTER_F(dynamic_default_fixture, single_thread)->Arg({256 << 10})->Arg({64 << 20});
+
+BENCHMARK_DEFINE_F(dynamic_default_fixture, max_threads)(benchmark::State& state) {
+
+  if (state.thread_index == 0) {
+    SetUp(state);
+  }
+
+  encode_timepoints(*this, state, std::thread::hardware_concurrency());
+}
+
+BENCHMARK_REGISTER_F(dynamic_default_fixture, max_threads)->UseRealTime()->Arg({256 << 10})->Arg({64 << 20});
+
+/*
+  compression ratio of lz4 on a timepoint that differs from the noisy embryo in every 5th item by 1,
+  with and without the difference to the noisy embryo, as label
+*/
+BENCHMARK_DEFINE_F(dynamic_default_fixture, temporal_diff_then_lz4)(benchmark::State& state) {
+
+  if (state.thread_index == 0) {
+    SetUp(state);
+  }
+
+  sqeazy::temporal_diff_scheme<std::uint16_t>::reset("bench_lz4");
+  sqeazy::temporal_diff_scheme<std::uint16_t> local("interval=0,reference=keyframe,sequence=bench_lz4");
+  sqeazy::lz4_scheme<std::uint16_t> lz4;
+  local.set_n_threads(1);
+  lz4.set_n_threads(1);
+
+  std::vector<std::uint16_t> next(noisy_embryo_.begin(), noisy_embryo_.end());
+  for(std::size_t i = 0;i<next.size();i += 5)
+    next[i] += 1;
+
+  std::vector<std::uint16_t> residuals(size_);
+  std::vector<char> compressed(lz4.max_encoded_size(size_in_bytes()));
+
+  local.encode(noisy_embryo_.data(), residuals.data(), shape_);
+
+  char* end = compressed.data();
+  while (state.KeepRunning()) {
+
+    local.encode(next.data(),
+                 residuals.data(),
+                 shape_);
+
+    end = lz4.encode(residuals.data(),
+                     compressed.data(),
+                     shape_);
+  }
+
+  const double with_diff = double(size_in_bytes())/(end - compressed.data());
+  end = lz4.encode(next.data(), compressed.data(), shape_);
+
+  std::ostringstream msg;
+  msg << "ratio = " << with_diff
+      << ", lz4 only = " << double(size_in_bytes())/(end - compressed.data());
+  state.SetLabel(msg.str());
+
+  state.SetBytesProcessed(int64_t(state.iterations()) *
+                          int64_t(size_in_bytes()));
+}
+
+BENCHMARK_REGISTER_F(dynamic_default_fixture, temporal_diff_then_lz4)->Arg({256 << 10})->Arg({64 << 20});
+
+/*
+  a timepoint that is the noisy embryo moved by 1 item along y and x, motion compensation with bricks of 16^3
+  items and a search window of +-2 items, the compression ratio of lz4 with and without it as label
+*/
+BENCHMARK_DEFINE_F(dynamic_default_fixture, motion_then_lz4)(benchmark::State& state) {
+
+  if (state.thread_index == 0) {
+    SetUp(state);
+  }
+
+  const std::size_t len_x = shape_[sqeazy::row_major::x];
+  std::vector<std::uint16_t> next(size_, 0);
+  for(std::size_t i = len_x + 1;i<size_;++i)
+    next[i] = noisy_embryo_[i - len_x - 1];
+
+  sqeazy::lz4_scheme<std::uint16_t> lz4;
+  lz4.set_n_threads(1);
+  std::vector<std::uint16_t> residuals(size_);
+  std::vector<char> compressed(lz4.max_encoded_size(size_in_bytes()));
+
+  double ratios[2] = {0, 0};
+  for(int with_motion : {0, 1}){
+
+    const std::string sequence = "bench_motion" + std::to_string(with_motion);
+    sqeazy::temporal_diff_scheme<std::uint16_t>::reset(sequence);
+    sqeazy::temporal_diff_scheme<std::uint16_t> local("interval=0,reference=keyframe,sequence=" + sequence +
+                                                      (with_motion ? ",brick=16,search=2" : ""));
+    local.set_n_threads(std::thread::hardware_concurrency());
+    local.encode(noisy_embryo_.data(), residuals.data(), shape_);
+
+    if(with_motion){
+      while (state.KeepRunning()) {
+        local.encode(next.data(),
+                     residuals.data(),
+                     shape_);
+      }
+    }
+    else
+      local.encode(next.data(), residuals.data(), shape_);
+
+    char* end = lz4.encode(residuals.data(), compressed.data(), shape_);
+    ratios[with_motion] = double(size_in_bytes())/(end - compressed.data());
+  }
+
+  std::ostringstream msg;
+  msg << "ratio = " << ratios[1] << ", without motion = " << ratios[0];
+  state.SetLabel(msg.str());
+
+  state.SetBytesProcessed(int64_t(state.iterations()) *
+                          int64_t(size_in_bytes()));
+}
+
+BENCHMARK_REGISTER_F(dynamic_default_fixture, motion_then_lz4)->UseRealTime()->Arg({256 << 10})->Arg({64 << 20});
+
+BENCHMARK_MAIN();
@@ -92,6 +92,60 @@ BENCHMARK_DEFINE_F(dynamic_default_fixture, single_thread)(benchmark::State& sta
 
 BENCHMARK_REGISTER_F(dynamic_default_fixture, single_thread)->Arg({1<<16})->Arg({256 << 10})->Arg({64 << 20});
 
+BENCHMARK_DEFINE_F(dynamic_default_fixture, then_bitswap1_single_thread)(benchmark::State& state) {
+
+
+  if (state.thread_index == 0) {
+    SetUp(state);
+  }
+
+  sqeazy::tile_shuffle_scheme<std::uint16_t> local;
+  sqeazy::bitswap_scheme<std::uint16_t> bitswap;
+  local.set_n_threads(1);
+  bitswap.set_n_threads(1);
+
+  std::vector<std::uint16_t> shuffled(output_.size());
+
+  while (state.KeepRunning()) {
+    local.encode(sinus_.data(),
+                 shuffled.data(),
+                 shape_);
+
+    bitswap.encode(shuffled.data(),
+                   output_.data(),
+                   shape_);
+  }
+
+  state.SetBytesProcessed(int64_t(state.iterations()) *
+                          int64_t(size_)*sizeof(sinus_.front()));
+}
+
+BENCHMARK_REGISTER_F(dynamic_default_fixture, then_bitswap1_single_thread)->Arg({1<<16})->Arg({256 << 10})->Arg({64 << 20});
+
+BENCHMARK_DEFINE_F(dynamic_default_fixture, fused_bitswap1_single_thread)(benchmark::State& state) {
+
+
+  if (state.thread_index == 0) {
+    SetUp(state);
+  }
+
+  sqeazy::tile_shuffle_scheme<std::uint16_t> local;
+  sqeazy::bitswap_scheme<std::uint16_t> bitswap;
+  local.set_n_threads(1);
+
+  while (state.KeepRunning()) {
+    local.encode_fused(bitswap,
+                       sinus_.data(),
+                       output_.data(),
+                       shape_);
+  }
+
+  state.SetBytesProcessed(int64_t(state.iterations()) *
+                          int64_t(size_)*sizeof(sinus_.front()));
+}
+
+BENCHMARK_REGISTER_F(dynamic_default_fixture, fused_bitswap1_single_thread)->Arg({1<<16})->Arg({256 << 10})->Arg({64 << 20});
+
 BENCHMARK_DEFINE_F(dynamic_default_fixture, two_threads)(benchmark::State& state) {
 
 
@@ -0,0 +1,117 @@
+#define __BENCHMARK_VST_SCHEME_IMPL_CPP__
+
+#include <thread>
+
+#include "encoders/vst_scheme_impl.hpp"
+#include "encoders/quantiser_scheme_impl.hpp"
+#include "benchmark_fixtures.hpp"
+
+typedef sqeazy::benchmark::dynamic_synthetic_data<> dynamic_default_fixture;
+
+/*
+  vst encodes through a table that depends on the camera model only,
+  the quantiser has to build a histogram of every input first
+*/
+template <typename sink_t>
+static void encode_with(dynamic_default_fixture& _fixture,
+                        benchmark::State& state,
+                        sink_t& _sink){
+
+  std::vector<char> encoded(_sink.max_encoded_size(_fixture.size_in_bytes()));
+
+  _sink.encode(_fixture.embryo_.data(),
+               encoded.data(),
+               _fixture.shape_);
+
+  while (state.KeepRunning()) {
+
+    _sink.encode(_fixture.embryo_.data(),
+                 encoded.data(),
+                 _fixture.shape_);
+  }
+
+  state.SetBytesProcessed(int64_t(state.iterations()) *
+                          int64_t(_fixture.size_in_bytes()));
+}
+
+BENCHMARK_DEFINE_F(dynamic_default_fixture, single_thread)(benchmark::State& state) {
+
+  if (state.thread_index == 0) {
+    SetUp(state);
+  }
+
+  sqeazy::vst_scheme<std::uint16_t> local("gain=0.46,offset=100,read_noise=1.6");
+  local.set_n_threads(1);
+  encode_with(*this, state, local);
+}
+
+BENCHMARK_REGISTER_F(dynamic_default_fixture, single_thread)->Arg({256 << 10})->Arg({64 << 20});
+
+BENCHMARK_DEFINE_F(dynamic_default_fixture, max_threads)(benchmark::State& state) {
+
+  if (state.thread_index == 0) {
+    SetUp(state);
+  }
+
+  sqeazy::vst_scheme<std::uint16_t> local("gain=0.46,offset=100,read_noise=1.6");
+  local.set_n_threads(std::thread::hardware_concurrency());
+  encode_with(*this, state, local);
+}
+
+BENCHMARK_REGISTER_F(dynamic_default_fixture, max_threads)->UseRealTime()->Arg({256 << 10})->Arg({64 << 20});
+
+BENCHMARK_DEFINE_F(dynamic_default_fixture, wide_codes_single_thread)(benchmark::State& state) {
+
+  if (state.thread_index == 0) {
+    SetUp(state);
+  }
+
+  sqeazy::vst_scheme<std::uint16_t> local("gain=0.46,offset=100,read_noise=1.6,bits=16,step=0.5");
+  local.set_n_threads(1);
+  encode_with(*this, state, local);
+}
+
+BENCHMARK_REGISTER_F(dynamic_default_fixture, wide_codes_single_thread)->Arg({256 << 10})->Arg({64 << 20});
+
+BENCHMARK_DEFINE_F(dynamic_default_fixture, quantiser_single_thread)(benchmark::State& state) {
+
+  if (state.thread_index == 0) {
+    SetUp(state);
+  }
+
+  sqeazy::quantiser_scheme<std::uint16_t> local;
+  local.set_n_threads(1);
+  encode_with(*this, state, local);
+}
+
+BENCHMARK_REGISTER_F(dynamic_default_fixture, quantiser_single_thread)->Arg({256 << 10})->Arg({64 << 20});
+
+BENCHMARK_DEFINE_F(dynamic_default_fixture, decode_single_thread)(benchmark::State& state) {
+
+  if (state.thread_index == 0) {
+    SetUp(state);
+  }
+
+  sqeazy::vst_scheme<std::uint16_t> local("gain=0.46,offset=100,read_noise=1.6");
+  local.set_n_threads(1);
+
+  std::vector<char> encoded(local.max_encoded_size(size_in_bytes()));
+  local.encode(embryo_.data(),
+               encoded.data(),
+               shape_);
+
+  while (state.KeepRunning()) {
+
+    local.decode(encoded.data(),
+                 output_.data(),
+                 encoded.size(),
+                 output_.size());
+  }
+
+  state.SetBytesProcessed(int64_t(state.iterations()) *
+                          int64_t(size_in_bytes()));
+}
+
+BENCHMARK_REGISTER_F(dynamic_default_fixture, decode_single_thread)->Arg({256 << 10})->Arg({64 << 20});
+
+BENCHMARK_MAIN();
@@ -306,6 +306,12 @@ namespace compass {
         struct avx {};
         struct avx2 {};
 
+        struct bmi2 {};
+
+        struct avx512f {};
+        struct avx512bw {};
+        struct avx512vbmi {};
+
 
     };
 
@@ -815,6 +821,10 @@ namespace compass {
             return instance;
           }
 
+          static std::uint32_t levels(ct::x86_tag){
+            return cache::get().ebx_data_.size();
+          }
+
           static std::uint32_t level(int _lvl, ct::x86_tag){
 
             if(_lvl <= 0){
@@ -1052,6 +1062,42 @@ namespace compass {
         return value;
       }
 
+      static bool has(feature::bmi2 , ct::x86_tag){
+
+        auto regs = rt::cpuid(7,0,0,0);
+
+        bool value = bitview(regs[ct::ebx]).test(8);
+
+        return value;
+      }
+
+      static bool has(feature::avx512f , ct::x86_tag){
+
+        auto regs = rt::cpuid(7,0,0,0);
+
+        bool value = bitview(regs[ct::ebx]).test(16);
+
+        return value;
+      }
+
+      static bool has(feature::avx512bw , ct::x86_tag){
+
+        auto regs = rt::cpuid(7,0,0,0);
+
+        bool value = bitview(regs[ct::ebx]).test(30);
+
+        return value;
+      }
+
+      static bool has(feature::avx512vbmi , ct::x86_tag){
+
+        auto regs = rt::cpuid(7,0,0,0);
+
+        bool value = bitview(regs[ct::ecx]).test(1);
+
+        return value;
+      }
+
     };
 
   };
@@ -1170,6 +1216,14 @@ namespace compass {
                     return compass::runtime::detail::size::cache::level(_lvl,current_arch_t());
 
                 }
+
+                //number of cache levels found on this host
+                static std::uint32_t levels(){
+
+                    using current_arch_t = ct::arch::type;
+                    return compass::runtime::detail::size::cache::levels(current_arch_t());
+
+                }
             };
 
 
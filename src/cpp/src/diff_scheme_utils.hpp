@@ -3,8 +3,15 @@
 
 #include <vector>
 #include <numeric>
+#include <utility>
+#include <algorithm>
+#include <functional>
+#include <cstdint>
+#include <type_traits>
 
+#include "sqeazy_common.hpp"
 #include "traits.hpp"
+#include "neighborhood_utils.hpp"
 
 
 namespace sqeazy {
@@ -99,5 +106,387 @@ T naive_sum(const T* _ptr, const U& _index,
 }
 
 
+/**
+   \brief geometry and predictor of diff_scheme: every voxel inside the halo of the stack is predicted
+   by the mean of its Neighborhood, the sum over the neighborhood wraps around like naive_sum does
+
+   the neighborhoods used by diff_scheme are causal, i.e. a voxel at linear index i depends on voxels
+   before i - causal_distance() only; decode hence walks the stack in chunks of causal_distance() voxels
+   (one plane for last_plane_neighborhood), the voxels of a chunk do not depend on each other and are
+   distributed among threads, so the result does not depend on the number of threads
+
+*/
+template <typename Neighborhood>
+struct neighborhood_mean {
+
+    static const int x_width = Neighborhood::x_offset_end - Neighborhood::x_offset_begin;
+    static const int y_width = Neighborhood::y_offset_end - Neighborhood::y_offset_begin;
+    static const int z_width = Neighborhood::z_offset_end - Neighborhood::z_offset_begin;
+
+    //same as num_traversed_pixels<Neighborhood>(), but known at compile time so that dividing by it vectorizes
+    static const unsigned n_traversed_pixels = x_width*y_width*z_width;
+
+    //shorter chunks are decoded voxel by voxel
+    static const std::size_t min_chunk_size = 1 << 10;
+
+    //chunks are decoded in blocks of at least this many voxels or rows
+    static const std::size_t min_block_size = 1 << 13;
+    static const int block_rows = 16;
+
+    typedef std::pair<std::size_t, std::size_t> range_type;
+
+    /**
+       \brief linear [begin, end) index ranges of the voxels that are predicted, sorted and disjoint
+
+       follows the halo geometry diff_scheme has always used, so that existing buffers decode as before
+
+    */
+    static std::vector<range_type> predicted_ranges(const std::vector<std::size_t>& _shape) {
+
+        const std::size_t length = std::accumulate(_shape.begin(), _shape.end(), std::size_t(1), std::multiplies<std::size_t>());
+
+        std::vector<std::size_t> offsets;
+        sqeazy::halo<Neighborhood, std::size_t> geometry(_shape[row_major::w],
+                                                         _shape[row_major::h],
+                                                         _shape[row_major::d]);
+        geometry.compute_offsets_in_x(offsets);
+
+        std::size_t halo_size_x = geometry.non_halo_end(0)-geometry.non_halo_begin(0);
+        if(offsets.size()==1)//no offsets in other dimensions than x
+            halo_size_x = length - offsets.front();
+
+        std::sort(offsets.begin(), offsets.end());
+
+        std::vector<range_type> value;
+        value.reserve(offsets.size());
+
+        for(const std::size_t offset : offsets) {
+
+            const std::size_t end = std::min(offset + halo_size_x, length);
+            if(offset >= end)
+                continue;
+
+            if(!value.empty() && offset <= value.back().second)
+                value.back().second = std::max(value.back().second, end);
+            else
+                value.push_back(std::make_pair(offset, end));
+        }
+
+        return value;
+    }
+
+    //linear offset of the first and of the last voxel of the neighborhood
+    static std::intmax_t min_offset(const std::vector<std::size_t>& _shape) {
+
+        const std::intmax_t len_x = _shape[row_major::x];
+        const std::intmax_t frame = len_x*_shape[row_major::y];
+
+        return Neighborhood::z_offset_begin*frame + Neighborhood::y_offset_begin*len_x + Neighborhood::x_offset_begin;
+    }
+
+    static std::intmax_t max_offset(const std::vector<std::size_t>& _shape) {
+
+        const std::intmax_t len_x = _shape[row_major::x];
+        const std::intmax_t frame = len_x*_shape[row_major::y];
+
+        return (Neighborhood::z_offset_end - 1)*frame + (Neighborhood::y_offset_end - 1)*len_x + (Neighborhood::x_offset_end - 1);
+    }
+
+    //distance in memory between a voxel and the closest neighbor it depends on, 0 if it depends on itself or later voxels
+    static std::size_t causal_distance(const std::vector<std::size_t>& _shape) {
+
+        const std::intmax_t value = max_offset(_shape);
+        return value < 0 ? -value : 0;
+    }
+
+    /**
+       \brief neighborhood sums of the voxels at linear indices [_begin, _end) of _ptr, modulo the range of T
+
+       sums along x are computed once per row of the neighborhood and carried along y, _window and _rows
+       are scratch space
+
+    */
+    template <typename T>
+    static void sums_of(const T* _ptr,
+                        std::size_t _begin,
+                        std::size_t _end,
+                        const std::vector<std::size_t>& _shape,
+                        T* _sums,
+                        std::vector<T>& _window,
+                        std::vector<T>& _rows) {
+
+        const std::size_t len_x = _shape[row_major::x];
+        const std::intmax_t frame = len_x*_shape[row_major::y];
+        const std::size_t n = _end - _begin;
+        const std::size_t n_window = n + (y_width - 1)*len_x;
+        const std::size_t n_first = std::min(n, len_x);
+
+        if(_window.size() < n_window)
+            _window.resize(n_window);
+        if(z_width > 1 && _rows.size() < n)
+            _rows.resize(n);
+
+        T* window = _window.data();
+        //the sums over y_width rows go straight to _sums if there is only one plane to sum
+        T* rows = z_width > 1 ? _rows.data() : _sums;
+
+        if(z_width > 1)
+            std::fill(_sums, _sums + n, 0);
+
+        for(int dz = Neighborhood::z_offset_begin; dz < Neighborhood::z_offset_end; ++dz) {
+
+            //window sums along x of all rows reached in plane dz
+            const T* first = _ptr + _begin + dz*frame + Neighborhood::y_offset_begin*std::intmax_t(len_x) + Neighborhood::x_offset_begin;
+
+            std::copy(first, first + n_window, window);
+            for(int dx = 1; dx < x_width; ++dx) {
+                const T* shifted = first + dx;
+                for(std::size_t i = 0; i < n_window; ++i)
+                    window[i] += shifted[i];
+            }
+
+            //sums over y_width rows, carried along y
+            for(std::size_t i = 0; i < n_first; ++i) {
+                T sum = 0;
+                for(int dy = 0; dy < y_width; ++dy)
+                    sum += window[i + dy*len_x];
+                rows[i] = sum;
+            }
+
+            const T* entering = window + (y_width - 1)*len_x;
+            const T* leaving = window - len_x;
+            for(std::size_t i = n_first; i < n; ++i)
+                rows[i] = rows[i - len_x] + entering[i] - leaving[i];
+
+            if(z_width > 1) {
+                for(std::size_t i = 0; i < n; ++i)
+                    _sums[i] += rows[i];
+            }
+        }
+    }
+
+    /**
+       \brief the sum divided by the number of voxels in the neighborhood as diff_scheme computes it,
+       i.e. after conversion to the unsigned type twice as wide as T
+
+    */
+    template <typename T>
+    static typename add_unsigned<typename twice_as_wide<T>::type >::type mean_of(T _sum) {
+
+        typedef typename add_unsigned<typename twice_as_wide<T>::type >::type sum_type;
+
+        //for unsigned T the quotient fits into T, dividing in T keeps the vector lanes narrow
+        if(std::is_unsigned<T>::value)
+            return T(_sum / T(n_traversed_pixels));
+        else
+            return sum_type(_sum) / sum_type(n_traversed_pixels);
+    }
+
+    /**
+       \brief call _functor(lo, hi) for every part [lo, hi) of [_begin, _end) that lies inside _ranges
+
+    */
+    template <typename functor_t>
+    static void for_each_predicted(const std::vector<range_type>& _ranges,
+                                   std::size_t _begin,
+                                   std::size_t _end,
+                                   functor_t&& _functor) {
+
+        auto range = std::upper_bound(_ranges.begin(), _ranges.end(), _begin,
+                                      [](std::size_t _index, const range_type& _range) {
+                                          return _index < _range.second;
+                                      });
+
+        for(; range != _ranges.end() && range->first < _end; ++range)
+            _functor(std::max(range->first, _begin), std::min(range->second, _end));
+    }
+
+    /**
+       \brief the prediction: _out[i] = _in[i] - mean of the neighborhood of i in _in,
+       all other voxels are copied
+
+       the neighborhood sums of all voxels are independent, they are computed block by block
+       from sliding sums along x and y (see sums_of), blocks are distributed among _nthreads threads
+
+       \param[in] _in stack to encode
+       \param[out] _out residuals, must not overlap _in
+       \param[in] _shape extent of the stack
+       \param[in] _nthreads number of threads to use
+
+    */
+    template <typename T, typename S>
+    static void encode(const T* _in,
+                       S* _out,
+                       const std::vector<std::size_t>& _shape,
+                       int _nthreads = 1) {
+
+        const std::size_t length = std::accumulate(_shape.begin(), _shape.end(), std::size_t(1), std::multiplies<std::size_t>());
+        const std::vector<range_type> ranges = predicted_ranges(_shape);
+
+        //copy the halo
+        std::size_t copied = 0;
+        for(const range_type& range : ranges) {
+            std::copy(_in + copied, _in + range.first, _out + copied);
+            copied = range.second;
+        }
+        std::copy(_in + copied, _in + length, _out + copied);
+
+        if(ranges.empty())
+            return;
+
+        const std::size_t first = ranges.front().first;
+        const std::size_t span = ranges.back().second - first;
+        const std::size_t block_size = std::max(std::size_t(block_rows)*_shape[row_major::x], min_block_size);
+        const omp_size_type n_blocks = (span + block_size - 1)/block_size;
+
+#pragma omp parallel                            \
+    shared(_out)                                 \
+    num_threads(_nthreads)
+        {
+            std::vector<T> sums;
+            std::vector<T> window;
+            std::vector<T> rows;
+
+#pragma omp for schedule(static)
+            for(omp_size_type b = 0; b < n_blocks; ++b) {
+
+                const std::size_t begin = first + b*block_size;
+                const std::size_t end = std::min(begin + block_size, first + span);
+
+                if(sums.size() < end - begin)
+                    sums.resize(end - begin);
+                sums_of(_in, begin, end, _shape, sums.data(), window, rows);
+
+                for_each_predicted(ranges, begin, end,
+                                   [&](std::size_t _lo, std::size_t _hi) {
+
+                                       const T* in = _in + _lo;
+                                       const T* sum = sums.data() + (_lo - begin);
+                                       S* out = _out + _lo;
+
+                                       for(std::size_t i = 0; i < _hi - _lo; ++i)
+                                           out[i] = in[i] - mean_of(sum[i]);
+                                   });
+            }
+        }
+    }
+
+    /**
+       \brief inverse of the prediction: _out[i] = _in[i] + mean of the neighborhood of i in _out,
+       all other voxels are copied
+
+       \param[in] _in residuals
+       \param[out] _out reconstructed stack, may equal _in
+       \param[in] _shape extent of the stack
+       \param[in] _nthreads number of threads to use
+
+    */
+    template <typename S, typename T>
+    static void decode(const S* _in,
+                       T* _out,
+                       const std::vector<std::size_t>& _shape,
+                       int _nthreads = 1) {
+
+        const std::size_t length = std::accumulate(_shape.begin(), _shape.end(), std::size_t(1), std::multiplies<std::size_t>());
+        const std::vector<range_type> ranges = predicted_ranges(_shape);
+        const std::size_t distance = causal_distance(_shape);
+
+        const bool inplace = (const void*)_in == (const void*)_out;
+
+        if(ranges.empty() || distance < min_chunk_size) {
+
+            //voxel by voxel, neighbors that are not decoded yet are read as residuals
+            if(!inplace)
+                std::copy(_in, _in + length, _out);
+
+            const bool on_line = y_width == 1 && z_width == 1 && distance > 0;
+            const std::intmax_t leaving_offset = min_offset(_shape) - 1;
+            const std::intmax_t entering_offset = max_offset(_shape);
+
+            for(const range_type& range : ranges) {
+
+                T sum = naive_sum<Neighborhood>(_out, range.first,
+                                                _shape[row_major::w],
+                                                _shape[row_major::h],
+                                                _shape[row_major::d]);
+
+                for(std::size_t i = range.first; i < range.second; ++i) {
+
+                    if(i > range.first) {
+                        if(on_line)
+                            sum += _out[i + entering_offset] - _out[i + leaving_offset];
+                        else
+                            sum = naive_sum<Neighborhood>(_out, i,
+                                                          _shape[row_major::w],
+                                                          _shape[row_major::h],
+                                                          _shape[row_major::d]);
+                    }
+
+                    _out[i] = _in[i] + mean_of(sum);
+                }
+            }
+
+            return;
+        }
+
+        //copy the halo
+        if(!inplace) {
+            std::size_t copied = 0;
+            for(const range_type& range : ranges) {
+                std::copy(_in + copied, _in + range.first, _out + copied);
+                copied = range.second;
+            }
+            std::copy(_in + copied, _in + length, _out + copied);
+        }
+
+        const std::size_t first = ranges.front().first;
+        const std::size_t last = ranges.back().second;
+        //blocks small enough for the scratch buffers to stay in cache, but spanning several rows
+        //as the sums of the first row of every block are not carried along y
+        const std::size_t block_size = std::max(std::size_t(block_rows)*_shape[row_major::x], min_block_size);
+
+#pragma omp parallel                            \
+    shared(_out)                                 \
+    num_threads(_nthreads)
+        {
+            std::vector<T> sums;
+            std::vector<T> window;
+            std::vector<T> rows;
+
+            for(std::size_t chunk = first; chunk < last; chunk += distance) {
+
+                const std::size_t chunk_end = std::min(chunk + distance, last);
+                const std::size_t chunk_size = chunk_end - chunk;
+                const omp_size_type n_blocks = std::max<omp_size_type>(_nthreads, (chunk_size + block_size - 1)/block_size);
+
+#pragma omp for schedule(static)
+                for(omp_size_type b = 0; b < n_blocks; ++b) {
+
+                    const std::size_t begin = chunk + (b*chunk_size)/n_blocks;
+                    const std::size_t end = chunk + ((b + 1)*chunk_size)/n_blocks;
+                    if(begin == end)
+                        continue;
+
+                    if(sums.size() < end - begin)
+                        sums.resize(end - begin);
+                    sums_of((const T*)_out, begin, end, _shape, sums.data(), window, rows);
+
+                    for_each_predicted(ranges, begin, end,
+                                       [&](std::size_t _lo, std::size_t _hi) {
+
+                                           const S* in = _in + _lo;
+                                           const T* sum = sums.data() + (_lo - begin);
+                                           T* out = _out + _lo;
+
+                                           for(std::size_t i = 0; i < _hi - _lo; ++i)
+                                               out[i] = in[i] + mean_of(sum[i]);
+                                       });
+                }
+            }
+        }
+    }
+};
+
+
 } //sqeazy
 #endif /* _DIFF_SCHEME_UTILS_H_ */
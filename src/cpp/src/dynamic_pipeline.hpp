@@ -659,6 +659,10 @@ namespace sqeazy
 
           outgoing_t* casted_temp = reinterpret_cast<outgoing_t*>(temp.get());
 
+          //metadata the sink put in front of its payload is not touched by the tail filters
+          const std::size_t metadata_size = sink_->metadata_bytes(_out,encoded_end)/sizeof(outgoing_t);
+          outgoing_t* tail_begin = _out + metadata_size;
+          compressed_size -= metadata_size;
 
           std::vector<std::size_t> sinked_shape(_shape);
 
@@ -667,14 +671,14 @@ namespace sqeazy
             sinked_shape[row_major::x] = compressed_size;
           }
 
-          encoded_end = tail_filters_.encode(_out,
+          encoded_end = tail_filters_.encode(tail_begin,
                                              casted_temp,
                                              sinked_shape);
           if(!encoded_end){
             std::cerr << "[dynamic_pipeline::detail_encode] unable to process data with tail_filters\n";
             return nullptr;
           }
-          encoded_end = std::copy(casted_temp,encoded_end,_out);
+          encoded_end = std::copy(casted_temp,encoded_end,tail_begin);
 
         }
       } else {
@@ -794,13 +798,18 @@ namespace sqeazy
         std::vector<outgoing_t> sink_in;
 
         if(tail_filters_.size()){
-          const outgoing_t* tail_in = reinterpret_cast<const outgoing_t*>(_in);
+          //metadata the sink put in front of its payload was not touched by the tail filters
+          const std::size_t metadata_size = sink_->metadata_bytes(compressor_begin,compressor_begin+input_len)/sizeof(*_in);
+          const outgoing_t* tail_in = reinterpret_cast<const outgoing_t*>(_in) + metadata_size;
+          if(!in_shape.empty())
+            in_shape.back() = input_len - metadata_size;
 
           //FIXME: filters may change the size of the buffer!
-          sink_in.resize(output_len*sizeof(*_out)/*/sizeof(*_in)*/);
+          sink_in.resize(metadata_size + output_len*sizeof(*_out)/*/sizeof(*_in)*/);
           std::fill(sink_in.begin(), sink_in.end(),0);
+          std::copy(_in, _in + metadata_size, sink_in.begin());
 
-          outgoing_t* tail_out = reinterpret_cast<outgoing_t*>(sink_in.data());
+          outgoing_t* tail_out = reinterpret_cast<outgoing_t*>(sink_in.data()) + metadata_size;
 
           err_code = tail_filters_.decode(tail_in,
                                           tail_out,
@@ -856,6 +865,9 @@ namespace sqeazy
        store_only_sum->max_encoded_size(400) = 8
        * the result would be: 2*100 + max(400,8) = 600 Bytes!
 
+       filters that store state in the header (their bound exceeds the input) add that excess on top once, see stage_chain::max_header_growth,
+       their own contribution to the maximum is the payload alone, see stage_chain::max_payload_size
+
 
        \param[in]
 
@@ -872,15 +884,19 @@ namespace sqeazy
 
       std::intmax_t value = hdr.size()*2;
 
+      //the state filters put into the header is not part of what the sink or the tail filters bound
+      value += head_filters_.max_header_growth(_incoming_size_byte);
+      value += tail_filters_.max_header_growth(_incoming_size_byte);
+
       std::vector<std::intmax_t> max_enc_size;
       if(head_filters_.size())
-        max_enc_size.push_back(head_filters_.max_encoded_size(_incoming_size_byte));
+        max_enc_size.push_back(head_filters_.max_payload_size(_incoming_size_byte));
 
       if(sink_)
         max_enc_size.push_back(sink_->max_encoded_size(_incoming_size_byte));
 
       if(tail_filters_.size())
-        max_enc_size.push_back(tail_filters_.max_encoded_size(_incoming_size_byte));
+        max_enc_size.push_back(tail_filters_.max_payload_size(_incoming_size_byte));
 
       if(!max_enc_size.empty())
         return value + *std::max_element(max_enc_size.begin(), max_enc_size.end());
@@ -81,6 +81,19 @@ namespace sqeazy{
     };
 
 
+    /**
+       \brief encode the input by this stage immediately followed by _next in one pass,
+       the result must be identical to calling encode of this stage and then encode of _next
+
+       \return
+       \retval nullptr if this stage cannot be fused with _next
+
+    */
+    virtual out_type* encode_fused(const filter& _next,
+                                   const in_type*,
+                                   out_type*,
+                                   const std::vector<std::size_t>&) {return nullptr;};
+
     virtual int decode(const in_type*,
                out_type*,
                const std::vector<std::size_t>&,
@@ -150,6 +163,16 @@ namespace sqeazy{
                std::vector<std::size_t> _outshape = std::vector<std::size_t>()) const {return 1;};
 
     virtual std::intmax_t max_encoded_size(std::intmax_t _incoming_size_byte) const override { return 0; };
+
+    /**
+       \brief number of leading bytes of the encoded buffer [_begin,_end) that carry stage metadata
+       rather than encoded items, pipelines pass these bytes around any filters that follow the sink
+
+       \return size of the metadata section in bytes (0 if there is none)
+       \retval
+
+    */
+    virtual std::size_t metadata_bytes(const out_type* _begin, const out_type* _end) const { return 0; };
   };
 
 
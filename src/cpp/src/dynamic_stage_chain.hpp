@@ -187,6 +187,35 @@ namespace sqeazy {
                 return name();
             }
 
+        /**
+           \brief run stage _fidx of the chain on _in, if the stage can be fused with its successor
+           both are run in one pass and _fidx is advanced to the successor
+
+           \return
+           \retval end of the output written or nullptr on failure
+
+        */
+        outgoing_t* encode_step(std::size_t& _fidx,
+                                const incoming_t *_in,
+                                outgoing_t *_out,
+                                const std::vector<std::size_t>& _shape){
+
+            outgoing_t* value = nullptr;
+
+            if((_fidx + 1) < chain_.size())
+                value = chain_[_fidx]->encode_fused(*chain_[_fidx+1], _in, _out, _shape);
+
+            if(value){
+#ifdef _SQY_VERBOSE_
+                std::cout << "[SQY_VERBOSE] [stage_chain::encode]\tfused " << chain_[_fidx]->name() << " and " << chain_[_fidx+1]->name() << "\n";
+#endif
+                ++_fidx;
+                return value;
+            }
+
+            return chain_[_fidx]->encode( _in, _out, _shape);
+        }
+
         /**
            \brief encode one-dimensional array _in and write results to _out
 
@@ -235,13 +264,15 @@ namespace sqeazy {
             incoming_t * in_ptr = temp_in.data();
 
             std::size_t compressed_items = 0;
+            std::size_t n_passes = 0;
 
-            for( std::size_t fidx = 0;fidx<chain_.size();++fidx )
+            for( std::size_t fidx = 0;fidx<chain_.size();++fidx,++n_passes )
             {
 
-                value = chain_[fidx]->encode( in_ptr,
-                                              out_ptr,
-                                              _shape);
+                value = encode_step(fidx,
+                                    in_ptr,
+                                    out_ptr,
+                                    _shape);
 
                 if(value)
                     compressed_items = std::distance(out_ptr,value);
@@ -258,7 +289,7 @@ namespace sqeazy {
                 std::swap(in_ptr,out_ptr);
             }
 
-            if(chain_.size() % 2 == 0){
+            if(n_passes % 2 == 0){
                 value = std::copy(reinterpret_cast<outgoing_t*>(temp_in.data()),
                                   value,
                                   _out);
@@ -297,13 +328,15 @@ namespace sqeazy {
             incoming_t * in_ptr = nullptr;
 
             std::size_t compressed_items = 0;
+            std::size_t n_passes = 0;
 
-            for( std::size_t fidx = 0;fidx<chain_.size();++fidx )
+            for( std::size_t fidx = 0;fidx<chain_.size();++fidx,++n_passes )
             {
 
-                value = chain_[fidx]->encode( in_ptr ?  in_ptr : _in,
-                                              out_ptr,
-                                              _shape);
+                value = encode_step(fidx,
+                                    in_ptr ?  in_ptr : _in,
+                                    out_ptr,
+                                    _shape);
 
                 if(value)
                     compressed_items = std::distance(out_ptr,value);
@@ -322,7 +355,7 @@ namespace sqeazy {
                 std::swap(in_ptr,out_ptr);
             }
 
-            if(chain_.size() % 2 == 0){
+            if(n_passes % 2 == 0){
                 value = std::copy(reinterpret_cast<outgoing_t*>(in_ptr),
                                   value,
                                   _out);
@@ -400,6 +433,35 @@ namespace sqeazy {
 
 
         }
+
+        /**
+           \brief like max_encoded_size, but without the state the stages store in the header (see max_header_growth)
+
+        */
+        std::intmax_t max_payload_size(std::intmax_t _incoming_size_byte) const {
+
+            std::intmax_t value = 0;
+            for( auto & f : chain_ )
+                value = (std::max)(value, (std::min)(f->max_encoded_size(_incoming_size_byte), _incoming_size_byte));
+
+            return value;
+        }
+
+        /**
+           \brief sum of the amounts by which the bounds of the stages exceed _incoming_size_byte
+
+           filters keep the size of the data, a bound above it is state that a filter stores in the header
+           after encoding (e.g. a background map), the header of a pipeline grows by at most this much
+
+        */
+        std::intmax_t max_header_growth(std::intmax_t _incoming_size_byte) const {
+
+            std::intmax_t value = 0;
+            for( auto & f : chain_ )
+                value += (std::max)(std::intmax_t(0), f->max_encoded_size(_incoming_size_byte) - _incoming_size_byte);
+
+            return value;
+        }
     };
 
 
@@ -0,0 +1,206 @@
+#ifndef _BACKGROUND_MAP_SCHEME_IMPL_H_
+#define _BACKGROUND_MAP_SCHEME_IMPL_H_
+
+#include <sstream>
+#include <string>
+#include <functional>
+#include <numeric>
+#include <algorithm>
+
+#include "sqeazy_common.hpp"
+#include "traits.hpp"
+#include "dynamic_stage.hpp"
+#include "string_parsers.hpp"
+
+#include "brick_utils.hpp"
+#include "background_map_utils.hpp"
+
+namespace sqeazy {
+
+
+  /**
+* @brief spatially varying background removal: the <percentile> of the intensities is computed for every tile of
+* the stack (default: 16x64x64 in z,y,x), the background of every voxel is interpolated trilinearly between the
+* centers of the surrounding tiles and subtracted (saturating at 0)
+*
+* the map of tile backgrounds is stored in the header (config), with restore=1 decode adds the interpolated
+* background back, otherwise decode copies the input
+*
+* this scheme is not reversable, values below the background are lost
+*
+*/
+  template <typename in_type>
+  struct background_map_scheme : public filter<in_type> {
+
+    typedef filter<in_type> base_type;
+    typedef in_type raw_type;
+    typedef in_type compressed_type;
+
+    static_assert(std::is_arithmetic<raw_type>::value==true,"[background_map_scheme] input type is non-arithmetic");
+    static const std::string description() { return std::string("subtract a background that is interpolated trilinearly between the <percentile|default = 0.5> of the intensities in tiles of <tile_z|default = 16>x<tile_y|default = 64>x<tile_x|default = 64> items, the map of tile backgrounds is stored in the header; <restore|default = 0> add the background back when decoding"); };
+
+    detail::background_map<raw_type> background;
+    bool restore;
+
+    background_map_scheme(const std::string& _payload=""):
+      background(),
+      restore(false)
+      {
+
+        pipeline_parser p;
+        auto config_map = p.minors(_payload.begin(),_payload.end());
+
+        if(config_map.size()){
+
+          static const std::string axes[3] = {"tile_z", "tile_y", "tile_x"};
+          for(int d = 0;d<3;++d){
+            auto f_itr = config_map.find(axes[d]);
+            if(f_itr!=config_map.end())
+              background.tile_shape[d] = std::stoul(f_itr->second);
+          }
+
+          auto f_itr = config_map.find("percentile");
+          if(f_itr!=config_map.end())
+            background.percentile = std::stof(f_itr->second);
+
+          f_itr = config_map.find("restore");
+          if(f_itr!=config_map.end())
+            restore = (f_itr->second == "1" || f_itr->second == "true");
+
+          f_itr = config_map.find("map");
+          if(f_itr!=config_map.end() && !f_itr->second.empty()){
+            background.values.resize(parsing::verbatim_yields_n_items_of<raw_type>(f_itr->second));
+            parsing::verbatim_to_range(f_itr->second, background.values.begin(), background.values.end());
+          }
+        }
+
+        for(std::size_t& _tile : background.tile_shape){
+          if(!_tile){
+            std::cerr << "[background_map_scheme] tiles of size 0 are not supported, using 1\n";
+            _tile = 1;
+          }
+        }
+
+        if(!(background.percentile >= 0.f && background.percentile <= 1.f)){
+          std::cerr << "[background_map_scheme] percentile=" << background.percentile << " is not supported, expected a value in [0,1], using 0.5\n";
+          background.percentile = .5f;
+        }
+      }
+
+    std::string name() const override final {
+
+      return std::string("rmbkrd_map");
+
+    }
+
+    std::string config() const override final {
+
+      std::ostringstream msg;
+      msg << "tile_z=" << background.tile_shape[row_major::z] << ","
+          << "tile_y=" << background.tile_shape[row_major::y] << ","
+          << "tile_x=" << background.tile_shape[row_major::x] << ","
+          << "percentile=" << std::to_string(background.percentile) << ","
+          << "restore=" << int(restore);
+
+      if(!background.values.empty())
+        msg << ",map=" << parsing::range_to_verbatim(background.values.begin(), background.values.end());
+
+      return msg.str();
+
+    }
+
+    /**
+       \brief the payload keeps its size, but encode puts the map into the header (see config): the bound includes
+       the map of the most tiles a stack of _size_bytes can hold
+
+    */
+    std::intmax_t max_encoded_size(std::intmax_t _size_bytes) const override final {
+
+      const std::size_t n_items = _size_bytes/sizeof(raw_type);
+      const std::size_t min_tile = *std::min_element(background.tile_shape.begin(), background.tile_shape.end());
+      const std::size_t map_bytes = detail::max_bricks(n_items, min_tile)*sizeof(raw_type);
+
+      return _size_bytes + std::string(",map=").size() + parsing::verbatim_bytes_in_header(map_bytes);
+    }
+
+    compressed_type* encode( const raw_type* _input, compressed_type* _output, std::size_t _input_size) override final {
+
+      return encode(_input, _output, std::vector<std::size_t>(1,_input_size));
+
+    }
+
+    compressed_type* encode( const raw_type* _input, compressed_type* _output, const std::vector<std::size_t>& _shape) override final {
+
+      background.estimate(_input, _shape, this->n_threads());
+
+      return background.subtract(_input, _output, _shape, this->n_threads());
+
+    }
+
+    int decode( const compressed_type* _input,
+                raw_type* _output,
+                std::size_t _input_size,
+                std::size_t _output_size = 0) const override final {
+
+      return decode(_input, _output, std::vector<std::size_t>(1,_input_size), std::vector<std::size_t>());
+    }
+
+    int decode( const compressed_type* _input, raw_type* _output,
+                const std::vector<std::size_t>& _shape,
+                std::vector<std::size_t>) const override final {
+
+      const std::size_t length = std::accumulate(_shape.begin(), _shape.end(), 1, std::multiplies<std::size_t>());
+
+      if(restore){
+
+        const std::vector<std::size_t> grid = background.tiles_of(_shape);
+        if(background.values.size() != grid[row_major::z]*grid[row_major::y]*grid[row_major::x]){
+          std::cerr << "[background_map_scheme] the background map holds " << background.values.size()
+                    << " tiles, the stack has " << grid[row_major::z]*grid[row_major::y]*grid[row_major::x] << "\n";
+          return FAILURE;
+        }
+
+        background.add(_input, _output, _shape, this->n_threads());
+        return SUCCESS;
+      }
+
+      if(_input!=_output ){
+
+        if(this->n_threads() == 1)
+          std::copy(_input, _input + length, _output);
+        else{
+          const int nthreads = this->n_threads();
+          omp_size_type len = length;
+
+          #pragma omp parallel for                  \
+            shared(_output)                                             \
+            firstprivate( _input )                                      \
+            num_threads(nthreads)
+          for(omp_size_type i = 0;i<len;++i){
+            _output[i] = _input[i];
+          }
+        }
+      }
+
+      return SUCCESS;
+    }
+
+    ~background_map_scheme(){};
+
+    std::string output_type() const final override {
+
+      return sqeazy::header_utils::represent<compressed_type>::as_string();
+
+    }
+
+    bool is_compressor() const final override {
+
+      return base_type::is_compressor;
+
+    }
+
+  };
+
+}
+
+#endif /* _BACKGROUND_MAP_SCHEME_IMPL_H_ */
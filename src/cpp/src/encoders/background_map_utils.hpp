@@ -0,0 +1,345 @@
+#ifndef _BACKGROUND_MAP_UTILS_H_
+#define _BACKGROUND_MAP_UTILS_H_
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <climits>
+#include <limits>
+#include <type_traits>
+
+#include "sqeazy_common.hpp"
+#include "traits.hpp"
+#include "saturating_subtract_utils.hpp"
+
+namespace sqeazy {
+
+  namespace detail {
+
+    /**
+       \brief linear interpolation between the centers of the tiles along one axis: coordinate c lies between
+       the centers of tile first[c] and first[c]+1 (or on the first/last center if it is outside of them),
+       weight[c] is the share of tile first[c]+1; runs holds the coordinates at which first changes (and _len),
+       so the interpolation can be done run by run without looking up the tiles of every coordinate
+    */
+    struct tile_interpolation {
+
+      std::vector<std::uint32_t> first;
+      std::vector<std::uint32_t> second;
+      std::vector<float> weight;
+      std::vector<std::size_t> runs;
+
+      tile_interpolation(std::size_t _len, std::size_t _tile, std::size_t _n_tiles):
+        first(_len,0),
+        second(_len,0),
+        weight(_len,0),
+        runs()
+      {
+
+        for(std::size_t c = 0;c<_len;++c){
+
+          //center of tile t is at (t + 0.5)*_tile - 0.5
+          const float position = (float(c) + .5f)/float(_tile) - .5f;
+          const float clamped = (std::min)((std::max)(position, 0.f), float(_n_tiles - 1));
+          const std::size_t lower = (std::min)(std::size_t(clamped), _n_tiles - 1);
+
+          first[c] = lower;
+          second[c] = (std::min)(lower + 1, _n_tiles - 1);
+          weight[c] = clamped - float(lower);
+
+          if(!c || first[c] != first[c-1])
+            runs.push_back(c);
+        }
+
+        runs.push_back(_len);
+      }
+    };
+
+    /**
+       \brief coarse background of a 3D stack: the _percentile of the intensities of every tile of the stack,
+       the background of a voxel is interpolated trilinearly from the values of the 8 surrounding tile centers
+
+       histograms are used for integral types of at most 16 bits, other types select the percentile from a copy of the tile
+    */
+    template <typename raw_t>
+    struct background_map {
+
+      static const bool use_histogram = std::is_integral<raw_t>::value && sizeof(raw_t) <= 2;
+
+      typedef typename std::conditional<std::is_integral<raw_t>::value,
+                                        typename std::make_unsigned<raw_t>::type,
+                                        std::uint16_t>::type key_t;
+
+      //flipping the sign bit maps signed values to keys of the same order
+      static const key_t sign_bit = std::is_signed<raw_t>::value && std::is_integral<raw_t>::value ? key_t(key_t(1) << (sizeof(key_t)*CHAR_BIT - 1)) : key_t(0);
+
+      static const std::size_t n_bins = std::size_t(1) << (sizeof(key_t)*CHAR_BIT);
+      //neighboring items are counted in different banks, so that runs of equal values do not serialize the increments
+      static const std::size_t n_banks = 2;
+
+      std::vector<std::size_t> tile_shape;
+      float percentile;
+
+      std::vector<std::size_t> grid_shape;
+      std::vector<raw_t> values;
+
+      background_map(const std::vector<std::size_t>& _tile_shape = {16,64,64}, float _percentile = .5f):
+        tile_shape(_tile_shape),
+        percentile(_percentile),
+        grid_shape(3,0),
+        values()
+      {}
+
+      /**
+         \brief shapes of less than 3 dimensions are treated as a single plane or row
+      */
+      static std::vector<std::size_t> as_3d(const std::vector<std::size_t>& _shape){
+
+        std::vector<std::size_t> value(3,1);
+        const std::size_t n = (std::min)(_shape.size(), std::size_t(3));
+        std::copy(_shape.end() - n, _shape.end(), value.end() - n);
+        return value;
+      }
+
+      std::vector<std::size_t> tiles_of(const std::vector<std::size_t>& _shape) const {
+
+        const std::vector<std::size_t> shape = as_3d(_shape);
+        std::vector<std::size_t> value(3,0);
+        for(int d = 0;d<3;++d)
+          value[d] = (shape[d] + tile_shape[d] - 1)/tile_shape[d];
+        return value;
+      }
+
+      //index of the item at the _percentile of _n sorted items
+      std::size_t rank(std::size_t _n) const {
+        return (std::min)(std::size_t(percentile*(_n - 1) + .5f), _n - 1);
+      }
+
+      /**
+         \brief compute the percentile of every tile, tiles are distributed among _nthreads threads
+         which use a private histogram each
+      */
+      void estimate(const raw_t* _input, const std::vector<std::size_t>& _shape, int _nthreads = 1){
+
+        const std::vector<std::size_t> shape = as_3d(_shape);
+        grid_shape = tiles_of(shape);
+        values.resize(grid_shape[row_major::z]*grid_shape[row_major::y]*grid_shape[row_major::x]);
+
+        const omp_size_type n_tiles = values.size();
+        raw_t* dst = values.data();
+
+#pragma omp parallel                            \
+  shared( dst )                                 \
+  num_threads(_nthreads)
+        {
+          std::vector<std::uint32_t> bins(use_histogram ? n_bins*n_banks : 0, 0);
+          std::vector<raw_t> copy;
+
+#pragma omp for schedule(dynamic)
+          for(omp_size_type t = 0;t<n_tiles;++t)
+            dst[t] = tile_percentile(_input, shape, t, bins, copy);
+        }
+      }
+
+      raw_t tile_percentile(const raw_t* _input,
+                            const std::vector<std::size_t>& _shape,
+                            std::size_t _tile,
+                            std::vector<std::uint32_t>& _bins,
+                            std::vector<raw_t>& _copy) const {
+
+        const std::size_t len_y = _shape[row_major::y];
+        const std::size_t len_x = _shape[row_major::x];
+
+        const std::size_t tx = _tile % grid_shape[row_major::x];
+        const std::size_t ty = (_tile / grid_shape[row_major::x]) % grid_shape[row_major::y];
+        const std::size_t tz = _tile / (grid_shape[row_major::x]*grid_shape[row_major::y]);
+
+        const std::size_t z_begin = tz*tile_shape[row_major::z];
+        const std::size_t z_end = (std::min)(z_begin + tile_shape[row_major::z], _shape[row_major::z]);
+        const std::size_t y_begin = ty*tile_shape[row_major::y];
+        const std::size_t y_end = (std::min)(y_begin + tile_shape[row_major::y], len_y);
+        const std::size_t x_begin = tx*tile_shape[row_major::x];
+        const std::size_t x_end = (std::min)(x_begin + tile_shape[row_major::x], len_x);
+
+        const std::size_t n = (z_end - z_begin)*(y_end - y_begin)*(x_end - x_begin);
+        const std::size_t k = rank(n);
+
+        if(!use_histogram){
+          _copy.clear();
+          for(std::size_t z = z_begin;z<z_end;++z)
+            for(std::size_t y = y_begin;y<y_end;++y){
+              const raw_t* row = _input + (z*len_y + y)*len_x;
+              _copy.insert(_copy.end(), row + x_begin, row + x_end);
+            }
+          std::nth_element(_copy.begin(), _copy.begin() + k, _copy.end());
+          return _copy[k];
+        }
+
+        std::uint32_t* bins = _bins.data();
+        key_t min_key = (std::numeric_limits<key_t>::max)();
+        key_t max_key = 0;
+
+        for(std::size_t z = z_begin;z<z_end;++z)
+          for(std::size_t y = y_begin;y<y_end;++y){
+            const raw_t* row = _input + (z*len_y + y)*len_x;
+            std::size_t x = x_begin;
+            for(;x + 1 < x_end;x += 2){
+              bins[key_t(row[x]) ^ sign_bit]++;
+              bins[n_bins + (key_t(row[x+1]) ^ sign_bit)]++;
+            }
+            if(x < x_end)
+              bins[key_t(row[x]) ^ sign_bit]++;
+
+            //a separate loop lets the compiler vectorize the reduction
+            for(x = x_begin;x<x_end;++x){
+              const key_t key = key_t(row[x]) ^ sign_bit;
+              min_key = (std::min)(min_key, key);
+              max_key = (std::max)(max_key, key);
+            }
+          }
+
+        //only the populated range is scanned and cleared for the next tile
+        std::size_t running = 0;
+        std::size_t found = max_key;
+        for(std::size_t key = min_key;key<=max_key;++key){
+          running += bins[key] + bins[n_bins + key];
+          if(running > k){
+            found = key;
+            break;
+          }
+        }
+        std::fill(bins + min_key, bins + std::size_t(max_key) + 1, 0);
+        std::fill(bins + n_bins + min_key, bins + n_bins + std::size_t(max_key) + 1, 0);
+
+        return raw_t(key_t(found) ^ sign_bit);
+      }
+
+      //round to the nearest value of raw_t, the interpolated values lie within the range of the map
+      static raw_t to_raw(float _value){
+
+        if(!std::is_integral<raw_t>::value)
+          return raw_t(_value);
+
+        return std::is_signed<raw_t>::value ? raw_t(std::floor(_value + .5f)) : raw_t(_value + .5f);
+      }
+
+      /**
+         \brief call _functor(row_offset, background) for every row of the stack, background holds the interpolated
+         background of the len_x items of the row; rows are distributed among _nthreads threads,
+         values must hold the tiles of _shape
+
+      */
+      template <typename Functor>
+      void for_each_row(const std::vector<std::size_t>& _shape, Functor _functor, int _nthreads = 1) const {
+
+        const std::vector<std::size_t> shape = as_3d(_shape);
+        const std::vector<std::size_t> grid = tiles_of(shape);
+        const std::size_t len_y = shape[row_major::y];
+        const std::size_t len_x = shape[row_major::x];
+        const std::size_t gy = grid[row_major::y];
+        const std::size_t gx = grid[row_major::x];
+
+        const tile_interpolation along_z(shape[row_major::z], tile_shape[row_major::z], grid[row_major::z]);
+        const tile_interpolation along_y(len_y, tile_shape[row_major::y], gy);
+        const tile_interpolation along_x(len_x, tile_shape[row_major::x], gx);
+
+        const omp_size_type n_rows = shape[row_major::z]*len_y;
+        const raw_t* map = values.data();
+
+#pragma omp parallel                            \
+  shared( _functor )                            \
+  num_threads(_nthreads)
+        {
+          //background at the tile centers along x for the current row, then for every item of the row
+          std::vector<float> centers(gx, 0.f);
+          std::vector<raw_t> background(len_x, 0);
+          float* c = centers.data();
+          raw_t* bg = background.data();
+
+          const float* x_weight = along_x.weight.data();
+          const std::size_t n_runs = along_x.runs.size() - 1;
+
+#pragma omp for schedule(static)
+          for(omp_size_type r = 0;r<n_rows;++r){
+
+            const std::size_t z = r / len_y;
+            const std::size_t y = r % len_y;
+
+            const float wz = along_z.weight[z];
+            const float wy = along_y.weight[y];
+            const raw_t* z0y0 = map + (along_z.first[z]*gy + along_y.first[y])*gx;
+            const raw_t* z0y1 = map + (along_z.first[z]*gy + along_y.second[y])*gx;
+            const raw_t* z1y0 = map + (along_z.second[z]*gy + along_y.first[y])*gx;
+            const raw_t* z1y1 = map + (along_z.second[z]*gy + along_y.second[y])*gx;
+
+            for(std::size_t t = 0;t<gx;++t){
+              const float z0 = float(z0y0[t]) + wy*(float(z0y1[t]) - float(z0y0[t]));
+              const float z1 = float(z1y0[t]) + wy*(float(z1y1[t]) - float(z1y0[t]));
+              c[t] = z0 + wz*(z1 - z0);
+            }
+
+            for(std::size_t k = 0;k<n_runs;++k){
+
+              const std::size_t x_begin = along_x.runs[k];
+              const std::size_t x_end = along_x.runs[k+1];
+              const float lower = c[along_x.first[x_begin]];
+              const float delta = c[along_x.second[x_begin]] - lower;
+
+              for(std::size_t x = x_begin;x<x_end;++x)
+                bg[x] = to_raw(lower + x_weight[x]*delta);
+            }
+
+            _functor(r*len_x, (const raw_t*)bg);
+          }
+        }
+      }
+
+      /**
+         \brief _output = _input - background, saturating at 0 (_input may equal _output)
+      */
+      raw_t* subtract(const raw_t* _input, raw_t* _output, const std::vector<std::size_t>& _shape, int _nthreads = 1) const {
+
+        const std::vector<std::size_t> shape = as_3d(_shape);
+        const std::size_t len_x = shape[row_major::x];
+
+        for_each_row(shape,
+                     [=](std::size_t _row, const raw_t* _background){
+                       saturating::subtract_each(_input + _row, len_x, _background, _output + _row);
+                     },
+                     _nthreads);
+
+        return _output + shape[row_major::z]*shape[row_major::y]*len_x;
+      }
+
+      /**
+         \brief _output = _input + background, saturating at the largest value of raw_t (_input may equal _output)
+      */
+      raw_t* add(const raw_t* _input, raw_t* _output, const std::vector<std::size_t>& _shape, int _nthreads = 1) const {
+
+        typedef typename std::conditional<std::is_integral<raw_t>::value, typename twice_as_wide<raw_t>::type, raw_t>::type sum_t;
+        static const sum_t max_value = (std::numeric_limits<raw_t>::max)();
+
+        const std::vector<std::size_t> shape = as_3d(_shape);
+        const std::size_t len_x = shape[row_major::x];
+
+        for_each_row(shape,
+                     [=](std::size_t _row, const raw_t* _background){
+                       const raw_t* in = _input + _row;
+                       raw_t* out = _output + _row;
+                       for(std::size_t x = 0;x<len_x;++x){
+                         const sum_t sum = sum_t(in[x]) + sum_t(_background[x]);
+                         out[x] = sum > max_value ? raw_t(max_value) : raw_t(sum);
+                       }
+                     },
+                     _nthreads);
+
+        return _output + shape[row_major::z]*shape[row_major::y]*len_x;
+      }
+    };
+
+  };
+
+};
+
+#endif /* _BACKGROUND_MAP_UTILS_H_ */
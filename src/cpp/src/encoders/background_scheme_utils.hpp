@@ -4,6 +4,10 @@
 #include <climits>
 #include <iostream>
 #include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <type_traits>
+#include "sqeazy_common.hpp"
 #include "traits.hpp"
 #include "neighborhood_utils.hpp"
 #include "hist_impl.hpp"
@@ -11,107 +15,216 @@
 namespace sqeazy {
 
 
-    template <typename raw_type, typename size_type>
+  namespace detail {
+
     /**
-     * @brief search for the place with the lowest mean value (median would be too expensive).
-     * the current implementation loops through the first & last two x-y planes
-     * as well as the first & last z-x plane
-     *
-     * @param _input 3D stack that is to be parsed
-     * @param _dims dimensionality of the input complying to c_storage_order _dims[] = {z-shape,y-shape,x-shape}
-     * @param _darkest_face (inout type) this is the vector that will contain the result
-     * @return const void
-     */
-    static const void extract_darkest_face(const raw_type* _input,
-                                           const std::vector<size_type>& _dims,
-                                           std::vector<raw_type>& _darkest_face) {
+       \brief 2D face of a 3D stack seen through the memory of the stack, i.e. _n_rows rows of _row_length
+       contiguous items, row r starts at offset + r*row_stride
+    */
+    struct strided_face {
+
+      std::size_t offset;
+      std::size_t n_rows;
+      std::size_t row_length;
+      std::size_t row_stride;
+
+      std::size_t size() const {
+        return n_rows*row_length;
+      }
+    };
 
-      typedef typename add_unsigned<typename twice_as_wide<size_type>::type >::type index_type;
+    /**
+       \brief faces of the stack that are candidates for the background: the first & last x-y plane as well as
+       the first & last z-x plane, faces that coincide (stacks of 1 plane or 1 row) are listed once
 
-#ifdef _WIN32
-	  raw_type support = (std::numeric_limits<raw_type>::max)();
-#else
-      raw_type support = std::numeric_limits<raw_type>::max();
-#endif
-      index_type input_index =0;
-      const index_type frame_size = _dims[_dims.size()-2]*_dims[_dims.size()-1];
+       \param[in] _dims dimensionality of the input complying to c_storage_order _dims[] = {z-shape,y-shape,x-shape}
+    */
+    template <typename size_type>
+    static std::vector<strided_face> candidate_faces(const std::vector<size_type>& _dims){
 
-      sqeazy::histogram<raw_type> running_histo;
-      float temp = 0;
+      std::vector<strided_face> value;
 
-#ifdef _SQY_VERBOSE_
-      std::cout << "[SQY_VERBOSE]\t extract_darkest_face on image ";
-      for(auto i = 0;i<_dims.size();++i){
-        std::cout << _dims[i] << ((_dims[i]!=_dims.back()) ? "x" : " ");
-      }
-      std::cout << "\n";
-#endif
-      //faces with z
-      const size_type indices[2] = {0,_dims[row_major::z]-1};
-      size_type z_idx = 0;
+      const std::size_t len_z = _dims[row_major::z];
+      const std::size_t len_y = _dims[row_major::y];
+      const std::size_t len_x = _dims[row_major::x];
+      const std::size_t frame = len_y*len_x;
 
-      for(size_type z_idx_ctr = 0;
-          z_idx_ctr < 2;
-          ++z_idx_ctr ) {
+      if(!len_z || !frame)
+        return value;
 
-        z_idx = indices[z_idx_ctr];
-        if(!(z_idx < _dims[row_major::z])){
-          continue;
+      value.push_back({0, len_y, len_x, len_x});
+      if(len_z > 1)
+        value.push_back({(len_z-1)*frame, len_y, len_x, len_x});
+
+      value.push_back({0, len_z, len_x, frame});
+      if(len_y > 1)
+        value.push_back({(len_y-1)*len_x, len_z, len_x, frame});
+
+      return value;
+    }
+
+    /**
+       \brief histogram all _faces of _input in one pass, the rows of all faces are distributed among _nthreads threads
+       which count into private bins that are summed up afterwards
+
+       \param[in] _input 3D stack
+       \param[in] _faces faces to histogram
+       \param[out] _histos one histogram per face, counts are added to the existing ones
+       \param[in] _nthreads number of threads to use
+    */
+    template <typename raw_type>
+    static void fill_face_histograms(const raw_type* _input,
+                                     const std::vector<strided_face>& _faces,
+                                     std::vector<histogram<raw_type> >& _histos,
+                                     int _nthreads = 1){
+
+      typedef typename std::make_unsigned<raw_type>::type index_type;
+      typedef typename histogram<raw_type>::bins_type bins_type;
+
+      const std::size_t num_bins = histogram<raw_type>::num_bins;
+      const std::size_t n_faces = _faces.size();
+      _histos.resize(n_faces);
+
+      for(std::size_t f = 0;f<n_faces;++f)
+        _histos[f].num_entries += _faces[f].size();
+
+      if(_nthreads == 1){
+        for(std::size_t f = 0;f<n_faces;++f){
+          const strided_face& face = _faces[f];
+          bins_type* bins = _histos[f].bins.data();
+
+          for(std::size_t r = 0;r<face.n_rows;++r){
+            const raw_type* row = _input + face.offset + r*face.row_stride;
+            for(std::size_t x = 0;x<face.row_length;++x)
+              bins[index_type(row[x])]++;
+          }
         }
+        return;
+      }
 
-        input_index = z_idx*(frame_size);
-        const raw_type* begin = _input + input_index;
-        running_histo.clear();
+      //bins of face f of thread t start at (t*n_faces + f)*num_bins
+      std::vector<bins_type> private_bins(std::size_t(_nthreads)*n_faces*num_bins, 0);
+      bins_type* private_itr = private_bins.data();
+      const strided_face* faces = _faces.data();
+
+#pragma omp parallel                            \
+  shared( private_itr )                         \
+  firstprivate( _input, faces )                 \
+  num_threads(_nthreads)
+      {
+        bins_type* my_bins = private_itr + omp_get_thread_num()*n_faces*num_bins;
+
+        for(std::size_t f = 0;f<n_faces;++f){
+
+          const strided_face face = faces[f];
+          bins_type* bins = my_bins + f*num_bins;
+          const omp_size_type n_rows = face.n_rows;
+
+#pragma omp for schedule(static) nowait
+          for(omp_size_type r = 0;r<n_rows;++r){
+            const raw_type* row = _input + face.offset + r*face.row_stride;
+            for(std::size_t x = 0;x<face.row_length;++x)
+              bins[index_type(row[x])]++;
+          }
+        }
+      }
 
-        running_histo.add_from_image(begin, begin + (frame_size));
+      const omp_size_type n_bins = n_faces*num_bins;
+      const omp_size_type n_clones = _nthreads;
+      std::vector<bins_type*> face_bins(n_faces, nullptr);
+      for(std::size_t f = 0;f<n_faces;++f)
+        face_bins[f] = _histos[f].bins.data();
+      bins_type* const* face_bins_itr = face_bins.data();
+
+#pragma omp parallel for                        \
+  shared( face_bins_itr )                       \
+  firstprivate( private_itr, n_clones )         \
+  num_threads(_nthreads)
+      for(omp_size_type idx = 0;idx<n_bins;idx++){
+        bins_type sum = 0;
+        for(omp_size_type clone = 0;clone<n_clones;++clone)
+          sum += private_itr[clone*n_bins + idx];
+        face_bins_itr[idx / num_bins][idx % num_bins] += sum;
+      }
+    }
 
-        temp = running_histo.calc_support();
+  };
 
-#ifdef _SQY_VERBOSE_
-        running_histo.fill_stats();
-        std::cout << "[SQY_VERBOSE]\t face z = " << z_idx << " / " << _dims[row_major::z] <<" , support = " << temp << ", mean = " << running_histo.calc_mean() << "\n";
+    /**
+     * @brief find the face of the stack with the lowest _percentile of intensities (first & last x-y plane,
+     * first & last z-x plane) and return its histogram; the faces are histogrammed in place through strided
+     * views in a single pass, so any percentile of the darkest face can be obtained from _darkest afterwards
+     *
+     * @param _input 3D stack that is to be parsed
+     * @param _dims dimensionality of the input complying to c_storage_order _dims[] = {z-shape,y-shape,x-shape}
+     * @param _darkest (out) histogram of the darkest face
+     * @param _percentile fraction of the face intensities that is used to rank the faces
+     * @param _nthreads number of threads to use
+     * @return the darkest face, a face with n_rows == 0 if the stack is empty
+     */
+    template <typename raw_type, typename size_type>
+    static detail::strided_face darkest_face_histogram(const raw_type* _input,
+                                                       const std::vector<size_type>& _dims,
+                                                       histogram<raw_type>& _darkest,
+                                                       float _percentile = .99f,
+                                                       int _nthreads = 1) {
 
-#endif
+      const std::vector<detail::strided_face> faces = detail::candidate_faces(_dims);
+
+      _darkest.clear();
+      if(faces.empty())
+        return detail::strided_face{0, 0, 0, 0};
 
+      std::vector<histogram<raw_type> > histos(faces.size());
+      detail::fill_face_histograms(_input, faces, histos, _nthreads);
 
-        if(temp < support) {
-          if(_darkest_face.size()<frame_size)
-            _darkest_face.resize(frame_size);
+      std::size_t darkest = 0;
+      float support = (std::numeric_limits<float>::max)();
 
-          //FIXME: do we really need to copy the face out?
-          std::copy(begin, begin + (frame_size),_darkest_face.begin());
+      for(std::size_t f = 0;f<faces.size();++f){
+        const float temp = histos[f].calc_support(_percentile);
+#ifdef _SQY_VERBOSE_
+        histos[f].fill_stats();
+        std::cout << "[SQY_VERBOSE]\t face at offset " << faces[f].offset << " with stride " << faces[f].row_stride
+                  << ", support = " << temp << ", mean = " << histos[f].calc_mean() << "\n";
+#endif
+        if(temp < support){
+          darkest = f;
           support = temp;
         }
       }
 
-      //faces with y
-      std::vector<raw_type> face(_dims[2]*_dims[row_major::z]);
-      for(size_type y_idx = 0; y_idx < _dims[1]; y_idx+=(_dims[1]-1)) {
-
-        running_histo.clear();
+      std::swap(_darkest.bins, histos[darkest].bins);
+      _darkest.num_entries = histos[darkest].num_entries;
 
-        for(size_type z_idx = 0; z_idx < _dims[row_major::z]; ++z_idx) {
-          input_index = z_idx*(frame_size)+y_idx*_dims[2];
-          std::copy(_input + input_index, _input+input_index+_dims[2], face.begin() + (z_idx*_dims[2]));
-          running_histo.add_from_image(_input + input_index, _input+input_index+_dims[2]);
-
-        }
+      return faces[darkest];
+    }
 
-        temp = running_histo.calc_support();
-#ifdef _SQY_VERBOSE_
-        running_histo.fill_stats();
-        std::cout << "[SQY_VERBOSE]\t face y = " << y_idx << " / "<< _dims[1] << " , support = " << temp << ", mean = " << running_histo.calc_mean() << "\n";
+    template <typename raw_type, typename size_type>
+    /**
+     * @brief search for the place with the lowest 99% support of the intensities and copy it out
+     * (see darkest_face_histogram for an estimate that does not copy anything),
+     * the current implementation loops through the first & last x-y planes
+     * as well as the first & last z-x plane
+     *
+     * @param _input 3D stack that is to be parsed
+     * @param _dims dimensionality of the input complying to c_storage_order _dims[] = {z-shape,y-shape,x-shape}
+     * @param _darkest_face (inout type) this is the vector that will contain the result
+     * @return const void
+     */
+    static const void extract_darkest_face(const raw_type* _input,
+                                           const std::vector<size_type>& _dims,
+                                           std::vector<raw_type>& _darkest_face) {
 
-#endif
+      histogram<raw_type> darkest;
+      const detail::strided_face face = darkest_face_histogram(_input, _dims, darkest);
 
-        if(temp < support) {
-          if(_darkest_face.size()<(size_t)(_dims[row_major::x]*_dims[row_major::z]))
-            _darkest_face.resize(_dims[row_major::x]*_dims[row_major::z]);
-          //FIXME: do we really need to copy the face out?
-          std::copy(face.begin(), face.end(),_darkest_face.begin());
+      if(_darkest_face.size()<face.size())
+        _darkest_face.resize(face.size());
 
-          support = temp;
-        }
+      for(std::size_t r = 0;r<face.n_rows;++r){
+        const raw_type* row = _input + face.offset + r*face.row_stride;
+        std::copy(row, row + face.row_length, _darkest_face.begin() + r*face.row_length);
       }
 
     }
@@ -171,5 +284,186 @@ static unsigned  count_neighbors_if(Value_type* _input,
 
 }
 
+  /**
+     \brief number of voxels below a threshold inside the box spanned by Neighborhood around every voxel
+     of a 3D stack
+
+     in contrast to count_neighbors_if, the counts are obtained from running sums along x (per row),
+     along y (per plane) and along z (across planes), so the cost per voxel does not depend on the size
+     of the neighborhood; only the last (z extent + 1) planes of box sums are kept in memory
+
+     only voxels whose neighborhood lies completely inside the stack (the interior) receive a count
+
+  */
+template <typename Neighborhood>
+struct box_count_below {
+
+    static const int x_width = Neighborhood::x_offset_end - Neighborhood::x_offset_begin;
+    static const int y_width = Neighborhood::y_offset_end - Neighborhood::y_offset_begin;
+    static const int z_width = Neighborhood::z_offset_end - Neighborhood::z_offset_begin;
+
+    static const std::size_t volume = std::size_t(x_width)*y_width*z_width;
+
+    typedef typename std::conditional<(volume < (std::size_t(1) << 16)),
+                                      std::uint16_t,
+                                      std::uint32_t>::type count_type;
+
+    //first index along an axis whose neighborhood does not reach below 0
+    static std::size_t interior_begin(int _offset_begin) {
+        return _offset_begin < 0 ? -_offset_begin : 0;
+    }
+
+    //one past the last index along an axis of length _len whose neighborhood does not reach beyond _len
+    static std::size_t interior_end(std::size_t _len, int _offset_end) {
+        const std::size_t reach = _offset_end > 1 ? _offset_end - 1 : 0;
+        return _len > reach ? _len - reach : 0;
+    }
+
+    /**
+       \brief call _functor(row_offset, counts, x_first, x_last) for every row of the interior, counts[x]
+       holds the number of voxels below _threshold in the neighborhood of voxel x in [x_first, x_last)
+       of the row starting at _input + row_offset
+
+       planes are processed one after another, the rows of a plane are distributed among _nthreads threads
+
+       \param[in] _input 3D stack
+       \param[in] _dims dimensionality of the input complying to c_storage_order _dims[] = {z-shape,y-shape,x-shape}
+       \param[in] _threshold voxels strictly below it are counted
+       \param[in] _functor called for every interior row, calls for rows of the same plane may run concurrently
+
+    */
+    template <typename Value_type, typename Size_type, typename Functor>
+    static void for_each_row(const Value_type* _input,
+                             const std::vector<Size_type>& _dims,
+                             const Value_type _threshold,
+                             Functor _functor,
+                             int _nthreads = 1) {
+
+        const std::size_t len_z = _dims[row_major::z];
+        const std::size_t len_y = _dims[row_major::y];
+        const std::size_t len_x = _dims[row_major::x];
+        const std::size_t frame = len_y*len_x;
+
+        const std::size_t z_first = interior_begin(Neighborhood::z_offset_begin);
+        const std::size_t z_last = interior_end(len_z, Neighborhood::z_offset_end);
+        const std::size_t y_first = interior_begin(Neighborhood::y_offset_begin);
+        const std::size_t y_last = interior_end(len_y, Neighborhood::y_offset_end);
+        const std::size_t x_first = interior_begin(Neighborhood::x_offset_begin);
+        const std::size_t x_last = interior_end(len_x, Neighborhood::x_offset_end);
+
+        if(z_first >= z_last || y_first >= y_last || x_first >= x_last)
+            return;
+
+        //planes and rows of the input that are part of any interior neighborhood
+        const omp_size_type zs_begin = z_first + Neighborhood::z_offset_begin;
+        const omp_size_type zs_end = z_last + Neighborhood::z_offset_end - 1;
+        const omp_size_type ys_begin = y_first + Neighborhood::y_offset_begin;
+        const omp_size_type ys_end = y_last + Neighborhood::y_offset_end - 1;
+        const omp_size_type n_rows = y_last - y_first;
+
+        //x window sums of the current input plane
+        std::vector<count_type> row_sums(frame, 0);
+        //x-y window sums of the last z_width+1 input planes
+        std::vector<count_type> plane_sums((z_width + 1)*frame, 0);
+        //x-y-z window sums of the current output plane
+        std::vector<count_type> box_sums(frame, 0);
+
+        count_type* rows = row_sums.data();
+        count_type* boxes = box_sums.data();
+
+#pragma omp parallel                                \
+    shared(rows, boxes, plane_sums, _functor)        \
+    num_threads(_nthreads)
+        {
+            const omp_size_type n_blocks = _nthreads;
+
+            for(omp_size_type zs = zs_begin; zs < zs_end; ++zs) {
+
+                const Value_type* plane_in = _input + zs*frame;
+                count_type* plane = plane_sums.data() + (zs % (z_width + 1))*frame;
+
+                //1. sliding window along x
+#pragma omp for schedule(static)
+                for(omp_size_type ys = ys_begin; ys < ys_end; ++ys) {
+
+                    const Value_type* row = plane_in + ys*len_x;
+                    count_type* sums = rows + ys*len_x;
+
+                    //a narrow accumulator lets gcc 12 (SLP vectorizer) add up the comparison masks as -1
+                    count_type sum = 0;
+                    for(int dx = Neighborhood::x_offset_begin; dx < Neighborhood::x_offset_end; ++dx)
+                        sum += row[x_first + dx] < _threshold;
+                    sums[x_first] = sum;
+
+                    const Value_type* entering = row + x_first + Neighborhood::x_offset_end;
+                    const Value_type* leaving = row + x_first + Neighborhood::x_offset_begin;
+                    for(std::size_t x = x_first + 1; x < x_last; ++x) {
+                        sum += (*(entering++) < _threshold);
+                        sum -= (*(leaving++) < _threshold);
+                        sums[x] = sum;
+                    }
+                }
+
+                //2. sliding window along y, every thread slides through a contiguous block of rows
+#pragma omp for schedule(static)
+                for(omp_size_type b = 0; b < n_blocks; ++b) {
+
+                    const std::size_t y_begin = y_first + (b*n_rows)/n_blocks;
+                    const std::size_t y_end = y_first + ((b + 1)*n_rows)/n_blocks;
+                    if(y_begin == y_end)
+                        continue;
+
+                    count_type* dst = plane + y_begin*len_x;
+                    std::fill(dst + x_first, dst + x_last, 0);
+                    for(int dy = Neighborhood::y_offset_begin; dy < Neighborhood::y_offset_end; ++dy) {
+                        const count_type* src = rows + (y_begin + dy)*len_x;
+                        for(std::size_t x = x_first; x < x_last; ++x)
+                            dst[x] += src[x];
+                    }
+
+                    for(std::size_t y = y_begin + 1; y < y_end; ++y) {
+                        const count_type* prev = plane + (y - 1)*len_x;
+                        const count_type* entering = rows + (y + Neighborhood::y_offset_end - 1)*len_x;
+                        const count_type* leaving = rows + (y + Neighborhood::y_offset_begin - 1)*len_x;
+                        dst = plane + y*len_x;
+                        for(std::size_t x = x_first; x < x_last; ++x)
+                            dst[x] = prev[x] + entering[x] - leaving[x];
+                    }
+                }
+
+                //3. sliding window along z, report the rows of the output plane
+                const omp_size_type z = zs - (Neighborhood::z_offset_end - 1);
+                if(z < omp_size_type(z_first))
+                    continue;
+
+#pragma omp for schedule(static)
+                for(omp_size_type y = y_first; y < omp_size_type(y_last); ++y) {
+
+                    count_type* dst = boxes + y*len_x;
+
+                    if(z == omp_size_type(z_first)) {
+                        std::fill(dst + x_first, dst + x_last, 0);
+                        for(int dz = Neighborhood::z_offset_begin; dz < Neighborhood::z_offset_end; ++dz) {
+                            const count_type* src = plane_sums.data() + ((z + dz) % (z_width + 1))*frame + y*len_x;
+                            for(std::size_t x = x_first; x < x_last; ++x)
+                                dst[x] += src[x];
+                        }
+                    }
+                    else {
+                        const count_type* entering = plane + y*len_x;
+                        //input plane zs - z_width sits in the ring slot that follows the one of zs
+                        const count_type* leaving = plane_sums.data() + ((zs + 1) % (z_width + 1))*frame + y*len_x;
+                        for(std::size_t x = x_first; x < x_last; ++x)
+                            dst[x] += entering[x] - leaving[x];
+                    }
+
+                    _functor(z*frame + y*len_x, (const count_type*)dst, x_first, x_last);
+                }
+            }
+        }
+    }
+
+};
+
 } //sqeazy
 #endif /* _BACKGROUND_SCHEME_UTILS_H_ */
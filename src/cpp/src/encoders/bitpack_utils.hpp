@@ -0,0 +1,327 @@
+#ifndef _BITPACK_UTILS_H_
+#define _BITPACK_UTILS_H_
+
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <climits>
+#include <type_traits>
+#include <iostream>
+
+#include "compass.hpp"
+#include "sqeazy_common.hpp"
+
+#ifdef COMPASS_CT_ARCH_X86
+#include <immintrin.h>
+#endif
+
+namespace sqeazy {
+
+  namespace detail {
+
+    /**
+       \brief dense packing of _bits wide codes: code i occupies bits [i*_bits,(i+1)*_bits) of the
+       byte stream, least significant bit first; every group of 8 codes fills exactly _bits bytes
+
+    */
+    namespace bitpack {
+
+      //number of codes every thread processes at once, must be a multiple of 8
+      static const std::size_t block_size = 1 << 15;
+
+      static std::size_t packed_bytes(std::size_t _len, std::uint32_t _bits){
+        return (_len*_bits + CHAR_BIT - 1)/CHAR_BIT;
+      }
+
+      /**
+         \brief look up the code of every item of [_in,_in+_len) in _lut and pack it to _out (scalar reference implementation)
+
+      */
+      template <typename in_t, typename code_t>
+      static void encode_scalar(const in_t* _in,
+                                std::size_t _len,
+                                const code_t* _lut,
+                                std::uint32_t _bits,
+                                char* _out){
+
+        typedef typename std::make_unsigned<in_t>::type index_t;
+
+        const std::uint64_t mask = (std::uint64_t(1) << _bits) - 1;
+        std::uint64_t acc = 0;
+        std::uint32_t filled = 0;
+
+        for(std::size_t idx = 0;idx<_len;++idx){
+          acc |= (std::uint64_t(_lut[index_t(_in[idx])]) & mask) << filled;
+          filled += _bits;
+
+          for(;filled >= CHAR_BIT;filled -= CHAR_BIT){
+            *(_out++) = static_cast<char>(acc & 0xff);
+            acc >>= CHAR_BIT;
+          }
+        }
+
+        if(filled)
+          *_out = static_cast<char>(acc & 0xff);
+      }
+
+      /**
+         \brief unpack _len codes from _in and write the _lut entry of each to _out (scalar reference implementation)
+
+      */
+      template <typename out_t>
+      static void decode_scalar(const char* _in,
+                                std::size_t _len,
+                                const out_t* _lut,
+                                std::uint32_t _bits,
+                                out_t* _out){
+
+        const std::uint64_t mask = (std::uint64_t(1) << _bits) - 1;
+        std::uint64_t acc = 0;
+        std::uint32_t available = 0;
+
+        for(std::size_t idx = 0;idx<_len;++idx){
+          for(;available < _bits;available += CHAR_BIT)
+            acc |= std::uint64_t(static_cast<unsigned char>(*(_in++))) << available;
+
+          _out[idx] = _lut[acc & mask];
+          acc >>= _bits;
+          available -= _bits;
+        }
+      }
+
+#ifdef COMPASS_CT_ARCH_X86
+
+      /**
+         \brief fused lookup and packing with pext: 4 codes in 16-bit lanes are compressed at once, 2 such words hold
+         the 8 codes that fill _bits bytes (the byte order of the stream relies on x86 being little endian)
+
+      */
+      template <typename in_t>
+      SQY_TARGET("bmi2")
+      static void encode_bmi2(const in_t* _in,
+                              std::size_t _len,
+                              const std::uint16_t* _lut,
+                              std::uint32_t _bits,
+                              char* _out){
+
+        typedef typename std::make_unsigned<in_t>::type index_t;
+
+        const std::uint64_t lane_mask = ((std::uint64_t(1) << _bits) - 1)*0x0001000100010001ull;
+        const std::uint32_t shift = 4*_bits;
+        const std::size_t low_bytes = (std::min)(_bits, std::uint32_t(8));
+
+        std::size_t idx = 0;
+        for(;(idx+8)<=_len;idx+=8){
+
+          const std::uint64_t first = std::uint64_t(_lut[index_t(_in[idx  ])])
+            | (std::uint64_t(_lut[index_t(_in[idx+1])]) << 16)
+            | (std::uint64_t(_lut[index_t(_in[idx+2])]) << 32)
+            | (std::uint64_t(_lut[index_t(_in[idx+3])]) << 48);
+          const std::uint64_t second = std::uint64_t(_lut[index_t(_in[idx+4])])
+            | (std::uint64_t(_lut[index_t(_in[idx+5])]) << 16)
+            | (std::uint64_t(_lut[index_t(_in[idx+6])]) << 32)
+            | (std::uint64_t(_lut[index_t(_in[idx+7])]) << 48);
+
+          const std::uint64_t lo = _pext_u64(first,lane_mask);
+          const std::uint64_t hi = _pext_u64(second,lane_mask);
+
+          const std::uint64_t word0 = shift < 64 ? (lo | (hi << shift)) : lo;
+          const std::uint64_t word1 = shift < 64 ? (hi >> (64 - shift)) : hi;
+
+          std::memcpy(_out, &word0, low_bytes);
+          if(_bits > 8)
+            std::memcpy(_out + 8, &word1, _bits - 8);
+          _out += _bits;
+        }
+
+        encode_scalar(_in + idx, _len - idx, _lut, _bits, _out);
+      }
+
+      /**
+         \brief fused unpacking and lookup with pdep, mirrors encode_bmi2
+
+      */
+      template <typename out_t>
+      SQY_TARGET("bmi2")
+      static void decode_bmi2(const char* _in,
+                              std::size_t _len,
+                              const out_t* _lut,
+                              std::uint32_t _bits,
+                              out_t* _out){
+
+        const std::uint64_t lane_mask = ((std::uint64_t(1) << _bits) - 1)*0x0001000100010001ull;
+        const std::uint32_t shift = 4*_bits;
+        const std::uint64_t low_mask = shift < 64 ? ((std::uint64_t(1) << shift) - 1) : ~std::uint64_t(0);
+        const std::size_t low_bytes = (std::min)(_bits, std::uint32_t(8));
+
+        std::size_t idx = 0;
+        for(;(idx+8)<=_len;idx+=8){
+
+          std::uint64_t word0 = 0;
+          std::uint64_t word1 = 0;
+          std::memcpy(&word0, _in, low_bytes);
+          if(_bits > 8)
+            std::memcpy(&word1, _in + 8, _bits - 8);
+          _in += _bits;
+
+          const std::uint64_t lo = word0 & low_mask;
+          const std::uint64_t hi = shift < 64 ? (((word0 >> shift) | (word1 << (64 - shift))) & low_mask) : word1;
+
+          const std::uint64_t first = _pdep_u64(lo,lane_mask);
+          const std::uint64_t second = _pdep_u64(hi,lane_mask);
+
+          _out[idx  ] = _lut[ first        & 0xffff];
+          _out[idx+1] = _lut[(first >> 16) & 0xffff];
+          _out[idx+2] = _lut[(first >> 32) & 0xffff];
+          _out[idx+3] = _lut[ first >> 48          ];
+          _out[idx+4] = _lut[ second        & 0xffff];
+          _out[idx+5] = _lut[(second >> 16) & 0xffff];
+          _out[idx+6] = _lut[(second >> 32) & 0xffff];
+          _out[idx+7] = _lut[ second >> 48          ];
+        }
+
+        decode_scalar(_in, _len - idx, _lut, _bits, _out + idx);
+      }
+
+#endif
+
+      /**
+         \brief look up the code of every item of [_in,_in+_len) in _lut and write the codes densely packed with _bits each to _out
+
+         \param[in] _in input buffer
+         \param[in] _len number of elements in _in
+         \param[in] _lut encode lookup table, must have 1 << bits(in_t) items, only the lower _bits of every item are used
+         \param[in] _bits width of a code (1 to 16)
+         \param[out] _out output buffer of at least packed_bytes(_len,_bits) bytes
+         \param[in] _nthreads number of threads to use
+
+         \return pointer to _out + packed_bytes(_len,_bits)
+      */
+      template <typename in_t, typename code_t>
+      static char* encode(const in_t* _in,
+                          std::size_t _len,
+                          const std::vector<code_t>& _lut,
+                          std::uint32_t _bits,
+                          char* _out,
+                          int _nthreads = 1){
+
+        static_assert(sizeof(code_t) <= 2, "[bitpack::encode] codes must not be wider than 16 bits");
+
+        void (*kernel)(const in_t*, std::size_t, const code_t*, std::uint32_t, char*) = encode_scalar<in_t,code_t>;
+
+#ifdef COMPASS_CT_ARCH_X86
+        std::vector<std::uint16_t> wide_lut;
+        const std::uint16_t* bmi2_lut = reinterpret_cast<const std::uint16_t*>(_lut.data());
+
+        if(sqeazy::platform::has_simd<compass::feature::bmi2>()){
+
+#ifdef _SQY_VERBOSE_
+          std::cout << "[SQY_VERBOSE] [detail::bitpack::encode]\tusing bmi2 pext method\n";
+#endif
+          if(sizeof(code_t) != sizeof(std::uint16_t)){
+            wide_lut.assign(_lut.begin(), _lut.end());
+            bmi2_lut = wide_lut.data();
+          }
+
+          const omp_size_type n_blocks = (_len + block_size - 1)/block_size;
+          const std::size_t len = _len;
+
+#pragma omp parallel for                        \
+  shared(_out )                                 \
+  firstprivate( len, _in, bmi2_lut, _bits )     \
+  num_threads(_nthreads)
+          for(omp_size_type b = 0;b<n_blocks;b++){
+            const std::size_t offset = b*block_size;
+            encode_bmi2(_in + offset, (std::min)(block_size, len - offset), bmi2_lut, _bits,
+                        _out + offset/CHAR_BIT*_bits);
+          }
+
+          return _out + packed_bytes(_len,_bits);
+        }
+
+#ifdef _SQY_VERBOSE_
+        std::cout << "[SQY_VERBOSE] [detail::bitpack::encode]\tusing scalar method, why ? "
+                  << "sqeazy::platform::use_vectorisation::value = " << sqeazy::platform::use_vectorisation::value << ", "
+                  << "sqeazy::platform::has_simd<compass::feature::bmi2>() = " << sqeazy::platform::has_simd<compass::feature::bmi2>() << "\n";
+#endif
+#endif
+
+        const omp_size_type n_blocks = (_len + block_size - 1)/block_size;
+        const std::size_t len = _len;
+        const code_t* lut = _lut.data();
+
+#pragma omp parallel for                        \
+  shared(_out )                                 \
+  firstprivate( len, _in, lut, _bits, kernel )  \
+  num_threads(_nthreads)
+        for(omp_size_type b = 0;b<n_blocks;b++){
+          const std::size_t offset = b*block_size;
+          kernel(_in + offset, (std::min)(block_size, len - offset), lut, _bits,
+                 _out + offset/CHAR_BIT*_bits);
+        }
+
+        return _out + packed_bytes(_len,_bits);
+      }
+
+      /**
+         \brief unpack _len codes of _bits each from _in and write the _lut entry of every code to _out
+
+         \param[in] _in packed input buffer of at least packed_bytes(_len,_bits) bytes
+         \param[in] _len number of codes to unpack
+         \param[in] _lut decode lookup table, must have at least 1 << _bits items
+         \param[in] _bits width of a code (1 to 16)
+         \param[out] _out output buffer of at least _len items
+         \param[in] _nthreads number of threads to use
+
+         \return pointer to _out + _len
+      */
+      template <typename out_t>
+      static out_t* decode(const char* _in,
+                           std::size_t _len,
+                           const std::vector<out_t>& _lut,
+                           std::uint32_t _bits,
+                           out_t* _out,
+                           int _nthreads = 1){
+
+        void (*kernel)(const char*, std::size_t, const out_t*, std::uint32_t, out_t*) = decode_scalar<out_t>;
+
+#ifdef COMPASS_CT_ARCH_X86
+        if(sqeazy::platform::has_simd<compass::feature::bmi2>()){
+#ifdef _SQY_VERBOSE_
+          std::cout << "[SQY_VERBOSE] [detail::bitpack::decode]\tusing bmi2 pdep method\n";
+#endif
+          kernel = decode_bmi2<out_t>;
+        }
+#ifdef _SQY_VERBOSE_
+        else
+          std::cout << "[SQY_VERBOSE] [detail::bitpack::decode]\tusing scalar method, why ? "
+                    << "sqeazy::platform::use_vectorisation::value = " << sqeazy::platform::use_vectorisation::value << ", "
+                    << "sqeazy::platform::has_simd<compass::feature::bmi2>() = " << sqeazy::platform::has_simd<compass::feature::bmi2>() << "\n";
+#endif
+#endif
+
+        const omp_size_type n_blocks = (_len + block_size - 1)/block_size;
+        const std::size_t len = _len;
+        const out_t* lut = _lut.data();
+
+#pragma omp parallel for                        \
+  shared(_out )                                 \
+  firstprivate( len, _in, lut, _bits, kernel )  \
+  num_threads(_nthreads)
+        for(omp_size_type b = 0;b<n_blocks;b++){
+          const std::size_t offset = b*block_size;
+          kernel(_in + offset/CHAR_BIT*_bits, (std::min)(block_size, len - offset), lut, _bits,
+                 _out + offset);
+        }
+
+        return _out + _len;
+      }
+
+    };
+
+  };
+
+};
+
+#endif /* _BITPACK_UTILS_H_ */
@@ -74,6 +74,57 @@ namespace sqeazy {
     }
 
 
+    /**
+       \brief bitplane reordering of the _length items in _input which are part of a larger stream,
+       the first item of _input is item _first_word*num_planes of the stream
+
+       every output segment (bitplane) is _segment_length items long; only the whole words
+       _first_word ... _first_word+_length/num_planes of each segment are written, so that blocks of a stream
+       can be processed independently and yield the same result as scalar_bitplane_reorder_encode on the full stream
+
+       \return
+       \retval
+
+    */
+    template <const unsigned num_bits_per_plane,
+              typename raw_type
+              >
+    static const error_code scalar_bitplane_reorder_encode_block(const raw_type* _input,
+                                                                 std::size_t _length,
+                                                                 raw_type* _output,
+                                                                 std::size_t _segment_length,
+                                                                 std::size_t _first_word)
+    {
+
+      typedef typename std::make_unsigned<raw_type>::type word_type;
+
+      static const unsigned type_width = CHAR_BIT*sizeof(raw_type);
+      static const unsigned num_planes = type_width/num_bits_per_plane;
+      static const word_type mask = word_type(~(~0u << (num_bits_per_plane)));
+
+      const std::size_t n_words = _length/num_planes;
+
+      for(std::size_t w = 0; w < n_words; ++w, _input += num_planes) {
+
+        for(unsigned plane_index = 0; plane_index<num_planes; ++plane_index) {
+
+          const unsigned input_bit_offset = plane_index*num_bits_per_plane;
+          word_type word = 0;
+
+          for(unsigned item = 0; item<num_planes; ++item){
+            const word_type extracted_bits = (word_type(_input[item]) >> input_bit_offset) & mask;
+            word |= word_type(extracted_bits << ((type_width - num_bits_per_plane) - item*num_bits_per_plane));
+          }
+
+          _output[((num_planes-1-plane_index)*_segment_length) + _first_word + w] = raw_type(word);
+        }
+      }
+
+      return SUCCESS;
+
+    }
+
+
     template <const unsigned num_bits_per_plane,
               typename raw_type ,
               typename size_type
@@ -310,6 +310,59 @@ namespace sqeazy {
 
     }
 
+    /**
+       \brief 1-bit bitplane reordering of the _length 16-bit items in _input which are part of a larger stream,
+       the first item of _input is item _first_word*16 of the stream
+
+       the high and low bytes of 16 items are packed into one register each (in reverse item order),
+       _mm_movemask_epi8 then yields a complete output word per plane; the result is identical to
+       scalar_bitplane_reorder_encode_block<1>, items beyond the last multiple of 16 are not touched
+
+       \return
+       \retval
+
+    */
+    template <typename raw_type>
+    static const error_code sse_bitplane_reorder_encode_block_16bit(const raw_type* _input,
+                                                                    std::size_t _length,
+                                                                    raw_type* _output,
+                                                                    std::size_t _segment_length,
+                                                                    std::size_t _first_word)
+    {
+
+      if(sizeof(raw_type) != 2)
+        return FAILURE;
+
+      const std::size_t n_words = _length/16;
+      const __m128i low_byte = _mm_set1_epi16(0xff);
+      const __m128i reverse = _mm_set_epi8(0,1,2,3,4,5,6,7,8,9,10,11,12,13,14,15);
+
+      raw_type* dst = _output + _first_word;
+
+      for(std::size_t w = 0; w < n_words; ++w, _input += 16, ++dst) {
+
+        const __m128i first = _mm_loadu_si128(reinterpret_cast<const __m128i*>(_input));
+        const __m128i second = _mm_loadu_si128(reinterpret_cast<const __m128i*>(_input + 8));
+
+        //item 15 goes to byte 0, so that the bit of item 0 ends up as msb of the movemask
+        __m128i high = _mm_shuffle_epi8(_mm_packus_epi16(_mm_srli_epi16(first,8), _mm_srli_epi16(second,8)), reverse);
+        __m128i low = _mm_shuffle_epi8(_mm_packus_epi16(_mm_and_si128(first,low_byte), _mm_and_si128(second,low_byte)), reverse);
+
+        //the most significant plane is stored in the first segment
+        for(std::size_t seg = 0; seg < 8; ++seg){
+          dst[seg*_segment_length] = raw_type(_mm_movemask_epi8(high));
+          high = _mm_add_epi8(high,high);
+        }
+
+        for(std::size_t seg = 8; seg < 16; ++seg){
+          dst[seg*_segment_length] = raw_type(_mm_movemask_epi8(low));
+          low = _mm_add_epi8(low,low);
+        }
+      }
+
+      return SUCCESS;
+    }
+
   }//namespace detail
 
 }//namespace sqeazy
@@ -1,6 +1,8 @@
 #ifndef _BITSWAP_SCHEME_IMPL_H_
 #define _BITSWAP_SCHEME_IMPL_H_
 
+#include <array>
+
 #include "compass.hpp"
 #include "neighborhood_utils.hpp"
 #include "sqeazy_common.hpp"
@@ -103,8 +105,7 @@ namespace sqeazy {
         std::copy(_input+max_size,_input+_length,_output+max_size);
 
       int err = 0;
-      if(sqeazy::platform::use_vectorisation::value &&
-         compass::runtime::has(compass::feature::sse4()) &&
+      if(sqeazy::platform::has_simd<compass::feature::sse4>() &&
          num_bits_per_plane==1 &&
          sizeof(raw_type)>1 &&
          sqeazy::detail::sse_valid_length<static_num_bits_per_plane,raw_type>(_length)
@@ -124,7 +125,7 @@ namespace sqeazy {
 #ifdef _SQY_VERBOSE_
         std::cout << "[bitswap_scheme::encode]\tusing scalar method, why ? "
                   << "sqeazy::platform::use_vectorisation::value = "<< sqeazy::platform::use_vectorisation::value << ", "
-                  << "compass::runtime::has(compass::feature::sse4()) = " << compass::runtime::has(compass::feature::sse4())<< ","
+                  << "sqeazy::platform::has_simd<compass::feature::sse4>() = " << sqeazy::platform::has_simd<compass::feature::sse4>() << ","
                   << "num_bits_per_plane==1 " << num_bits_per_plane << " ==1 ,"
                   << "sizeof(raw_type)=" << sizeof(raw_type) << ">1, "
                   << "sqeazy::detail::sse_valid_length<static_num_bits_per_plane,raw_type>(_length) " <<
@@ -158,6 +159,91 @@ namespace sqeazy {
 
 
 
+    /**
+       \brief number of items the offset of every block given to encode_block has to be a multiple of
+
+    */
+    static constexpr std::size_t block_alignment() {
+
+      return (128/(sizeof(raw_type)*CHAR_BIT))*((sizeof(raw_type)*CHAR_BIT)/static_num_bits_per_plane);
+
+    }
+
+    /**
+       \brief encode the _n items in _block which start at item _offset of a stream that is _length items long
+
+       the bitplanes are written to their final position in _output, so once all items of the stream
+       were passed in (in any order), _output is identical to what encode(stream, _output, _length) yields;
+       _offset must be a multiple of block_alignment(), blocks must not overlap
+
+       \return
+       \retval
+
+    */
+    void encode_block(const raw_type* _block,
+                      std::size_t _offset,
+                      std::size_t _n,
+                      compressed_type* _output,
+                      std::size_t _length) const {
+
+      const std::size_t max_size = _length - (_length % num_planes);
+      const std::size_t segment_length = max_size/num_planes;
+
+      //items beyond the last full word of every plane are stored as is
+      if(_offset + _n > max_size){
+        const std::size_t first_raw = (std::max)(max_size, _offset);
+        std::copy(_block + (first_raw - _offset), _block + _n, _output + first_raw);
+      }
+
+      const std::size_t n_planed = _offset < max_size ? (std::min)(_n, max_size - _offset) : 0;
+
+      const bool use_sse = sizeof(raw_type)>1 && sqeazy::platform::has_simd<compass::feature::sse4>();
+
+      //the planes of a chunk are collected on the stack first and then copied as one run per plane,
+      //writing to all planes directly makes the stores of one item collide in the same cache sets
+      static const std::size_t chunk_size = 16*block_alignment();
+      std::array<raw_type, chunk_size> staging;
+
+      for(std::size_t chunk = 0;chunk<n_planed;chunk+=chunk_size){
+
+        const std::size_t n_items = (std::min)(chunk_size, n_planed - chunk);
+        const std::size_t n_words = n_items/num_planes;
+        const raw_type* input = _block + chunk;
+        std::size_t n_done = 0;
+
+#if defined(__AVX__) || (defined(COMPASS_CT_HAS_SSE4) && COMPASS_CT_HAS_SSE4 > 0)
+        if(use_sse && num_bits_per_plane==1){
+
+          n_done = n_items - (n_items % block_alignment());
+
+          if(sizeof(raw_type)==2){
+            sqeazy::detail::sse_bitplane_reorder_encode_block_16bit(input, n_done,
+                                                                    staging.data(),
+                                                                    n_words,
+                                                                    0);
+          }
+          else if(n_done){
+            for(std::uint32_t seg = 0;seg<num_planes;++seg)
+              sqeazy::detail::simd_collect_single_bitplane(input, input + n_done,
+                                                           staging.data() + seg*n_words,
+                                                           seg);
+          }
+        }
+#endif
+
+        sqeazy::detail::scalar_bitplane_reorder_encode_block<static_num_bits_per_plane>(input + n_done,
+                                                                                        n_items - n_done,
+                                                                                        staging.data(),
+                                                                                        n_words,
+                                                                                        n_done/num_planes);
+
+        for(std::uint32_t seg = 0;seg<num_planes;++seg)
+          std::copy(staging.data() + seg*n_words, staging.data() + (seg+1)*n_words,
+                    _output + seg*segment_length + (_offset + chunk)/num_planes);
+      }
+
+    }
+
     int decode( const compressed_type* _input, raw_type* _output,
                 const std::vector<std::size_t>& _ishape,
                 std::vector<std::size_t> _oshape = std::vector<std::size_t>()) const override final {
@@ -0,0 +1,423 @@
+#ifndef _BRICK_UTILS_H_
+#define _BRICK_UTILS_H_
+
+#include <cstdint>
+#include <array>
+#include <vector>
+#include <iterator>
+#include <numeric>
+#include <algorithm>
+#include <functional>
+#include <thread>
+
+#include "sqeazy_common.hpp"
+#include "sqeazy_algorithms.hpp"
+
+namespace sqeazy {
+
+  namespace detail {
+
+	/**
+	   \brief partition of a row-major stack of any rank into bricks of brick_shape, bricks at the upper
+	   border of an axis are cut to the stack
+
+	   bricks are identified by their row-major index in the grid of bricks; a brick is stored in a stream
+	   as one contiguous range with its voxels in row-major order (see for_each_run)
+
+	*/
+	struct brick_layout {
+
+	  static const std::size_t max_rank = 8;
+
+	  std::vector<std::size_t> shape;
+	  std::vector<std::size_t> brick_shape;
+	  std::vector<std::size_t> n_bricks;
+
+	  template <typename shape_container_t, typename brick_shape_container_t>
+	  brick_layout(const shape_container_t& _shape,
+				   const brick_shape_container_t& _brick_shape):
+		shape(_shape.begin(), _shape.end()),
+		brick_shape(_brick_shape.begin(), _brick_shape.end()),
+		n_bricks()
+		{
+
+		  if(shape.empty() || shape.size() > max_rank || shape.size() != brick_shape.size()){
+			std::cerr << "[sqeazy::detail::brick_layout] received " << shape.size() << "D shape and "
+					  << brick_shape.size() << "D brick shape, only matching ranks up to " << max_rank << " are supported!\n";
+			shape.clear();
+			brick_shape.clear();
+			return;
+		  }
+
+		  n_bricks.resize(shape.size());
+		  for(std::size_t d = 0;d<shape.size();++d){
+			if(!brick_shape[d])
+			  brick_shape[d] = 1;
+			n_bricks[d] = (shape[d] + brick_shape[d] - 1)/brick_shape[d];
+		  }
+		}
+
+	  std::size_t rank() const {
+		return shape.size();
+	  }
+
+	  /**
+		 \brief number of bricks in the stack
+
+	  */
+	  std::size_t size() const {
+		return std::accumulate(n_bricks.begin(), n_bricks.end(), std::size_t(shape.empty() ? 0 : 1), std::multiplies<std::size_t>());
+	  }
+
+	  /**
+		 \brief extent of brick _id along _axis
+
+	  */
+	  std::size_t extent(std::size_t _id, std::size_t _axis) const {
+
+		for(std::size_t d = rank() - 1;d>_axis;--d)
+		  _id /= n_bricks[d];
+
+		const std::size_t first = (_id % n_bricks[_axis])*brick_shape[_axis];
+		return (std::min)(brick_shape[_axis], shape[_axis] - first);
+	  }
+
+	  /**
+		 \brief position of the first voxel of brick _id in the row-major stack
+
+	  */
+	  std::size_t offset(std::size_t _id) const {
+
+		std::size_t value = 0;
+		std::size_t stride = 1;
+		for(std::size_t d = rank();d-- > 0;){
+		  value += (_id % n_bricks[d])*brick_shape[d]*stride;
+		  _id /= n_bricks[d];
+		  stride *= shape[d];
+		}
+
+		return value;
+	  }
+
+	  /**
+		 \brief number of voxels inside brick _id
+
+	  */
+	  std::size_t volume(std::size_t _id) const {
+
+		std::size_t value = 1;
+		for(std::size_t d = rank();d-- > 0;){
+		  const std::size_t first = (_id % n_bricks[d])*brick_shape[d];
+		  _id /= n_bricks[d];
+		  value *= (std::min)(brick_shape[d], shape[d] - first);
+		}
+
+		return value;
+	  }
+
+	  /**
+		 \brief call _functor(stack_offset, length) for _n_rows x-rows of brick _id starting with row _first_row,
+		 rows are visited in row-major order of the brick
+
+	  */
+	  template <typename functor_t>
+	  void for_each_row(std::size_t _id,
+						functor_t&& _functor,
+						std::size_t _first_row = 0,
+						std::size_t _n_rows = ~std::size_t(0)) const {
+		walk(_id, false, _first_row, _n_rows, _functor);
+	  }
+
+	  /**
+		 \brief call _functor(stack_offset, length) for every contiguous run of brick _id in row-major order of the brick,
+		 consecutive rows are merged into one run if the brick spans the stack along all faster axes
+
+	  */
+	  template <typename functor_t>
+	  void for_each_run(std::size_t _id,
+						functor_t&& _functor) const {
+		walk(_id, true, 0, ~std::size_t(0), _functor);
+	  }
+
+	private:
+
+	  template <typename functor_t>
+	  void walk(std::size_t _id,
+				bool _merge,
+				std::size_t _first_row,
+				std::size_t _n_rows,
+				functor_t& _functor) const {
+
+		const std::size_t n_axes = rank();
+		if(!n_axes)
+		  return;
+
+		std::array<std::size_t, max_rank> extents;
+		std::array<std::size_t, max_rank> strides;
+		std::array<std::size_t, max_rank> counters;
+
+		std::size_t offset = 0;
+		std::size_t stride = 1;
+		for(std::size_t d = n_axes;d-- > 0;){
+		  const std::size_t first = (_id % n_bricks[d])*brick_shape[d];
+		  _id /= n_bricks[d];
+
+		  extents[d] = (std::min)(brick_shape[d], shape[d] - first);
+		  strides[d] = stride;
+		  offset += first*stride;
+		  stride *= shape[d];
+		}
+
+		// fold the slowest axes into the run as long as the brick covers the stack along the faster ones
+		std::size_t n_run_axes = 1;
+		std::size_t run = extents[n_axes-1];
+		while(_merge && n_run_axes < n_axes && extents[n_axes-n_run_axes] == shape[n_axes-n_run_axes]){
+		  run *= extents[n_axes-n_run_axes-1];
+		  ++n_run_axes;
+		}
+
+		const std::size_t n_outer = n_axes - n_run_axes;
+		std::size_t n_rows = 1;
+		for(std::size_t d = 0;d<n_outer;++d)
+		  n_rows *= extents[d];
+
+		if(_first_row >= n_rows)
+		  return;
+
+		// position the odometer on _first_row
+		std::size_t rem = _first_row;
+		for(std::size_t d = n_outer;d-- > 0;){
+		  counters[d] = rem % extents[d];
+		  rem /= extents[d];
+		  offset += counters[d]*strides[d];
+		}
+
+		if(!n_outer){
+		  _functor(offset, run);
+		  return;
+		}
+
+		// rows along the fastest outer axis are visited in a tight loop, the slower ones carry over afterwards
+		const std::size_t inner = n_outer - 1;
+		const std::size_t inner_stride = strides[inner];
+		const std::size_t last_row = _first_row + (std::min)(_n_rows, n_rows - _first_row);
+
+		for(std::size_t r = _first_row;r<last_row;){
+
+		  const std::size_t n_inner = (std::min)(extents[inner] - counters[inner], last_row - r);
+		  std::size_t row_offset = offset;
+		  for(std::size_t i = 0;i<n_inner;++i, row_offset += inner_stride)
+			_functor(row_offset, run);
+
+		  r += n_inner;
+		  offset -= counters[inner]*inner_stride;
+		  counters[inner] = 0;
+
+		  for(std::size_t d = inner;d-- > 0;){
+			offset += strides[d];
+			if(++counters[d] < extents[d])
+			  break;
+			offset -= extents[d]*strides[d];
+			counters[d] = 0;
+		  }
+		}
+	  }
+
+	};
+
+	namespace bricks {
+
+	  /**
+		 \brief visit bricks [_first, _last) of the stream, the range is halved recursively and one half is
+		 handed to another thread as an OpenMP task until it holds less than _grain voxels
+
+	  */
+	  template <typename functor_t>
+	  static void visit_range(const std::size_t* _order,
+							  const std::size_t* _offsets,
+							  std::size_t _first,
+							  std::size_t _last,
+							  std::size_t _grain,
+							  const functor_t* _functor){
+
+		while(_last - _first > 1 && _offsets[_last] - _offsets[_first] > _grain){
+		  const std::size_t mid = _first + (_last - _first)/2;
+
+#pragma omp task firstprivate(_order, _offsets, mid, _last, _grain, _functor)
+		  visit_range(_order, _offsets, mid, _last, _grain, _functor);
+
+		  _last = mid;
+		}
+
+		for(std::size_t i = _first;i<_last;++i)
+		  (*_functor)(_order[i], _offsets[i]);
+	  }
+
+	};
+
+	/**
+	   \brief upper bound of the number of bricks of any stack of _n_items voxels, given the smallest extent
+	   _min_extent of a brick along any axis (to bound what depends on the brick count before the shape is known)
+
+	   along an axis of length L, a brick extent b yields ceil(L/b) <= L bricks and for L >= b at most 2L/b;
+	   for b >= 2 the product over all axes is therefore at most max(1, 2*_n_items/b)
+
+	*/
+	static std::size_t max_bricks(std::size_t _n_items, std::size_t _min_extent){
+
+	  if(_min_extent < 2 || !_n_items)
+		return _n_items;
+
+	  return (std::max)(std::size_t(1), 2*_n_items/_min_extent);
+	}
+
+	/**
+	   \brief stream offset of every brick of _layout if the bricks are stored in _order, _order[i] being the id
+	   of the brick at stream position i (the identity if empty); the result holds one more item with the stream length
+
+	*/
+	static std::vector<std::size_t> stream_offsets(const brick_layout& _layout,
+												   const std::vector<std::size_t>& _order,
+												   int _nthreads = 1){
+
+	  const std::size_t n_bricks = _layout.size();
+	  std::vector<std::size_t> value(n_bricks + 1, 0);
+
+	  if(!n_bricks)
+		return value;
+
+	  if(_order.empty()){
+		std::vector<std::size_t> identity(n_bricks);
+		std::iota(identity.begin(), identity.end(), 0);
+		return stream_offsets(_layout, identity, _nthreads);
+	  }
+
+	  prefix_sum_of(_order.begin(), _order.end(), value.begin(),
+					[&](std::size_t _id){ return _layout.volume(_id); },
+					_nthreads);
+	  value[n_bricks] = value[n_bricks-1] + _layout.volume(_order.back());
+
+	  return value;
+	}
+
+	/**
+	   \brief call _functor(brick_id, stream_offset) for every brick of _layout stored in _order (the identity if empty)
+
+	   the stream is split recursively in halves which are processed as OpenMP tasks, so that idle threads pick up
+	   the remaining work of busy ones; the recursion does not depend on any cache size, every task works on a
+	   contiguous part of the stream and on bricks that are neighbors in _order
+
+	*/
+	template <typename functor_t>
+	static void for_each_brick(const brick_layout& _layout,
+							   const std::vector<std::size_t>& _order,
+							   functor_t&& _functor,
+							   int _nthreads = 1){
+
+	  const std::size_t n_bricks = _layout.size();
+
+	  if(!_order.empty() && _order.size() != n_bricks){
+		std::cerr << "[sqeazy::detail::for_each_brick] brick order does not match the number of bricks ("
+				  << _order.size() << " != " << n_bricks << ")!\n";
+		return;
+	  }
+
+	  std::vector<std::size_t> order = _order;
+	  if(order.empty()){
+		order.resize(n_bricks);
+		std::iota(order.begin(), order.end(), 0);
+	  }
+
+	  const std::vector<std::size_t> offsets = stream_offsets(_layout, order, _nthreads);
+
+	  if(_nthreads <= 0)
+		_nthreads = std::thread::hardware_concurrency();
+
+	  if(n_bricks < (std::size_t)_nthreads)
+		_nthreads = n_bricks ? n_bricks : 1;
+
+	  // a task should be large enough to hide its scheduling cost and small enough to balance the load
+	  const std::size_t grain = (std::max)(std::size_t(1) << 15, offsets.back()/(16*_nthreads));
+
+	  const std::size_t* porder = order.data();
+	  const std::size_t* poffsets = offsets.data();
+	  const typename std::remove_reference<functor_t>::type* pfunctor = &_functor;
+
+	  if(_nthreads == 1){
+		bricks::visit_range(porder, poffsets, 0, n_bricks, offsets.back(), pfunctor);
+		return;
+	  }
+
+#pragma omp parallel							\
+  firstprivate(porder, poffsets, pfunctor)		\
+  num_threads(_nthreads)
+	  {
+#pragma omp single nowait
+		bricks::visit_range(porder, poffsets, 0, n_bricks, grain, pfunctor);
+	  }
+
+	}
+
+	/**
+	   \brief copy every brick of _layout from the row-major stack at _stack to the stream at _stream in _order
+
+	   \return _stream + number of copied voxels, _stream if _order does not match _layout
+
+	*/
+	template <typename in_iterator_t, typename out_iterator_t>
+	static out_iterator_t gather_bricks(in_iterator_t _stack,
+										out_iterator_t _stream,
+										const brick_layout& _layout,
+										const std::vector<std::size_t>& _order,
+										int _nthreads = 1){
+
+	  if(!_order.empty() && _order.size() != _layout.size())
+		return _stream;
+
+	  for_each_brick(_layout, _order,
+					 [=, &_layout](std::size_t _id, std::size_t _offset){
+					   auto dst = _stream + _offset;
+					   _layout.for_each_run(_id, [&](std::size_t _stack_offset, std::size_t _len){
+						   dst = std::copy(_stack + _stack_offset, _stack + _stack_offset + _len, dst);
+						 });
+					 },
+					 _nthreads);
+
+	  return _stream + std::accumulate(_layout.shape.begin(), _layout.shape.end(), std::size_t(1), std::multiplies<std::size_t>());
+	}
+
+	/**
+	   \brief inverse of gather_bricks, copy every brick of the stream at _stream stored in _order back to its
+	   place in the row-major stack at _stack
+
+	   \return _stack + number of copied voxels, _stack if _order does not match _layout
+
+	*/
+	template <typename in_iterator_t, typename out_iterator_t>
+	static out_iterator_t scatter_bricks(in_iterator_t _stream,
+										 out_iterator_t _stack,
+										 const brick_layout& _layout,
+										 const std::vector<std::size_t>& _order,
+										 int _nthreads = 1){
+
+	  if(!_order.empty() && _order.size() != _layout.size())
+		return _stack;
+
+	  for_each_brick(_layout, _order,
+					 [=, &_layout](std::size_t _id, std::size_t _offset){
+					   auto src = _stream + _offset;
+					   _layout.for_each_run(_id, [&](std::size_t _stack_offset, std::size_t _len){
+						   std::copy(src, src + _len, _stack + _stack_offset);
+						   src += _len;
+						 });
+					 },
+					 _nthreads);
+
+	  return _stack + std::accumulate(_layout.shape.begin(), _layout.shape.end(), std::size_t(1), std::multiplies<std::size_t>());
+	}
+
+  };
+
+};
+
+#endif /* _BRICK_UTILS_H_ */
@@ -0,0 +1,201 @@
+#ifndef _CDF53_WAVELET_SCHEME_IMPL_H_
+#define _CDF53_WAVELET_SCHEME_IMPL_H_
+
+#include <sstream>
+#include <string>
+#include <functional>
+#include <algorithm>
+#include <vector>
+
+#include "sqeazy_common.hpp"
+#include "traits.hpp"
+#include "dynamic_stage.hpp"
+#include "string_parsers.hpp"
+
+#include "wavelet_utils.hpp"
+
+namespace sqeazy {
+
+
+  /**
+* @brief reversible integer 5/3 (CDF, LeGall) lifting wavelet transform of every plane (mode=2d) or of the whole
+* volume (mode=3d), the low pass of every level is transformed again by the next one
+*
+* the subbands are stored in place (low pass first along every axis), so the top left corner of the output holds
+* a preview of the stack at 1/2^levels of its resolution; high pass coefficients are zig-zag mapped so that small
+* details end up as small unsigned values with zero high bits
+*
+* this scheme can be run inplace, the input is copied to the output (unless they are the same) and transformed there.
+* this scheme is reversable.
+*
+*/
+  template <typename in_type>
+  struct cdf53_wavelet_scheme : public filter<in_type> {
+
+    typedef filter<in_type> base_type;
+    typedef in_type raw_type;
+    typedef in_type compressed_type;
+    typedef detail::lifting_53<raw_type> transform_type;
+
+    static const std::string description() { return std::string("reversible integer 5/3 (CDF) lifting wavelet transform, subbands stored in place with the low pass first; <levels|default = 2> number of levels (at most until the smallest transformed extent is down to 1 item), <mode|default = 2d> 2d transforms every plane, 3d the whole volume"); };
+
+
+    transform_type transform;
+
+    cdf53_wavelet_scheme(const std::string& _payload=""):
+      transform(2, false)
+      {
+
+        pipeline_parser p;
+        auto config_map = p.minors(_payload.begin(),_payload.end());
+
+        if(config_map.size()){
+
+          auto f_itr = config_map.find("levels");
+          if(f_itr!=config_map.end()){
+            transform.levels = std::stoi(f_itr->second);
+            if(transform.levels < 0){
+              std::cerr << "[cdf53_wavelet_scheme] levels=" << f_itr->second << " is not supported, expected a value >= 0, using 0\n";
+              transform.levels = 0;
+            }
+          }
+
+          f_itr = config_map.find("mode");
+          if(f_itr!=config_map.end()){
+            if(f_itr->second == "3d")
+              transform.volumetric = true;
+            else if(f_itr->second != "2d")
+              std::cerr << "[cdf53_wavelet_scheme] mode=" << f_itr->second << " is not supported, expected 2d or 3d, using 2d\n";
+          }
+
+        }
+      }
+
+    std::string name() const override final {
+
+      std::ostringstream msg;
+      msg << "cdf53_wavelet";
+
+      return msg.str();
+
+    }
+
+    std::string config() const override final {
+
+      std::ostringstream msg;
+      msg << "levels=" << transform.levels << ",mode=" << (transform.volumetric ? "3d" : "2d");
+      return msg.str();
+
+    }
+
+    std::intmax_t max_encoded_size(std::intmax_t _size_bytes) const override final {
+
+      return _size_bytes;
+    }
+
+    compressed_type* encode( const raw_type* _input,
+                             compressed_type* _output,
+                             const std::vector<std::size_t>& _shape) override final {
+
+      if(_shape.size()!=3){
+        std::cerr << "[cdf53_wavelet_scheme] unable to process input data that is not 3D\n";
+        return _output;
+      }
+
+      const std::size_t len = std::accumulate(_shape.begin(), _shape.end(),1,std::multiplies<std::size_t>());
+      if(!len)
+        return _output;
+
+      //config() is written to the header after encoding, the decoder sees the capped levels
+      const int max_levels = transform.max_levels(_shape);
+      if(transform.levels > max_levels){
+        std::cerr << "[cdf53_wavelet_scheme] levels=" << transform.levels << " exceeds what the smallest extent supports, using "
+                  << max_levels << "\n";
+        transform.levels = max_levels;
+      }
+
+      if(_input != _output)
+        std::copy(_input, _input + len, _output);
+      transform.forward(_output, _shape, this->n_threads());
+
+      return _output + len;
+    }
+
+    int decode( const compressed_type* _input,
+                raw_type* _output,
+                const std::vector<std::size_t>& _ishape,
+                std::vector<std::size_t> _oshape = std::vector<std::size_t>()) const override final {
+
+      if(_ishape.size()!=3){
+        std::cerr << "[cdf53_wavelet_scheme] unable to process input data that is not 3D\n";
+        return FAILURE;
+      }
+
+      const std::size_t len = std::accumulate(_ishape.begin(), _ishape.end(), 1, std::multiplies<std::size_t>());
+      if(!len)
+        return SUCCESS;
+
+      if(_input != _output)
+        std::copy(_input, _input + len, _output);
+      transform.inverse(_output, _ishape, this->n_threads());
+
+      return SUCCESS;
+
+    }
+
+    /**
+       \brief decode a preview of the stack only, _output receives the low pass of level _level (see
+       detail::lifting_53::lowpass_shape) as a dense stack of its own, the levels below _level are not inverted
+
+       \return SUCCESS or FAILURE
+    */
+    int decode_lowpass( const compressed_type* _input,
+                        raw_type* _output,
+                        const std::vector<std::size_t>& _ishape,
+                        int _level) const {
+
+      if(_ishape.size()!=3 || _level < 0 || _level > transform.levels){
+        std::cerr << "[cdf53_wavelet_scheme] unable to decode level " << _level << " of this input\n";
+        return FAILURE;
+      }
+
+      const std::size_t len = std::accumulate(_ishape.begin(), _ishape.end(), 1, std::multiplies<std::size_t>());
+      if(!len)
+        return SUCCESS;
+
+      std::vector<raw_type> coefficients(_input, _input + len);
+      transform.inverse(coefficients.data(), _ishape, this->n_threads(), _level);
+
+      const auto lowpass = transform.lowpass_shape(_ishape, _level);
+      const std::size_t len_y = _ishape[row_major::y];
+      const std::size_t len_x = _ishape[row_major::x];
+
+      for(std::size_t z = 0;z<lowpass[row_major::z];++z)
+        for(std::size_t y = 0;y<lowpass[row_major::y];++y)
+          _output = std::copy(coefficients.begin() + (z*len_y + y)*len_x,
+                              coefficients.begin() + (z*len_y + y)*len_x + lowpass[row_major::x],
+                              _output);
+
+      return SUCCESS;
+    }
+
+
+    ~cdf53_wavelet_scheme(){};
+
+    std::string output_type() const final override {
+
+      return sqeazy::header_utils::represent<compressed_type>::as_string();
+
+    }
+
+    bool is_compressor() const final override {
+
+      return base_type::is_compressor;
+
+    }
+
+  };
+
+}
+
+#endif /* _CDF53_WAVELET_SCHEME_IMPL_H_ */
@@ -79,60 +79,15 @@ namespace sqeazy {
                              compressed_type* _compressed,
                              const std::vector<std::size_t>& _shape) override final {
 
-      typedef std::size_t size_type;
-
       if(_shape.size()!=3){
         std::cerr << "[diff_scheme] unable to process input data that is not 3D\n";
         return _compressed;
       }
 
       std::size_t length = std::accumulate(_shape.begin(), _shape.end(),1,std::multiplies<std::size_t>());
-      std::copy(_raw, _raw + length, _compressed);//crossing fingers due to possible type mismatch
-
-      std::vector<size_type> offsets;
-      sqeazy::halo<Neighborhood, size_type> geometry(_shape[row_major::w],
-                                                     _shape[row_major::h],
-                                                     _shape[row_major::d]);
-      geometry.compute_offsets_in_x(offsets);
-
-
-      size_type halo_size_x = geometry.non_halo_end(0)-geometry.non_halo_begin(0);
-      if(offsets.size()==1)//no offsets in other dimensions than x
-      {
-        halo_size_x = length - offsets.front();
-      }
-
-
-      const auto n_traversed_pixels = sqeazy::num_traversed_pixels<Neighborhood>();
 
       out_type* signed_compressed = reinterpret_cast<out_type*>(_compressed);
-
-      auto offsets_begin = offsets.begin();
-      const omp_size_type offset_size = offsets.size();
-      const int nthreads = this->n_threads();
-      //auto shape_begin = _shape.data();
-	  const auto pshape = _shape.data();
-
-#pragma omp parallel for                        \
-  shared(signed_compressed)                            \
-  firstprivate( offset_size, halo_size_x, offsets_begin, _raw, pshape,n_traversed_pixels) \
-  num_threads(nthreads)
-      for(omp_size_type offset = 0; offset < offset_size; ++offset) {
-
-        for(std::size_t index = 0; index < (std::size_t)halo_size_x; ++index) {
-
-          auto     local_index = index + *(offsets_begin + offset);
-          sum_type local_sum = naive_sum<Neighborhood>(_raw,local_index,
-                                                       pshape[row_major::w],
-                                                       pshape[row_major::h],
-                                                       pshape[row_major::d]
-            );
-
-          *(signed_compressed + local_index) = _raw[local_index] - local_sum/n_traversed_pixels;
-
-        }
-
-      }
+      neighborhood_mean<Neighborhood>::encode(_raw, signed_compressed, _shape, this->n_threads());
 
       return _compressed+length;
 
@@ -144,50 +99,16 @@ namespace sqeazy {
                 const std::vector<std::size_t>& _shape,
                 std::vector<std::size_t> _out_shape = std::vector<std::size_t>()) const override final {
 
-      typedef std::size_t size_type;
       if(_out_shape.empty())
         _out_shape = _shape;
 
-      unsigned long length = std::accumulate(_shape.begin(), _shape.end(),1,std::multiplies<std::size_t>());
-      std::copy(_in,_in + length, _out);
-
-      std::vector<size_type> offsets;
-      sqeazy::halo<Neighborhood, size_type> geometry(_shape[row_major::w],
-                                                     _shape[row_major::h],
-                                                     _shape[row_major::d]);
-      geometry.compute_offsets_in_x(offsets);
-
-      size_type halo_size_x = geometry.non_halo_end(0)-geometry.non_halo_begin(0);
-      if(offsets.size()==1)//no offsets in other dimensions than x
-      {
-        halo_size_x = length - offsets.front();
+      if(_shape.size()!=3){
+        std::cerr << "[diff_scheme] unable to process input data that is not 3D\n";
+        return FAILURE;
       }
 
-      const sum_type n_traversed_pixels = sqeazy::num_traversed_pixels<Neighborhood>();
       const out_type* signed_in = reinterpret_cast<const out_type*>(_in);
-      const int nthreads = this->n_threads();
-      const omp_size_type offset_size = offsets.size();
-      auto offsets_begin = offsets.begin();
-      auto shape_begin   = _shape.data();
-
-#pragma omp parallel for                               \
-  shared(_out)                            \
-  firstprivate( offsets_begin, offset_size, n_traversed_pixels, signed_in, shape_begin ) \
-  num_threads(nthreads)
-      for(omp_size_type offset=0; offset<offset_size; ++offset) {
-
-        for(std::size_t index = 0; index < (std::size_t)halo_size_x; ++index) {
-
-          const size_type local_index = index + *(offsets_begin + offset);
-          sum_type  local_sum = naive_sum<Neighborhood>(_out,
-                                                        local_index,
-                                                        *(shape_begin + row_major::w),
-                                                        *(shape_begin + row_major::h),
-                                                        *(shape_begin + row_major::d));
-          _out[local_index] = signed_in[local_index] + local_sum/n_traversed_pixels;
-
-        }
-      }
+      neighborhood_mean<Neighborhood>::decode(signed_in, _out, _shape, this->n_threads());
 
       return SUCCESS;
 
@@ -3,6 +3,7 @@
 
 #include <sstream>
 #include <string>
+#include <cmath>
 
 #include "neighborhood_utils.hpp"
 #include "sqeazy_common.hpp"
@@ -10,6 +11,7 @@
 #include "dynamic_stage.hpp"
 #include "string_parsers.hpp"
 #include "background_scheme_utils.hpp"
+#include "saturating_subtract_utils.hpp"
 
 namespace sqeazy {
 
@@ -94,60 +96,121 @@ namespace sqeazy {
       typedef std::size_t size_type;
       unsigned long length = std::accumulate(_shape.begin(), _shape.end(), 1, std::multiplies<size_type>());
 
-      std::vector<size_type> offsets;
-      sqeazy::halo<Neighborhood, size_type> geometry(_shape.begin(), _shape.end());
-      geometry.compute_offsets_in_x(offsets);
+      typedef box_count_below<Neighborhood> counter_t;
+      typedef typename counter_t::count_type count_type;
 
-      size_type halo_size_x = length - offsets[row_major::x];
+      //a pixel is flattened if more than cut_fraction of its neighbors fall below threshold,
+      //the pixel itself is above threshold and hence counts for none of them
+      const float cut_fraction = fraction*(size<Neighborhood>()-1);
+      const std::size_t min_count = cut_fraction < 0 ? 0 : std::size_t(std::floor(cut_fraction)) + 1;
 
-      //no offsets in other dimensions than x
-      if(offsets.size()!=1)
-      {
-        halo_size_x = geometry.non_halo_end(row_major::x) - geometry.non_halo_begin(row_major::x) + 1;
-      }
+      const bool flattens = min_count <= counter_t::volume;
+      const count_type local_min_count = flattens ? min_count : 0;
+      const raw_type local_threshold = threshold;
+
+      //pixels below threshold and pixels in the halo of the stack are left untouched
+      counter_t::for_each_row(_input, _shape, local_threshold,
+                              [&](size_type _row, const count_type* _counts, size_type _x_first, size_type _x_last){
+
+                                const raw_type* in = _input + _row;
+                                compressed_type* out = _output + _row;
+
+                                //local copies, so that the compiler does not reload them after every store to out
+                                const raw_type row_threshold = local_threshold;
+                                const count_type row_min_count = local_min_count;
+                                const bool row_flattens = flattens;
+
+                                for(size_type x = _x_first; x < _x_last; ++x){
+                                  const raw_type value = in[x];
+                                  const bool flatten = row_flattens & (_counts[x] >= row_min_count);
+                                  out[x] = value < row_threshold ? out[x] : (flatten ? raw_type(0) : value);
+                                }
+                              },
+                              this->n_threads());
+
+
+      return _output+length;
+
+    }
+
+    /**
+       \brief flatten like encode does and subtract threshold from every remaining pixel (saturating at 0) in the same pass,
+       this yields what remove_background_scheme(threshold) yields on the output of encode except that pixels below threshold
+       and pixels in the halo of the stack are reduced as well instead of being left untouched
 
+       \param[in] _input 3D stack
+       \param[out] _output buffer of the same size as _input, must not be _input
+       \param[in] _shape dimensionality of the input complying to c_storage_order _shape[] = {z-shape,y-shape,x-shape}
 
-      unsigned n_neighbors_below_threshold = 0;
+       \return pointer to the end of the written output
+    */
+    compressed_type* encode_and_remove_background( const raw_type* _input,
+                                                   compressed_type* _output,
+                                                   const std::vector<std::size_t>& _shape) const {
+
+      typedef std::size_t size_type;
+      const size_type length = std::accumulate(_shape.begin(), _shape.end(), 1, std::multiplies<size_type>());
+
+      typedef box_count_below<Neighborhood> counter_t;
+      typedef typename counter_t::count_type count_type;
 
       const float cut_fraction = fraction*(size<Neighborhood>()-1);
+      const std::size_t min_count = cut_fraction < 0 ? 0 : std::size_t(std::floor(cut_fraction)) + 1;
 
+      const bool flattens = min_count <= counter_t::volume;
+      const count_type local_min_count = flattens ? min_count : 0;
+      const raw_type local_threshold = threshold;
       const int nthreads = this->n_threads();
-      const omp_size_type offset_size = offsets.size();
-      auto offsets_begin = offsets.begin();
-	  auto local_shape = _shape;
-	  const auto local_threshold = threshold;
-
-#pragma omp parallel for                  \
-  shared(_output)                                                          \
-  firstprivate( _input, offsets_begin, offset_size, local_threshold, local_shape , n_neighbors_below_threshold, cut_fraction) \
-  num_threads(nthreads)
-      for(omp_size_type offset=0; offset<offset_size; ++offset) {
 
-        for(std::size_t index = 0; index < (std::size_t)halo_size_x; ++index) {
+      const size_type len_z = _shape[row_major::z];
+      const size_type len_y = _shape[row_major::y];
+      const size_type len_x = _shape[row_major::x];
 
-          const size_type local_index = index + *(offsets_begin + offset);
+      const size_type z_first = counter_t::interior_begin(Neighborhood::z_offset_begin);
+      const size_type z_last = counter_t::interior_end(len_z, Neighborhood::z_offset_end);
+      const size_type y_first = counter_t::interior_begin(Neighborhood::y_offset_begin);
+      const size_type y_last = counter_t::interior_end(len_y, Neighborhood::y_offset_end);
+      const bool has_interior = counter_t::interior_begin(Neighborhood::x_offset_begin) < counter_t::interior_end(len_x, Neighborhood::x_offset_end);
 
-          //skip pixels that are below threshold
-          if(*(_input + local_index)<local_threshold)
-            continue;
+      //1. rows that for_each_row does not report
+      const omp_size_type n_rows = len_z*len_y;
 
-          n_neighbors_below_threshold = count_neighbors_if<Neighborhood>(_input + local_index,
-                                                                         local_shape,
-                                                                         // std::bind2nd(std::less<raw_type>(), threshold)
-                                                                         [&](raw_type element){
-                                                                           return element < local_threshold;
-                                                                         }
-            );
+#pragma omp parallel for                        \
+  shared(_output)                               \
+  num_threads(nthreads)
+      for(omp_size_type r = 0;r<n_rows;++r){
+        const size_type z = r / len_y;
+        const size_type y = r % len_y;
 
-          if(n_neighbors_below_threshold>cut_fraction){
-            _output[local_index] = 0;
-          }
-          else
-            _output[local_index] = _input[local_index];
+        if(has_interior && z >= z_first && z < z_last && y >= y_first && y < y_last)
+          continue;
 
-        }
+        detail::saturating::subtract(_input + r*len_x, len_x, local_threshold, _output + r*len_x);
       }
 
+      //2. interior rows, pixels below threshold end up at 0 whether flattened or not
+      counter_t::for_each_row(_input, _shape, local_threshold,
+                              [&](size_type _row, const count_type* _counts, size_type _x_first, size_type _x_last){
+
+                                const raw_type* in = _input + _row;
+                                compressed_type* out = _output + _row;
+
+                                const raw_type row_threshold = local_threshold;
+                                const count_type row_min_count = local_min_count;
+                                const bool row_flattens = flattens;
+
+                                detail::saturating::subtract_scalar(in, _x_first, row_threshold, out);
+
+                                for(size_type x = _x_first; x < _x_last; ++x){
+                                  const raw_type value = in[x];
+                                  const raw_type reduced = value > row_threshold ? raw_type(value - row_threshold) : raw_type(0);
+                                  const bool flatten = row_flattens & (_counts[x] >= row_min_count);
+                                  out[x] = flatten ? raw_type(0) : reduced;
+                                }
+
+                                detail::saturating::subtract_scalar(in + _x_last, len_x - _x_last, row_threshold, out + _x_last);
+                              },
+                              nthreads);
 
       return _output+length;
 
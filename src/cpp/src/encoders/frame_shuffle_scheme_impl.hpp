@@ -21,14 +21,16 @@ namespace sqeazy {
     typedef in_type raw_type;
     typedef in_type compressed_type;
 
-    static const std::string description() { return std::string("reorder the frames in the incoming stack based on some defined metric"); };
+    static const std::string description() { return std::string("reorder the frames in the incoming stack based on some defined metric; use metric_stride=<integer|default: 1> to compute the metric from every n-th row only"); };
     static const std::size_t default_frame_chunk_size = 1;
 
     std::size_t frame_chunk_size;
     std::string serialized_reorder_map;
+    std::size_t metric_stride;
 
     frame_shuffle_scheme(const std::string& _payload=""):
-      frame_chunk_size(default_frame_chunk_size)
+      frame_chunk_size(default_frame_chunk_size),
+      metric_stride(1)
       {
 
         pipeline_parser p;auto config_map = p.minors(_payload.begin(),_payload.end());
@@ -43,6 +45,10 @@ namespace sqeazy {
           if(f_itr!=config_map.end())
             serialized_reorder_map = f_itr->second;
 
+          f_itr = config_map.find("metric_stride");
+          if(f_itr!=config_map.end())
+            metric_stride = (std::max)(1, std::stoi(f_itr->second));
+
         }
       }
 
@@ -61,6 +67,8 @@ namespace sqeazy {
       msg << "frame_chunk_size=" << std::to_string(frame_chunk_size);
       msg << ",";
       msg << "reorder_map=" << serialized_reorder_map;
+      if(metric_stride != 1)
+        msg << ",metric_stride=" << metric_stride;
       return msg.str();
 
     }
@@ -78,7 +86,7 @@ namespace sqeazy {
       typedef std::size_t size_type;
       unsigned long length = std::accumulate(_shape.begin(), _shape.end(), 1, std::multiplies<size_type>());
 
-      detail::frame_shuffle frames_of(frame_chunk_size);
+      detail::frame_shuffle frames_of(frame_chunk_size, std::vector<std::size_t>(), metric_stride);
 
       auto value = frames_of.encode(_input, _input+length,
                                     _output,
@@ -3,10 +3,18 @@
 
 #include <cstdint>
 #include <iterator>
+#include <type_traits>
 #include <boost/accumulators/accumulators.hpp>
 #include <boost/accumulators/statistics.hpp>
+#include "compass.hpp"
 #include "traits.hpp"
 #include "sqeazy_common.hpp"
+#include "sqeazy_algorithms.hpp"
+#include "brick_utils.hpp"
+
+#ifdef COMPASS_CT_ARCH_X86
+#include <immintrin.h>
+#endif
 
 
 namespace sqeazy {
@@ -15,19 +23,216 @@ namespace sqeazy {
 
     namespace bacc = boost::accumulators;
 
+    namespace frame_metric {
+
+      /**
+         \brief accumulator type wide enough to sum a frame chunk of value_t without overflow
+
+      */
+      template <typename value_t>
+      struct sum_of {
+        typedef typename std::conditional<std::is_floating_point<value_t>::value,
+                                          double,
+                                          typename std::conditional<std::is_signed<value_t>::value,
+                                                                    std::int64_t,
+                                                                    std::uint64_t>::type
+                                          >::type type;
+      };
+
+      template <typename value_t>
+      static typename sum_of<value_t>::type sum_scalar(const value_t* _begin, std::size_t _len){
+
+        typedef typename sum_of<value_t>::type sum_t;
+
+        sum_t value = 0;
+        for(std::size_t i = 0;i<_len;++i)
+          value += _begin[i];
+
+        return value;
+      }
+
+      //types without a dedicated kernel fall back to the scalar sum
+      template <typename value_t>
+      static typename sum_of<value_t>::type sum_sse2(const value_t* _begin, std::size_t _len){
+        return sum_scalar(_begin, _len);
+      }
+
+      template <typename value_t>
+      static typename sum_of<value_t>::type sum_avx2(const value_t* _begin, std::size_t _len){
+        return sum_scalar(_begin, _len);
+      }
+
+#ifdef COMPASS_CT_ARCH_X86
+
+      //sum of absolute differences to 0 yields the sum of 8 bytes in every 64-bit lane
+      SQY_TARGET("sse2")
+      static std::uint64_t sum_sse2(const std::uint8_t* _begin, std::size_t _len){
+
+        const __m128i zero = _mm_setzero_si128();
+        __m128i acc = _mm_setzero_si128();
+
+        std::size_t i = 0;
+        for(;(i+16)<=_len;i+=16)
+          acc = _mm_add_epi64(acc, _mm_sad_epu8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(_begin+i)), zero));
+
+        std::uint64_t value = std::uint64_t(_mm_cvtsi128_si64(acc)) + std::uint64_t(_mm_cvtsi128_si64(_mm_unpackhi_epi64(acc,acc)));
+        return value + sum_scalar(_begin+i, _len-i);
+      }
+
+      SQY_TARGET("avx2")
+      static std::uint64_t sum_avx2(const std::uint8_t* _begin, std::size_t _len){
+
+        const __m256i zero = _mm256_setzero_si256();
+        __m256i acc = _mm256_setzero_si256();
+
+        std::size_t i = 0;
+        for(;(i+32)<=_len;i+=32)
+          acc = _mm256_add_epi64(acc, _mm256_sad_epu8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(_begin+i)), zero));
+
+        const __m128i half = _mm_add_epi64(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc,1));
+        std::uint64_t value = std::uint64_t(_mm_cvtsi128_si64(half)) + std::uint64_t(_mm_cvtsi128_si64(_mm_unpackhi_epi64(half,half)));
+        return value + sum_scalar(_begin+i, _len-i);
+      }
+
+      //the even and odd 16-bit items are added into 32-bit lanes, which are widened to 64-bit
+      //before they can overflow (every lane grows by at most 2*65535 per iteration)
+      SQY_TARGET("sse2")
+      static std::uint64_t sum_sse2(const std::uint16_t* _begin, std::size_t _len){
+
+        static const std::size_t max_iterations = 1 << 15;
+        const __m128i low_short = _mm_set1_epi32(0xffff);
+        const __m128i zero = _mm_setzero_si128();
+        __m128i acc64 = _mm_setzero_si128();
+
+        std::size_t i = 0;
+        while((i+8)<=_len){
+
+          __m128i acc32 = _mm_setzero_si128();
+          const std::size_t end = (std::min)(_len - (_len - i) % 8, i + 8*max_iterations);
+
+          for(;i<end;i+=8){
+            const __m128i values = _mm_loadu_si128(reinterpret_cast<const __m128i*>(_begin+i));
+            acc32 = _mm_add_epi32(acc32, _mm_and_si128(values, low_short));
+            acc32 = _mm_add_epi32(acc32, _mm_srli_epi32(values, 16));
+          }
+
+          acc64 = _mm_add_epi64(acc64, _mm_unpacklo_epi32(acc32, zero));
+          acc64 = _mm_add_epi64(acc64, _mm_unpackhi_epi32(acc32, zero));
+        }
+
+        std::uint64_t value = std::uint64_t(_mm_cvtsi128_si64(acc64)) + std::uint64_t(_mm_cvtsi128_si64(_mm_unpackhi_epi64(acc64,acc64)));
+        return value + sum_scalar(_begin+i, _len-i);
+      }
+
+      SQY_TARGET("avx2")
+      static std::uint64_t sum_avx2(const std::uint16_t* _begin, std::size_t _len){
+
+        static const std::size_t max_iterations = 1 << 15;
+        const __m256i low_short = _mm256_set1_epi32(0xffff);
+        const __m256i zero = _mm256_setzero_si256();
+        __m256i acc64 = _mm256_setzero_si256();
+
+        std::size_t i = 0;
+        while((i+16)<=_len){
+
+          __m256i acc32 = _mm256_setzero_si256();
+          const std::size_t end = (std::min)(_len - (_len - i) % 16, i + 16*max_iterations);
+
+          for(;i<end;i+=16){
+            const __m256i values = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(_begin+i));
+            acc32 = _mm256_add_epi32(acc32, _mm256_and_si256(values, low_short));
+            acc32 = _mm256_add_epi32(acc32, _mm256_srli_epi32(values, 16));
+          }
+
+          acc64 = _mm256_add_epi64(acc64, _mm256_unpacklo_epi32(acc32, zero));
+          acc64 = _mm256_add_epi64(acc64, _mm256_unpackhi_epi32(acc32, zero));
+        }
+
+        const __m128i half = _mm_add_epi64(_mm256_castsi256_si128(acc64), _mm256_extracti128_si256(acc64,1));
+        std::uint64_t value = std::uint64_t(_mm_cvtsi128_si64(half)) + std::uint64_t(_mm_cvtsi128_si64(_mm_unpackhi_epi64(half,half)));
+        return value + sum_scalar(_begin+i, _len-i);
+      }
+
+#endif
+
+      /**
+         \brief sum of [_begin, _begin + _len), uses the widest SIMD kernel available for 8- and 16-bit unsigned input
+
+      */
+      template <typename value_t>
+      static typename sum_of<value_t>::type sum(const value_t* _begin, std::size_t _len){
+
+#ifdef COMPASS_CT_ARCH_X86
+        if(sqeazy::platform::has_simd<compass::feature::avx2>())
+          return sum_avx2(_begin, _len);
+
+        if(sqeazy::platform::has_simd<compass::feature::sse2>())
+          return sum_sse2(_begin, _len);
+#endif
+
+        return sum_scalar(_begin, _len);
+      }
+
+    };
+
 	struct frame_shuffle {
 
 	  std::size_t frame_chunk_size;
       std::vector<std::size_t> decode_map;
+	  std::size_t metric_stride;
 
 	  frame_shuffle(std::size_t _fsize = 1,
-					std::vector<std::size_t> _map = std::vector<std::size_t>()):
+					std::vector<std::size_t> _map = std::vector<std::size_t>(),
+					std::size_t _metric_stride = 1):
 		frame_chunk_size(_fsize),
-		decode_map(_map)
+		decode_map(_map),
+		metric_stride(_metric_stride > 0 ? _metric_stride : 1)
       {
 
       }
 
+	  /**
+		 \brief sum over every metric_stride-th row of the _n_rows rows (of _row_length items each) starting at _chunk
+
+	  */
+	  template <typename value_t>
+	  typename frame_metric::sum_of<value_t>::type chunk_sum(const value_t* _chunk,
+															 std::size_t _n_rows,
+															 std::size_t _row_length) const {
+
+		if(metric_stride == 1)
+		  return frame_metric::sum(_chunk, _n_rows*_row_length);
+
+		typename frame_metric::sum_of<value_t>::type value = 0;
+		for(std::size_t r = 0;r<_n_rows;r+=metric_stride)
+		  value += frame_metric::sum(_chunk + r*_row_length, _row_length);
+
+		return value;
+	  }
+
+	  /**
+		 \brief partition of _shape into chunks of frame_chunk_size frames, the last chunk may be incomplete
+
+	  */
+	  template <typename shape_container_t>
+	  brick_layout chunks_of(const shape_container_t& _shape) const {
+		std::vector<std::size_t> chunk_shape(_shape.begin(), _shape.end());
+		chunk_shape[row_major::z] = frame_chunk_size;
+		return brick_layout(_shape, chunk_shape);
+	  }
+
+	  /**
+		 \brief order of all _n_chunks chunks in the shuffled stream, chunks not covered by decode_map
+		 (the incomplete one) stay in place at the end
+
+	  */
+	  std::vector<std::size_t> chunk_order(std::size_t _n_chunks) const {
+		std::vector<std::size_t> value(decode_map.begin(), decode_map.end());
+		for(std::size_t i = value.size();i<_n_chunks;++i)
+		  value.push_back(i);
+		return value;
+	  }
+
       template <typename value_t>
       std::vector<value_t> remainder(const std::vector<value_t>& _shape) const {
 		std::vector<value_t> rem = _shape;
@@ -95,79 +300,45 @@ namespace sqeazy {
 								 const shape_container_t& _shape,
 								 int nthreads=  1) {
 
-		//typedef typename std::iterator_traits<in_iterator_t>::value_type in_value_type;
-		//typedef typename std::remove_cv<in_value_type>::type in_value_t;
-
-		typedef typename std::iterator_traits<decltype(_shape.begin())>::value_type shape_value_type;
-		typedef typename std::remove_cv<shape_value_type>::type shape_value_t;
-
-		const shape_container_t rem = remainder(_shape);
-		const std::size_t n_elements_per_frame = _shape[row_major::y]*_shape[row_major::x];
-		const std::size_t n_elements_per_frame_chunk = n_elements_per_frame*frame_chunk_size;
-
-		shape_container_t n_full_frames = _shape;
-		std::fill(n_full_frames.begin(), n_full_frames.end(),1);
-		n_full_frames[row_major::z] = _shape[row_major::z] / frame_chunk_size;
-
-		const omp_size_type n_chunks = std::accumulate(n_full_frames.begin(), n_full_frames.end(),1,std::multiplies<shape_value_t>());
-
-		// COLLECT STATISTICS /////////////////////////////////////////////////////////////////////////////////////////////////////
-		// - use plain mean as metric as this should only be an indicator for the signal activity inside the frame here
-		// - a plain sum would do as well as n_elements_per_frame_chunk is constant for all frames
-
-		std::vector<float> metric(n_chunks,0.f);
-		auto metric_itr = metric.data();
-
-#pragma omp parallel for    \
-  shared(metric_itr)		\
-  firstprivate(_begin)		\
-  num_threads(nthreads)
-		for(omp_size_type i = 0;i<n_chunks;++i){
+		typedef typename std::iterator_traits<in_iterator_t>::value_type in_value_type;
+		typedef typename std::remove_cv<in_value_type>::type in_value_t;
+		typedef typename frame_metric::sum_of<in_value_t>::type sum_t;
 
-		  auto voxel_itr = _begin + i*n_elements_per_frame_chunk;
+		const std::size_t n_rows_per_frame_chunk = _shape[row_major::y]*frame_chunk_size;
+		const std::size_t n_elements_per_frame_chunk = n_rows_per_frame_chunk*_shape[row_major::x];
 
-		  float sum = std::accumulate(voxel_itr,voxel_itr+n_elements_per_frame_chunk,
-									  float(0),
-									  std::plus<float>());
-		  *(metric_itr + i) = sum / n_elements_per_frame_chunk;
-		}
+		const omp_size_type n_chunks = _shape[row_major::z] / frame_chunk_size;
 
-		// PERFORM SHUFFLE /////////////////////////////////////////////////////////////////////////////////////////////////////
+		// - use the plain sum as metric as this should only be an indicator for the signal activity inside the frame here,
+		//   n_elements_per_frame_chunk is constant for all frames
+		// - metric and ranking share one parallel region, the chunks are copied by gather_bricks afterwards
+		std::vector<sum_t> metric(n_chunks,0);
 		decode_map.resize(n_chunks);
 
-		auto sorted_metric = metric;
+		auto pmetric = metric.data();
+		auto pdecode_map = decode_map.data();
 
-		//TODO: we need a parallel sort here!
-		//TODO: what if there are frame_chunks with the same value? (highly unlikely with float32_t)
-		std::sort(sorted_metric.begin(), sorted_metric.end());
-
-		auto decode_map_itr = decode_map.data();
-		auto metric_begin = metric.data();
-		auto metric_end = metric_begin + metric.size();
-		auto sorted_metric_begin = sorted_metric.data();
-		const omp_size_type loop_count = metric.size();
-
-#pragma omp parallel for								\
-  shared(_out)							\
-  firstprivate(decode_map_itr,metric_begin,metric_end,sorted_metric_begin,_begin) \
+#pragma omp parallel							\
+  shared(metric)								\
+  firstprivate(_begin,pmetric,pdecode_map)		\
   num_threads(nthreads)
-		for(omp_size_type i =0;i<loop_count;++i){
-		  auto dst = _out + i*n_elements_per_frame_chunk;
-
-		  auto item = *(sorted_metric_begin + i);
-		  auto unsorted_itr = std::find(metric_begin, metric_end,
-										item);
-		  std::size_t original_index = std::distance(metric_begin,unsorted_itr);
-		  *(decode_map_itr + i) = original_index;
-		  auto src_start = _begin + original_index*n_elements_per_frame_chunk;
-
-		  std::copy(src_start,
-					src_start+n_elements_per_frame_chunk,
-					dst);
-		}
+		{
+
+		  // COLLECT STATISTICS ///////////////////////////////////////////////////////////////////////////////////////////////
+#pragma omp for
+		  for(omp_size_type i = 0;i<n_chunks;++i){
+			pmetric[i] = chunk_sum(&*(_begin + i*n_elements_per_frame_chunk),
+								   n_rows_per_frame_chunk,
+								   _shape[row_major::x]);
+		  }
 
+		  // PERFORM SHUFFLE //////////////////////////////////////////////////////////////////////////////////////////////////
+		  // decode_map[i] is the original index of the chunk written to position i, chunks with equal metric keep their order
+#pragma omp single
+		  sqeazy::argsort(metric.begin(), metric.end(), pdecode_map);
+		}
 
-		return _out + metric.size()*n_elements_per_frame_chunk;
+		return gather_bricks(_begin, _out, chunks_of(_shape), decode_map, nthreads);
 
       }
 
@@ -199,77 +370,47 @@ namespace sqeazy {
 		// 75% quanframe?
 		// typedef typename boost::accumulators::accumulator_set<double, stats<boost::accumulators::tag::pot_quanframe<boost::right>(.75)> > quanframe_acc_t;
 
-		const shape_container_t rem = remainder(_shape);
-		const std::size_t n_elements_per_frame = _shape[row_major::y]*_shape[row_major::x];
-		const std::size_t n_elements_per_frame_chunk = n_elements_per_frame*frame_chunk_size;
-
-		shape_container_t n_full_frames = _shape;
-		std::fill(n_full_frames.begin(), n_full_frames.end(),1);
-		n_full_frames[row_major::z] = _shape[row_major::z] / frame_chunk_size;
+		const std::size_t row_length = _shape[row_major::x];
+		const std::size_t n_rows_per_frame_chunk = _shape[row_major::y]*frame_chunk_size;
+		const std::size_t n_elements_per_frame_chunk = n_rows_per_frame_chunk*row_length;
 
 		const shape_value_t n_chunks = (_shape[row_major::z] + frame_chunk_size - 1)/frame_chunk_size;
-		// const auto len = std::distance(_begin,_end);
-
-		// COLLECT STATISTICS /////////////////////////////////////////////////////////////////////////////////////////////////////
-		// median plus stddev around median or take 75% quanframe directly
 
+		// median plus stddev around median or take 75% quanframe directly, the last chunk is incomplete and stays in place
 		std::vector<float> metric(n_chunks-1,0.);
-		auto metric_itr = metric.data();
-		const omp_size_type loop_count = metric.size();
-
-#pragma omp parallel for    \
-  shared(metric_itr)		\
-  firstprivate(_begin)		\
-  num_threads(nthreads)
-		for(omp_size_type i = 0;i<loop_count;++i){
-		  median_acc_t acc;
-		  auto voxel_itr = _begin + i*n_elements_per_frame_chunk;
-
-		  for(std::size_t p = 0;p<n_elements_per_frame_chunk;++p){
-			acc(*voxel_itr++);
-		  }
-
-		  *(metric_itr + i) = bacc::median(acc);
-		}
-
-		// PERFORM SHUFFLE /////////////////////////////////////////////////////////////////////////////////////////////////////
 		decode_map.resize(metric.size());
 
-		auto sorted_metric = metric;
-
-//TODO: we need a parallel sort here!
-		//TODO: what if there are frame_chunks with the same value? (highly unlikely with float32_t)
-		std::sort(sorted_metric.begin(), sorted_metric.end());
+		auto pmetric = metric.data();
+		auto pdecode_map = decode_map.data();
+		const omp_size_type loop_count = metric.size();
 
-		auto decode_map_itr = decode_map.data();
-		auto metric_begin = metric.data();
-		auto metric_end = metric_begin + metric.size();
-		auto sorted_metric_begin = sorted_metric.data();
+#pragma omp parallel							\
+  shared(metric)								\
+  firstprivate(_begin,pmetric,pdecode_map)		\
+  num_threads(nthreads)
+		{
 
+		  // COLLECT STATISTICS ///////////////////////////////////////////////////////////////////////////////////////////////
+#pragma omp for
+		  for(omp_size_type i = 0;i<loop_count;++i){
+			median_acc_t acc;
+			auto chunk_itr = _begin + i*n_elements_per_frame_chunk;
 
-		#pragma omp parallel for															\
-		  shared(_out)																		\
-		  firstprivate(decode_map_itr,metric_begin,metric_end,sorted_metric_begin,_begin)	\
-		  num_threads(nthreads)
-		for(omp_size_type i =0;i<loop_count;++i){
+			for(std::size_t r = 0;r<n_rows_per_frame_chunk;r+=metric_stride){
+			  auto voxel_itr = chunk_itr + r*row_length;
+			  for(std::size_t p = 0;p<row_length;++p)
+				acc(*voxel_itr++);
+			}
 
-		  auto item = *(sorted_metric_begin + i);
-		  auto unsorted_itr = std::find(metric_begin, metric_end,
-										item);
-		  std::size_t original_index = std::distance(metric_begin,unsorted_itr);
-		  *(decode_map_itr + i) = original_index;
-		  auto src_start = _begin + original_index*n_elements_per_frame_chunk;
+			pmetric[i] = bacc::median(acc);
+		  }
 
-		  auto dst = _out + i*n_elements_per_frame_chunk;
-		  std::copy(src_start,
-					src_start+n_elements_per_frame_chunk,
-					dst);
+		  // PERFORM SHUFFLE //////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma omp single
+		  sqeazy::argsort(metric.begin(), metric.end(), pdecode_map);
 		}
 
-		auto dst = std::copy(_begin+metric.size()*n_elements_per_frame_chunk,
-							 _end,
-							 _out + metric.size()*n_elements_per_frame_chunk);
-		return dst;
+		return gather_bricks(_begin, _out, chunks_of(_shape), chunk_order(n_chunks), nthreads);
 
 	  }
 
@@ -305,7 +446,7 @@ namespace sqeazy {
 		  return _out;
 		}
 
-		return decode_with_remainder(_begin, _end, _out,_shape);
+		return decode_with_remainder(_begin, _end, _out,_shape,nthreads);
 
       }
 
@@ -316,46 +457,16 @@ namespace sqeazy {
 										   const shape_container_t& _shape,
 										   int nthreads = 1) const {
 
-		const shape_container_t rem = remainder(_shape);
-		const bool has_remainder = std::accumulate(rem.begin(), rem.end(),0) > 0;
-
-		const std::size_t n_elements_per_frame = _shape[row_major::y]*_shape[row_major::x];
-
-		const std::size_t n_elements_per_frame_chunk = n_elements_per_frame*frame_chunk_size;
-
-		shape_container_t n_full_frames = _shape;
-		std::fill(n_full_frames.begin(), n_full_frames.end(),1);
-		n_full_frames[row_major::z] = _shape[row_major::z] / frame_chunk_size;
-
-		const omp_size_type loop_count = decode_map.size();
-		auto decode_map_itr = decode_map.data();
+		const brick_layout chunks = chunks_of(_shape);
 
-#pragma omp parallel for												\
-		  shared(_out)																		\
-  firstprivate(decode_map_itr,_begin) \
-		  num_threads(nthreads)
-		for(omp_size_type i =0;i<loop_count;++i){
-		  auto src = _begin + i*n_elements_per_frame_chunk;
-		  auto offset = *(decode_map_itr+i);
-		  auto dst = _out + (offset*n_elements_per_frame_chunk);
-		  std::copy(src,
-					src+n_elements_per_frame_chunk,
-					dst);
-		}
-
-		auto dst = _out;
-
-		if(has_remainder){
-		  dst = std::copy(_begin+decode_map.size()*n_elements_per_frame_chunk,
-						  _end,
-						  _out+decode_map.size()*n_elements_per_frame_chunk);
-		}
-		else{
-		  dst += decode_map.size()*n_elements_per_frame_chunk;
+		if(decode_map.size() > chunks.size() ||
+		   std::count_if(decode_map.begin(), decode_map.end(), [&](std::size_t _index){ return _index >= chunks.size();})){
+		  std::cerr << "[sqeazy::detail::frame_shuffle::decode] decode map does not match the number of frame chunks!\n";
+		  return _out;
 		}
 
-		return dst;
-	  };
+		return scatter_bricks(_begin, _out, chunks, chunk_order(chunks.size()), nthreads);
+	  }
 	};
 
   };
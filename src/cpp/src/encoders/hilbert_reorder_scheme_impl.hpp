@@ -0,0 +1,139 @@
+#ifndef _HILBERT_REORDER_SCHEME_IMPL_H_
+#define _HILBERT_REORDER_SCHEME_IMPL_H_
+
+#include <sstream>
+#include <string>
+#include <functional>
+
+#include "sqeazy_common.hpp"
+#include "traits.hpp"
+#include "dynamic_stage.hpp"
+#include "string_parsers.hpp"
+
+#include "hilbert_reorder_utils.hpp"
+
+namespace sqeazy {
+
+
+  /**
+* @brief reorder the incoming stack into tiles of tile_size^3 voxels, every tile is stored along the 3D hilbert
+* curve through it; in contrast to the z curve (zcurve_reorder_scheme), consecutive voxels of the output are
+* always neighbors in the stack
+*
+* tile_size is rounded down to a power of 2 in [2,64], tiles of 16^3 voxels (default) fit into the L1 cache
+*
+* this scheme cannot be run inplace.
+* this scheme is reversable.
+*
+*/
+  template <typename in_type>
+  struct hilbert_reorder_scheme : public filter<in_type> {
+
+    typedef filter<in_type> base_type;
+    typedef in_type raw_type;
+    typedef in_type compressed_type;
+
+    static const std::string description() { return std::string("reorder the memory layout of the incoming buffer using 3D hilbert curves inside tiles, <tile_size|default = 16> the extent of a tile (power of 2, up to 64)"); };
+
+
+    std::size_t tile_size;
+    detail::hilbert encoder;
+
+    hilbert_reorder_scheme(const std::string& _payload=""):
+      tile_size(16),
+      encoder(16)
+      {
+
+        pipeline_parser p;
+        auto config_map = p.minors(_payload.begin(),_payload.end());
+
+        if(config_map.size()){
+
+          auto f_itr = config_map.find("tile_size");
+          if(f_itr!=config_map.end()){
+            const int requested = std::stoi(f_itr->second);
+            if(requested <= 0)
+              std::cerr << "[hilbert_reorder_scheme] tile_size=" << requested << " is not supported, expected a value > 0, using 16\n";
+            else {
+              encoder = detail::hilbert(requested);
+              tile_size = encoder.tile_size;
+            }
+          }
+
+        }
+      }
+
+    std::string name() const override final {
+
+      std::ostringstream msg;
+      msg << "hilbert_reorder";
+
+      return msg.str();
+
+    }
+
+    std::string config() const override final {
+
+      std::ostringstream msg;
+      msg << "tile_size=" << std::to_string(tile_size);
+      return msg.str();
+
+    }
+
+    std::intmax_t max_encoded_size(std::intmax_t _size_bytes) const override final {
+
+      return _size_bytes;
+    }
+
+    compressed_type* encode( const raw_type* _input,
+                             compressed_type* _output,
+                             const std::vector<std::size_t>& _shape) override final {
+
+      const std::size_t len = std::accumulate(_shape.begin(), _shape.end(),1,std::multiplies<std::size_t>());
+      auto value = encoder.encode(_input,
+                                  _input + len,
+                                  _output,
+                                  _shape,
+                                  this->n_threads());
+      return value;
+    }
+
+    int decode( const compressed_type* _input,
+                raw_type* _output,
+                const std::vector<std::size_t>& _ishape,
+                std::vector<std::size_t> _oshape = std::vector<std::size_t>()) const override final {
+
+      std::size_t len = std::accumulate(_ishape.begin(), _ishape.end(), 1, std::multiplies<std::size_t>());
+
+      auto value = encoder.decode(_input,
+                                  _input + len,
+                                  _output,
+                                  _ishape,
+                                  this->n_threads());
+      if(value==(_output+len))
+        return SUCCESS;
+      else
+        return FAILURE;
+
+    }
+
+
+    ~hilbert_reorder_scheme(){};
+
+    std::string output_type() const final override {
+
+      return sqeazy::header_utils::represent<compressed_type>::as_string();
+
+    }
+
+    bool is_compressor() const final override {
+
+      return base_type::is_compressor;
+
+    }
+
+  };
+
+}
+
+#endif /* _HILBERT_REORDER_SCHEME_IMPL_H_ */
@@ -0,0 +1,307 @@
+#ifndef _HILBERT_REORDER_UTILS_H_
+#define _HILBERT_REORDER_UTILS_H_
+
+#include <cstdint>
+#include <array>
+#include <vector>
+#include <memory>
+#include <iterator>
+#include <algorithm>
+
+#include "sqeazy_common.hpp"
+#include "traits.hpp"
+#include "brick_utils.hpp"
+
+namespace sqeazy {
+
+  namespace detail {
+
+	/**
+	   \brief coordinates (z,y,x) of the _index-th voxel along the 3D Hilbert curve through a cube
+	   of 2^_n_bits voxels per axis
+
+	   follows J. Skilling, "Programming the Hilbert curve", AIP Conf. Proc. 707 (2004): the index is
+	   spread into its transposed form (bit i of every coordinate taken from 3 consecutive bits of the index),
+	   Gray decoded and the excess rotations of Butz' algorithm are undone level by level
+
+	*/
+	static std::array<std::uint32_t,3> hilbert_to_axes(std::uint64_t _index, int _n_bits){
+
+	  static const int n_dims = 3;
+	  std::array<std::uint32_t,3> value = {{0,0,0}};
+
+	  //transpose
+	  for(int b = 0;b<_n_bits;++b){
+		for(int d = 0;d<n_dims;++d){
+		  const std::uint64_t bit = (_index >> (b*n_dims + (n_dims - 1 - d))) & 1;
+		  value[d] |= std::uint32_t(bit) << b;
+		}
+	  }
+
+	  //Gray decode by H ^ (H/2)
+	  const std::uint32_t n_max = std::uint32_t(2) << (_n_bits - 1);
+	  std::uint32_t t = value[n_dims-1] >> 1;
+	  for(int d = n_dims - 1;d>0;--d)
+		value[d] ^= value[d-1];
+	  value[0] ^= t;
+
+	  //undo excess work
+	  for(std::uint32_t q = 2;q != n_max;q <<= 1){
+		const std::uint32_t p = q - 1;
+		for(int d = n_dims - 1;d>=0;--d){
+		  if(value[d] & q)
+			value[0] ^= p;
+		  else{
+			t = (value[0] ^ value[d]) & p;
+			value[0] ^= t;
+			value[d] ^= t;
+		  }
+		}
+	  }
+
+	  return value;
+	}
+
+	struct hilbert {
+
+	  std::size_t tile_size;
+
+	  //curve[i] is the row-major position inside a full tile of the i-th voxel along the curve
+	  std::vector<std::uint32_t> curve;
+
+	  static const std::size_t min_tile_size = 2;
+	  static const std::size_t max_tile_size = 64;
+
+	  //stack offset of every curve position inside a full tile and inside the (at most 7) kinds of tiles cut by
+	  //the upper border of a stack of the given shape, relative to the origin of the tile
+	  struct tile_offsets {
+
+		std::vector<std::size_t> shape;
+		std::vector<std::size_t> full;
+		std::array<std::vector<std::size_t>,8> cut;
+	  };
+
+	  //offsets for the last shape seen, they take several MB at tile_size=64 and are reused as long as the shape is
+	  mutable std::shared_ptr<const tile_offsets> cached_offsets;
+
+	  /**
+		 \brief prepare the curve through tiles of _tsize^3 voxels, _tsize is rounded down to a power of 2
+		 inside [min_tile_size, max_tile_size]
+
+	  */
+	  hilbert(std::size_t _tsize):
+		tile_size(min_tile_size),
+		curve(),
+		cached_offsets()
+		{
+		  while(tile_size < max_tile_size && (tile_size << 1) <= _tsize)
+			tile_size <<= 1;
+
+		  int n_bits = 0;
+		  while((std::size_t(1) << n_bits) < tile_size)
+			++n_bits;
+
+		  curve.resize(tile_size*tile_size*tile_size);
+		  for(std::size_t i = 0;i<curve.size();++i){
+			const std::array<std::uint32_t,3> pos = hilbert_to_axes(i, n_bits);
+			curve[i] = (pos[row_major::z]*tile_size + pos[row_major::y])*tile_size + pos[row_major::x];
+		  }
+		}
+
+	  /**
+		 \brief reorder the stack into tiles of tile_size^3 voxels, tiles are stored in row-major order
+		 of the tile grid and every tile is stored along the hilbert curve through it
+
+		 tiles cut by the upper border of any axis follow the same curve, voxels outside of the stack are skipped
+
+		 \param[in]
+
+		 \return
+		 \retval
+
+	  */
+	  template <typename in_iterator_t, typename out_iterator_t, typename shape_container_t>
+	  out_iterator_t encode(in_iterator_t _begin,
+							in_iterator_t _end,
+							out_iterator_t _out,
+							const shape_container_t& _shape,
+							int _nthreads = 1) const {
+
+		typedef typename std::iterator_traits<in_iterator_t>::value_type in_value_type;
+		typedef typename std::remove_cv<in_value_type>::type in_value_t;
+
+		typedef typename std::iterator_traits<out_iterator_t>::value_type out_value_type;
+		typedef typename std::remove_cv<out_value_type>::type out_value_t;
+
+		static_assert(sizeof(in_value_t) == sizeof(out_value_t), "[sqeazy::detail::hilbert::encode] hilbert received non-matching types");
+
+		if(_shape.size()!=3){
+		  std::cerr << "[sqeazy::detail::hilbert::encode] received non-3D shape which is currently unsupported!\n";
+		  return _out;
+		}
+
+		std::size_t n_elements = _end - _begin;
+		std::size_t n_elements_from_shape = std::accumulate(_shape.begin(), _shape.end(),
+															1,
+															std::multiplies<std::size_t>());
+		if(n_elements_from_shape != n_elements){
+		  std::cerr << "[sqeazy::detail::hilbert::encode] input iterator range does not match shape in 1D size!\n";
+		  return _out;
+		}
+
+		for_each_voxel_of_tiles(_shape,
+								[&](std::size_t _stack_offset, std::size_t _stream_offset){
+								  _out[_stream_offset] = _begin[_stack_offset];
+								},
+								_nthreads);
+
+		return _out + n_elements;
+	  }
+
+	  /**
+		 \brief offsets of the curve positions for tiles of a stack of _shape, taken from the cache if the
+		 shape did not change since the last call
+
+	  */
+	  template <typename shape_container_t>
+	  std::shared_ptr<const tile_offsets> offsets_of(const shape_container_t& _shape) const {
+
+		std::shared_ptr<const tile_offsets> value = std::atomic_load(&cached_offsets);
+		if(value &&
+		   value->shape.size() == _shape.size() &&
+		   std::equal(value->shape.begin(), value->shape.end(), _shape.begin()))
+		  return value;
+
+		std::shared_ptr<tile_offsets> fresh = std::make_shared<tile_offsets>();
+		fresh->shape.assign(_shape.begin(), _shape.end());
+
+		const std::size_t len_y = _shape[row_major::y];
+		const std::size_t len_x = _shape[row_major::x];
+		const std::size_t ts = tile_size;
+		const std::size_t n_voxels_per_tile = curve.size();
+
+		fresh->full.resize(n_voxels_per_tile);
+		for(std::size_t i = 0;i<n_voxels_per_tile;++i){
+		  const std::size_t z = curve[i] / (ts*ts);
+		  const std::size_t y = (curve[i] / ts) % ts;
+		  const std::size_t x = curve[i] % ts;
+		  fresh->full[i] = (z*len_y + y)*len_x + x;
+		}
+
+		//tiles cut by the upper border of the stack visit the curve positions inside of it only,
+		//there are at most 8 kinds of tiles (cut or not along z, y and x)
+		for(int kind = 1;kind<8;++kind){
+		  const std::size_t z_extent = (kind & 4) ? _shape[row_major::z] % ts : ts;
+		  const std::size_t y_extent = (kind & 2) ? len_y % ts : ts;
+		  const std::size_t x_extent = (kind & 1) ? len_x % ts : ts;
+
+		  if(!z_extent || !y_extent || !x_extent)
+			continue;
+
+		  fresh->cut[kind].reserve(z_extent*y_extent*x_extent);
+		  for(std::size_t i = 0;i<n_voxels_per_tile;++i){
+			if(curve[i] / (ts*ts) < z_extent &&
+			   (curve[i] / ts) % ts < y_extent &&
+			   curve[i] % ts < x_extent)
+			  fresh->cut[kind].push_back(fresh->full[i]);
+		  }
+		}
+
+		value = fresh;
+		std::atomic_store(&cached_offsets, value);
+		return value;
+	  }
+
+	  /**
+		 \brief call _functor(stack_offset, stream_offset) for every voxel of _shape, tile by tile and
+		 along the curve inside every tile
+
+		 the stack offset of every curve position inside a full or cut tile is looked up once for all tiles
+		 (and all calls with the same shape, see offsets_of), tiles are distributed among _nthreads threads by the
+		 brick engine (see brick_utils.hpp)
+
+	  */
+	  template <typename shape_container_t, typename functor_t>
+	  void for_each_voxel_of_tiles(const shape_container_t& _shape,
+								   functor_t&& _functor,
+								   int _nthreads = 1) const {
+
+		const brick_layout tiles(_shape, std::vector<std::size_t>(_shape.size(), tile_size));
+
+		const std::size_t ts = tile_size;
+		const std::shared_ptr<const tile_offsets> offsets = offsets_of(_shape);
+
+		for_each_brick(tiles, std::vector<std::size_t>(),
+					   [&](std::size_t _tile, std::size_t _tile_offset){
+
+						 const std::size_t origin = tiles.offset(_tile);
+
+						 const int kind = (tiles.extent(_tile, row_major::z) != ts ? 4 : 0)
+						   | (tiles.extent(_tile, row_major::y) != ts ? 2 : 0)
+						   | (tiles.extent(_tile, row_major::x) != ts ? 1 : 0);
+
+						 const std::vector<std::size_t>& visited = kind ? offsets->cut[kind] : offsets->full;
+						 const std::size_t* poffsets = visited.data();
+						 const std::size_t n_visited = visited.size();
+
+						 for(std::size_t i = 0;i<n_visited;++i)
+						   _functor(origin + poffsets[i], _tile_offset + i);
+					   },
+					   _nthreads);
+
+	  }
+
+	  /**
+		 \brief inverse of encode
+
+		 \param[in]
+
+		 \return
+		 \retval
+
+	  */
+	  template <typename in_iterator_t, typename out_iterator_t, typename shape_container_t>
+	  out_iterator_t decode(in_iterator_t _begin,
+							in_iterator_t _end,
+							out_iterator_t _out,
+							const shape_container_t& _shape,
+							int _nthreads = 1) const {
+
+		typedef typename std::iterator_traits<in_iterator_t>::value_type in_value_type;
+		typedef typename std::remove_cv<in_value_type>::type in_value_t;
+
+		typedef typename std::iterator_traits<out_iterator_t>::value_type out_value_type;
+		typedef typename std::remove_cv<out_value_type>::type out_value_t;
+
+		static_assert(sizeof(in_value_t) == sizeof(out_value_t), "[sqeazy::detail::hilbert::decode] hilbert received non-matching types");
+
+		if(_shape.size()!=3){
+		  std::cerr << "[sqeazy::detail::hilbert::decode] received non-3D shape which is currently unsupported!\n";
+		  return _out;
+		}
+
+		std::size_t n_elements = _end - _begin;
+		std::size_t n_elements_from_shape = std::accumulate(_shape.begin(), _shape.end(),
+															1,
+															std::multiplies<std::size_t>());
+		if(n_elements_from_shape != n_elements){
+		  std::cerr << "[sqeazy::detail::hilbert::decode] input iterator range does not match shape in 1D size!\n";
+		  return _out;
+		}
+
+		for_each_voxel_of_tiles(_shape,
+								[&](std::size_t _stack_offset, std::size_t _stream_offset){
+								  _out[_stack_offset] = _begin[_stream_offset];
+								},
+								_nthreads);
+
+		return _out + n_elements;
+	  }
+
+	};
+
+  };
+
+};
+
+#endif /* _HILBERT_REORDER_UTILS_H_ */
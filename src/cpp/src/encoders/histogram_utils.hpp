@@ -6,6 +6,9 @@
 #include <iterator>
 #include <numeric>
 #include <cmath>
+#include <algorithm>
+#include <random>
+#include <thread>
 
 #include "sqeazy_common.hpp"
 
@@ -171,6 +174,93 @@ namespace sqeazy {
 
         }
 
+            /**
+             *  \brief fill the histogram represented by _bins with the value counts observed in a subset of [_begin,_end);
+             *  the range is cut into blocks of _block_size items of which _fraction are visited, either
+             *  at a fixed stride or at a random (but reproducible) position inside each stride
+             *
+             *  \param _begin random access iterator pointing to element 0 of the values to histogram
+             *  \param _end random access iterator pointing to the last+1 element of the values to histogram
+             *  \param _bins input iterator of the histogram bins (assumed to yield a linear range of range(0,max_value(*_begin)))
+             *  \param _fraction fraction of blocks to visit, values >= 1 histogram the full range
+             *  \param _random draw one block at random from every stride instead of taking the first one
+             *  \param nthreads number of threads to use
+             *  \param _block_size number of consecutive items that are visited at once
+             *  \return _bins + number of bins
+             */
+            template <typename iter_type, typename bin_iter_type>
+            bin_iter_type fill_histogram_sampled(iter_type _begin,
+                                                 iter_type _end,
+                                                 bin_iter_type _bins,
+                                                 float _fraction,
+                                                 bool _random = false,
+                                                 int nthreads = 1,
+                                                 std::size_t _block_size = 1 << 12
+                )
+            {
+
+                const std::size_t len = std::distance(_begin,_end);
+                const std::size_t n_blocks = (len + _block_size - 1)/_block_size;
+
+                if(!(_fraction < 1.f) || n_blocks < 2)
+                    return fill_histogram(_begin, _end, _bins, nthreads);
+
+                if(nthreads <= 0)
+                    nthreads = std::thread::hardware_concurrency();
+
+                typedef typename std::iterator_traits<iter_type>::value_type value_type;
+                using histo_t = typename dense_histo<value_type>::type;
+
+                const std::size_t n_sampled = (std::max)(std::size_t(1),
+                                                         std::min(n_blocks,std::size_t(std::ceil(_fraction*n_blocks))));
+
+                //block i is taken from [i*n_blocks/n_sampled, (i+1)*n_blocks/n_sampled)
+                std::vector<std::size_t> blocks(n_sampled,0);
+                std::mt19937 gen(n_blocks);
+                for(std::size_t i = 0;i<n_sampled;++i){
+                    const std::size_t first = (i*n_blocks)/n_sampled;
+                    const std::size_t last = ((i+1)*n_blocks)/n_sampled;
+                    blocks[i] = first;
+                    if(_random && last > first + 1)
+                        blocks[i] += gen() % (last - first);
+                }
+
+                std::vector<histo_t> histo_clones(nthreads, histo_t(dense_histo<value_type>::size,0));
+                auto histo_clones_itr = histo_clones.data();
+                const auto blocks_itr = blocks.data();
+                const omp_size_type n_blocks_sampled = n_sampled;
+
+#pragma omp parallel for                                        \
+    shared( histo_clones_itr )                                  \
+    firstprivate( _begin, blocks_itr, len, _block_size )        \
+    num_threads(nthreads)
+                for(omp_size_type b = 0;b<n_blocks_sampled;b++){
+
+                    auto my_histo_itr = (histo_clones_itr+omp_get_thread_num())->data();
+                    const std::size_t first = blocks_itr[b]*_block_size;
+                    const std::size_t last = (std::min)(len, first + _block_size);
+
+                    for(std::size_t i = first;i<last;++i)
+                        my_histo_itr[(std::uint32_t)*(_begin+i)]++;
+
+                }
+
+                const omp_size_type histo_len = dense_histo<value_type>::size;
+                const omp_size_type n_clones = histo_clones.size();
+
+#pragma omp parallel for                        \
+    shared( _bins )                             \
+    firstprivate( histo_clones_itr, n_clones )  \
+    num_threads(nthreads)
+                for(omp_size_type idx = 0;idx<histo_len;idx++){
+                    for(omp_size_type clone = 0;clone<n_clones;++clone){
+                        *(_bins + idx) += (histo_clones_itr+clone)->data()[idx];
+                    }
+                }
+
+                return _bins + histo_len;
+            }
+
         };
 
 
@@ -520,6 +610,38 @@ namespace sqeazy {
             return _obegin+len;
         }
 
+        /**
+         *  \brief earth mover's distance between two histograms of equal binning, i.e. the sum over all bins of the
+         *  absolute difference of both normalized cumulative distributions; for intensity histograms this is the
+         *  average distance in intensity units that has to be moved to turn one distribution into the other
+         *
+         *  \param _lbegin start of first histogram
+         *  \param _lend end of first histogram
+         *  \param _rbegin start of second histogram (expected to have as many bins as the first)
+         *  \return result_t (0 if any histogram is empty)
+         */
+        template <typename iter_t, typename riter_t, typename result_t = double>
+        result_t earth_movers_distance(iter_t _lbegin, iter_t _lend, riter_t _rbegin){
+
+            const result_t lsum = std::accumulate(_lbegin, _lend, result_t(0));
+            const result_t rsum = std::accumulate(_rbegin, _rbegin + std::distance(_lbegin,_lend), result_t(0));
+
+            if(!(lsum > 0) || !(rsum > 0))
+                return 0;
+
+            result_t lcdf = 0;
+            result_t rcdf = 0;
+            result_t value = 0;
+
+            for(;_lbegin!=_lend;++_lbegin,++_rbegin){
+                lcdf += *_lbegin;
+                rcdf += *_rbegin;
+                value += std::fabs(lcdf/lsum - rcdf/rsum);
+            }
+
+            return value;
+        }
+
 
     }  // detail
 
@@ -0,0 +1,383 @@
+#ifndef _LUT_UTILS_H_
+#define _LUT_UTILS_H_
+
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <climits>
+#include <type_traits>
+#include <iostream>
+
+#include "compass.hpp"
+#include "sqeazy_common.hpp"
+
+#ifdef COMPASS_CT_ARCH_X86
+#include <immintrin.h>
+#endif
+
+namespace sqeazy {
+
+  namespace detail {
+
+    namespace lut {
+
+      //number of elements every thread processes at once with the vectorized kernels
+      static const std::size_t block_size = 1 << 15;
+
+      /**
+         \brief apply _lut to every element of [_in,_in+_len) and write the result to _out (scalar reference implementation)
+
+         \param[in] _in input buffer
+         \param[in] _len number of elements in _in
+         \param[in] _lut lookup table, must have 1 << bits(in_t) items
+         \param[out] _out output buffer of at least _len items
+         \param[in] _nthreads number of threads to use
+
+         \return pointer to _out + _len
+      */
+      template <typename in_t, typename out_t>
+      static out_t* apply_scalar(const in_t* _in,
+                                 std::size_t _len,
+                                 const std::vector<out_t>& _lut,
+                                 out_t* _out,
+                                 int _nthreads = 1){
+
+        typedef typename std::make_unsigned<in_t>::type index_t;
+
+        const out_t* lut = _lut.data();
+
+        if(_nthreads==1){
+          for(std::size_t idx = 0;idx<_len;++idx)
+            _out[idx] = lut[index_t(_in[idx])];
+        }
+        else{
+          const omp_size_type len = _len;
+
+#pragma omp parallel for                        \
+  shared(_out )                                 \
+  firstprivate( len, _in, lut )                 \
+  num_threads(_nthreads)
+          for(omp_size_type idx = 0;idx<len;idx++){
+            _out[idx] = lut[index_t(_in[idx])];
+          }
+        }
+
+        return _out + _len;
+      }
+
+#ifdef COMPASS_CT_ARCH_X86
+
+      /**
+         \brief 16-bit to 8-bit lookup using AVX2 gathers, the lookup table must be padded by sizeof(int)
+         bytes as every gather loads 4 bytes starting at the looked up item
+
+      */
+      SQY_TARGET("avx2")
+      static void encode_16to8_avx2(const std::uint16_t* _in,
+                                    std::size_t _len,
+                                    const std::uint8_t* _padded_lut,
+                                    std::uint8_t* _out){
+
+        const int* base = reinterpret_cast<const int*>(_padded_lut);
+        const __m256i low_byte = _mm256_set1_epi32(0xff);
+        //packus operates per 128-bit lane, this restores the order of 4-byte groups
+        const __m256i lane_order = _mm256_setr_epi32(0,4,1,5,2,6,3,7);
+
+        std::size_t idx = 0;
+        for(;(idx+32)<=_len;idx+=32){
+
+          const __m256i first = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(_in+idx));
+          const __m256i second = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(_in+idx+16));
+
+          __m256i g0 = _mm256_i32gather_epi32(base, _mm256_cvtepu16_epi32(_mm256_castsi256_si128(first)), 1);
+          __m256i g1 = _mm256_i32gather_epi32(base, _mm256_cvtepu16_epi32(_mm256_extracti128_si256(first,1)), 1);
+          __m256i g2 = _mm256_i32gather_epi32(base, _mm256_cvtepu16_epi32(_mm256_castsi256_si128(second)), 1);
+          __m256i g3 = _mm256_i32gather_epi32(base, _mm256_cvtepu16_epi32(_mm256_extracti128_si256(second,1)), 1);
+
+          g0 = _mm256_and_si256(g0,low_byte);
+          g1 = _mm256_and_si256(g1,low_byte);
+          g2 = _mm256_and_si256(g2,low_byte);
+          g3 = _mm256_and_si256(g3,low_byte);
+
+          const __m256i packed = _mm256_packus_epi16(_mm256_packus_epi32(g0,g1),
+                                                     _mm256_packus_epi32(g2,g3));
+
+          _mm256_storeu_si256(reinterpret_cast<__m256i*>(_out+idx),
+                              _mm256_permutevar8x32_epi32(packed,lane_order));
+        }
+
+        for(;idx<_len;++idx)
+          _out[idx] = _padded_lut[_in[idx]];
+
+      }
+
+      /**
+         \brief 8-bit to 16-bit lookup using AVX2 gathers, the lookup table must be padded by sizeof(std::uint16_t)
+         items as every gather loads 4 bytes starting at the looked up item
+
+      */
+      SQY_TARGET("avx2")
+      static void decode_8to16_avx2(const std::uint8_t* _in,
+                                    std::size_t _len,
+                                    const std::uint16_t* _padded_lut,
+                                    std::uint16_t* _out){
+
+        const int* base = reinterpret_cast<const int*>(_padded_lut);
+        const __m256i low_short = _mm256_set1_epi32(0xffff);
+
+        std::size_t idx = 0;
+        for(;(idx+16)<=_len;idx+=16){
+
+          const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(_in+idx));
+
+          __m256i g0 = _mm256_i32gather_epi32(base, _mm256_cvtepu8_epi32(bytes), 2);
+          __m256i g1 = _mm256_i32gather_epi32(base, _mm256_cvtepu8_epi32(_mm_srli_si128(bytes,8)), 2);
+
+          g0 = _mm256_and_si256(g0,low_short);
+          g1 = _mm256_and_si256(g1,low_short);
+
+          //packus operates per 128-bit lane, restore the order of 8-byte groups
+          const __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi32(g0,g1),0xd8);
+          _mm256_storeu_si256(reinterpret_cast<__m256i*>(_out+idx),packed);
+        }
+
+        for(;idx<_len;++idx)
+          _out[idx] = _padded_lut[_in[idx]];
+
+      }
+
+      /**
+         \brief 16-bit to 16-bit lookup using AVX2 gathers, the lookup table must be padded by sizeof(std::uint16_t)
+         items as every gather loads 4 bytes starting at the looked up item
+
+      */
+      SQY_TARGET("avx2")
+      static void lookup_16to16_avx2(const std::uint16_t* _in,
+                                     std::size_t _len,
+                                     const std::uint16_t* _padded_lut,
+                                     std::uint16_t* _out){
+
+        const int* base = reinterpret_cast<const int*>(_padded_lut);
+        const __m256i low_short = _mm256_set1_epi32(0xffff);
+
+        std::size_t idx = 0;
+        for(;(idx+16)<=_len;idx+=16){
+
+          const __m256i values = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(_in+idx));
+
+          __m256i g0 = _mm256_i32gather_epi32(base, _mm256_cvtepu16_epi32(_mm256_castsi256_si128(values)), 2);
+          __m256i g1 = _mm256_i32gather_epi32(base, _mm256_cvtepu16_epi32(_mm256_extracti128_si256(values,1)), 2);
+
+          g0 = _mm256_and_si256(g0,low_short);
+          g1 = _mm256_and_si256(g1,low_short);
+
+          //packus operates per 128-bit lane, restore the order of 8-byte groups
+          const __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi32(g0,g1),0xd8);
+          _mm256_storeu_si256(reinterpret_cast<__m256i*>(_out+idx),packed);
+        }
+
+        for(;idx<_len;++idx)
+          _out[idx] = _padded_lut[_in[idx]];
+
+      }
+
+      /**
+         \brief 8-bit to 16-bit lookup using vpermi2b, the 256 entry table is split in a low-byte and a high-byte plane
+         of 4 registers each; 2 permutes select among the lower and upper 128 entries, bit 7 of the index chooses among them
+
+      */
+      SQY_TARGET("avx512f,avx512bw,avx512vbmi")
+      static void decode_8to16_avx512vbmi(const std::uint8_t* _in,
+                                          std::size_t _len,
+                                          const std::uint16_t* _lut,
+                                          std::uint16_t* _out){
+
+        alignas(64) std::uint8_t low[256];
+        alignas(64) std::uint8_t high[256];
+
+        for(int i = 0;i<256;++i){
+          low[i] = _lut[i] & 0xff;
+          high[i] = _lut[i] >> 8;
+        }
+
+        const __m512i low0 = _mm512_load_si512(low);
+        const __m512i low1 = _mm512_load_si512(low+64);
+        const __m512i low2 = _mm512_load_si512(low+128);
+        const __m512i low3 = _mm512_load_si512(low+192);
+
+        const __m512i high0 = _mm512_load_si512(high);
+        const __m512i high1 = _mm512_load_si512(high+64);
+        const __m512i high2 = _mm512_load_si512(high+128);
+        const __m512i high3 = _mm512_load_si512(high+192);
+
+        //unpack operates per 128-bit lane, these restore the order of 8-byte groups
+        const __m512i first_half = _mm512_set_epi64(11,10,3,2,9,8,1,0);
+        const __m512i second_half = _mm512_set_epi64(15,14,7,6,13,12,5,4);
+
+        std::size_t idx = 0;
+        for(;(idx+64)<=_len;idx+=64){
+
+          const __m512i values = _mm512_loadu_si512(_in+idx);
+          const __mmask64 upper = _mm512_movepi8_mask(values);
+
+          const __m512i lo = _mm512_mask_blend_epi8(upper,
+                                                    _mm512_permutex2var_epi8(low0,values,low1),
+                                                    _mm512_permutex2var_epi8(low2,values,low3));
+          const __m512i hi = _mm512_mask_blend_epi8(upper,
+                                                    _mm512_permutex2var_epi8(high0,values,high1),
+                                                    _mm512_permutex2var_epi8(high2,values,high3));
+
+          const __m512i a = _mm512_unpacklo_epi8(lo,hi);
+          const __m512i b = _mm512_unpackhi_epi8(lo,hi);
+
+          _mm512_storeu_si512(_out+idx,_mm512_permutex2var_epi64(a,first_half,b));
+          _mm512_storeu_si512(_out+idx+32,_mm512_permutex2var_epi64(a,second_half,b));
+        }
+
+        for(;idx<_len;++idx)
+          _out[idx] = _lut[_in[idx]];
+
+      }
+
+#endif
+
+      /**
+         \brief call _kernel on consecutive blocks of _len items, distribute blocks among _nthreads threads
+
+      */
+      template <typename in_t, typename out_t, typename lut_t, typename kernel_t>
+      static void blockwise(kernel_t _kernel,
+                            const in_t* _in,
+                            std::size_t _len,
+                            const lut_t* _lut,
+                            out_t* _out,
+                            int _nthreads){
+
+        const omp_size_type n_blocks = (_len + block_size - 1)/block_size;
+        const std::size_t len = _len;
+
+#pragma omp parallel for                        \
+  shared(_out )                                 \
+  firstprivate( len, _in, _lut, _kernel )       \
+  num_threads(_nthreads)
+        for(omp_size_type b = 0;b<n_blocks;b++){
+          const std::size_t offset = b*block_size;
+          _kernel(_in + offset, (std::min)(block_size, len - offset), _lut, _out + offset);
+        }
+
+      }
+
+      /**
+         \brief apply _lut to every element of [_in,_in+_len) and write the result to _out,
+         the 16-bit to 8-bit, 8-bit to 16-bit and 16-bit to 16-bit cases are vectorized if the hardware supports it
+
+         \param[in] _in input buffer
+         \param[in] _len number of elements in _in
+         \param[in] _lut lookup table, must have 1 << bits(in_t) items
+         \param[out] _out output buffer of at least _len items
+         \param[in] _nthreads number of threads to use
+
+         \return pointer to _out + _len
+      */
+      template <typename in_t, typename out_t>
+      static out_t* apply(const in_t* _in,
+                          std::size_t _len,
+                          const std::vector<out_t>& _lut,
+                          out_t* _out,
+                          int _nthreads = 1){
+
+#ifdef COMPASS_CT_ARCH_X86
+        static const bool is_16to8 = sizeof(in_t)==2 && sizeof(out_t)==1;
+        static const bool is_8to16 = sizeof(in_t)==1 && sizeof(out_t)==2;
+        static const bool is_16to16 = sizeof(in_t)==2 && sizeof(out_t)==2;
+        const std::size_t lut_size = std::size_t(1) << (sizeof(in_t)*CHAR_BIT);
+
+        if(sqeazy::platform::use_vectorisation::value && (is_16to8 || is_8to16 || is_16to16) &&
+           _lut.size() >= lut_size && _len >= block_size){
+
+          if(is_16to8 && sqeazy::platform::has_simd<compass::feature::avx2>()){
+
+#ifdef _SQY_VERBOSE_
+            std::cout << "[SQY_VERBOSE] [detail::lut::apply]\tusing avx2 gather method\n";
+#endif
+            vec_32algn_t<std::uint8_t> padded(lut_size + sizeof(int),0);
+            const std::uint8_t* lut_begin = reinterpret_cast<const std::uint8_t*>(_lut.data());
+            std::copy(lut_begin, lut_begin + lut_size, padded.begin());
+
+            blockwise(encode_16to8_avx2,
+                      reinterpret_cast<const std::uint16_t*>(_in), _len,
+                      padded.data(),
+                      reinterpret_cast<std::uint8_t*>(_out),
+                      _nthreads);
+            return _out + _len;
+          }
+
+          if(is_16to16 && sqeazy::platform::has_simd<compass::feature::avx2>()){
+
+#ifdef _SQY_VERBOSE_
+            std::cout << "[SQY_VERBOSE] [detail::lut::apply]\tusing avx2 gather method\n";
+#endif
+            vec_32algn_t<std::uint16_t> padded(lut_size + 2,0);
+            const std::uint16_t* lut_begin = reinterpret_cast<const std::uint16_t*>(_lut.data());
+            std::copy(lut_begin, lut_begin + lut_size, padded.begin());
+
+            blockwise(lookup_16to16_avx2,
+                      reinterpret_cast<const std::uint16_t*>(_in), _len,
+                      padded.data(),
+                      reinterpret_cast<std::uint16_t*>(_out),
+                      _nthreads);
+            return _out + _len;
+          }
+
+          if(is_8to16 &&
+             sqeazy::platform::has_simd<compass::feature::avx512bw>() &&
+             sqeazy::platform::has_simd<compass::feature::avx512vbmi>()){
+
+#ifdef _SQY_VERBOSE_
+            std::cout << "[SQY_VERBOSE] [detail::lut::apply]\tusing avx512vbmi permute method\n";
+#endif
+            blockwise(decode_8to16_avx512vbmi,
+                      reinterpret_cast<const std::uint8_t*>(_in), _len,
+                      reinterpret_cast<const std::uint16_t*>(_lut.data()),
+                      reinterpret_cast<std::uint16_t*>(_out),
+                      _nthreads);
+            return _out + _len;
+          }
+
+          if(is_8to16 && sqeazy::platform::has_simd<compass::feature::avx2>()){
+
+#ifdef _SQY_VERBOSE_
+            std::cout << "[SQY_VERBOSE] [detail::lut::apply]\tusing avx2 gather method\n";
+#endif
+            vec_32algn_t<std::uint16_t> padded(lut_size + 2,0);
+            const std::uint16_t* lut_begin = reinterpret_cast<const std::uint16_t*>(_lut.data());
+            std::copy(lut_begin, lut_begin + lut_size, padded.begin());
+
+            blockwise(decode_8to16_avx2,
+                      reinterpret_cast<const std::uint8_t*>(_in), _len,
+                      padded.data(),
+                      reinterpret_cast<std::uint16_t*>(_out),
+                      _nthreads);
+            return _out + _len;
+          }
+        }
+
+#ifdef _SQY_VERBOSE_
+        std::cout << "[SQY_VERBOSE] [detail::lut::apply]\tusing scalar method, why ? "
+                  << "sqeazy::platform::use_vectorisation::value = " << sqeazy::platform::use_vectorisation::value << ", "
+                  << "sqeazy::platform::has_simd<compass::feature::avx2>() = " << sqeazy::platform::has_simd<compass::feature::avx2>() << ", "
+                  << "sizeof(in_t) = " << sizeof(in_t) << ", sizeof(out_t) = " << sizeof(out_t) << ", "
+                  << "_len = " << _len << " >= " << block_size << "\n";
+#endif
+#endif
+
+        return apply_scalar(_in, _len, _lut, _out, _nthreads);
+      }
+
+    };
+
+  };
+
+};
+
+#endif /* _LUT_UTILS_H_ */
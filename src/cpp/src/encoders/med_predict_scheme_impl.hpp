@@ -0,0 +1,140 @@
+#ifndef _MED_PREDICT_SCHEME_IMPL_H_
+#define _MED_PREDICT_SCHEME_IMPL_H_
+
+#include <sstream>
+#include <string>
+#include <functional>
+
+#include "sqeazy_common.hpp"
+#include "traits.hpp"
+#include "dynamic_stage.hpp"
+#include "string_parsers.hpp"
+
+#include "med_predict_utils.hpp"
+
+namespace sqeazy {
+
+
+  /**
+* @brief predict every voxel from its left, upper and upper left neighbor with the median edge detector
+* of JPEG-LS (LOCO-I) and store the residual; residuals are zig-zag mapped so that small positive and negative
+* residuals both end up as small unsigned values with zero high bits
+*
+* mode=3d applies the same predictor to the difference of every plane to the plane before it
+*
+* this scheme cannot be run inplace.
+* this scheme is reversable.
+*
+*/
+  template <typename in_type>
+  struct med_predict_scheme : public filter<in_type> {
+
+    typedef filter<in_type> base_type;
+    typedef in_type raw_type;
+    typedef in_type compressed_type;
+    typedef detail::med_predict<raw_type> predictor_type;
+    typedef typename predictor_type::residual_t residual_type;
+
+    static const std::string description() { return std::string("store residual of median edge detector (JPEG-LS) prediction from left, upper and upper left neighbor, zig-zag mapped; <mode|default = 2d> 2d predicts inside every plane, 3d predicts the difference to the plane before"); };
+
+
+    predictor_type predictor;
+
+    med_predict_scheme(const std::string& _payload=""):
+      predictor(false)
+      {
+
+        pipeline_parser p;
+        auto config_map = p.minors(_payload.begin(),_payload.end());
+
+        if(config_map.size()){
+
+          auto f_itr = config_map.find("mode");
+          if(f_itr!=config_map.end())
+            predictor.inter_plane = (f_itr->second == "3d");
+
+        }
+      }
+
+    std::string name() const override final {
+
+      std::ostringstream msg;
+      msg << "med_predict";
+
+      return msg.str();
+
+    }
+
+    std::string config() const override final {
+
+      std::ostringstream msg;
+      msg << "mode=" << (predictor.inter_plane ? "3d" : "2d");
+      return msg.str();
+
+    }
+
+    std::intmax_t max_encoded_size(std::intmax_t _size_bytes) const override final {
+
+      return _size_bytes;
+    }
+
+    compressed_type* encode( const raw_type* _input,
+                             compressed_type* _output,
+                             const std::vector<std::size_t>& _shape) override final {
+
+      if(_shape.size()!=3){
+        std::cerr << "[med_predict_scheme] unable to process input data that is not 3D\n";
+        return _output;
+      }
+
+      const std::size_t len = std::accumulate(_shape.begin(), _shape.end(),1,std::multiplies<std::size_t>());
+      if(!len)
+        return _output;
+
+      residual_type* residuals = reinterpret_cast<residual_type*>(_output);
+      predictor.encode(_input, residuals, _shape, this->n_threads());
+
+      return _output + len;
+    }
+
+    int decode( const compressed_type* _input,
+                raw_type* _output,
+                const std::vector<std::size_t>& _ishape,
+                std::vector<std::size_t> _oshape = std::vector<std::size_t>()) const override final {
+
+      if(_ishape.size()!=3){
+        std::cerr << "[med_predict_scheme] unable to process input data that is not 3D\n";
+        return FAILURE;
+      }
+
+      const std::size_t len = std::accumulate(_ishape.begin(), _ishape.end(), 1, std::multiplies<std::size_t>());
+      if(!len)
+        return SUCCESS;
+
+      const residual_type* residuals = reinterpret_cast<const residual_type*>(_input);
+      predictor.decode(residuals, _output, _ishape, this->n_threads());
+
+      return SUCCESS;
+
+    }
+
+
+    ~med_predict_scheme(){};
+
+    std::string output_type() const final override {
+
+      return sqeazy::header_utils::represent<compressed_type>::as_string();
+
+    }
+
+    bool is_compressor() const final override {
+
+      return base_type::is_compressor;
+
+    }
+
+  };
+
+}
+
+#endif /* _MED_PREDICT_SCHEME_IMPL_H_ */
@@ -0,0 +1,506 @@
+#ifndef _MED_PREDICT_UTILS_H_
+#define _MED_PREDICT_UTILS_H_
+
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+#include <limits>
+#include <type_traits>
+
+#include "compass.hpp"
+#include "sqeazy_common.hpp"
+#include "traits.hpp"
+#include "scalar_utils.hpp"
+
+#ifdef COMPASS_CT_ARCH_X86
+#include <immintrin.h>
+#endif
+
+namespace sqeazy {
+
+  namespace detail {
+
+    /**
+       \brief median edge detector of JPEG-LS (LOCO-I) for the left (_a), upper (_b) and upper left (_c) neighbor:
+       the smaller neighbor if an edge is above or left of the voxel, the larger one if an edge is below or right,
+       the plane through all three neighbors otherwise
+
+       the prediction is always inside [min(_a,_b), max(_a,_b)], it equals the median of _a, _b and _a + _b - _c
+       which is computed without branches
+
+    */
+    template <typename T>
+    inline T med_of(T _a, T _b, T _c){
+
+      const T larger = std::max(_a, _b);
+      const T smaller = std::min(_a, _b);
+
+      return std::max(smaller, std::min(larger, T(_a + _b - _c)));
+    }
+
+    template <typename raw_t>
+    struct med_predict {
+
+      static_assert(std::is_integral<raw_t>::value, "[sqeazy::detail::med_predict] only integer types are supported");
+
+      typedef typename add_unsigned<raw_t>::type residual_t;
+
+      //predictions are computed on values wider than raw_t, so that differences to the previous plane can be taken exactly
+      typedef typename std::conditional<(sizeof(raw_t) < sizeof(std::int32_t)),
+                                        std::int32_t,
+                                        std::int64_t>::type lane_t;
+
+      bool inter_plane;
+
+      /**
+         \brief _inter_plane = false predicts every plane on its own (JPEG-LS),
+         _inter_plane = true applies the predictor to the difference of every plane to the plane before it
+
+      */
+      med_predict(bool _inter_plane = false):
+        inter_plane(_inter_plane)
+      {}
+
+      /**
+         \brief the values of row _y in plane _z the predictor runs on, i.e. the voxels themselves
+         or their difference to the previous plane
+
+      */
+      void load_row(const raw_t* _stack,
+                    std::size_t _z, std::size_t _y,
+                    std::size_t _len_y, std::size_t _len_x,
+                    lane_t* _row) const {
+
+        const raw_t* row = _stack + (_z*_len_y + _y)*_len_x;
+
+        if(inter_plane && _z > 0){
+          const raw_t* before = row - _len_y*_len_x;
+          for(std::size_t x = 0;x<_len_x;++x)
+            _row[x] = lane_t(row[x]) - lane_t(before[x]);
+        }
+        else{
+          for(std::size_t x = 0;x<_len_x;++x)
+            _row[x] = row[x];
+        }
+      }
+
+      /**
+         \brief zig-zag mapped residuals of the row at _row, _above is the row before it (nullptr for the first row of a plane);
+         with _from_plane_before, all values are taken as differences to the voxel _frame items before
+
+         every voxel is predicted from the input only, so the loop is free of dependencies and vectorizes
+
+      */
+      template <bool _from_plane_before>
+      static void encode_row(const raw_t* _row,
+                             const raw_t* _above,
+                             std::size_t _frame,
+                             std::size_t _len_x,
+                             residual_t* _output) {
+
+        auto value_of = [_frame](const raw_t* _ptr, std::size_t _x) -> lane_t {
+          return _from_plane_before ? lane_t(_ptr[_x]) - lane_t(_ptr[_x - _frame]) : lane_t(_ptr[_x]);
+        };
+
+        if(_above){
+          _output[0] = zigzag_encode<residual_t>(value_of(_row, 0) - value_of(_above, 0));
+          for(std::size_t x = 1;x<_len_x;++x){
+            const lane_t pred = med_of(value_of(_row, x - 1), value_of(_above, x), value_of(_above, x - 1));
+            _output[x] = zigzag_encode<residual_t>(value_of(_row, x) - pred);
+          }
+        }
+        else{
+          _output[0] = zigzag_encode<residual_t>(value_of(_row, 0));
+          for(std::size_t x = 1;x<_len_x;++x)
+            _output[x] = zigzag_encode<residual_t>(value_of(_row, x) - value_of(_row, x - 1));
+        }
+      }
+
+      /**
+         \brief write the zig-zag mapped residuals of _input to _output
+
+         rows do not depend on each other and are distributed among _nthreads threads,
+         inside a row the prediction runs on all voxels at once
+
+      */
+      template <typename shape_container_t>
+      residual_t* encode(const raw_t* _input,
+                         residual_t* _output,
+                         const shape_container_t& _shape,
+                         int _nthreads = 1) const {
+
+        const std::size_t len_z = _shape[row_major::z];
+        const std::size_t len_y = _shape[row_major::y];
+        const std::size_t len_x = _shape[row_major::x];
+        const std::size_t frame = len_y*len_x;
+        const omp_size_type n_rows = len_z*len_y;
+        const bool from_plane_before = inter_plane;
+
+#pragma omp parallel for                        \
+  shared(_output)                               \
+  schedule(static)                              \
+  num_threads(_nthreads)
+        for(omp_size_type r = 0;r<n_rows;++r){
+
+          const raw_t* row = _input + r*len_x;
+          const raw_t* above = (r % len_y) ? row - len_x : nullptr;
+
+          if(from_plane_before && std::size_t(r) >= len_y)
+            encode_row<true>(row, above, frame, len_x, _output + r*len_x);
+          else
+            encode_row<false>(row, above, frame, len_x, _output + r*len_x);
+        }
+
+        return _output + n_rows*len_x;
+      }
+
+      /**
+         \brief reconstruct row _y of plane _z in _output from its residuals, requires the rows
+         it is predicted from to be decoded already
+
+      */
+      void decode_row(const residual_t* _input,
+                      raw_t* _output,
+                      std::size_t _z, std::size_t _y,
+                      std::size_t _len_y, std::size_t _len_x,
+                      lane_t* _above) const {
+
+        const std::size_t offset = (_z*_len_y + _y)*_len_x;
+        const residual_t* in = _input + offset;
+        raw_t* out = _output + offset;
+
+        const bool from_plane_before = inter_plane && _z > 0;
+        const raw_t* before = from_plane_before ? out - _len_y*_len_x : out;
+
+        if(_y)
+          load_row(_output, _z, _y - 1, _len_y, _len_x, _above);
+
+        //the predictor runs on the differences to the plane before, the voxels are reconstructed from them
+        const lane_t first_base = from_plane_before ? lane_t(before[0]) : 0;
+        out[0] = raw_t(first_base + (_y ? _above[0] : 0) + zigzag_decode(in[0]));
+        lane_t left = lane_t(out[0]) - first_base;
+
+        for(std::size_t x = 1;x<_len_x;++x){
+
+          const lane_t pred = _y ? med_of(left, _above[x], _above[x-1]) : left;
+          const lane_t base = from_plane_before ? lane_t(before[x]) : 0;
+          const raw_t value = raw_t(base + pred + zigzag_decode(in[x]));
+
+          out[x] = value;
+          left = lane_t(value) - base;
+        }
+      }
+
+      /**
+         \brief reconstruct _n_rows rows at once, given by their linear row index in _rows; all of them must have a row above
+         in their plane and must not depend on each other
+
+         inside a row every voxel depends on its left neighbor, interleaving independent rows keeps several of these
+         dependency chains in flight; _above holds _n_rows rows of scratch space, _zeros one row of zeros
+
+      */
+      template <int _n_rows>
+      void decode_rows(const residual_t* _input,
+                       raw_t* _output,
+                       const std::size_t* _rows,
+                       std::size_t _len_y, std::size_t _len_x,
+                       lane_t* _above,
+                       const raw_t* _zeros) const {
+
+        const residual_t* in[_n_rows];
+        raw_t* out[_n_rows];
+        const raw_t* before[_n_rows];
+        const lane_t* above[_n_rows];
+        lane_t left[_n_rows];
+
+        for(int k = 0;k<_n_rows;++k){
+
+          const std::size_t z = _rows[k] / _len_y;
+          const std::size_t y = _rows[k] % _len_y;
+
+          in[k] = _input + _rows[k]*_len_x;
+          out[k] = _output + _rows[k]*_len_x;
+          before[k] = (inter_plane && z > 0) ? out[k] - _len_y*_len_x : _zeros;
+
+          load_row(_output, z, y - 1, _len_y, _len_x, _above + k*_len_x);
+          above[k] = _above + k*_len_x;
+
+          const lane_t base = before[k][0];
+          out[k][0] = raw_t(base + above[k][0] + zigzag_decode(in[k][0]));
+          left[k] = lane_t(out[k][0]) - base;
+        }
+
+        for(std::size_t x = 1;x<_len_x;++x){
+          for(int k = 0;k<_n_rows;++k){
+
+            const lane_t pred = med_of(left[k], above[k][x], above[k][x-1]);
+            const lane_t base = before[k][x];
+            const raw_t value = raw_t(base + pred + zigzag_decode(in[k][x]));
+
+            out[k][x] = value;
+            left[k] = lane_t(value) - base;
+          }
+        }
+      }
+
+#ifdef COMPASS_CT_ARCH_X86
+
+      //transpose 8 rows of 8 16-bit items in place
+      SQY_TARGET("sse4.1")
+      static void transpose_8x8_epi16(__m128i* _rows){
+
+        __m128i pairs[8];
+        for(int i = 0;i<4;++i){
+          pairs[2*i] = _mm_unpacklo_epi16(_rows[2*i], _rows[2*i+1]);
+          pairs[2*i+1] = _mm_unpackhi_epi16(_rows[2*i], _rows[2*i+1]);
+        }
+
+        __m128i quads[8];
+        for(int i = 0;i<2;++i){
+          quads[4*i] = _mm_unpacklo_epi32(pairs[4*i], pairs[4*i+2]);
+          quads[4*i+1] = _mm_unpackhi_epi32(pairs[4*i], pairs[4*i+2]);
+          quads[4*i+2] = _mm_unpacklo_epi32(pairs[4*i+1], pairs[4*i+3]);
+          quads[4*i+3] = _mm_unpackhi_epi32(pairs[4*i+1], pairs[4*i+3]);
+        }
+
+        for(int i = 0;i<4;++i){
+          _rows[2*i] = _mm_unpacklo_epi64(quads[i], quads[i+4]);
+          _rows[2*i+1] = _mm_unpackhi_epi64(quads[i], quads[i+4]);
+        }
+      }
+
+      //16-bit items of _in as 32-bit lanes, the lower (_high = false) or upper 4 of them
+      SQY_TARGET("sse4.1")
+      static __m128i widen_epi16(__m128i _in, bool _high, bool _signed){
+
+        const __m128i half = _high ? _mm_srli_si128(_in, 8) : _in;
+        return _signed ? _mm_cvtepi16_epi32(half) : _mm_cvtepu16_epi32(half);
+      }
+
+      /**
+         \brief decode_rows<8> for 16-bit raw_t, the 8 rows are transposed in blocks of 8 voxels so that the
+         dependency chain along x runs on two vectors of 4 32-bit lanes each
+
+      */
+      SQY_TARGET("sse4.1")
+      void decode_rows_sse4(const residual_t* _input,
+                            raw_t* _output,
+                            const std::size_t* _rows,
+                            std::size_t _len_y, std::size_t _len_x,
+                            const raw_t* _zeros) const {
+
+        static const int n_rows = 8;
+        static const bool is_signed = std::is_signed<raw_t>::value;
+        const std::size_t frame = _len_y*_len_x;
+
+        const residual_t* in[n_rows];
+        raw_t* out[n_rows];
+        const raw_t* before[n_rows];
+        const raw_t* up[n_rows];
+        const raw_t* up_before[n_rows];
+
+        //the state of the chain along x: the left neighbor and the upper left neighbor
+        std::int32_t left[n_rows];
+        std::int32_t upper_left[n_rows];
+
+        for(int k = 0;k<n_rows;++k){
+
+          const bool from_plane_before = inter_plane && _rows[k] >= _len_y;
+
+          in[k] = _input + _rows[k]*_len_x;
+          out[k] = _output + _rows[k]*_len_x;
+          up[k] = out[k] - _len_x;
+          before[k] = from_plane_before ? out[k] - frame : _zeros;
+          up_before[k] = from_plane_before ? up[k] - frame : _zeros;
+
+          const std::int32_t base = before[k][0];
+          upper_left[k] = std::int32_t(up[k][0]) - std::int32_t(up_before[k][0]);
+          out[k][0] = raw_t(base + upper_left[k] + zigzag_decode(in[k][0]));
+          left[k] = std::int32_t(out[k][0]) - base;
+        }
+
+        __m128i a[2] = {_mm_loadu_si128(reinterpret_cast<const __m128i*>(left)),
+                        _mm_loadu_si128(reinterpret_cast<const __m128i*>(left + 4))};
+        __m128i c[2] = {_mm_loadu_si128(reinterpret_cast<const __m128i*>(upper_left)),
+                        _mm_loadu_si128(reinterpret_cast<const __m128i*>(upper_left + 4))};
+
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i one = _mm_set1_epi16(1);
+
+        std::size_t x = 1;
+        for(;x + 8 <= _len_x;x += 8){
+
+          __m128i residuals[n_rows], uppers[n_rows], bases[n_rows], upper_bases[n_rows], values[n_rows];
+          for(int k = 0;k<n_rows;++k){
+            residuals[k] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in[k] + x));
+            uppers[k] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(up[k] + x));
+            bases[k] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(before[k] + x));
+            upper_bases[k] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(up_before[k] + x));
+          }
+
+          transpose_8x8_epi16(residuals);
+          transpose_8x8_epi16(uppers);
+          if(inter_plane){
+            transpose_8x8_epi16(bases);
+            transpose_8x8_epi16(upper_bases);
+          }
+
+          for(int j = 0;j<8;++j){
+
+            //zig-zag decode in 16-bit lanes
+            const __m128i diff = _mm_xor_si128(_mm_srli_epi16(residuals[j], 1),
+                                               _mm_sub_epi16(zero, _mm_and_si128(residuals[j], one)));
+            __m128i value[2];
+
+            for(int h = 0;h<2;++h){
+
+              const __m128i base = inter_plane ? widen_epi16(bases[j], h, is_signed) : zero;
+              __m128i b = widen_epi16(uppers[j], h, is_signed);
+              if(inter_plane)
+                b = _mm_sub_epi32(b, widen_epi16(upper_bases[j], h, is_signed));
+
+              const __m128i plane = _mm_sub_epi32(_mm_add_epi32(a[h], b), c[h]);
+              const __m128i pred = _mm_max_epi32(_mm_min_epi32(a[h], b),
+                                                 _mm_min_epi32(_mm_max_epi32(a[h], b), plane));
+
+              __m128i v = _mm_add_epi32(_mm_add_epi32(base, pred), widen_epi16(diff, h, true));
+              v = _mm_slli_epi32(v, 16);
+              v = is_signed ? _mm_srai_epi32(v, 16) : _mm_srli_epi32(v, 16);
+
+              value[h] = v;
+              a[h] = _mm_sub_epi32(v, base);
+              c[h] = b;
+            }
+
+            values[j] = is_signed ? _mm_packs_epi32(value[0], value[1]) : _mm_packus_epi32(value[0], value[1]);
+          }
+
+          transpose_8x8_epi16(values);
+          for(int k = 0;k<n_rows;++k)
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out[k] + x), values[k]);
+        }
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(left), a[0]);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(left + 4), a[1]);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(upper_left), c[0]);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(upper_left + 4), c[1]);
+
+        for(int k = 0;k<n_rows;++k){
+          for(std::size_t xx = x;xx<_len_x;++xx){
+
+            const std::int32_t base = before[k][xx];
+            const std::int32_t b = std::int32_t(up[k][xx]) - std::int32_t(up_before[k][xx]);
+            const raw_t value = raw_t(base + med_of(left[k], b, upper_left[k]) + zigzag_decode(in[k][xx]));
+
+            out[k][xx] = value;
+            left[k] = std::int32_t(value) - base;
+            upper_left[k] = b;
+          }
+        }
+      }
+
+#endif
+
+      static const int n_interleaved_rows = 8;
+
+      /**
+         \brief inverse of encode
+
+         every plane depends on its own rows above only (or in addition on the rows y-1 and y of the plane before
+         if inter_plane is set), planes are decoded in parallel row by row; with inter_plane, row y of plane z is
+         decoded once row y of plane z-1 is, i.e. along the anti diagonals z+y = const
+
+         independent rows are decoded n_interleaved_rows at a time
+
+      */
+      template <typename shape_container_t>
+      raw_t* decode(const residual_t* _input,
+                    raw_t* _output,
+                    const shape_container_t& _shape,
+                    int _nthreads = 1) const {
+
+        const std::size_t len_z = _shape[row_major::z];
+        const std::size_t len_y = _shape[row_major::y];
+        const std::size_t len_x = _shape[row_major::x];
+        const std::size_t n_interleaved = n_interleaved_rows;
+
+#ifdef COMPASS_CT_ARCH_X86
+        const bool use_sse4 = sizeof(raw_t) == 2 && sqeazy::platform::has_simd<compass::feature::sse4>();
+#endif
+
+#pragma omp parallel                            \
+  shared(_output)                               \
+  num_threads(_nthreads)
+        {
+          std::vector<lane_t> above(n_interleaved*len_x);
+          const std::vector<raw_t> zeros(len_x, 0);
+          std::size_t rows[n_interleaved_rows];
+
+          //decode the rows of (z,y) for z in [_z_first, _z_last], y = _d - z
+          auto decode_group = [&](std::size_t _z_first, std::size_t _z_last, std::size_t _d, bool _same_y){
+
+            std::size_t n_rows = 0;
+            for(std::size_t z = _z_first;z<=_z_last;++z){
+              const std::size_t y = _same_y ? _d : _d - z;
+              if(y)
+                rows[n_rows++] = z*len_y + y;
+              else
+                decode_row(_input, _output, z, y, len_y, len_x, above.data());
+            }
+
+            if(n_rows == n_interleaved){
+#ifdef COMPASS_CT_ARCH_X86
+              if(use_sse4){
+                decode_rows_sse4(_input, _output, rows, len_y, len_x, zeros.data());
+                return;
+              }
+#endif
+              decode_rows<n_interleaved_rows>(_input, _output, rows, len_y, len_x, above.data(), zeros.data());
+            }
+            else
+              for(std::size_t r = 0;r<n_rows;++r)
+                decode_row(_input, _output, rows[r] / len_y, rows[r] % len_y, len_y, len_x, above.data());
+          };
+
+          if(!inter_plane){
+
+            const omp_size_type n_groups = (len_z + n_interleaved - 1)/n_interleaved;
+
+#pragma omp for schedule(dynamic)
+            for(omp_size_type g = 0;g<n_groups;++g){
+              const std::size_t z_first = g*n_interleaved;
+              const std::size_t z_last = std::min(z_first + n_interleaved, len_z) - 1;
+              for(std::size_t y = 0;y<len_y;++y)
+                decode_group(z_first, z_last, y, true);
+            }
+
+          }
+          else{
+
+            const std::size_t n_diagonals = len_z + len_y - 1;
+            for(std::size_t d = 0;d<n_diagonals;++d){
+
+              const std::size_t z_first = d < len_y ? 0 : d - len_y + 1;
+              const std::size_t z_last = std::min(d, len_z - 1);
+              const omp_size_type n_groups = (z_last - z_first + n_interleaved)/n_interleaved;
+
+#pragma omp for schedule(static)
+              for(omp_size_type g = 0;g<n_groups;++g){
+                const std::size_t group_first = z_first + g*n_interleaved;
+                decode_group(group_first, std::min(group_first + n_interleaved - 1, z_last), d, false);
+              }
+            }
+
+          }
+        }
+
+        return _output + len_z*len_y*len_x;
+      }
+
+    };
+
+  };
+
+};
+
+#endif /* _MED_PREDICT_UTILS_H_ */
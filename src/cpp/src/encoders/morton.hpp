@@ -6,6 +6,12 @@
 #include <climits>
 
 #include "traits.hpp"
+#include "compass.hpp"
+#include "sqeazy_common.hpp"
+
+#ifdef COMPASS_CT_ARCH_X86
+#include <immintrin.h>
+#endif
 
 namespace sqeazy {
 	namespace detail {
@@ -208,6 +214,50 @@ namespace sqeazy {
 #endif
 
 #endif
+
+		/**
+		   \brief mask of all bits in a morton index (as produced by morton_at_ct) that belong to lane _lane,
+		   lane 0 is x, lane 1 is y and lane 2 is z; the lowest _n_coordinate_bits of a coordinate are covered
+		*/
+		template <int bitplane_width = 1, int stripe_size = 3>
+		static constexpr std::uint64_t morton_lane_mask(int _lane, int _n_coordinate_bits = 8) {
+			std::uint64_t value = 0;
+			for (int b = 0; b < _n_coordinate_bits; ++b) {
+				const int chunk = b / bitplane_width;
+				value |= std::uint64_t(1) << (chunk*stripe_size*bitplane_width + _lane*bitplane_width + (b % bitplane_width));
+			}
+			return value;
+		}
+
+		/**
+		   \brief BMI2 twin of morton_at_ct<bitplane_width>, the bits of each coordinate are scattered with
+		   a single pdep per lane (gathered with pext) instead of byte-wise table lookups;
+		   yields the identical index for all coordinates below 256
+		*/
+		template <int bitplane_width = 1>
+		struct morton_bmi2 {
+
+			static constexpr std::uint64_t x_mask = morton_lane_mask<bitplane_width>(0);
+			static constexpr std::uint64_t y_mask = morton_lane_mask<bitplane_width>(1);
+			static constexpr std::uint64_t z_mask = morton_lane_mask<bitplane_width>(2);
+
+#ifdef COMPASS_CT_ARCH_X86
+			SQY_TARGET("bmi2")
+			static std::uint64_t from(std::uint32_t z,
+									  std::uint32_t y,
+									  std::uint32_t x) {
+				return _pdep_u64(z, z_mask) | _pdep_u64(y, y_mask) | _pdep_u64(x, x_mask);
+			}
+
+			SQY_TARGET("bmi2")
+			static void to(std::uint64_t index, std::uint32_t& z, std::uint32_t& y, std::uint32_t& x) {
+				z = _pext_u64(index, z_mask);
+				y = _pext_u64(index, y_mask);
+				x = _pext_u64(index, x_mask);
+			}
+#endif
+		};
+
 	};
 };
 
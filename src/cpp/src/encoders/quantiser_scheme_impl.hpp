@@ -19,6 +19,8 @@
 #include "string_parsers.hpp"
 #include "dynamic_stage.hpp"
 #include "quantiser_utils.hpp"
+#include "lut_utils.hpp"
+#include "bitpack_utils.hpp"
 #include "regex_helpers.hpp"
 
 namespace sqeazy {
@@ -62,14 +64,36 @@ namespace sqeazy {
     parsed_map_t  config_map;
 
     quantiser<raw_type, compressed_type> shrinker;
-    static const std::string description() { return std::string("scalar histogram-based quantisation for conversion uint16->uint8; <decode_lut_path> : the lut will be taken from there (for decoding) or written there (for encoding); <decode_lut_string> : decode LUT will be taken from the argument value (for decoding) or written there (for encoding); <weighting_function>=(none, power_of_<enumerator>_<denominator> : apply power-law pow(x,<enumerator>/<denominator>) to histogram weights, offset_power_of_<enumerator>_<denominator> : apply power-law pow(x,<enumerator>/<denominator>) to histogram weights starting at first non-zero bin index) ");
+
+    //width of the packed codes, 0 if every code occupies one compressed_type item
+    //(codes are packed whenever bits is given, also if they are not wider than compressed_type)
+    std::uint32_t bits;
+    //holds the LUTs for any bits, 16-bit codes fit every width up to 16
+    typedef quantiser<raw_type, std::uint16_t> packing_quantiser_t;
+    std::unique_ptr<packing_quantiser_t> packing_shrinker;
+
+    //LUT reuse across calls to encode: maximum drift of the histogram (earth mover's distance in intensity units), negative if disabled
+    float reuse_threshold;
+    //name of the series of buffers that share the reference histogram and its LUT (see lut_reference_registry)
+    std::string sequence;
+    bool decode_lut_missing;
+
+    //the decode LUT is stored as binary section in front of the payload (see quantiser::lut_to_binary)
+    bool decode_lut_in_payload;
+    static const std::string description() { return std::string("scalar histogram-based quantisation for conversion uint16->uint8; <decode_lut_path> : the lut will be taken from there (for decoding) or written there (for encoding); <decode_lut_string> : decode LUT will be taken from the argument value (for decoding, the LUT is written as binary section in front of the payload otherwise); <weighting_function>=(none, power_of_<enumerator>_<denominator> : apply power-law pow(x,<enumerator>/<denominator>) to histogram weights, offset_power_of_<enumerator>_<denominator> : apply power-law pow(x,<enumerator>/<denominator>) to histogram weights starting at first non-zero bin index); <sample>=fraction of the input used to build the histogram (default: 1, i.e. all of it); <sample_mode>=(stride : take blocks at a fixed stride, random : take one block at random per stride); <reuse_lut>=maximum drift of the (sampled) histogram, measured as earth mover's distance in intensity units, up to which the LUT of the previous buffer encoded for the same <sequence> (default: default) is reused, the reference is kept for the lifetime of the process; only the LUT hash is stored when reusing, decoders must have decoded the buffer that published the LUT before; published LUTs are kept for the lifetime of the process, but only the 16 most recently used ones (see lut_registry); <bits>=width of the quantised codes (1 to 16), 1 << bits levels are used and the codes are packed densely into the output stream, also if bits does not exceed the width of the output type (default: one code per output item)");
     };
 
     quantiser_scheme(const std::string &_payload = ""):
       quantiser_config(_payload),
       weighting_string("none"),
       config_map(),
-      shrinker()
+      shrinker(),
+      bits(0),
+      packing_shrinker(),
+      reuse_threshold(-1.f),
+      sequence("default"),
+      decode_lut_missing(false),
+      decode_lut_in_payload(false)
     {
 
       pipeline_parser p;
@@ -80,22 +104,103 @@ namespace sqeazy {
       if(fitr != config_map.end())
         weighting_string = fitr->second;
 
+      fitr = config_map.find("bits");
+      if(fitr != config_map.end()){
+        const int found_bits = std::stoi(fitr->second);
+        if(found_bits < 1 || found_bits > int(sizeof(std::uint16_t)*CHAR_BIT)){
+          std::cerr << "[quantiser_scheme] bits=" << fitr->second << " is not supported, expected 1 to 16, codes will not be packed\n";
+          config_map.erase(fitr);
+        }
+        else{
+          bits = found_bits;
+          packing_shrinker.reset(new packing_quantiser_t());
+          packing_shrinker->set_bits(bits);
+        }
+      }
+
+      std::vector<raw_type>& lut_decode = bits ? packing_shrinker->lut_decode_ : shrinker.lut_decode_;
+
+      decode_lut_in_payload = config_map.find("decode_lut_in_payload") != config_map.end();
+
       fitr = config_map.find("decode_lut_path");
-      if(fitr != config_map.end())
-        shrinker.lut_from_file(fitr->second, shrinker.lut_decode_);
-      else{
-          fitr = config_map.find("decode_lut_string");
-          if(fitr != config_map.end())
-            {
-              shrinker.lut_from_string(fitr->second, shrinker.lut_decode_);
-            }
+      if(fitr != config_map.end()){
+        if(bits)
+          packing_shrinker->lut_from_file(fitr->second, lut_decode);
+        else
+          shrinker.lut_from_file(fitr->second, lut_decode);
+      }
+      else if(!decode_lut_in_payload){
+        auto hash_itr = config_map.find("decode_lut_hash");
+        fitr = config_map.find("decode_lut_string");
+        if(fitr != config_map.end())
+          {
+            if(bits)
+              packing_shrinker->lut_from_string(fitr->second, lut_decode);
+            else
+              shrinker.lut_from_string(fitr->second, lut_decode);
+            if(hash_itr != config_map.end())
+              lut_registry<raw_type>::store(hash_itr->second, lut_decode);
+          }
+        else if(hash_itr != config_map.end() &&
+                !lut_registry<raw_type>::load(hash_itr->second, lut_decode)){
+          std::cerr << "[quantiser_scheme] decode LUT with hash " << hash_itr->second
+                    << " is unknown, decode the buffer that published it first\n";
+          decode_lut_missing = true;
         }
+      }
+
+      //loading a LUT may have resized it to the maximum number of levels
+      if(bits)
+        packing_shrinker->set_bits(bits);
+
+      fitr = config_map.find("reuse_lut");
+      if(fitr != config_map.end())
+        reuse_threshold = std::stof(fitr->second);
+
+      fitr = config_map.find("sequence");
+      if(fitr != config_map.end() && !fitr->second.empty())
+        sequence = fitr->second;
+
+      fitr = config_map.find("sample");
+      if(fitr != config_map.end()){
+        auto mode_itr = config_map.find("sample_mode");
+        const bool random = mode_itr != config_map.end() && mode_itr->second == "random";
+        shrinker.set_sampling(std::stof(fitr->second), random);
+        if(packing_shrinker)
+          packing_shrinker->set_sampling(std::stof(fitr->second), random);
+      }
 
       shrinker.set_n_threads(this->n_threads());
+      if(packing_shrinker)
+        packing_shrinker->set_n_threads(this->n_threads());
     }
 
     ~quantiser_scheme() override final {}
 
+    /**
+       \brief forget the published decode LUT with hash _hash (all of them if _hash is empty), buffers that only
+       refer to it by its hash cannot be decoded anymore
+
+    */
+    static void reset(const std::string& _hash = ""){
+
+      if(_hash.empty())
+        lut_registry<raw_type>::reset();
+      else
+        lut_registry<raw_type>::erase(_hash);
+    }
+
+    /**
+       \brief forget the reference histogram and LUT of _sequence, the next buffer encoded with reuse_lut computes
+       a new LUT
+
+    */
+    static void reset_reference(const std::string& _sequence = "default"){
+
+      lut_reference_registry<raw_type, compressed_type>::erase(_sequence);
+      lut_reference_registry<raw_type, typename packing_quantiser_t::lut_encode_t::value_type>::erase(_sequence);
+    }
+
     std::string name() const override final {
 
       return std::string("quantiser");
@@ -131,11 +236,24 @@ namespace sqeazy {
     std::intmax_t max_encoded_size(std::intmax_t _size_bytes) const override final {
 
       std::intmax_t payload_size = _size_bytes*sizeof(raw_type)/sizeof(compressed_type);
-      std::intmax_t lut_size = shrinker.lut_decode_.size()*sizeof(raw_type);
+      std::intmax_t lut_size = shrinker.max_binary_lut_bytes(bits ? packing_shrinker->n_levels() : shrinker.n_levels());
       return payload_size+lut_size;
 
     }
 
+    /**
+       \brief the binary decode LUT section in front of the payload is metadata, see quantiser::lut_to_binary
+
+    */
+    std::size_t metadata_bytes(const compressed_type* _begin, const compressed_type* _end) const override final {
+
+      if(!decode_lut_in_payload)
+        return 0;
+
+      return shrinker.binary_lut_bytes(reinterpret_cast<const char*>(_begin),
+                                       reinterpret_cast<const char*>(_end));
+    }
+
     std::string output_type() const final override {
 
       return sqeazy::header_utils::represent<compressed_type>::as_string();
@@ -148,6 +266,30 @@ namespace sqeazy {
 
     }
 
+    /**
+       \brief setup _shrinker on [_begin,_end) using the weighting function this scheme was configured with
+
+    */
+    template <typename quantiser_t>
+    void setup(quantiser_t& _shrinker,
+               const raw_type* _begin, const raw_type* _end) const {
+
+      //TODO: this is atrocious, refactor this if-else-hell
+      if(weighting_string.find("none")!=std::string::npos)
+        _shrinker.setup_com(_begin, _end);
+      else{
+        auto ratio = sqeazy::extract_ratio(weighting_string);
+        if(weighting_string.find("offset")!=std::string::npos){
+          sqeazy::weighters::offset_power_of w(ratio.first,ratio.second);
+          _shrinker.setup_com(_begin, _end,w);
+        } else {
+          sqeazy::weighters::power_of w(ratio.first,ratio.second);
+          _shrinker.setup_com(_begin, _end,w);
+        }
+
+      }
+    }
+
     /**
      * @brief encode input raw_type buffer and write to output (not owned, not allocated)
      *
@@ -171,7 +313,7 @@ namespace sqeazy {
      * @param _input input raw_type buffer
      * @param _output output char buffer (not owned, not allocated)
      * @param _length mutable std::vector<size_type>, contains the shape of _input at [0] and the number of written bytes at [1]
-     * @return sqeazy::error_code
+     * @return pointer past the last written item, the payload is preceded by the binary decode LUT unless the LUT is reused or written to a file
      */
     compressed_type* encode( const raw_type* _in, compressed_type* _out, std::size_t _length) override final {
 
@@ -179,50 +321,179 @@ namespace sqeazy {
       if(!_in || !_length)
         return _out;
 
+      if(bits)
+        return encode(*packing_shrinker, _in, _out, _length);
+      else
+        return encode(shrinker, _in, _out, _length);
+    }
+
+    /**
+     * @brief compute (or reuse) the LUT of _shrinker for _in, publish the decode LUT and apply the encode LUT
+     *
+     * @return pointer past the last written item
+     */
+    template <typename quantiser_t>
+    compressed_type* encode(quantiser_t& _shrinker, const raw_type* _in, compressed_type* _out, std::size_t _length) {
+
       const raw_type* in_begin = _in;
       const raw_type* in_end = _in + _length;
 
-      //TODO: this is atrocious, refactor this if-else-hell
-      if(weighting_string.find("none")!=std::string::npos)
-        shrinker.setup_com(in_begin, in_end);
+      typedef typename quantiser_t::lut_encode_t::value_type code_t;
+      typedef lut_reference_registry<raw_type, code_t> references;
+
+      bool reuse_lut = false;
+      std::vector<std::uint32_t> current_histo;
+      typename references::reference_ptr reference;
+
+      std::ostringstream settings;
+      settings << "bits=" << bits << ",weighting_function=" << weighting_string;
+
+      if(reuse_threshold >= 0){
+
+        reference = references::get(sequence);
+
+        current_histo.resize(quantiser_t::max_raw_,0);
+        detail::parallel::fill_histogram_sampled(in_begin, in_end, current_histo.begin(),
+                                                 (std::min)(_shrinker.sample_fraction_, 1.f/32),
+                                                 false,
+                                                 this->n_threads());
+
+        if(!reference->histogram.empty() && reference->settings == settings.str()){
+          const double drift = detail::earth_movers_distance(current_histo.begin(), current_histo.end(),
+                                                             reference->histogram.begin());
+          reuse_lut = drift <= reuse_threshold;
+
+#ifdef _SQY_VERBOSE_
+          std::cout << "[SQY_VERBOSE] [quantiser_scheme::encode]\thistogram drift " << drift
+                    << (reuse_lut ? " <= " : " > ") << reuse_threshold
+                    << (reuse_lut ? ", reusing LUT\n" : ", recomputing LUT\n");
+#endif
+        }
+      }
+
+      if(reuse_lut){
+        _shrinker.lut_encode_ = reference->lut_encode;
+        _shrinker.lut_decode_ = reference->lut_decode;
+      }
       else{
-        auto ratio = sqeazy::extract_ratio(weighting_string);
-        if(weighting_string.find("offset")!=std::string::npos){
-          sqeazy::weighters::offset_power_of w(ratio.first,ratio.second);
-          shrinker.setup_com(in_begin, in_end,w);
-        } else {
-          sqeazy::weighters::power_of w(ratio.first,ratio.second);
-          shrinker.setup_com(in_begin, in_end,w);
+
+        if(reuse_threshold >= 0)
+          _shrinker.reset();
+
+        setup(_shrinker, in_begin, in_end);
+
+        if(reference){
+          reference->histogram.swap(current_histo);
+          reference->lut_encode = _shrinker.lut_encode_;
+          reference->lut_decode = _shrinker.lut_decode_;
+          reference->settings = settings.str();
         }
+      }
 
+#ifdef _SQY_VERBOSE_
+      if(!reuse_lut && _shrinker.sample_fraction_ < 1.f){
+        auto full_histo = detail::parallel::create_histogram(in_begin, in_end, this->n_threads());
+        quantiser_t full_shrinker;
+        full_shrinker.set_n_threads(this->n_threads());
+        full_shrinker.set_bits(bits ? bits : sizeof(compressed_type)*CHAR_BIT);
+        setup(full_shrinker, in_begin, in_end);
+
+        const double sampled_error = _shrinker.mean_squared_error(full_histo);
+        const double full_error = full_shrinker.mean_squared_error(full_histo);
+        std::cout << "[SQY_VERBOSE] [quantiser_scheme::encode]\tsampled " << _shrinker.sample_fraction_
+                  << " of the input, mean squared LUT error " << sampled_error
+                  << " versus " << full_error << " with the full histogram (ratio "
+                  << (full_error > 0 ? sampled_error/full_error : 0.) << ")\n";
       }
+#endif
+
+      compressed_type* payload = _out;
+      config_map.erase("decode_lut_string");
+      decode_lut_in_payload = false;
 
       auto fitr = config_map.find("decode_lut_path");
-      if(fitr!=config_map.end())
-        shrinker.lut_to_file(fitr->second,shrinker.lut_decode_);
-      else
-        config_map["decode_lut_string"] = shrinker.lut_to_string(shrinker.lut_decode_);
+      if(fitr!=config_map.end()){
+        if(!reuse_lut)
+          _shrinker.lut_to_file(fitr->second,_shrinker.lut_decode_);
+      }
+      else{
+        if(reuse_threshold >= 0){
+          const std::string hash = _shrinker.lut_hash(_shrinker.lut_decode_);
+          config_map["decode_lut_hash"] = hash;
 
-      applyLUT<raw_type, compressed_type> lutApplyer(shrinker.lut_encode_);
-      compressed_type* out_end = nullptr;
+          if(!reuse_lut)
+            lut_registry<raw_type>::store(hash, _shrinker.lut_decode_);
+        }
 
-      if(this->n_threads()==1)
-        out_end = std::transform(_in,_in+_length,_out,lutApplyer);
-      else{
-        const omp_size_type len = _length;
-        const omp_size_type nthreads = this->n_threads();
-
-#pragma omp parallel for                        \
-  shared(_out )                              \
-  firstprivate( len, _in, lutApplyer )       \
-  num_threads(nthreads)
-        for(omp_size_type idx = 0;idx<len;idx++){
-          _out[idx] = lutApplyer(_in[idx]);
+        if(!reuse_lut){
+          const std::size_t lut_bytes = _shrinker.lut_to_binary(_shrinker.lut_decode_,
+                                                               reinterpret_cast<char*>(_out));
+          payload += lut_bytes/sizeof(compressed_type);
+          decode_lut_in_payload = true;
         }
-        out_end = _out + len;
       }
 
-      return out_end;
+      if(decode_lut_in_payload)
+        config_map["decode_lut_in_payload"] = "1";
+      else
+        config_map.erase("decode_lut_in_payload");
+
+      return write_codes(_in, _length, _shrinker.lut_encode_, payload);
+    }
+
+    /**
+     * @brief write the codes of _in to _out, bit packed if bits is set, one compressed_type item per code otherwise
+     *
+     * @return pointer past the last written item
+     */
+    template <typename code_t>
+    compressed_type* write_codes(const raw_type* _in, std::size_t _length,
+                                 const std::vector<code_t>& _lut_encode,
+                                 compressed_type* _out) const {
+
+      //codes wider than compressed_type are only produced for packing, they never reach detail::lut::apply
+      return write_codes(_in, _length, _lut_encode, _out, std::is_same<code_t, compressed_type>());
+    }
+
+    template <typename code_t>
+    compressed_type* write_codes(const raw_type* _in, std::size_t _length,
+                                 const std::vector<code_t>& _lut_encode,
+                                 compressed_type* _out,
+                                 std::true_type) const {
+
+      if(bits)
+        return pack_codes(_in, _length, _lut_encode, _out);
+
+      return detail::lut::apply(_in, _length,
+                                _lut_encode,
+                                _out,
+                                this->n_threads());
+    }
+
+    template <typename code_t>
+    compressed_type* write_codes(const raw_type* _in, std::size_t _length,
+                                 const std::vector<code_t>& _lut_encode,
+                                 compressed_type* _out,
+                                 std::false_type) const {
+
+      return pack_codes(_in, _length, _lut_encode, _out);
+    }
+
+    template <typename code_t>
+    compressed_type* pack_codes(const raw_type* _in, std::size_t _length,
+                                const std::vector<code_t>& _lut_encode,
+                                compressed_type* _out) const {
+
+      char* packed_end = detail::bitpack::encode(_in, _length,
+                                                 _lut_encode,
+                                                 bits,
+                                                 reinterpret_cast<char*>(_out),
+                                                 this->n_threads());
+
+      //pad the stream to full items of compressed_type
+      std::size_t packed_items = (packed_end - reinterpret_cast<char*>(_out) + sizeof(compressed_type) - 1)/sizeof(compressed_type);
+      std::fill(packed_end, reinterpret_cast<char*>(_out + packed_items), 0);
+      return _out + packed_items;
     }
 
 
@@ -247,6 +518,62 @@ namespace sqeazy {
                 std::size_t _outlength = 0) const override final {
 
 
+      const std::vector<raw_type>* lut_decode = bits ? &packing_shrinker->lut_decode_ : &shrinker.lut_decode_;
+      std::vector<raw_type> payload_lut;
+
+      if(decode_lut_in_payload){
+        const char* in_begin = reinterpret_cast<const char*>(_in);
+        const std::size_t lut_bytes = shrinker.lut_from_binary(in_begin,
+                                                               in_begin + _inlength*sizeof(compressed_type),
+                                                               payload_lut);
+        if(!lut_bytes){
+          std::cerr << "[quantiser_scheme::decode] unable to read decode LUT from payload\n";
+          return FAILURE;
+        }
+
+        //every code must hit an entry of the LUT, a shorter section does not belong to this configuration
+        if(payload_lut.size() != lut_decode->size()){
+          std::cerr << "[quantiser_scheme::decode] decode LUT in payload has " << payload_lut.size()
+                    << " entries, expected " << lut_decode->size() << "\n";
+          return FAILURE;
+        }
+
+        auto hash_itr = config_map.find("decode_lut_hash");
+        if(hash_itr != config_map.end())
+          lut_registry<raw_type>::store(hash_itr->second, payload_lut);
+
+        lut_decode = &payload_lut;
+        _in += lut_bytes/sizeof(compressed_type);
+        _inlength -= lut_bytes/sizeof(compressed_type);
+      }
+      else if(decode_lut_missing)
+        return FAILURE;
+
+      if(bits){
+
+        const std::size_t in_bytes = _inlength*sizeof(compressed_type);
+        if(!_outlength)
+          _outlength = in_bytes*CHAR_BIT/bits;
+
+        const std::size_t size = (std::min)(std::size_t(_outlength), in_bytes*CHAR_BIT/bits);
+
+        //every code must hit an entry of the LUT
+        std::vector<raw_type> padded_lut;
+        if(lut_decode->size() < (std::size_t(1) << bits)){
+          padded_lut.resize(std::size_t(1) << bits, raw_type(0));
+          std::copy(lut_decode->begin(), lut_decode->end(), padded_lut.begin());
+          lut_decode = &padded_lut;
+        }
+
+        raw_type* end_ptr = detail::bitpack::decode(reinterpret_cast<const char*>(_in), size,
+                                                    *lut_decode,
+                                                    bits,
+                                                    _out,
+                                                    this->n_threads());
+
+        return (end_ptr - _out) - _outlength;
+      }
+
       if(!_outlength)
         _outlength = _inlength;
 
@@ -255,28 +582,10 @@ namespace sqeazy {
         size = (std::min)(_outlength,_inlength);
       }
 
-      applyLUT<compressed_type, raw_type> lutApplyer(shrinker.lut_decode_);
-      auto begin = _in;
-      auto end   = _in+size;
-      raw_type* end_ptr = nullptr;
-
-      if(this->n_threads()==1)
-        end_ptr = std::transform(begin, end,
-                                      _out,
-                                      lutApplyer);
-      else{
-        const omp_size_type len = size;
-        const omp_size_type nthreads = this->n_threads();
-
-#pragma omp parallel for                        \
-  shared(_out )                              \
-  firstprivate( len, _in, lutApplyer )       \
-  num_threads(nthreads)
-        for(omp_size_type idx = 0;idx<len;idx++){
-          _out[idx] = lutApplyer(_in[idx]);
-        }
-        end_ptr = _out + len;
-      }
+      raw_type* end_ptr = detail::lut::apply(_in, size,
+                                             *lut_decode,
+                                             _out,
+                                             this->n_threads());
 
       return (end_ptr - _out) - _outlength;
     }
@@ -3,6 +3,7 @@
 
 #include <vector>
 #include <map>
+#include <list>
 #include <cmath>
 #include <algorithm>
 #include <functional>
@@ -12,12 +13,16 @@
 #include <type_traits>
 #include <fstream>
 #include <iomanip>
+#include <sstream>
+#include <mutex>
+#include <memory>
 
 #include "traits.hpp"
 #include "string_parsers.hpp"
 #include "sqeazy_common.hpp"
 #include "header_utils.hpp"
 #include "histogram_utils.hpp"
+#include "lut_utils.hpp"
 
 #include "quantiser_weighters.hpp"
 
@@ -36,11 +41,214 @@ namespace sqeazy {
     };
 
     compressed_type operator()(const raw_type& _value){
-      return lut_[_value];
+      return lut_[typename std::make_unsigned<raw_type>::type(_value)];
     }
 
   };
 
+  namespace detail {
+
+    /**
+       \brief append _value as LEB128 varint (7 bits per byte, high bit set on all but the last byte) to _dst
+
+       \return pointer to the byte after the last one written
+    */
+    static inline char* put_varint(std::uint64_t _value, char* _dst){
+
+      while(_value > 0x7f){
+        *(_dst++) = char((_value & 0x7f) | 0x80);
+        _value >>= 7;
+      }
+      *(_dst++) = char(_value);
+
+      return _dst;
+    }
+
+    /**
+       \brief read LEB128 varint from [_begin,_end) into _value
+
+       \return pointer to the byte after the varint, nullptr if the varint is truncated
+    */
+    static inline const char* get_varint(const char* _begin, const char* _end, std::uint64_t& _value){
+
+      _value = 0;
+      for(int shift = 0;_begin!=_end && shift < 64;shift += 7){
+        const std::uint64_t byte = static_cast<unsigned char>(*(_begin++));
+        _value |= (byte & 0x7f) << shift;
+        if(!(byte & 0x80))
+          return _begin;
+      }
+
+      return nullptr;
+    }
+
+  };
+
+  /**
+     \brief process wide store of decode LUTs by their hash, encoders that reuse a LUT over several
+     buffers only embed its hash in the header once the LUT itself was published
+
+     only the capacity() most recently stored or loaded LUTs are kept, so that long series which keep
+     publishing new LUTs do not grow the store without bound; a hash that was evicted must be published again
+
+  */
+  template <typename raw_type>
+  struct lut_registry {
+
+    typedef std::vector<raw_type> lut_t;
+    typedef std::list<std::pair<std::string, lut_t> > entries_t;
+
+    static void store(const std::string& _hash, const lut_t& _lut){
+      std::lock_guard<std::mutex> lock(mutex());
+      entries_t& value = entries();
+
+      auto fitr = find(_hash);
+      if(fitr != value.end())
+        value.erase(fitr);
+
+      value.emplace_front(_hash, _lut);
+      while(value.size() > limit())
+        value.pop_back();
+    }
+
+    static bool load(const std::string& _hash, lut_t& _lut){
+      std::lock_guard<std::mutex> lock(mutex());
+      entries_t& value = entries();
+
+      auto fitr = find(_hash);
+      if(fitr == value.end())
+        return false;
+
+      value.splice(value.begin(), value, fitr);
+      _lut = fitr->second;
+      return true;
+    }
+
+    /**
+       \brief forget the LUT with hash _hash
+
+    */
+    static void erase(const std::string& _hash){
+      std::lock_guard<std::mutex> lock(mutex());
+
+      auto fitr = find(_hash);
+      if(fitr != entries().end())
+        entries().erase(fitr);
+    }
+
+    /**
+       \brief forget all LUTs
+
+    */
+    static void reset(){
+      std::lock_guard<std::mutex> lock(mutex());
+      entries().clear();
+    }
+
+    static std::size_t size(){
+      std::lock_guard<std::mutex> lock(mutex());
+      return entries().size();
+    }
+
+    static std::size_t capacity(){
+      std::lock_guard<std::mutex> lock(mutex());
+      return limit();
+    }
+
+    /**
+       \brief keep at most _capacity LUTs (at least 1), the least recently used ones are evicted first
+
+    */
+    static void set_capacity(std::size_t _capacity){
+      std::lock_guard<std::mutex> lock(mutex());
+      limit() = (std::max)(_capacity, std::size_t(1));
+      while(entries().size() > limit())
+        entries().pop_back();
+    }
+
+  private:
+
+    static typename entries_t::iterator find(const std::string& _hash){
+      return std::find_if(entries().begin(), entries().end(),
+                          [&_hash](const typename entries_t::value_type& _entry){ return _entry.first == _hash; });
+    }
+
+    static std::mutex& mutex(){
+      static std::mutex value;
+      return value;
+    }
+
+    static std::size_t& limit(){
+      static std::size_t value = 16;
+      return value;
+    }
+
+    static entries_t& entries(){
+      static entries_t value;
+      return value;
+    }
+  };
+
+  /**
+     \brief histogram and LUTs an encoder computed last for a sequence of buffers, the LUTs are reused for the
+     next buffer of the sequence as long as its histogram does not drift too far from this one
+
+  */
+  template <typename raw_type, typename code_type>
+  struct lut_reference {
+
+    //histogram the LUTs were computed from, empty if there is none yet
+    std::vector<std::uint32_t> histogram;
+    std::vector<code_type> lut_encode;
+    std::vector<raw_type> lut_decode;
+
+    //configuration the LUTs were computed with, LUTs of another configuration are not reused
+    std::string settings;
+
+    void clear(){
+      histogram.clear();
+      lut_encode.clear();
+      lut_decode.clear();
+      settings.clear();
+    }
+  };
+
+  /**
+     \brief process wide store of the lut_reference of every sequence, pipelines are rebuilt for every buffer they
+     encode (e.g. by the C API), so the reference must outlive them
+
+  */
+  template <typename raw_type, typename code_type>
+  struct lut_reference_registry {
+
+    typedef std::shared_ptr<lut_reference<raw_type, code_type> > reference_ptr;
+
+    static reference_ptr get(const std::string& _sequence){
+      std::lock_guard<std::mutex> lock(mutex());
+      reference_ptr& value = references()[_sequence];
+      if(!value)
+        value = std::make_shared<lut_reference<raw_type, code_type> >();
+      return value;
+    }
+
+    static void erase(const std::string& _sequence){
+      std::lock_guard<std::mutex> lock(mutex());
+      references().erase(_sequence);
+    }
+
+  private:
+
+    static std::mutex& mutex(){
+      static std::mutex value;
+      return value;
+    }
+
+    static std::map<std::string, reference_ptr>& references(){
+      static std::map<std::string, reference_ptr> value;
+      return value;
+    }
+  };
+
   //all is public for now
   template<typename raw_type,typename compressed_type >
   struct quantiser
@@ -74,6 +282,9 @@ namespace sqeazy {
     lut_decode_t lut_decode_;
     int nthreads_;
 
+    float sample_fraction_;//fraction of the input used for the histogram, 1 = all of it
+    bool sample_random_;
+
     template <typename weight_functor_t = weighters::none>
     quantiser(const raw_type* _begin = 0,
               const raw_type* _end = 0,
@@ -86,7 +297,9 @@ namespace sqeazy {
       importance_(max_raw_,0.f),
       lut_encode_(max_raw_,compressed_type(0)),
       lut_decode_(max_compressed_,raw_type(0)),
-      nthreads_(_nt)
+      nthreads_(_nt),
+      sample_fraction_(1.f),
+      sample_random_(false)
       {
 
         reset();
@@ -96,6 +309,25 @@ namespace sqeazy {
       };
 
 
+    /**
+       \brief number of quantisation levels, i.e. the size of the decode LUT (max_compressed_ unless set_bits was called)
+
+    */
+    std::size_t n_levels() const {
+      return lut_decode_.size();
+    }
+
+    /**
+       \brief limit the number of quantisation levels to 1 << _bits (at most max_compressed_), e.g. to pack the codes densely
+
+    */
+    void set_bits(std::uint32_t _bits){
+
+      const std::size_t levels = _bits < sizeof(compressed_type)*CHAR_BIT ? (std::size_t(1) << _bits) : max_compressed_;
+      lut_decode_.resize(levels, raw_type(0));
+
+    }
+
     void reset() {
 
       sum_ = 0;
@@ -143,7 +375,12 @@ namespace sqeazy {
 
     void computeHistogram(const raw_type* _begin, const raw_type* _end){
 
-      detail::parallel::fill_histogram(_begin, _end, histo_.begin(), n_threads());
+      if(sample_fraction_ < 1.f)
+        detail::parallel::fill_histogram_sampled(_begin, _end, histo_.begin(),
+                                                 sample_fraction_, sample_random_,
+                                                 n_threads());
+      else
+        detail::parallel::fill_histogram(_begin, _end, histo_.begin(), n_threads());
 
       //TODO: does it make sense to acc the histo_ with (n>1) threads if the histo fits into L2?
       sum_ = std::accumulate(histo_.begin(), histo_.end(),0);
@@ -177,7 +414,7 @@ namespace sqeazy {
       else
         importanceSum = std::accumulate(importance_.begin(),importance_.end(),0.);
 
-      size_t levels_available = max_compressed_;//-1 one because we are assuming to use 0 already
+      size_t levels_available = n_levels();//-1 one because we are assuming to use 0 already
       float bucketSize = importanceSum/levels_available;
 
       float importanceIntegral = importance_.front();
@@ -189,7 +426,7 @@ namespace sqeazy {
       for(uint32_t raw_idx = 1;raw_idx<quantiser::max_raw_;++raw_idx){
 
         //bucket overflow
-        if(quantile_sum >= bucketSize && comp_idx<(max_compressed_-1)){
+        if(quantile_sum >= bucketSize && comp_idx<(n_levels()-1)){
 
           //FIXME: using std::array::at is expected to harm performance
           lut_decode_.at(comp_idx) = static_cast<raw_type>(index_max_importance);
@@ -234,7 +471,7 @@ namespace sqeazy {
       else
         importanceSum = std::accumulate(importance_.begin(),importance_.end(),0.);
 
-      size_t levels_available = max_compressed_;//-1 one because we are assuming to use 0 already
+      size_t levels_available = n_levels();//-1 one because we are assuming to use 0 already
       float bucketSize = importanceSum/levels_available;
 
       float importanceIntegral = importance_.front();
@@ -336,7 +573,7 @@ namespace sqeazy {
                                          }
         );
 
-      if(n_levels <= max_compressed_)
+      if(n_levels <= this->n_levels())
         linear_mapping_quantisation();
       else
         // adaptive_lloyd_max(importanceSum);
@@ -409,7 +646,7 @@ namespace sqeazy {
         );
 
       //compute the LUT
-      if(n_levels <= max_compressed_)
+      if(n_levels <= this->n_levels())
         linear_mapping_quantisation();
       else
         adaptive_lloyd_com(importanceSum);
@@ -446,42 +683,13 @@ namespace sqeazy {
 
       setup_com(_input,_input + _in_nelems);
 
-      applyLUT<raw_type, compressed_type> lutApplyer(lut_encode_);
-
-      if(n_threads()==1)
-        std::transform(_input,_input+_in_nelems,_output,lutApplyer);
-      else{
-        const omp_size_type len = _in_nelems;
-
-#pragma omp parallel for                        \
-  shared(_output )                              \
-  firstprivate( len, _input, lutApplyer )       \
-  num_threads(nthreads_)
-        for(omp_size_type idx = 0;idx<len;idx++){
-          _output[idx] = lutApplyer(_input[idx]);
-        }
-      }
+      detail::lut::apply(_input, _in_nelems, lut_encode_, _output, nthreads_);
 
     }
 
     void decode(const compressed_type* _input, const size_t& _in_nelems, raw_type* _output){
 
-      applyLUT<compressed_type, raw_type> lutApplyer(lut_decode_);
-
-      if(n_threads()==1)
-        std::transform(_input,_input+_in_nelems,_output,lutApplyer);
-      else{
-        const omp_size_type len = _in_nelems;
-
-#pragma omp parallel for                        \
-  shared(_output )                       \
-  firstprivate( len, _input, lutApplyer )           \
-  num_threads(nthreads_)
-        for(omp_size_type idx = 0;idx<len;idx++){
-          _output[idx] = lutApplyer(_input[idx]);
-        }
-      }
-
+      detail::lut::apply(_input, _in_nelems, lut_decode_, _output, nthreads_);
 
     }
 
@@ -523,6 +731,135 @@ namespace sqeazy {
       return value;
     }
 
+    /**
+       \brief upper bound of the number of bytes lut_to_binary emits for a LUT of _n_items
+
+    */
+    static std::size_t max_binary_lut_bytes(std::size_t _n_items) {
+
+      //zig-zag encoded deltas carry one bit more than raw_type, every varint byte holds 7 bits
+      const std::size_t max_varint_bytes = (sizeof(raw_type)*CHAR_BIT + 1 + 6)/7;
+      return sizeof(std::uint32_t) + 10 + _n_items*max_varint_bytes + sizeof(compressed_type);
+    }
+
+    /**
+       \brief serialize _lut to _dst as binary section: the number of bytes that follow as 4-byte little endian
+       integer, the number of items and the zig-zag encoded differences of consecutive items as varints;
+       the section is padded to a multiple of sizeof(compressed_type)
+
+       \param[in] _lut decode LUT
+       \param[out] _dst buffer of at least max_binary_lut_bytes(_lut.size()) bytes
+
+       \return number of bytes written
+       \retval
+
+    */
+    template <typename lut_type>
+    static std::size_t lut_to_binary(const lut_type& _lut, char* _dst){
+
+      char* iter = detail::put_varint(_lut.size(), _dst + sizeof(std::uint32_t));
+
+      std::int64_t last = 0;
+      for(const auto& item : _lut){
+        const std::int64_t delta = std::int64_t(item) - last;
+        iter = detail::put_varint((std::uint64_t(delta) << 1) ^ std::uint64_t(delta >> 63), iter);
+        last = item;
+      }
+
+      while((iter - _dst) % sizeof(compressed_type))
+        *(iter++) = 0;
+
+      const std::uint32_t section_bytes = (iter - _dst) - sizeof(std::uint32_t);
+      for(std::size_t b = 0;b<sizeof(std::uint32_t);++b)
+        _dst[b] = char((section_bytes >> (8*b)) & 0xff);
+
+      return iter - _dst;
+    }
+
+    /**
+       \brief size in bytes (including the length prefix) of the binary LUT section starting at _begin
+
+       \return number of bytes, 0 if the section does not fit into [_begin,_end)
+       \retval
+
+    */
+    static std::size_t binary_lut_bytes(const char* _begin, const char* _end){
+
+      if((_end - _begin) < std::ptrdiff_t(sizeof(std::uint32_t)))
+        return 0;
+
+      std::uint32_t section_bytes = 0;
+      for(std::size_t b = 0;b<sizeof(std::uint32_t);++b)
+        section_bytes |= std::uint32_t(static_cast<unsigned char>(_begin[b])) << (8*b);
+
+      if(std::size_t(_end - _begin) - sizeof(std::uint32_t) < section_bytes)
+        return 0;
+
+      return sizeof(std::uint32_t) + section_bytes;
+    }
+
+    /**
+       \brief deserialize a LUT written by lut_to_binary from [_begin,_end)
+
+       \param[in] _begin start of the binary section
+       \param[in] _end end of the buffer that contains the section
+       \param[out] _lut decode LUT
+
+       \return number of bytes consumed, 0 if the section is malformed
+       \retval
+
+    */
+    static std::size_t lut_from_binary(const char* _begin, const char* _end, std::vector<raw_type>& _lut){
+
+      const std::size_t total_bytes = binary_lut_bytes(_begin,_end);
+      if(!total_bytes)
+        return 0;
+
+      const std::size_t section_bytes = total_bytes - sizeof(std::uint32_t);
+      const char* section_end = _begin + total_bytes;
+
+      std::uint64_t n_items = 0;
+      const char* iter = detail::get_varint(_begin + sizeof(std::uint32_t), section_end, n_items);
+      if(!iter || n_items > section_bytes)
+        return 0;
+
+      _lut.resize(n_items);
+
+      std::int64_t last = 0;
+      for(raw_type& item : _lut){
+        std::uint64_t zigzag = 0;
+        iter = detail::get_varint(iter, section_end, zigzag);
+        if(!iter)
+          return 0;
+
+        last += std::int64_t(zigzag >> 1) ^ -std::int64_t(zigzag & 1);
+        item = static_cast<raw_type>(last);
+      }
+
+      return section_end - _begin;
+    }
+
+    /**
+       \brief content hash (64-bit FNV-1a as hex string) of _lut, used to refer to a LUT without embedding it
+
+    */
+    template <typename lut_type>
+    static std::string lut_hash(const lut_type& _lut){
+
+      std::uint64_t value = 14695981039346656037ull;
+      const unsigned char* bytes = reinterpret_cast<const unsigned char*>(_lut.data());
+      const std::size_t nbytes = _lut.size()*sizeof(_lut[0]);
+
+      for(std::size_t i = 0;i<nbytes;++i){
+        value ^= bytes[i];
+        value *= 1099511628211ull;
+      }
+
+      std::ostringstream msg;
+      msg << std::hex << std::setw(16) << std::setfill('0') << value;
+      return msg.str();
+    }
+
     //could this be replaced by a stream operator overload?
     //TODO: perhaps very slow
     void lut_from_string(const std::string& _lut_as_string,
@@ -629,7 +966,53 @@ namespace sqeazy {
       return nthreads_;
     }
 
-    const std::vector<int>* get_histogram() const {
+    /**
+       \brief build the histogram from a subset of the input only, see detail::parallel::fill_histogram_sampled
+
+       \param[in] _fraction fraction of the input to visit, values >= 1 disable sampling
+       \param[in] _random visit blocks at random positions rather than at a fixed stride
+
+       \return
+       \retval
+
+    */
+    void set_sampling(float _fraction, bool _random = false){
+      sample_fraction_ = _fraction > 0.f ? _fraction : 1.f;
+      sample_random_ = _random;
+    }
+
+    /**
+       \brief expected squared error of a roundtrip through lut_encode_ and lut_decode_ for data
+       distributed according to _histo
+
+       \param[in] _histo histogram of the data, max_raw_ bins
+
+       \return mean squared error
+       \retval
+
+    */
+    double mean_squared_error(const std::vector<std::uint32_t>& _histo) const {
+
+      double value = 0;
+      double count = 0;
+
+      for(std::size_t raw_idx = 0;raw_idx<_histo.size() && raw_idx<max_raw_;++raw_idx){
+
+        if(!_histo[raw_idx])
+          continue;
+
+        typedef typename std::make_unsigned<compressed_type>::type index_t;
+        const double decoded = lut_decode_[index_t(lut_encode_[raw_idx])];
+        const double diff = decoded - double(raw_idx);
+
+        value += diff*diff*_histo[raw_idx];
+        count += _histo[raw_idx];
+      }
+
+      return count > 0 ? value/count : 0.;
+    }
+
+    const std::vector<std::uint32_t>* get_histogram() const {
       return &histo_;
 
     }
@@ -663,7 +1046,7 @@ namespace sqeazy {
                 << sqeazy::header_utils::represent<compressed_type>::as_string();
 
       float importanceSum = std::accumulate(importance_.begin(),importance_.end(),0.);
-      float bucketSize = importanceSum/max_compressed_;
+      float bucketSize = importanceSum/n_levels();
       quant_log << " (initial bucket size: " << bucketSize << ", sum(wei*int): "<< importanceSum<< ")\n";
 
       quant_log << std::setw(13) << "[begin,end]"
@@ -729,7 +1112,7 @@ namespace sqeazy {
                   << std::setw(15) << importance_[item] << "\n";
 
       quant_log << "\ndecode_lut:\n";
-      for( uint32_t item = 0;item < (max_compressed_);++item)
+      for( uint32_t item = 0;item < (n_levels());++item)
         quant_log << std::setw(10) << item << std::setw(10) << (int)lut_decode_[item] << "\n";
 
       quant_log.precision(prec_);
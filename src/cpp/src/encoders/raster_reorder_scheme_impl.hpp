@@ -25,15 +25,18 @@ namespace sqeazy {
     static const std::string description() {
       std::ostringstream msg;
       msg << "reorder the memory layout of the incoming buffer by linearizing virtual tiles, ";
-      msg << "control the tile size by tile_size=<integer|default: " << default_tile_size << ">";
+      msg << "control the tile size by tile_size=<integer|default: " << default_tile_size << ">, ";
+      msg << "bypass the cache on writing by stores=<auto|cached|streaming|default: auto>";
       return msg.str();
     };
 
     std::size_t tile_size;
+    detail::store_policy stores;
 
 
     raster_reorder_scheme(const std::string& _payload=""):
-      tile_size(default_tile_size)
+      tile_size(default_tile_size),
+      stores(detail::store_policy::automatic)
       {
 
         pipeline_parser p;
@@ -45,6 +48,16 @@ namespace sqeazy {
           if(f_itr!=config_map.end())
             tile_size = std::stoi(f_itr->second);
 
+          f_itr = config_map.find("stores");
+          if(f_itr!=config_map.end()){
+            if(f_itr->second == "streaming")
+              stores = detail::store_policy::streaming;
+            else if(f_itr->second == "cached")
+              stores = detail::store_policy::cached;
+            else if(f_itr->second != "auto")
+              std::cerr << "[raster_reorder_scheme] unknown value for stores: " << f_itr->second << ", using auto\n";
+          }
+
         }
       }
 
@@ -61,6 +74,12 @@ namespace sqeazy {
 
       std::ostringstream msg;
       msg << "tile_size=" << std::to_string(tile_size);
+
+      if(stores == detail::store_policy::streaming)
+        msg << ",stores=streaming";
+      if(stores == detail::store_policy::cached)
+        msg << ",stores=cached";
+
       return msg.str();
 
     }
@@ -109,7 +128,7 @@ namespace sqeazy {
       typedef std::size_t size_type;
       unsigned long length = std::accumulate(_shape.begin(), _shape.end(), 1, std::multiplies<size_type>());
 
-      detail::reorder tiles_of(tile_size);
+      detail::reorder tiles_of(tile_size, stores);
 
       auto value = tiles_of.encode(_input, _input+length,
                                    _output,
@@ -127,7 +146,7 @@ namespace sqeazy {
 
       std::size_t length = std::accumulate(_ishape.begin(), _ishape.end(), 1, std::multiplies<std::size_t>());
 
-      detail::reorder tiles_of(tile_size);
+      detail::reorder tiles_of(tile_size, stores);
 
       auto value = tiles_of.decode(_input, _input+length,
                                    _output,
@@ -2,26 +2,196 @@
 #define _MEMORY_REORDER_UTILS_H_
 
 #include <cstdint>
+#include <cstring>
 #include <iterator>
 
+#include "compass.hpp"
+#include "sqeazy_common.hpp"
 #include "traits.hpp"
+#include "brick_utils.hpp"
 
-#include <xmmintrin.h>
-#include <smmintrin.h>
+#ifdef COMPASS_CT_ARCH_X86
+#include <immintrin.h>
+#endif
 
 
 namespace sqeazy {
 
   namespace detail {
 
+	/**
+	   \brief how the SIMD reorder paths write to the output: automatic uses streaming (non-temporal)
+	   stores if the output does not fit into the last level cache, cached and streaming force either
+
+	*/
+	enum class store_policy { automatic, cached, streaming };
+
+	namespace raster {
+
+	  typedef void (*copy_runs_t)(const char*, std::size_t, char*, std::size_t, std::size_t, std::size_t);
+
+	  /**
+		 \brief copy _n_runs runs of _run_bytes bytes, run i is read from _src + i*_src_stride
+		 and written to _dst + i*_dst_stride
+
+	  */
+	  static void copy_runs(const char* _src, std::size_t _src_stride,
+							char* _dst, std::size_t _dst_stride,
+							std::size_t _n_runs, std::size_t _run_bytes){
+
+		for(std::size_t i = 0;i<_n_runs;++i,_src += _src_stride,_dst += _dst_stride)
+		  std::memcpy(_dst, _src, _run_bytes);
+
+	  }
+
+#ifdef COMPASS_CT_ARCH_X86
+	  //the SIMD variants expect _run_bytes to be a multiple of their block width,
+	  //the streaming ones additionally expect _dst and _dst_stride to be aligned to it
+	  template <bool non_temporal>
+	  SQY_TARGET("sse2")
+	  static void copy_runs_sse2(const char* _src, std::size_t _src_stride,
+								 char* _dst, std::size_t _dst_stride,
+								 std::size_t _n_runs, std::size_t _run_bytes){
+
+		for(std::size_t i = 0;i<_n_runs;++i,_src += _src_stride,_dst += _dst_stride){
+		  for(std::size_t b = 0;b<_run_bytes;b+=16){
+			const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(_src + b));
+			if(non_temporal)
+			  _mm_stream_si128(reinterpret_cast<__m128i*>(_dst + b),block);
+			else
+			  _mm_storeu_si128(reinterpret_cast<__m128i*>(_dst + b),block);
+		  }
+		}
+
+		if(non_temporal)
+		  _mm_sfence();
+	  }
+
+	  template <bool non_temporal>
+	  SQY_TARGET("avx")
+	  static void copy_runs_avx(const char* _src, std::size_t _src_stride,
+								char* _dst, std::size_t _dst_stride,
+								std::size_t _n_runs, std::size_t _run_bytes){
+
+		for(std::size_t i = 0;i<_n_runs;++i,_src += _src_stride,_dst += _dst_stride){
+		  for(std::size_t b = 0;b<_run_bytes;b+=32){
+			const __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(_src + b));
+			if(non_temporal)
+			  _mm256_stream_si256(reinterpret_cast<__m256i*>(_dst + b),block);
+			else
+			  _mm256_storeu_si256(reinterpret_cast<__m256i*>(_dst + b),block);
+		  }
+		}
+
+		if(non_temporal)
+		  _mm_sfence();
+	  }
+
+	  template <bool non_temporal>
+	  SQY_TARGET("avx512f")
+	  static void copy_runs_avx512(const char* _src, std::size_t _src_stride,
+								   char* _dst, std::size_t _dst_stride,
+								   std::size_t _n_runs, std::size_t _run_bytes){
+
+		for(std::size_t i = 0;i<_n_runs;++i,_src += _src_stride,_dst += _dst_stride){
+		  for(std::size_t b = 0;b<_run_bytes;b+=64){
+			const __m512i block = _mm512_loadu_si512(reinterpret_cast<const void*>(_src + b));
+			if(non_temporal)
+			  _mm512_stream_si512(reinterpret_cast<__m512i*>(_dst + b),block);
+			else
+			  _mm512_storeu_si512(reinterpret_cast<void*>(_dst + b),block);
+		  }
+		}
+
+		if(non_temporal)
+		  _mm_sfence();
+	  }
+#endif
+
+	  /**
+		 \brief size of the last level cache in bytes, 0 if it cannot be determined
+
+	  */
+	  static std::size_t last_level_cache_bytes(){
+
+		static const std::size_t value = compass::runtime::size::cache::levels() > 0 ?
+		  compass::runtime::size::cache::level(compass::runtime::size::cache::levels()) : 0;
+
+		return value;
+	  }
+
+	  /**
+		 \brief select the widest copy kernel whose block divides _run_bytes and that the CPU supports,
+		 streaming stores are only used if every destination of a run is aligned to the block width and
+		 runs cover full cache lines (partial lines written non-temporally are much slower than cached stores)
+
+		 \return nullptr if no SIMD kernel fits
+
+	  */
+	  static copy_runs_t select_copy_runs(std::size_t _run_bytes,
+										  const void* _dst,
+										  std::size_t _dst_stride,
+										  bool _non_temporal){
+
+		copy_runs_t value = nullptr;
+
+#ifdef COMPASS_CT_ARCH_X86
+		if(!sqeazy::platform::use_vectorisation::value){
+#ifdef _SQY_VERBOSE_
+		  std::cout << "[SQY_VERBOSE] [detail::raster::select_copy_runs]\tvectorisation disabled, using scalar copies\n";
+#endif
+		  return value;
+		}
+
+		const std::uintptr_t dst_address = reinterpret_cast<std::uintptr_t>(_dst);
+		static const std::size_t cacheline_bytes = 64;
+		auto streamable = [&](std::size_t _width){
+		  return _non_temporal && (_run_bytes % cacheline_bytes) == 0 &&
+			(dst_address % _width) == 0 && (_dst_stride % _width) == 0;
+		};
+
+		//kernels whose block does not divide _run_bytes are skipped
+		auto fitting = [&](std::size_t _width, copy_runs_t _cached, copy_runs_t _streaming) -> copy_runs_t {
+		  if(_run_bytes % _width)
+			return nullptr;
+		  return streamable(_width) ? _streaming : _cached;
+		};
+
+		value = sqeazy::platform::widest_kernel<copy_runs_t>(nullptr,
+															 fitting(16, &copy_runs_sse2<false>, &copy_runs_sse2<true>),
+															 fitting(32, &copy_runs_avx<false>, &copy_runs_avx<true>),
+															 fitting(64, &copy_runs_avx512<false>, &copy_runs_avx512<true>));
+#endif
+
+		return value;
+	  }
+
+	};
+
 
 	struct reorder {
 
 	  std::size_t tile_size;
+	  store_policy stores;
+
+	  reorder(std::size_t _tsize, store_policy _stores = store_policy::automatic):
+		tile_size(_tsize),
+		stores(_stores){
 
-	  reorder(std::size_t _tsize):
-		tile_size(_tsize){
+	  }
+
+	  /**
+		 \brief true if the SIMD paths should bypass the cache when writing _n_bytes of output
+
+	  */
+	  bool use_streaming_stores(std::size_t _n_bytes) const {
+
+		if(stores == store_policy::automatic){
+		  const std::size_t llc = raster::last_level_cache_bytes();
+		  return llc > 0 && _n_bytes > llc;
+		}
 
+		return stores == store_policy::streaming;
 	  }
 
 	  template <typename value_t>
@@ -33,6 +203,15 @@ namespace sqeazy {
 		return rem;
 	  }
 
+	  /**
+		 \brief partition of _shape into tiles of tile_size^3, tiles at the upper border may be cut
+
+	  */
+	  template <typename shape_container_t>
+	  brick_layout tiles_of(const shape_container_t& _shape) const {
+		return brick_layout(_shape, std::vector<std::size_t>(_shape.size(), tile_size));
+	  }
+
 	  template <typename in_iterator_t, typename out_iterator_t, typename shape_container_t>
 	  out_iterator_t encode(in_iterator_t _begin,
 							in_iterator_t _end,
@@ -70,92 +249,33 @@ namespace sqeazy {
 		const bool has_remainder = std::count_if(rem.begin(), rem.end(), [](shape_value_t el){ return el > 0;});
 
 		if(has_remainder)
-		  return encode_with_remainder(_begin,_end,_out,_shape);
+		  return encode_with_remainder(_begin,_end,_out,_shape,nthreads);
 		else{
 		  static const std::size_t n_elements_per_simd_block = 16/sizeof(in_value_t);
 
 		  if(tile_size % n_elements_per_simd_block == 0)
 			return encode_full_simd(_begin,_end,_out,_shape,nthreads);
 		  else
-			return encode_full(_begin,_end,_out,_shape,nthreads);
+			return encode_with_remainder(_begin,_end,_out,_shape,nthreads);
 		}
 
 	  }
 
 
-	  template <typename in_iterator_t, typename out_iterator_t, typename shape_container_t>
-	  out_iterator_t encode_full(in_iterator_t _begin,
-								 in_iterator_t _end,
-								 out_iterator_t _out,
-								 const shape_container_t& _shape,
-								 int _nthreads = 1) const {
+	  /**
+		 \brief encode a stack made of full tiles only with SIMD block copies
 
-		typedef decltype(_shape.data()) shape_ptr_t;
-		typedef typename std::iterator_traits<decltype(_shape.begin())>::value_type shape_value_type;
-		typedef typename std::remove_cv<shape_value_type>::type shape_value_t;
+		 every row of the input is split into runs of tile_size elements which are copied to
+		 their tiles with the widest block copy the CPU offers (16, 32 or 64 byte), outputs larger than the
+		 last level cache are written with streaming stores (see store_policy) as the output is
+		 consumed by later stages and not re-read right away
 
-		if(_nthreads <= 0)
-		  _nthreads = std::thread::hardware_concurrency();
+		 \param[in]
 
-		if(_shape[row_major::z] < (shape_value_t)_nthreads)
-		  _nthreads = _shape[row_major::z];
-
-		const shape_container_t rem = remainder(_shape);
-		const std::size_t n_elements_per_tile = std::pow(tile_size,_shape.size());
-		const std::size_t n_elements_per_tile_frame = std::pow(tile_size,_shape.size()-1);
-
-		shape_container_t n_full_tiles = _shape;
-
-		for(shape_value_t & n_tiles : n_full_tiles )
-		  n_tiles = n_tiles / tile_size;
-
-
-		const int chunk = tile_size;
-		shape_ptr_t shape = _shape.data();
-		shape_ptr_t full_tiles = n_full_tiles.data();
-		auto len = std::distance(_begin,_end);
-
-
-#pragma omp parallel for									\
-  shared( _begin, _out )										\
-  schedule(static,chunk)									\
-  firstprivate(shape,full_tiles)							\
-  num_threads(_nthreads)
-		for(omp_size_type z = 0;z<(omp_size_type)shape[row_major::z];++z){
-		  std::size_t ztile = z / tile_size;
-		  std::size_t z_intile_row_offset = z % tile_size;
-
-		  for(omp_size_type y = 0;y<(omp_size_type)shape[row_major::y];++y){
-			std::size_t ytile = y / tile_size;
-			std::size_t y_intile_row_offset = y % tile_size;
-
-			std::size_t xtile = 0;
-
-			std::size_t in_row = (z*shape[row_major::y]*shape[row_major::x]) + (y*shape[row_major::x]);
-			std::size_t out_tile_offset = (ztile*full_tiles[row_major::x]*full_tiles[row_major::y] + ytile*full_tiles[row_major::x]);
-			std::size_t intile_row_offset = z_intile_row_offset*n_elements_per_tile_frame + y_intile_row_offset*tile_size;
-
-			for(omp_size_type x = 0;x<(omp_size_type)shape[row_major::x];x+=tile_size){
-
-			  xtile = x / tile_size;
-			  in_iterator_t  src = _begin + in_row + x;
-			  out_iterator_t dst = _out + ((out_tile_offset+xtile)*n_elements_per_tile) + intile_row_offset;
-
-			  dst = std::copy(src,
-							  src + tile_size,
-							  dst
-				);
-
-			}
-
-		  }
-
-		}
-
-		return _out + len;
-
-	  }
+		 \return
+		 \retval
 
+	  */
 	  template <typename in_iterator_t, typename out_iterator_t, typename shape_container_t>
 	  out_iterator_t encode_full_simd(in_iterator_t _begin,
 									  in_iterator_t _end,
@@ -185,7 +305,6 @@ namespace sqeazy {
 		if(_shape[row_major::z] < (shape_value_t)_nthreads)
 		  _nthreads = _shape[row_major::z];
 
-		const shape_container_t rem = remainder(_shape);
 		const std::size_t n_elements_per_tile = std::pow(tile_size,_shape.size());
 		const std::size_t n_elements_per_tile_frame = std::pow(tile_size,_shape.size()-1);
 
@@ -194,14 +313,25 @@ namespace sqeazy {
 		for(shape_value_t & n_tiles : n_full_tiles )
 		  n_tiles = n_tiles / tile_size;
 
+		const auto len = std::distance(_begin,_end);
+		const std::size_t run_bytes = tile_size*sizeof(in_value_t);
+		const std::size_t tile_bytes = n_elements_per_tile*sizeof(in_value_t);
+
+		const char* src = reinterpret_cast<const char*>(&*_begin);
+		char* dst = reinterpret_cast<char*>(&*_out);
+
+		const raster::copy_runs_t copy_runs = raster::select_copy_runs(run_bytes, dst, tile_bytes,
+																	   use_streaming_stores(len*sizeof(in_value_t)));
+
+		if(!copy_runs)
+		  return encode_with_remainder(_begin,_end,_out,_shape,_nthreads);
+
 		shape_ptr_t shape = _shape.data();
 		shape_ptr_t full_tiles = n_full_tiles.data();
-		auto len = std::distance(_begin,_end);
-		out_iterator_t dst = _out;
 		const int chunk = tile_size;
 
 #pragma omp parallel for									\
-  shared( _begin, dst )										\
+  shared( src, dst )										\
   firstprivate(shape,full_tiles)							\
   schedule(static,chunk)									\
   num_threads(_nthreads)
@@ -213,26 +343,14 @@ namespace sqeazy {
 			std::size_t ytile = y / tile_size;
 			std::size_t y_intile_row_offset = y % tile_size;
 
-			std::size_t xtile = 0;
-
 			std::size_t in_row = (z*shape[row_major::y]*shape[row_major::x]) + (y*shape[row_major::x]);
 			std::size_t out_tile_offset = (ztile*full_tiles[row_major::x]*full_tiles[row_major::y] + ytile*full_tiles[row_major::x]);
 
 			std::size_t intile_row_offset = z_intile_row_offset*n_elements_per_tile_frame + y_intile_row_offset*tile_size;
 
-			for(omp_size_type x = 0;x<(omp_size_type)shape[row_major::x];x+=n_elements_per_simd_block){
-
-			  xtile = x / tile_size;
-
-			  const in_value_t* in_address = &*(_begin + in_row + x);
-			  dst = _out + ((out_tile_offset+xtile)*n_elements_per_tile) + intile_row_offset;
-			  in_value_t* out_address = &*dst;
-
-			  __m128i block = _mm_load_si128(reinterpret_cast<const __m128i*>(in_address));
-			  _mm_store_si128(reinterpret_cast<__m128i*>(out_address),block);
-			  dst += n_elements_per_simd_block;
-
-			}
+			copy_runs(src + in_row*sizeof(in_value_t), run_bytes,
+					  dst + (out_tile_offset*n_elements_per_tile + intile_row_offset)*sizeof(in_value_t), tile_bytes,
+					  full_tiles[row_major::x], run_bytes);
 
 		  }
 
@@ -243,6 +361,11 @@ namespace sqeazy {
 	  }
 
 
+	  /**
+		 \brief encode a stack of any shape, tiles are stored in row-major order of the tile grid, tiles
+		 at the upper border are cut to the stack
+
+	  */
 	  template <typename in_iterator_t, typename out_iterator_t, typename shape_container_t>
 	  out_iterator_t encode_with_remainder(in_iterator_t _begin,
 										   in_iterator_t _end,
@@ -250,119 +373,7 @@ namespace sqeazy {
 										   const shape_container_t& _shape,
 										   int _nthreads = 1) const {
 
-		typedef decltype(_shape.data()) shape_ptr_t;
-
-		typedef typename std::iterator_traits<decltype(_shape.begin())>::value_type shape_value_type;
-		typedef typename std::remove_cv<shape_value_type>::type shape_value_t;
-
-		if(_nthreads <= 0)
-		  _nthreads = std::thread::hardware_concurrency();
-
-		if(_shape[row_major::z] < (shape_value_t)_nthreads)
-		  _nthreads = _shape[row_major::z];
-
-		const shape_container_t rem = remainder(_shape);
-		const bool has_remainder = std::count_if(rem.begin(), rem.end(), [](shape_value_t el){ return el > 0;});
-
-		shape_container_t full_tiles_per_dim = _shape;
-		for(shape_value_t & tile : full_tiles_per_dim )
-		  tile = tile / tile_size;
-
-		shape_container_t tiles_per_dim = _shape;
-		for(shape_value_t & tile : tiles_per_dim )
-		  tile = (tile + tile_size - 1)/ tile_size;
-
-		const std::size_t n_tiles = std::accumulate(tiles_per_dim.begin(), tiles_per_dim.end(),
-													1,
-													std::multiplies<std::size_t>());
-
-		std::array<std::size_t, 3> tile_shape; tile_shape.fill(tile_size);
-
-		std::vector<std::array<std::size_t, 3> > tile_shapes (n_tiles, tile_shape);
-		std::vector<std::size_t>		 tile_sizes  (n_tiles, std::pow(tile_size,_shape.size()));
-
-
-		if(has_remainder){
-		  auto current_tile_shape = tile_shapes.begin();
-		  auto current_tile_sizes = tile_sizes.begin() ;
-
-		  for(shape_value_t z = 0;z<tiles_per_dim[row_major::z];++z){
-			tile_shape[row_major::z] = z != tiles_per_dim[row_major::z]-1 ? tile_size : rem[row_major::z];
-
-			for(shape_value_t y = 0;y<tiles_per_dim[row_major::y];++y){
-			  tile_shape[row_major::y] = y != tiles_per_dim[row_major::y]-1 ? tile_size : rem[row_major::y];
-
-			  for(shape_value_t x = 0;x<tiles_per_dim[row_major::x];++x){
-				tile_shape[row_major::x] = x != tiles_per_dim[row_major::x]-1 ? tile_size : rem[row_major::x];
-
-				*current_tile_shape = tile_shape;
-				++current_tile_shape;
-
-				*current_tile_sizes = std::accumulate(tile_shape.begin(), tile_shape.end(),1,std::multiplies<std::size_t>());
-				++current_tile_sizes;
-
-
-			  }
-			}
-		  }
-
-
-		}
-
-		std::vector<std::size_t> tile_output_offsets(n_tiles, 0);
-		std::size_t sum = 0;
-		for(std::size_t i = 0;i<tile_sizes.size();++i){
-		  tile_output_offsets[i] = sum;
-		  sum += tile_sizes[i];
-		}
-
-
-		const int chunk = tile_size;
-		shape_ptr_t shape = _shape.data();
-		shape_ptr_t ptiles_per_dim = tiles_per_dim.data();
-		const std::array<std::size_t, 3>* ptile_shapes = tile_shapes.data();
-		const std::size_t* ptile_output_offsets = tile_output_offsets.data();
-		auto len = std::distance(_begin,_end);
-
-#pragma omp parallel for									\
-  shared( _begin, _out )										\
-  schedule(static,chunk)									\
-  firstprivate(shape,ptiles_per_dim, ptile_shapes)			\
-  num_threads(_nthreads)
-		for(omp_size_type z = 0;z<(omp_size_type)shape[row_major::z];++z){
-
-		  std::size_t ztile = z / tile_size;
-		  std::size_t z_intile_row_offset = z % tile_size;
-
-		  for(omp_size_type y = 0;y<(omp_size_type)shape[row_major::y];++y){
-
-			std::size_t ytile = y / tile_size;
-			std::size_t y_intile_row_offset = y % tile_size;
-
-			std::size_t xtile = 0;
-
-			std::size_t in_row = (z*shape[row_major::y]*shape[row_major::x]) + (y*shape[row_major::x]);
-			std::size_t tile_index = (ztile*ptiles_per_dim[row_major::x]*ptiles_per_dim[row_major::y] + ytile*ptiles_per_dim[row_major::x]);
-
-
-			for(omp_size_type x = 0;x<(omp_size_type)shape[row_major::x];x+=tile_size,++xtile,++tile_index){
-
-			  std::size_t intile_row_offset = (z_intile_row_offset*ptile_shapes[tile_index][row_major::x]*ptile_shapes[tile_index][row_major::y]) + y_intile_row_offset*ptile_shapes[tile_index][row_major::x];
-			  std::size_t tile_output_offset = ptile_output_offsets[tile_index];
-
-			  std::copy(_begin + in_row + x,
-						_begin + in_row + x + tile_shapes[tile_index][row_major::x],
-						_out + tile_output_offset + intile_row_offset
-				);
-
-			}
-
-		  }
-
-		}
-
-
-		return _out + len;
+		return gather_bricks(_begin, _out, tiles_of(_shape), std::vector<std::size_t>(), _nthreads);
 	  }
 
 
@@ -397,170 +408,114 @@ namespace sqeazy {
 		}
 
 		const shape_container_t rem = remainder(_shape);
+		const bool has_remainder = std::count_if(rem.begin(), rem.end(), [](std::size_t el){ return el > 0;});
+
+		if(!has_remainder && (tile_size*sizeof(in_value_t)) % 16 == 0){
+		  auto value = decode_full_simd(_begin, _end, _out,_shape, _nthreads);
+		  if(value != _out)
+			return value;
+		}
 
 		return decode_with_remainder(_begin, _end, _out,_shape, _nthreads);
 
 	  }
 
-	  template <typename in_iterator_t, typename out_iterator_t, typename shape_container_t>
-	  out_iterator_t decode_with_remainder(in_iterator_t _begin,
-										   in_iterator_t _end,
-										   out_iterator_t _out,
-										   const shape_container_t& _shape,
-										   int _nthreads = 1) const {
+	  /**
+		 \brief inverse of encode_full_simd, every row of the output is gathered from its tiles with
+		 SIMD block copies
 
+		 \return _out if no SIMD copy is available, _out + number of decoded elements otherwise
 
+	  */
+	  template <typename in_iterator_t, typename out_iterator_t, typename shape_container_t>
+	  out_iterator_t decode_full_simd(in_iterator_t _begin,
+									  in_iterator_t _end,
+									  out_iterator_t _out,
+									  const shape_container_t& _shape,
+									  int _nthreads = 1) const {
+
+		typedef decltype(_shape.data()) shape_ptr_t;
 		typedef typename std::iterator_traits<decltype(_shape.begin())>::value_type shape_value_type;
 		typedef typename std::remove_cv<shape_value_type>::type shape_value_t;
 
 		typedef typename std::iterator_traits<in_iterator_t>::value_type in_value_type;
 		typedef typename std::remove_cv<in_value_type>::type in_value_t;
 
-		typedef typename std::iterator_traits<decltype(_shape.begin())>::value_type shape_value_type;
-		typedef typename std::remove_cv<shape_value_type>::type shape_value_t;
-		typedef decltype(_shape.data()) shape_ptr_t;
-
 		if(_nthreads <= 0)
 		  _nthreads = std::thread::hardware_concurrency();
 
 		if(_shape[row_major::z] < (shape_value_t)_nthreads)
 		  _nthreads = _shape[row_major::z];
 
+		const std::size_t n_elements_per_tile = std::pow(tile_size,_shape.size());
+		const std::size_t n_elements_per_tile_frame = std::pow(tile_size,_shape.size()-1);
 
-		const shape_container_t rem = remainder(_shape);
-		const bool has_remainder = std::count_if(rem.begin(), rem.end(), [](shape_value_t el){ return el > 0;});
-		const std::size_t n_elements = std::distance(_begin,_end);
+		shape_container_t n_full_tiles = _shape;
 
-		shape_container_t full_tiles_per_dim = _shape;
-		for(shape_value_t & tile : full_tiles_per_dim )
-		  tile = tile / tile_size;
+		for(shape_value_t & n_tiles : n_full_tiles )
+		  n_tiles = n_tiles / tile_size;
 
-		shape_container_t tiles_per_dim = _shape;
-		for(shape_value_t & tile : tiles_per_dim )
-		  tile = (tile + tile_size - 1)/ tile_size;
+		const auto len = std::distance(_begin,_end);
+		const std::size_t run_bytes = tile_size*sizeof(in_value_t);
+		const std::size_t tile_bytes = n_elements_per_tile*sizeof(in_value_t);
 
-		const std::size_t n_tiles = std::accumulate(tiles_per_dim.begin(), tiles_per_dim.end(),
-													1,
-													std::multiplies<std::size_t>());
+		const char* src = reinterpret_cast<const char*>(&*_begin);
+		char* dst = reinterpret_cast<char*>(&*_out);
 
-		std::array<std::size_t, 3> tile_shape; tile_shape.fill(tile_size);
-		std::vector<std::array<std::size_t, 3> > tile_shapes(n_tiles, tile_shape);
-		std::vector<std::size_t>		 tile_sizes  (n_tiles, std::pow(tile_size,_shape.size()));
+		//runs are written back to back into the output rows, hence the row pitch decides if streaming is possible
+		const raster::copy_runs_t copy_runs = raster::select_copy_runs(run_bytes, dst,
+																	   _shape[row_major::x]*sizeof(in_value_t),
+																	   use_streaming_stores(len*sizeof(in_value_t)));
 
+		if(!copy_runs)
+		  return _out;
 
-		if(has_remainder){
-		  auto current_tile_shape = tile_shapes.begin();
-		  auto current_tile_sizes = tile_sizes.begin()  ;
+		shape_ptr_t shape = _shape.data();
+		shape_ptr_t full_tiles = n_full_tiles.data();
+		const int chunk = tile_size;
 
-		  for(shape_value_t z = 0;z<tiles_per_dim[row_major::z];++z){
-			tile_shape[row_major::z] = z != tiles_per_dim[row_major::z]-1 ? tile_size : rem[row_major::z];
+#pragma omp parallel for									\
+  shared( src, dst )										\
+  firstprivate(shape,full_tiles)							\
+  schedule(static,chunk)									\
+  num_threads(_nthreads)
+		for(omp_size_type z = 0;z<(omp_size_type)shape[row_major::z];++z){
+		  std::size_t ztile = z / tile_size;
+		  std::size_t z_intile_row_offset = z % tile_size;
 
-			for(shape_value_t y = 0;y<tiles_per_dim[row_major::y];++y){
-			  tile_shape[row_major::y] = y != tiles_per_dim[row_major::y]-1 ? tile_size : rem[row_major::y];
+		  for(omp_size_type y = 0;y<(omp_size_type)shape[row_major::y];++y){
+			std::size_t ytile = y / tile_size;
+			std::size_t y_intile_row_offset = y % tile_size;
 
-			  for(shape_value_t x = 0;x<tiles_per_dim[row_major::x];++x){
-				tile_shape[row_major::x] = x != tiles_per_dim[row_major::x]-1 ? tile_size : rem[row_major::x];
+			std::size_t out_row = (z*shape[row_major::y]*shape[row_major::x]) + (y*shape[row_major::x]);
+			std::size_t in_tile_offset = (ztile*full_tiles[row_major::x]*full_tiles[row_major::y] + ytile*full_tiles[row_major::x]);
 
-				*current_tile_shape = tile_shape;
-				++current_tile_shape;
+			std::size_t intile_row_offset = z_intile_row_offset*n_elements_per_tile_frame + y_intile_row_offset*tile_size;
 
-				*current_tile_sizes = std::accumulate(tile_shape.begin(), tile_shape.end(),1,std::multiplies<std::size_t>());
-				++current_tile_sizes;
+			copy_runs(src + (in_tile_offset*n_elements_per_tile + intile_row_offset)*sizeof(in_value_t), tile_bytes,
+					  dst + out_row*sizeof(in_value_t), run_bytes,
+					  full_tiles[row_major::x], run_bytes);
 
-			  }
-			}
 		  }
-		}
-
-		std::vector<std::size_t> tile_size_sums(tile_sizes.size(),0);
-		std::size_t running_sum = 0;
-		for(std::size_t i = 0;i<tile_size_sums.size();++i){
-		  tile_size_sums[i] = running_sum;
-		  running_sum += tile_sizes[i];
-		}
 
-		std::vector<std::array<std::size_t, 3> > tile_spatial_offsets(n_tiles, tile_shape);
-		auto linear_offsets_begin = tile_spatial_offsets.begin();
-		std::array<std::size_t, 3> loc;
-
-		for(shape_value_t z = 0;z<_shape[row_major::z];z+=tile_size){
-		  for(shape_value_t y = 0;y<_shape[row_major::y];y+=tile_size){
-			for(shape_value_t x = 0;x<_shape[row_major::x];x+=tile_size){
-			  loc[row_major::x] = x;
-			  loc[row_major::y] = y;
-			  loc[row_major::z] = z;
-			  *linear_offsets_begin = loc;//copy-by-assignment
-			  ++linear_offsets_begin;
-			}
-		  }
 		}
 
+		return _out + len;
 
-		std::vector<in_value_t> buffer_row(_shape[row_major::x],0);
-		std::vector<std::vector<in_value_t>> buffer_row_per_thread(_nthreads, buffer_row);
-		auto pbuffer_row_per_thread = buffer_row_per_thread.data();
-
-		std::size_t write_count = 0;
-		const std::array<std::size_t, 3>* ptile_shapes = tile_shapes.data();
-
-		shape_ptr_t pshape = _shape.data();
-		const std::size_t* ptile_size_sums = tile_size_sums.data();
-		shape_value_t n_rows_in_output = _shape[row_major::z]*_shape[row_major::y];
-
-#pragma omp parallel for												\
-  shared( _begin, _out, write_count )									\
-  firstprivate(pshape,ptile_shapes,  ptile_size_sums, pbuffer_row_per_thread) \
-  num_threads(_nthreads)
-		for(omp_size_type row_in_output = 0;row_in_output<(omp_size_type)n_rows_in_output;++row_in_output)
-		{
-
-		  int tid = omp_get_thread_num();
-		  auto buffer_row_begin = pbuffer_row_per_thread[tid].begin();
-		  auto row_global_offset = row_in_output*pshape[row_major::x];
-
-		  std::size_t global_y = row_in_output % pshape[row_major::y];
-		  std::size_t global_z = row_in_output / pshape[row_major::y];
-
-		  std::size_t tile_y = global_y / tile_size;
-		  std::size_t tile_z = global_z / tile_size;
-
-		  std::size_t in_tile_y = global_y % tile_size;
-		  std::size_t in_tile_z = global_z % tile_size;
-
-
-		  std::size_t tile_offset = tile_z*tiles_per_dim[row_major::x]*tiles_per_dim[row_major::y];
-		  tile_offset += tile_y*tiles_per_dim[row_major::x];
-
-		  for(std::size_t tile = tile_offset;tile<(tile_offset+tiles_per_dim[row_major::x]);++tile)
-		  {
-
-
-			const std::size_t tile_extent_x = ptile_shapes[tile][row_major::x];
-			const std::size_t tile_extent_y = ptile_shapes[tile][row_major::y];
-			std::size_t in_tile_offset = in_tile_z*tile_extent_y*tile_extent_x + in_tile_y*tile_extent_x;
-
-			auto src = _begin + ptile_size_sums[tile] + in_tile_offset;
-
-			buffer_row_begin = std::copy(src, src + tile_extent_x,
-										 buffer_row_begin);
-
-		  }
-
-		  std::copy(pbuffer_row_per_thread[tid].begin(),
-					pbuffer_row_per_thread[tid].end(),
-					_out + row_global_offset);
-#pragma omp critical
-		  {
-			write_count += pshape[row_major::x];
-		  }
-		}
+	  }
 
+	  /**
+		 \brief inverse of encode_with_remainder, every tile is scattered from the stream to its place in the stack
 
-		if(write_count == n_elements)
-		  return _out + write_count;
-		else
-		  return _out;
+	  */
+	  template <typename in_iterator_t, typename out_iterator_t, typename shape_container_t>
+	  out_iterator_t decode_with_remainder(in_iterator_t _begin,
+										   in_iterator_t _end,
+										   out_iterator_t _out,
+										   const shape_container_t& _shape,
+										   int _nthreads = 1) const {
 
+		return scatter_bricks(_begin, _out, tiles_of(_shape), std::vector<std::size_t>(), _nthreads);
 	  }
 
 
@@ -7,6 +7,7 @@
 #include "dynamic_stage.hpp"
 #include "string_parsers.hpp"
 #include "background_scheme_utils.hpp"
+#include "saturating_subtract_utils.hpp"
 
 namespace sqeazy {
 
@@ -72,25 +73,22 @@ namespace sqeazy {
 
     compressed_type* encode( const raw_type* _input, compressed_type* _output, std::size_t _input_size) override final {
 
-      compressed_type* end_itr = nullptr;
+      return detail::saturating::subtract(_input, _input_size, threshold, _output, this->n_threads());
 
-      const omp_size_type nthreads  = this->n_threads();
-      const omp_size_type chunk_size = (_input_size + nthreads -1)/nthreads;
-      const omp_size_type len = _input_size;
-      const auto local_threshold = this->threshold;
+    }
 
-#pragma omp parallel for                        \
-  shared(_output)                               \
-  firstprivate( _input, chunk_size, local_threshold)  \
-  schedule(static,chunk_size)                   \
-      num_threads(nthreads)
-        for(omp_size_type i=0; i<len; ++i){
-          _output[i] = _input[i] > threshold ? _input[i] - threshold : 0;
-        }
+    /**
+       \brief remove the background from _data without a second buffer
 
-      end_itr = _output + len;
+       \param[in,out] _data payload
+       \param[in] _input_size number of items in _data
+       \param[in] _threshold background level
+
+       \return pointer to _data + _input_size
+    */
+    static compressed_type* static_encode_inplace( raw_type* _data, std::size_t _input_size, raw_type _threshold, int _nthreads = 1) {
 
-      return end_itr;
+      return detail::saturating::subtract_inplace(_data, _input_size, _threshold, _nthreads);
 
     }
 
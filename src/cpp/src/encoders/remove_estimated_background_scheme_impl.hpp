@@ -24,9 +24,29 @@ namespace sqeazy {
     typedef in_type raw_type;
     typedef in_type compressed_type;
 
-    remove_estimated_background_scheme(const std::string& _payload=""){}
+    float percentile;
+
+    remove_estimated_background_scheme(const std::string& _payload=""):
+      percentile(.99f)
+      {
+
+        pipeline_parser p;
+        auto config_map = p.minors(_payload.begin(),_payload.end());
+
+        if(config_map.size()){
+          auto f_itr = config_map.find("percentile");
+          if(f_itr!=config_map.end())
+            percentile = std::stof(f_itr->second);
+        }
+
+        if(!(percentile >= 0.f && percentile <= 1.f)){
+          std::cerr << "[remove_estimated_background_scheme] percentile=" << percentile << " is not supported, expected a value in [0,1], using 0.99\n";
+          percentile = .99f;
+        }
+      }
+
     static const std::string description() {
-      return std::string("estimate noise from darkest planes, remove median of that plane from all pixels/voxels");
+      return std::string("estimate noise from darkest planes, remove the <percentile|default = 0.99> of the intensities of that plane from all pixels/voxels");
     };
 
     std::string name() const override final {
@@ -35,7 +55,11 @@ namespace sqeazy {
     }
 
     std::string config() const override final {
-      return std::string("");
+
+      std::ostringstream msg;
+      msg << "percentile=" << percentile;
+      return msg.str();
+
     }
 
 
@@ -70,15 +94,13 @@ namespace sqeazy {
 
     compressed_type* encode( const raw_type* _input, compressed_type* _output, const std::vector<std::size_t>& _shape) override final {
 
-      std::vector<raw_type> darkest_face;
-      extract_darkest_face((const raw_type*)_input, _shape, darkest_face);
-
+      //the faces are histogrammed in place, nothing is copied
       sqeazy::histogram<raw_type> t;
-      t.add_from_image(darkest_face.begin(), darkest_face.end());
+      darkest_face_histogram((const raw_type*)_input, _shape, t, percentile, this->n_threads());
 
       std::size_t input_length = std::accumulate(_shape.begin(), _shape.end(), 1, std::multiplies<std::size_t>());
 
-      const float reduce_by = t.calc_support(.99f);
+      const float reduce_by = t.calc_support(percentile);
 
 #ifdef _SQY_VERBOSE_
       std::cout << "[SQY_VERBOSE] remove_estimated_background ";
@@ -93,15 +115,11 @@ namespace sqeazy {
 #endif
 
       if(_output) {
-        //copies the input to output, skipping pixels that have a neighborhood complying criteria
+        //flattens pixels whose neighborhood is mostly below reduce_by and reduces all others by reduce_by,
+        //one pass instead of flatten_to_neighborhood_scheme::encode followed by remove_background_scheme::encode
         flatten_to_neighborhood_scheme<raw_type> flatten(reduce_by,.5);
-        //flatten_to_neighborhood_scheme<raw_type>::static_encode(_input, _output, _shape, reduce_by);
-        flatten.encode(_input, _output, _shape);
-        //set those pixels to 0 that fall below reduce_by
-        remove_background_scheme<raw_type> reduce(reduce_by);
-        reduce.encode(_output, _output,  input_length);//do it inplace!
-
-        //remove_background_scheme<raw_type>::static_encode_inplace(_output, input_length, reduce_by);
+        flatten.set_n_threads(this->n_threads());
+        flatten.encode_and_remove_background(_input, _output, _shape);
       }
       else {
         std::cerr << "WARNING ["<< name() <<"::encode]\t inplace operation not supported\n";
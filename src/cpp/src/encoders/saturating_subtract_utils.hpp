@@ -0,0 +1,416 @@
+#ifndef _SATURATING_SUBTRACT_UTILS_H_
+#define _SATURATING_SUBTRACT_UTILS_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+
+#include "compass.hpp"
+#include "sqeazy_common.hpp"
+
+#ifdef COMPASS_CT_ARCH_X86
+#include <immintrin.h>
+#endif
+
+namespace sqeazy {
+
+  namespace detail {
+
+    namespace saturating {
+
+      //number of elements every thread processes at once
+      static const std::size_t block_size = 1 << 15;
+
+      /**
+         \brief _out[i] = _in[i] - _threshold if _in[i] > _threshold, else 0 (scalar reference implementation)
+
+         \param[in] _in input buffer
+         \param[in] _len number of elements in _in
+         \param[in] _threshold value to subtract
+         \param[out] _out output buffer of at least _len items, may be equal to _in
+      */
+      template <typename value_t>
+      static void subtract_scalar(const value_t* _in, std::size_t _len, value_t _threshold, value_t* _out){
+
+        for(std::size_t i = 0;i<_len;++i)
+          _out[i] = _in[i] > _threshold ? value_t(_in[i] - _threshold) : value_t(0);
+      }
+
+      /**
+         \brief _out[i] = _in[i] - _thresholds[i] if _in[i] > _thresholds[i], else 0 (scalar reference implementation)
+      */
+      template <typename value_t>
+      static void subtract_each_scalar(const value_t* _in, std::size_t _len, const value_t* _thresholds, value_t* _out){
+
+        for(std::size_t i = 0;i<_len;++i)
+          _out[i] = _in[i] > _thresholds[i] ? value_t(_in[i] - _thresholds[i]) : value_t(0);
+      }
+
+      /**
+         \brief number of leading items to process before _out + head is aligned to _alignment bytes,
+         0 if _out is not aligned to its own type and hence never will be
+      */
+      template <typename value_t>
+      static std::size_t aligned_head(const value_t* _out, std::size_t _len, std::size_t _alignment){
+
+        const std::size_t misalignment = reinterpret_cast<std::uintptr_t>(_out) % _alignment;
+        if(!misalignment || misalignment % sizeof(value_t))
+          return 0;
+
+        return (std::min)(_len, (_alignment - misalignment)/sizeof(value_t));
+      }
+
+      template <typename value_t>
+      static bool is_aligned(const value_t* _ptr, std::size_t _alignment){
+        return reinterpret_cast<std::uintptr_t>(_ptr) % _alignment == 0;
+      }
+
+      //fall-backs for types without saturating instructions
+      template <typename value_t>
+      static void subtract_sse2(const value_t* _in, std::size_t _len, value_t _threshold, value_t* _out){
+        subtract_scalar(_in, _len, _threshold, _out);
+      }
+
+      template <typename value_t>
+      static void subtract_avx2(const value_t* _in, std::size_t _len, value_t _threshold, value_t* _out){
+        subtract_scalar(_in, _len, _threshold, _out);
+      }
+
+      template <typename value_t>
+      static void subtract_avx512(const value_t* _in, std::size_t _len, value_t _threshold, value_t* _out){
+        subtract_scalar(_in, _len, _threshold, _out);
+      }
+
+      template <typename value_t>
+      static void subtract_each_sse2(const value_t* _in, std::size_t _len, const value_t* _thresholds, value_t* _out){
+        subtract_each_scalar(_in, _len, _thresholds, _out);
+      }
+
+      template <typename value_t>
+      static void subtract_each_avx2(const value_t* _in, std::size_t _len, const value_t* _thresholds, value_t* _out){
+        subtract_each_scalar(_in, _len, _thresholds, _out);
+      }
+
+      template <typename value_t>
+      static void subtract_each_avx512(const value_t* _in, std::size_t _len, const value_t* _thresholds, value_t* _out){
+        subtract_each_scalar(_in, _len, _thresholds, _out);
+      }
+
+#ifdef COMPASS_CT_ARCH_X86
+
+      //the kernels below process a scalar head until _out is aligned, then do unaligned loads and aligned stores,
+      //the remainder is done by a scalar tail; loads precede the stores of the same items, so _in may equal _out
+
+      SQY_TARGET("sse2")
+      static void subtract_sse2(const std::uint8_t* _in, std::size_t _len, std::uint8_t _threshold, std::uint8_t* _out){
+
+        std::size_t i = aligned_head(_out, _len, 16);
+        subtract_scalar(_in, i, _threshold, _out);
+        if(!is_aligned(_out + i, 16))
+          return subtract_scalar(_in + i, _len - i, _threshold, _out + i);
+
+        const __m128i threshold = _mm_set1_epi8(char(_threshold));
+        for(;i + 16 <= _len;i += 16){
+          const __m128i value = _mm_loadu_si128(reinterpret_cast<const __m128i*>(_in + i));
+          _mm_store_si128(reinterpret_cast<__m128i*>(_out + i), _mm_subs_epu8(value, threshold));
+        }
+
+        subtract_scalar(_in + i, _len - i, _threshold, _out + i);
+      }
+
+      SQY_TARGET("sse2")
+      static void subtract_sse2(const std::uint16_t* _in, std::size_t _len, std::uint16_t _threshold, std::uint16_t* _out){
+
+        std::size_t i = aligned_head(_out, _len, 16);
+        subtract_scalar(_in, i, _threshold, _out);
+        if(!is_aligned(_out + i, 16))
+          return subtract_scalar(_in + i, _len - i, _threshold, _out + i);
+
+        const __m128i threshold = _mm_set1_epi16(short(_threshold));
+        for(;i + 8 <= _len;i += 8){
+          const __m128i value = _mm_loadu_si128(reinterpret_cast<const __m128i*>(_in + i));
+          _mm_store_si128(reinterpret_cast<__m128i*>(_out + i), _mm_subs_epu16(value, threshold));
+        }
+
+        subtract_scalar(_in + i, _len - i, _threshold, _out + i);
+      }
+
+      SQY_TARGET("avx2")
+      static void subtract_avx2(const std::uint8_t* _in, std::size_t _len, std::uint8_t _threshold, std::uint8_t* _out){
+
+        std::size_t i = aligned_head(_out, _len, 32);
+        subtract_scalar(_in, i, _threshold, _out);
+        if(!is_aligned(_out + i, 32))
+          return subtract_scalar(_in + i, _len - i, _threshold, _out + i);
+
+        const __m256i threshold = _mm256_set1_epi8(char(_threshold));
+        for(;i + 32 <= _len;i += 32){
+          const __m256i value = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(_in + i));
+          _mm256_store_si256(reinterpret_cast<__m256i*>(_out + i), _mm256_subs_epu8(value, threshold));
+        }
+
+        subtract_scalar(_in + i, _len - i, _threshold, _out + i);
+      }
+
+      SQY_TARGET("avx2")
+      static void subtract_avx2(const std::uint16_t* _in, std::size_t _len, std::uint16_t _threshold, std::uint16_t* _out){
+
+        std::size_t i = aligned_head(_out, _len, 32);
+        subtract_scalar(_in, i, _threshold, _out);
+        if(!is_aligned(_out + i, 32))
+          return subtract_scalar(_in + i, _len - i, _threshold, _out + i);
+
+        const __m256i threshold = _mm256_set1_epi16(short(_threshold));
+        for(;i + 16 <= _len;i += 16){
+          const __m256i value = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(_in + i));
+          _mm256_store_si256(reinterpret_cast<__m256i*>(_out + i), _mm256_subs_epu16(value, threshold));
+        }
+
+        subtract_scalar(_in + i, _len - i, _threshold, _out + i);
+      }
+
+      SQY_TARGET("avx512f,avx512bw")
+      static void subtract_avx512(const std::uint8_t* _in, std::size_t _len, std::uint8_t _threshold, std::uint8_t* _out){
+
+        std::size_t i = aligned_head(_out, _len, 64);
+        subtract_scalar(_in, i, _threshold, _out);
+        if(!is_aligned(_out + i, 64))
+          return subtract_scalar(_in + i, _len - i, _threshold, _out + i);
+
+        const __m512i threshold = _mm512_set1_epi8(char(_threshold));
+        for(;i + 64 <= _len;i += 64){
+          const __m512i value = _mm512_loadu_si512(reinterpret_cast<const void*>(_in + i));
+          _mm512_store_si512(reinterpret_cast<void*>(_out + i), _mm512_subs_epu8(value, threshold));
+        }
+
+        subtract_scalar(_in + i, _len - i, _threshold, _out + i);
+      }
+
+      SQY_TARGET("avx512f,avx512bw")
+      static void subtract_avx512(const std::uint16_t* _in, std::size_t _len, std::uint16_t _threshold, std::uint16_t* _out){
+
+        std::size_t i = aligned_head(_out, _len, 64);
+        subtract_scalar(_in, i, _threshold, _out);
+        if(!is_aligned(_out + i, 64))
+          return subtract_scalar(_in + i, _len - i, _threshold, _out + i);
+
+        const __m512i threshold = _mm512_set1_epi16(short(_threshold));
+        for(;i + 32 <= _len;i += 32){
+          const __m512i value = _mm512_loadu_si512(reinterpret_cast<const void*>(_in + i));
+          _mm512_store_si512(reinterpret_cast<void*>(_out + i), _mm512_subs_epu16(value, threshold));
+        }
+
+        subtract_scalar(_in + i, _len - i, _threshold, _out + i);
+      }
+
+      SQY_TARGET("sse2")
+      static void subtract_each_sse2(const std::uint8_t* _in, std::size_t _len, const std::uint8_t* _thresholds, std::uint8_t* _out){
+
+        std::size_t i = aligned_head(_out, _len, 16);
+        subtract_each_scalar(_in, i, _thresholds, _out);
+        if(!is_aligned(_out + i, 16))
+          return subtract_each_scalar(_in + i, _len - i, _thresholds + i, _out + i);
+
+        for(;i + 16 <= _len;i += 16){
+          const __m128i value = _mm_loadu_si128(reinterpret_cast<const __m128i*>(_in + i));
+          const __m128i threshold = _mm_loadu_si128(reinterpret_cast<const __m128i*>(_thresholds + i));
+          _mm_store_si128(reinterpret_cast<__m128i*>(_out + i), _mm_subs_epu8(value, threshold));
+        }
+
+        subtract_each_scalar(_in + i, _len - i, _thresholds + i, _out + i);
+      }
+
+      SQY_TARGET("sse2")
+      static void subtract_each_sse2(const std::uint16_t* _in, std::size_t _len, const std::uint16_t* _thresholds, std::uint16_t* _out){
+
+        std::size_t i = aligned_head(_out, _len, 16);
+        subtract_each_scalar(_in, i, _thresholds, _out);
+        if(!is_aligned(_out + i, 16))
+          return subtract_each_scalar(_in + i, _len - i, _thresholds + i, _out + i);
+
+        for(;i + 8 <= _len;i += 8){
+          const __m128i value = _mm_loadu_si128(reinterpret_cast<const __m128i*>(_in + i));
+          const __m128i threshold = _mm_loadu_si128(reinterpret_cast<const __m128i*>(_thresholds + i));
+          _mm_store_si128(reinterpret_cast<__m128i*>(_out + i), _mm_subs_epu16(value, threshold));
+        }
+
+        subtract_each_scalar(_in + i, _len - i, _thresholds + i, _out + i);
+      }
+
+      SQY_TARGET("avx2")
+      static void subtract_each_avx2(const std::uint8_t* _in, std::size_t _len, const std::uint8_t* _thresholds, std::uint8_t* _out){
+
+        std::size_t i = aligned_head(_out, _len, 32);
+        subtract_each_scalar(_in, i, _thresholds, _out);
+        if(!is_aligned(_out + i, 32))
+          return subtract_each_scalar(_in + i, _len - i, _thresholds + i, _out + i);
+
+        for(;i + 32 <= _len;i += 32){
+          const __m256i value = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(_in + i));
+          const __m256i threshold = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(_thresholds + i));
+          _mm256_store_si256(reinterpret_cast<__m256i*>(_out + i), _mm256_subs_epu8(value, threshold));
+        }
+
+        subtract_each_scalar(_in + i, _len - i, _thresholds + i, _out + i);
+      }
+
+      SQY_TARGET("avx2")
+      static void subtract_each_avx2(const std::uint16_t* _in, std::size_t _len, const std::uint16_t* _thresholds, std::uint16_t* _out){
+
+        std::size_t i = aligned_head(_out, _len, 32);
+        subtract_each_scalar(_in, i, _thresholds, _out);
+        if(!is_aligned(_out + i, 32))
+          return subtract_each_scalar(_in + i, _len - i, _thresholds + i, _out + i);
+
+        for(;i + 16 <= _len;i += 16){
+          const __m256i value = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(_in + i));
+          const __m256i threshold = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(_thresholds + i));
+          _mm256_store_si256(reinterpret_cast<__m256i*>(_out + i), _mm256_subs_epu16(value, threshold));
+        }
+
+        subtract_each_scalar(_in + i, _len - i, _thresholds + i, _out + i);
+      }
+
+      SQY_TARGET("avx512f,avx512bw")
+      static void subtract_each_avx512(const std::uint8_t* _in, std::size_t _len, const std::uint8_t* _thresholds, std::uint8_t* _out){
+
+        std::size_t i = aligned_head(_out, _len, 64);
+        subtract_each_scalar(_in, i, _thresholds, _out);
+        if(!is_aligned(_out + i, 64))
+          return subtract_each_scalar(_in + i, _len - i, _thresholds + i, _out + i);
+
+        for(;i + 64 <= _len;i += 64){
+          const __m512i value = _mm512_loadu_si512(reinterpret_cast<const void*>(_in + i));
+          const __m512i threshold = _mm512_loadu_si512(reinterpret_cast<const void*>(_thresholds + i));
+          _mm512_store_si512(reinterpret_cast<void*>(_out + i), _mm512_subs_epu8(value, threshold));
+        }
+
+        subtract_each_scalar(_in + i, _len - i, _thresholds + i, _out + i);
+      }
+
+      SQY_TARGET("avx512f,avx512bw")
+      static void subtract_each_avx512(const std::uint16_t* _in, std::size_t _len, const std::uint16_t* _thresholds, std::uint16_t* _out){
+
+        std::size_t i = aligned_head(_out, _len, 64);
+        subtract_each_scalar(_in, i, _thresholds, _out);
+        if(!is_aligned(_out + i, 64))
+          return subtract_each_scalar(_in + i, _len - i, _thresholds + i, _out + i);
+
+        for(;i + 32 <= _len;i += 32){
+          const __m512i value = _mm512_loadu_si512(reinterpret_cast<const void*>(_in + i));
+          const __m512i threshold = _mm512_loadu_si512(reinterpret_cast<const void*>(_thresholds + i));
+          _mm512_store_si512(reinterpret_cast<void*>(_out + i), _mm512_subs_epu16(value, threshold));
+        }
+
+        subtract_each_scalar(_in + i, _len - i, _thresholds + i, _out + i);
+      }
+
+#endif
+
+      template <typename value_t>
+      struct kernel {
+
+        typedef void (*type)(const value_t*, std::size_t, value_t, value_t*);
+        typedef void (*each_type)(const value_t*, std::size_t, const value_t*, value_t*);
+
+        //widest kernel the hardware supports, types without saturating instructions end up in subtract_scalar anyway
+        static type select(){
+
+#ifdef COMPASS_CT_ARCH_X86
+          return sqeazy::platform::widest_kernel<type>(subtract_scalar<value_t>,
+                                                      subtract_sse2,
+                                                      subtract_avx2,
+                                                      subtract_avx512);
+#else
+          return subtract_scalar<value_t>;
+#endif
+        }
+
+        static each_type select_each(){
+
+#ifdef COMPASS_CT_ARCH_X86
+          return sqeazy::platform::widest_kernel<each_type>(subtract_each_scalar<value_t>,
+                                                           subtract_each_sse2,
+                                                           subtract_each_avx2,
+                                                           subtract_each_avx512);
+#else
+          return subtract_each_scalar<value_t>;
+#endif
+        }
+      };
+
+      /**
+         \brief _out[i] = _in[i] - _threshold if _in[i] > _threshold, else 0, i.e. a saturating subtraction
+         for unsigned types; 8-bit and 16-bit unsigned items are processed by SSE2, AVX2 or AVX-512 kernels
+         if the hardware supports it
+
+         \param[in] _in input buffer
+         \param[in] _len number of elements in _in
+         \param[in] _threshold value to subtract
+         \param[out] _out output buffer of at least _len items, may be equal to _in
+         \param[in] _nthreads number of threads to use
+
+         \return pointer to _out + _len
+      */
+      template <typename value_t>
+      static value_t* subtract(const value_t* _in,
+                               std::size_t _len,
+                               value_t _threshold,
+                               value_t* _out,
+                               int _nthreads = 1){
+
+        const typename kernel<value_t>::type local_kernel = kernel<value_t>::select();
+
+        if(_nthreads == 1 || _len <= block_size){
+          local_kernel(_in, _len, _threshold, _out);
+          return _out + _len;
+        }
+
+        const omp_size_type n_blocks = (_len + block_size - 1)/block_size;
+        const std::size_t len = _len;
+
+#pragma omp parallel for                                \
+  shared(_out )                                         \
+  firstprivate( len, _in, _threshold, local_kernel )    \
+  num_threads(_nthreads)
+        for(omp_size_type b = 0;b<n_blocks;b++){
+          const std::size_t offset = b*block_size;
+          local_kernel(_in + offset, (std::min)(block_size, len - offset), _threshold, _out + offset);
+        }
+
+        return _out + _len;
+      }
+
+      /**
+         \brief _out[i] = _in[i] - _thresholds[i] if _in[i] > _thresholds[i], else 0, with the same kernels as subtract
+         but on a single thread (meant to be called for rows of a stack from a parallel region)
+
+         \return pointer to _out + _len
+      */
+      template <typename value_t>
+      static value_t* subtract_each(const value_t* _in,
+                                    std::size_t _len,
+                                    const value_t* _thresholds,
+                                    value_t* _out){
+
+        kernel<value_t>::select_each()(_in, _len, _thresholds, _out);
+
+        return _out + _len;
+      }
+
+      template <typename value_t>
+      static value_t* subtract_inplace(value_t* _data,
+                                       std::size_t _len,
+                                       value_t _threshold,
+                                       int _nthreads = 1){
+
+        return subtract(_data, _len, _threshold, _data, _nthreads);
+      }
+
+    };
+
+  };
+
+};
+
+#endif /* _SATURATING_SUBTRACT_UTILS_H_ */
@@ -79,6 +79,34 @@ namespace sqeazy {
       return (ones|destination)^((~source<<at)&ones);
     }
 
+    /**
+       \brief map the signed difference _diff (taken modulo the range of T) to an unsigned integer of the same
+       width, small magnitudes map to small values: 0, -1, 1, -2, 2 ... become 0, 1, 2, 3, 4 ...
+
+    */
+    template <typename T, typename diff_t>
+    typename sqeazy::add_unsigned<T>::type zigzag_encode(const diff_t& _diff)  {
+      typedef typename sqeazy::add_unsigned<T>::type type;
+      typedef typename sqeazy::remove_unsigned<type>::type signed_type;
+      static const unsigned num_bits = sizeof(type) * CHAR_BIT;
+
+      const signed_type value = signed_type(type(_diff));
+      return type(type(type(value) << 1) ^ type(value >> (num_bits - 1)));
+    }
+
+    /**
+       \brief inverse of zigzag_encode, returns the difference as the signed type of the same width
+
+    */
+    template <typename T>
+    typename sqeazy::remove_unsigned<typename sqeazy::add_unsigned<T>::type>::type zigzag_decode(const T& _in)  {
+      typedef typename sqeazy::add_unsigned<T>::type type;
+      typedef typename sqeazy::remove_unsigned<type>::type signed_type;
+
+      const type value = type(_in);
+      return signed_type(type(value >> 1) ^ type(-type(value & 1)));
+    }
+
 
   }
 
@@ -0,0 +1,348 @@
+#ifndef _TEMPORAL_DIFF_SCHEME_IMPL_H_
+#define _TEMPORAL_DIFF_SCHEME_IMPL_H_
+
+#include <sstream>
+#include <string>
+#include <functional>
+#include <numeric>
+#include <cstdint>
+#include <limits>
+
+#include "sqeazy_common.hpp"
+#include "traits.hpp"
+#include "dynamic_stage.hpp"
+#include "string_parsers.hpp"
+
+#include "temporal_diff_utils.hpp"
+
+namespace sqeazy {
+
+
+  /**
+* @brief difference of every timepoint of a series to a reference volume, zig-zag mapped: static samples leave
+* mostly small residuals; every <interval>-th timepoint of a <sequence> is a keyframe that is stored as is,
+* with reference=previous all others are predicted from the timepoint before them, with reference=keyframe
+* from the last keyframe
+*
+* the reference volumes are kept per sequence for the lifetime of the process, encoders and decoders keep
+* separate ones; the header records the timepoint and its keyframe, a timepoint can only be decoded once its
+* reference was decoded: all timepoints from the keyframe on (reference=previous) or the keyframe alone
+* (reference=keyframe)
+*
+* with brick=<n>, the reference is motion compensated: every brick of n^3 items is predicted from the reference
+* shifted by the integer vector that minimizes the sum of absolute differences within <search> items along y and x
+* and <search_z> items along z, the shifts are stored in the header
+*
+*/
+  template <typename in_type>
+  struct temporal_diff_scheme : public filter<in_type> {
+
+    typedef filter<in_type> base_type;
+    typedef in_type raw_type;
+    typedef in_type compressed_type;
+    typedef typename add_unsigned<raw_type>::type value_type;
+    typedef detail::temporal_registry<value_type> registry;
+
+    static_assert(std::is_integral<raw_type>::value==true,"[temporal_diff_scheme] input type is not integral");
+    static const std::string description() { return std::string("store zig-zag mapped difference to a reference timepoint of a series of stacks; <interval|default = 8> every interval-th timepoint is a keyframe stored as is (0: the first only), <reference|default = previous> predict from the previous timepoint or from the last keyframe, <sequence|default = default> name of the series, the reference is kept for the lifetime of the process and decoders need the timepoints from the keyframe on; <brick|default = 0> predict bricks of brick^3 items from the reference shifted by the integer vector with the smallest sum of absolute differences (0: no motion compensation), <search|default = 2> largest shift along y and x, <search_z|default = 0> largest shift along z"); };
+
+    std::int64_t interval;
+    bool from_previous;
+    std::string sequence;
+    detail::block_shift<value_type> motion;
+
+    //timepoint and its keyframe, set by encode and read from the header for decoding
+    std::int64_t frame;
+    std::int64_t keyframe;
+
+    temporal_diff_scheme(const std::string& _payload=""):
+      interval(8),
+      from_previous(true),
+      sequence("default"),
+      motion(),
+      frame(-1),
+      keyframe(-1)
+      {
+
+        pipeline_parser p;
+        auto config_map = p.minors(_payload.begin(),_payload.end());
+
+        if(config_map.size()){
+
+          auto f_itr = config_map.find("interval");
+          if(f_itr!=config_map.end())
+            interval = std::stoll(f_itr->second);
+
+          f_itr = config_map.find("reference");
+          if(f_itr!=config_map.end()){
+            if(f_itr->second == "keyframe")
+              from_previous = false;
+            else if(f_itr->second != "previous")
+              std::cerr << "[temporal_diff_scheme] reference=" << f_itr->second << " is not supported, expected previous or keyframe, using previous\n";
+          }
+
+          f_itr = config_map.find("sequence");
+          if(f_itr!=config_map.end() && !f_itr->second.empty())
+            sequence = f_itr->second;
+
+          f_itr = config_map.find("brick");
+          if(f_itr!=config_map.end())
+            motion.brick = std::stoul(f_itr->second);
+
+          f_itr = config_map.find("search");
+          if(f_itr!=config_map.end())
+            motion.radius[row_major::y] = motion.radius[row_major::x] = std::stoi(f_itr->second);
+
+          f_itr = config_map.find("search_z");
+          if(f_itr!=config_map.end())
+            motion.radius[row_major::z] = std::stoi(f_itr->second);
+
+          f_itr = config_map.find("shifts");
+          if(f_itr!=config_map.end() && !f_itr->second.empty()){
+            motion.shifts.resize(parsing::verbatim_yields_n_items_of<std::int8_t>(f_itr->second));
+            parsing::verbatim_to_range(f_itr->second, motion.shifts.begin(), motion.shifts.end());
+          }
+
+          f_itr = config_map.find("frame");
+          if(f_itr!=config_map.end())
+            frame = std::stoll(f_itr->second);
+
+          f_itr = config_map.find("keyframe");
+          if(f_itr!=config_map.end())
+            keyframe = std::stoll(f_itr->second);
+        }
+
+        if(interval < 0){
+          std::cerr << "[temporal_diff_scheme] interval=" << interval << " is not supported, expected a value >= 0, using 8\n";
+          interval = 8;
+        }
+
+        for(int& _radius : motion.radius){
+          if(_radius < 0 || _radius > (std::numeric_limits<std::int8_t>::max)()){
+            std::cerr << "[temporal_diff_scheme] search=" << _radius << " is not supported, expected a value in [0,127], using "
+                      << (_radius < 0 ? 0 : 127) << "\n";
+            _radius = _radius < 0 ? 0 : 127;
+          }
+        }
+      }
+
+    /**
+       \brief forget the reference volumes of _sequence, the next timepoint encoded is a keyframe again
+
+    */
+    static void reset(const std::string& _sequence = "default"){
+
+      registry::erase("encode:" + _sequence);
+      registry::erase("decode:" + _sequence);
+    }
+
+    std::string name() const override final {
+
+      return std::string("temporal_diff");
+
+    }
+
+    std::string config() const override final {
+
+      std::ostringstream msg;
+      msg << "interval=" << interval << ","
+          << "reference=" << (from_previous ? "previous" : "keyframe") << ","
+          << "sequence=" << sequence;
+
+      if(motion.enabled())
+        msg << ",brick=" << motion.brick
+            << ",search=" << motion.radius[row_major::x]
+            << ",search_z=" << motion.radius[row_major::z];
+
+      if(frame >= 0)
+        msg << ",frame=" << frame << ",keyframe=" << keyframe;
+
+      if(!motion.shifts.empty())
+        msg << ",shifts=" << parsing::range_to_verbatim(motion.shifts.begin(), motion.shifts.end());
+
+      return msg.str();
+
+    }
+
+    /**
+       \brief the payload keeps its size, but encode puts the timepoint and, with motion compensation, the shifts into
+       the header (see config): the bound includes the shifts of the most bricks a stack of _size_bytes can hold
+
+    */
+    std::intmax_t max_encoded_size(std::intmax_t _size_bytes) const override final {
+
+      //frame and keyframe with up to 20 digits each
+      std::intmax_t value = _size_bytes + std::string(",frame=,keyframe=").size() + 2*20;
+
+      if(motion.enabled()){
+        const std::size_t n_items = _size_bytes/sizeof(raw_type);
+        value += std::string(",shifts=").size() + parsing::verbatim_bytes_in_header(3*detail::max_bricks(n_items, motion.brick));
+      }
+
+      return value;
+    }
+
+    bool is_keyframe() const {
+      return frame >= 0 && frame == keyframe;
+    }
+
+    compressed_type* encode( const raw_type* _input, compressed_type* _output, std::size_t _input_size) override final {
+
+      return encode(_input, _output, std::vector<std::size_t>(1,_input_size));
+
+    }
+
+    compressed_type* encode( const raw_type* _input, compressed_type* _output, const std::vector<std::size_t>& _shape) override final {
+
+      const std::size_t length = std::accumulate(_shape.begin(), _shape.end(), 1, std::multiplies<std::size_t>());
+      const value_type* input = reinterpret_cast<const value_type*>(_input);
+      value_type* output = reinterpret_cast<value_type*>(_output);
+
+      auto reference = registry::get("encode:" + sequence);
+      std::lock_guard<std::mutex> lock(reference->mutex);
+
+      frame = reference->last_frame + 1;
+
+      const bool new_chain = reference->keyframe < 0 || reference->shape != _shape ||
+        (interval > 0 && frame - reference->keyframe >= interval);
+
+      if(new_chain){
+        reference->shape = _shape;
+        reference->values.assign(input, input + length);
+        reference->keyframe = frame;
+
+        motion.shifts.clear();
+
+        if(_input != _output)
+          std::copy(input, input + length, output);
+      }
+      else if(motion.enabled()){
+        motion.estimate(input, reference->values.data(), _shape, this->n_threads());
+
+        //the shifted reference is read until all residuals are written, the next one goes to the spare buffer
+        if(from_previous)
+          reference->spare.resize(length);
+
+        motion.residual(input, reference->values.data(), _shape,
+                        output,
+                        from_previous ? reference->spare.data() : nullptr,
+                        this->n_threads());
+
+        if(from_previous)
+          reference->values.swap(reference->spare);
+      }
+      else {
+        detail::temporal::residual(input, reference->values.data(), length,
+                                   output,
+                                   from_previous ? reference->values.data() : nullptr,
+                                   this->n_threads());
+      }
+
+      if(new_chain || from_previous)
+        reference->frame = frame;
+      reference->last_frame = frame;
+      keyframe = reference->keyframe;
+
+      return _output + length;
+
+    }
+
+    int decode( const compressed_type* _input,
+                raw_type* _output,
+                std::size_t _input_size,
+                std::size_t _output_size = 0) const override final {
+
+      return decode(_input, _output, std::vector<std::size_t>(1,_input_size), std::vector<std::size_t>());
+    }
+
+    int decode( const compressed_type* _input, raw_type* _output,
+                const std::vector<std::size_t>& _shape,
+                std::vector<std::size_t>) const override final {
+
+      const std::size_t length = std::accumulate(_shape.begin(), _shape.end(), 1, std::multiplies<std::size_t>());
+      const value_type* input = reinterpret_cast<const value_type*>(_input);
+      value_type* output = reinterpret_cast<value_type*>(_output);
+
+      if(frame < 0 || keyframe < 0 || keyframe > frame){
+        std::cerr << "[temporal_diff_scheme] the header does not name a valid timepoint (frame=" << frame
+                  << ", keyframe=" << keyframe << ")\n";
+        return FAILURE;
+      }
+
+      auto reference = registry::get("decode:" + sequence);
+      std::lock_guard<std::mutex> lock(reference->mutex);
+
+      if(is_keyframe()){
+        reference->shape = _shape;
+        reference->values.assign(input, input + length);
+        reference->keyframe = frame;
+        reference->frame = frame;
+        reference->last_frame = frame;
+
+        if(_input != _output)
+          std::copy(input, input + length, output);
+
+        return SUCCESS;
+      }
+
+      const std::int64_t expected = from_previous ? frame - 1 : keyframe;
+      if(reference->keyframe != keyframe || reference->frame != expected || reference->values.size() != length){
+        std::cerr << "[temporal_diff_scheme] timepoint " << frame << " of sequence " << sequence
+                  << " is predicted from timepoint " << expected << ", but ";
+        if(reference->frame < 0)
+          std::cerr << "no timepoint was decoded yet";
+        else
+          std::cerr << "timepoint " << reference->frame << " was decoded last";
+        std::cerr << "; decode the timepoints from keyframe " << keyframe << " on first\n";
+        return FAILURE;
+      }
+
+      if(motion.enabled()){
+
+        if(from_previous)
+          reference->spare.resize(length);
+
+        if(!motion.reconstruct(input, reference->values.data(), _shape,
+                               output,
+                               from_previous ? reference->spare.data() : nullptr,
+                               this->n_threads())){
+          std::cerr << "[temporal_diff_scheme] the header holds " << motion.shifts.size()/3 << " shifts, the stack has "
+                    << motion.layout_of(_shape).size() << " bricks\n";
+          return FAILURE;
+        }
+
+        if(from_previous)
+          reference->values.swap(reference->spare);
+      }
+      else
+        detail::temporal::reconstruct(input, reference->values.data(), length,
+                                      output,
+                                      from_previous ? reference->values.data() : nullptr,
+                                      this->n_threads());
+
+      if(from_previous)
+        reference->frame = frame;
+      reference->last_frame = frame;
+
+      return SUCCESS;
+    }
+
+    ~temporal_diff_scheme(){};
+
+    std::string output_type() const final override {
+
+      return sqeazy::header_utils::represent<compressed_type>::as_string();
+
+    }
+
+    bool is_compressor() const final override {
+
+      return base_type::is_compressor;
+
+    }
+
+  };
+
+}
+
+#endif /* _TEMPORAL_DIFF_SCHEME_IMPL_H_ */
@@ -0,0 +1,741 @@
+#ifndef _TEMPORAL_DIFF_UTILS_H_
+#define _TEMPORAL_DIFF_UTILS_H_
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstdlib>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "compass.hpp"
+#include "sqeazy_common.hpp"
+#include "traits.hpp"
+#include "scalar_utils.hpp"
+#include "brick_utils.hpp"
+
+#ifdef COMPASS_CT_ARCH_X86
+#include <immintrin.h>
+#endif
+
+namespace sqeazy {
+
+  namespace detail {
+
+    namespace temporal {
+
+      //number of elements every thread processes at once
+      static const std::size_t block_size = 1 << 15;
+
+      /**
+         \brief _out[i] = zigzag_encode(_in[i] - _prediction[i]) (scalar reference implementation)
+
+         \param[in] _in current timepoint
+         \param[in] _prediction values _in is predicted by
+         \param[in] _len number of elements in _in
+         \param[out] _out residuals, may be equal to _in
+         \param[out] _keep receives a copy of _in if not nullptr, may be equal to _prediction
+      */
+      template <typename value_t>
+      static void residual_scalar(const value_t* _in, const value_t* _prediction, std::size_t _len,
+                                  value_t* _out, value_t* _keep){
+
+        for(std::size_t i = 0;i<_len;++i){
+          const value_t value = _in[i];
+          _out[i] = zigzag_encode<value_t>(value_t(value - _prediction[i]));
+          if(_keep)
+            _keep[i] = value;
+        }
+      }
+
+      /**
+         \brief _out[i] = _prediction[i] + zigzag_decode(_residuals[i]) (scalar reference implementation)
+
+         \param[out] _keep receives a copy of _out if not nullptr, may be equal to _prediction
+      */
+      template <typename value_t>
+      static void reconstruct_scalar(const value_t* _residuals, const value_t* _prediction, std::size_t _len,
+                                     value_t* _out, value_t* _keep){
+
+        for(std::size_t i = 0;i<_len;++i){
+          const value_t value = value_t(_prediction[i] + value_t(zigzag_decode(_residuals[i])));
+          _out[i] = value;
+          if(_keep)
+            _keep[i] = value;
+        }
+      }
+
+      //fall-backs for types without vectorized kernels
+      template <typename value_t>
+      static void residual_sse2(const value_t* _in, const value_t* _prediction, std::size_t _len,
+                                value_t* _out, value_t* _keep){
+        residual_scalar(_in, _prediction, _len, _out, _keep);
+      }
+
+      template <typename value_t>
+      static void residual_avx2(const value_t* _in, const value_t* _prediction, std::size_t _len,
+                                value_t* _out, value_t* _keep){
+        residual_scalar(_in, _prediction, _len, _out, _keep);
+      }
+
+      template <typename value_t>
+      static void reconstruct_sse2(const value_t* _residuals, const value_t* _prediction, std::size_t _len,
+                                   value_t* _out, value_t* _keep){
+        reconstruct_scalar(_residuals, _prediction, _len, _out, _keep);
+      }
+
+      template <typename value_t>
+      static void reconstruct_avx2(const value_t* _residuals, const value_t* _prediction, std::size_t _len,
+                                   value_t* _out, value_t* _keep){
+        reconstruct_scalar(_residuals, _prediction, _len, _out, _keep);
+      }
+
+#ifdef COMPASS_CT_ARCH_X86
+
+      //the kernels below load the input and the prediction of a vector before they store to _out and _keep,
+      //so _out may equal the input and _keep may equal _prediction; the remainder is done by the scalar versions
+
+      SQY_TARGET("sse2")
+      static void residual_sse2(const std::uint8_t* _in, const std::uint8_t* _prediction, std::size_t _len,
+                                std::uint8_t* _out, std::uint8_t* _keep){
+
+        const __m128i zero = _mm_setzero_si128();
+        std::size_t i = 0;
+        for(;i + 16 <= _len;i += 16){
+          const __m128i value = _mm_loadu_si128(reinterpret_cast<const __m128i*>(_in + i));
+          const __m128i diff = _mm_sub_epi8(value, _mm_loadu_si128(reinterpret_cast<const __m128i*>(_prediction + i)));
+          const __m128i zz = _mm_xor_si128(_mm_add_epi8(diff, diff), _mm_cmpgt_epi8(zero, diff));
+          _mm_storeu_si128(reinterpret_cast<__m128i*>(_out + i), zz);
+          if(_keep)
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(_keep + i), value);
+        }
+
+        residual_scalar(_in + i, _prediction + i, _len - i, _out + i, _keep ? _keep + i : nullptr);
+      }
+
+      SQY_TARGET("sse2")
+      static void residual_sse2(const std::uint16_t* _in, const std::uint16_t* _prediction, std::size_t _len,
+                                std::uint16_t* _out, std::uint16_t* _keep){
+
+        std::size_t i = 0;
+        for(;i + 8 <= _len;i += 8){
+          const __m128i value = _mm_loadu_si128(reinterpret_cast<const __m128i*>(_in + i));
+          const __m128i diff = _mm_sub_epi16(value, _mm_loadu_si128(reinterpret_cast<const __m128i*>(_prediction + i)));
+          const __m128i zz = _mm_xor_si128(_mm_add_epi16(diff, diff), _mm_srai_epi16(diff, 15));
+          _mm_storeu_si128(reinterpret_cast<__m128i*>(_out + i), zz);
+          if(_keep)
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(_keep + i), value);
+        }
+
+        residual_scalar(_in + i, _prediction + i, _len - i, _out + i, _keep ? _keep + i : nullptr);
+      }
+
+      SQY_TARGET("avx2")
+      static void residual_avx2(const std::uint8_t* _in, const std::uint8_t* _prediction, std::size_t _len,
+                                std::uint8_t* _out, std::uint8_t* _keep){
+
+        const __m256i zero = _mm256_setzero_si256();
+        std::size_t i = 0;
+        for(;i + 32 <= _len;i += 32){
+          const __m256i value = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(_in + i));
+          const __m256i diff = _mm256_sub_epi8(value, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(_prediction + i)));
+          const __m256i zz = _mm256_xor_si256(_mm256_add_epi8(diff, diff), _mm256_cmpgt_epi8(zero, diff));
+          _mm256_storeu_si256(reinterpret_cast<__m256i*>(_out + i), zz);
+          if(_keep)
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(_keep + i), value);
+        }
+
+        residual_scalar(_in + i, _prediction + i, _len - i, _out + i, _keep ? _keep + i : nullptr);
+      }
+
+      SQY_TARGET("avx2")
+      static void residual_avx2(const std::uint16_t* _in, const std::uint16_t* _prediction, std::size_t _len,
+                                std::uint16_t* _out, std::uint16_t* _keep){
+
+        std::size_t i = 0;
+        for(;i + 16 <= _len;i += 16){
+          const __m256i value = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(_in + i));
+          const __m256i diff = _mm256_sub_epi16(value, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(_prediction + i)));
+          const __m256i zz = _mm256_xor_si256(_mm256_add_epi16(diff, diff), _mm256_srai_epi16(diff, 15));
+          _mm256_storeu_si256(reinterpret_cast<__m256i*>(_out + i), zz);
+          if(_keep)
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(_keep + i), value);
+        }
+
+        residual_scalar(_in + i, _prediction + i, _len - i, _out + i, _keep ? _keep + i : nullptr);
+      }
+
+      //zigzag_decode: (zz >> 1) ^ -(zz & 1), there is no 8-bit shift, the bit shifted in from the neighbor is masked
+      SQY_TARGET("sse2")
+      static void reconstruct_sse2(const std::uint8_t* _residuals, const std::uint8_t* _prediction, std::size_t _len,
+                                   std::uint8_t* _out, std::uint8_t* _keep){
+
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i one = _mm_set1_epi8(1);
+        const __m128i low_bits = _mm_set1_epi8(0x7f);
+        std::size_t i = 0;
+        for(;i + 16 <= _len;i += 16){
+          const __m128i zz = _mm_loadu_si128(reinterpret_cast<const __m128i*>(_residuals + i));
+          const __m128i diff = _mm_xor_si128(_mm_and_si128(_mm_srli_epi16(zz, 1), low_bits),
+                                             _mm_sub_epi8(zero, _mm_and_si128(zz, one)));
+          const __m128i value = _mm_add_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(_prediction + i)), diff);
+          _mm_storeu_si128(reinterpret_cast<__m128i*>(_out + i), value);
+          if(_keep)
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(_keep + i), value);
+        }
+
+        reconstruct_scalar(_residuals + i, _prediction + i, _len - i, _out + i, _keep ? _keep + i : nullptr);
+      }
+
+      SQY_TARGET("sse2")
+      static void reconstruct_sse2(const std::uint16_t* _residuals, const std::uint16_t* _prediction, std::size_t _len,
+                                   std::uint16_t* _out, std::uint16_t* _keep){
+
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i one = _mm_set1_epi16(1);
+        std::size_t i = 0;
+        for(;i + 8 <= _len;i += 8){
+          const __m128i zz = _mm_loadu_si128(reinterpret_cast<const __m128i*>(_residuals + i));
+          const __m128i diff = _mm_xor_si128(_mm_srli_epi16(zz, 1), _mm_sub_epi16(zero, _mm_and_si128(zz, one)));
+          const __m128i value = _mm_add_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(_prediction + i)), diff);
+          _mm_storeu_si128(reinterpret_cast<__m128i*>(_out + i), value);
+          if(_keep)
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(_keep + i), value);
+        }
+
+        reconstruct_scalar(_residuals + i, _prediction + i, _len - i, _out + i, _keep ? _keep + i : nullptr);
+      }
+
+      SQY_TARGET("avx2")
+      static void reconstruct_avx2(const std::uint8_t* _residuals, const std::uint8_t* _prediction, std::size_t _len,
+                                   std::uint8_t* _out, std::uint8_t* _keep){
+
+        const __m256i zero = _mm256_setzero_si256();
+        const __m256i one = _mm256_set1_epi8(1);
+        const __m256i low_bits = _mm256_set1_epi8(0x7f);
+        std::size_t i = 0;
+        for(;i + 32 <= _len;i += 32){
+          const __m256i zz = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(_residuals + i));
+          const __m256i diff = _mm256_xor_si256(_mm256_and_si256(_mm256_srli_epi16(zz, 1), low_bits),
+                                                _mm256_sub_epi8(zero, _mm256_and_si256(zz, one)));
+          const __m256i value = _mm256_add_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(_prediction + i)), diff);
+          _mm256_storeu_si256(reinterpret_cast<__m256i*>(_out + i), value);
+          if(_keep)
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(_keep + i), value);
+        }
+
+        reconstruct_scalar(_residuals + i, _prediction + i, _len - i, _out + i, _keep ? _keep + i : nullptr);
+      }
+
+      SQY_TARGET("avx2")
+      static void reconstruct_avx2(const std::uint16_t* _residuals, const std::uint16_t* _prediction, std::size_t _len,
+                                   std::uint16_t* _out, std::uint16_t* _keep){
+
+        const __m256i zero = _mm256_setzero_si256();
+        const __m256i one = _mm256_set1_epi16(1);
+        std::size_t i = 0;
+        for(;i + 16 <= _len;i += 16){
+          const __m256i zz = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(_residuals + i));
+          const __m256i diff = _mm256_xor_si256(_mm256_srli_epi16(zz, 1), _mm256_sub_epi16(zero, _mm256_and_si256(zz, one)));
+          const __m256i value = _mm256_add_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(_prediction + i)), diff);
+          _mm256_storeu_si256(reinterpret_cast<__m256i*>(_out + i), value);
+          if(_keep)
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(_keep + i), value);
+        }
+
+        reconstruct_scalar(_residuals + i, _prediction + i, _len - i, _out + i, _keep ? _keep + i : nullptr);
+      }
+
+#endif
+
+      template <typename value_t>
+      struct kernel {
+
+        typedef void (*type)(const value_t*, const value_t*, std::size_t, value_t*, value_t*);
+
+        //widest kernel the hardware supports, types without vectorized kernels end up in the scalar versions anyway
+        static type select_residual(){
+
+#ifdef COMPASS_CT_ARCH_X86
+          return sqeazy::platform::widest_kernel<type>(residual_scalar<value_t>, residual_sse2, residual_avx2);
+#else
+          return residual_scalar<value_t>;
+#endif
+        }
+
+        static type select_reconstruct(){
+
+#ifdef COMPASS_CT_ARCH_X86
+          return sqeazy::platform::widest_kernel<type>(reconstruct_scalar<value_t>, reconstruct_sse2, reconstruct_avx2);
+#else
+          return reconstruct_scalar<value_t>;
+#endif
+        }
+      };
+
+      template <typename value_t>
+      static value_t* apply(typename kernel<value_t>::type _kernel,
+                            const value_t* _in, const value_t* _prediction, std::size_t _len,
+                            value_t* _out, value_t* _keep, int _nthreads){
+
+        if(_nthreads == 1 || _len <= block_size){
+          _kernel(_in, _prediction, _len, _out, _keep);
+          return _out + _len;
+        }
+
+        const omp_size_type n_blocks = (_len + block_size - 1)/block_size;
+        const std::size_t len = _len;
+
+#pragma omp parallel for                                        \
+  shared(_out, _keep )                                          \
+  firstprivate( len, _in, _prediction, _kernel )                \
+  num_threads(_nthreads)
+        for(omp_size_type b = 0;b<n_blocks;b++){
+          const std::size_t offset = b*block_size;
+          _kernel(_in + offset, _prediction + offset, (std::min)(block_size, len - offset),
+                  _out + offset, _keep ? _keep + offset : nullptr);
+        }
+
+        return _out + _len;
+      }
+
+      /**
+         \brief zig-zag mapped differences of _in to _prediction in a single pass, _keep (if not nullptr)
+         receives a copy of _in in the same pass; 8-bit and 16-bit unsigned items are processed by SSE2 or
+         AVX2 kernels if the hardware supports it
+
+         \return pointer to _out + _len
+      */
+      template <typename value_t>
+      static value_t* residual(const value_t* _in, const value_t* _prediction, std::size_t _len,
+                               value_t* _out, value_t* _keep = nullptr, int _nthreads = 1){
+
+        return apply(kernel<value_t>::select_residual(), _in, _prediction, _len, _out, _keep, _nthreads);
+      }
+
+      /**
+         \brief inverse of residual, _keep (if not nullptr) receives a copy of the reconstructed items
+
+         \return pointer to _out + _len
+      */
+      template <typename value_t>
+      static value_t* reconstruct(const value_t* _residuals, const value_t* _prediction, std::size_t _len,
+                                  value_t* _out, value_t* _keep = nullptr, int _nthreads = 1){
+
+        return apply(kernel<value_t>::select_reconstruct(), _residuals, _prediction, _len, _out, _keep, _nthreads);
+      }
+
+      /**
+         \brief sum of absolute differences of _lhs and _rhs (scalar reference implementation)
+      */
+      template <typename value_t>
+      static std::uint64_t sad_scalar(const value_t* _lhs, const value_t* _rhs, std::size_t _len){
+
+        std::uint64_t value = 0;
+        for(std::size_t i = 0;i<_len;++i)
+          value += _lhs[i] > _rhs[i] ? _lhs[i] - _rhs[i] : _rhs[i] - _lhs[i];
+
+        return value;
+      }
+
+      template <typename value_t>
+      static std::uint64_t sad_sse2(const value_t* _lhs, const value_t* _rhs, std::size_t _len){
+        return sad_scalar(_lhs, _rhs, _len);
+      }
+
+      template <typename value_t>
+      static std::uint64_t sad_avx2(const value_t* _lhs, const value_t* _rhs, std::size_t _len){
+        return sad_scalar(_lhs, _rhs, _len);
+      }
+
+#ifdef COMPASS_CT_ARCH_X86
+
+      SQY_TARGET("sse2")
+      static std::uint64_t sad_sse2(const std::uint8_t* _lhs, const std::uint8_t* _rhs, std::size_t _len){
+
+        __m128i sum = _mm_setzero_si128();
+        std::size_t i = 0;
+        for(;i + 16 <= _len;i += 16)
+          sum = _mm_add_epi64(sum, _mm_sad_epu8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(_lhs + i)),
+                                                _mm_loadu_si128(reinterpret_cast<const __m128i*>(_rhs + i))));
+
+        std::uint64_t lanes[2];
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), sum);
+        return lanes[0] + lanes[1] + sad_scalar(_lhs + i, _rhs + i, _len - i);
+      }
+
+      //|a - b| of 16-bit items is the larger of the two saturating differences, it is summed in 32-bit lanes
+      //which are flushed before they can overflow
+      SQY_TARGET("sse2")
+      static std::uint64_t sad_sse2(const std::uint16_t* _lhs, const std::uint16_t* _rhs, std::size_t _len){
+
+        static const std::size_t flush_every = 1 << 14;
+        const __m128i zero = _mm_setzero_si128();
+        std::uint64_t value = 0;
+        std::size_t i = 0;
+
+        while(i + 8 <= _len){
+          __m128i sum = zero;
+          const std::size_t end = (std::min)(_len - (_len - i) % 8, i + 8*flush_every);
+          for(;i < end;i += 8){
+            const __m128i lhs = _mm_loadu_si128(reinterpret_cast<const __m128i*>(_lhs + i));
+            const __m128i rhs = _mm_loadu_si128(reinterpret_cast<const __m128i*>(_rhs + i));
+            const __m128i diff = _mm_or_si128(_mm_subs_epu16(lhs, rhs), _mm_subs_epu16(rhs, lhs));
+            sum = _mm_add_epi32(sum, _mm_add_epi32(_mm_unpacklo_epi16(diff, zero), _mm_unpackhi_epi16(diff, zero)));
+          }
+
+          std::uint32_t lanes[4];
+          _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), sum);
+          value += std::uint64_t(lanes[0]) + lanes[1] + lanes[2] + lanes[3];
+        }
+
+        return value + sad_scalar(_lhs + i, _rhs + i, _len - i);
+      }
+
+      SQY_TARGET("avx2")
+      static std::uint64_t sad_avx2(const std::uint8_t* _lhs, const std::uint8_t* _rhs, std::size_t _len){
+
+        __m256i sum = _mm256_setzero_si256();
+        std::size_t i = 0;
+        for(;i + 32 <= _len;i += 32)
+          sum = _mm256_add_epi64(sum, _mm256_sad_epu8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(_lhs + i)),
+                                                      _mm256_loadu_si256(reinterpret_cast<const __m256i*>(_rhs + i))));
+
+        std::uint64_t lanes[4];
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), sum);
+        return lanes[0] + lanes[1] + lanes[2] + lanes[3] + sad_scalar(_lhs + i, _rhs + i, _len - i);
+      }
+
+      SQY_TARGET("avx2")
+      static std::uint64_t sad_avx2(const std::uint16_t* _lhs, const std::uint16_t* _rhs, std::size_t _len){
+
+        static const std::size_t flush_every = 1 << 14;
+        const __m256i zero = _mm256_setzero_si256();
+        std::uint64_t value = 0;
+        std::size_t i = 0;
+
+        while(i + 16 <= _len){
+          __m256i sum = zero;
+          const std::size_t end = (std::min)(_len - (_len - i) % 16, i + 16*flush_every);
+          for(;i < end;i += 16){
+            const __m256i lhs = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(_lhs + i));
+            const __m256i rhs = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(_rhs + i));
+            const __m256i diff = _mm256_or_si256(_mm256_subs_epu16(lhs, rhs), _mm256_subs_epu16(rhs, lhs));
+            sum = _mm256_add_epi32(sum, _mm256_add_epi32(_mm256_unpacklo_epi16(diff, zero), _mm256_unpackhi_epi16(diff, zero)));
+          }
+
+          std::uint32_t lanes[8];
+          _mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), sum);
+          for(int l = 0;l<8;++l)
+            value += lanes[l];
+        }
+
+        return value + sad_scalar(_lhs + i, _rhs + i, _len - i);
+      }
+
+#endif
+
+      template <typename value_t>
+      struct sad_kernel {
+
+        typedef std::uint64_t (*type)(const value_t*, const value_t*, std::size_t);
+
+        static type select(){
+
+#ifdef COMPASS_CT_ARCH_X86
+          return sqeazy::platform::widest_kernel<type>(sad_scalar<value_t>, sad_sse2, sad_avx2);
+#else
+          return sad_scalar<value_t>;
+#endif
+        }
+      };
+
+      /**
+         \brief sum of absolute differences of _lhs and _rhs; 8-bit and 16-bit unsigned items are processed
+         by SSE2 or AVX2 kernels if the hardware supports it
+      */
+      template <typename value_t>
+      static std::uint64_t sad(const value_t* _lhs, const value_t* _rhs, std::size_t _len){
+
+        return sad_kernel<value_t>::select()(_lhs, _rhs, _len);
+      }
+
+    };
+
+    /**
+       \brief the reference volume of a sequence of timepoints, as seen by an encoder or a decoder
+
+    */
+    template <typename value_t>
+    struct temporal_reference {
+
+      std::mutex mutex;
+      std::vector<std::size_t> shape;
+      std::vector<value_t> values;
+
+      //receives the next reference while values is still read from (motion compensation)
+      std::vector<value_t> spare;
+
+      //timepoint held in values, the keyframe of the current chain and the timepoint processed last (-1: none)
+      std::int64_t frame = -1;
+      std::int64_t keyframe = -1;
+      std::int64_t last_frame = -1;
+
+      void clear(){
+        shape.clear();
+        values.clear();
+        spare.clear();
+        frame = keyframe = last_frame = -1;
+      }
+    };
+
+    /**
+       \brief process wide store of the reference volumes by sequence name, pipelines are rebuilt from every
+       header they decode, so a timepoint can only be restored from the state an earlier buffer left behind
+
+    */
+    template <typename value_t>
+    struct temporal_registry {
+
+      typedef std::shared_ptr<temporal_reference<value_t> > reference_ptr;
+
+      static reference_ptr get(const std::string& _key){
+        std::lock_guard<std::mutex> lock(mutex());
+        reference_ptr& value = references()[_key];
+        if(!value)
+          value = std::make_shared<temporal_reference<value_t> >();
+        return value;
+      }
+
+      static void erase(const std::string& _key){
+        std::lock_guard<std::mutex> lock(mutex());
+        references().erase(_key);
+      }
+
+    private:
+
+      static std::mutex& mutex(){
+        static std::mutex value;
+        return value;
+      }
+
+      static std::map<std::string, reference_ptr>& references(){
+        static std::map<std::string, reference_ptr> value;
+        return value;
+      }
+    };
+
+    /**
+       \brief motion compensation of a stack against a reference stack: both are split into bricks, every brick
+       is predicted from the reference shifted by an integer vector that is found by minimizing the sum of absolute
+       differences inside a search window
+
+       shifts only point to positions at which the shifted brick is inside the stack, stacks of rank other
+       than 3 are treated as 3D stacks (leading axes are folded into z)
+
+    */
+    template <typename value_t>
+    struct block_shift {
+
+      //extent of a brick along every axis, 0 disables motion compensation
+      std::size_t brick;
+
+      //largest shift that is searched along z, y and x
+      std::array<int, 3> radius;
+
+      //shift of every brick in z,y,x order, bricks in row-major order of the brick grid
+      std::vector<std::int8_t> shifts;
+
+      block_shift(std::size_t _brick = 0, int _radius = 2, int _radius_z = 0):
+        brick(_brick),
+        radius({{_radius_z, _radius, _radius}}),
+        shifts()
+      {}
+
+      bool enabled() const {
+        return brick > 0;
+      }
+
+      static std::vector<std::size_t> as_3d(const std::vector<std::size_t>& _shape){
+
+        std::vector<std::size_t> value(3,1);
+        const std::size_t n = (std::min)(_shape.size(), std::size_t(3));
+        std::copy(_shape.end() - n, _shape.end(), value.end() - n);
+        for(std::size_t d = 0;d + 3<_shape.size();++d)
+          value[0] *= _shape[d];
+        return value;
+      }
+
+      brick_layout layout_of(const std::vector<std::size_t>& _shape) const {
+        return brick_layout(as_3d(_shape), std::vector<std::size_t>(3, brick));
+      }
+
+      /**
+         \brief candidate shifts sorted by their L1 norm, so that among shifts of equal cost the smallest is kept
+
+      */
+      std::vector<std::array<int, 3> > candidates() const {
+
+        std::vector<std::array<int, 3> > value;
+        for(int z = -radius[0];z<=radius[0];++z)
+          for(int y = -radius[1];y<=radius[1];++y)
+            for(int x = -radius[2];x<=radius[2];++x)
+              value.push_back({{z, y, x}});
+
+        std::stable_sort(value.begin(), value.end(),
+                         [](const std::array<int, 3>& _lhs, const std::array<int, 3>& _rhs){
+                           return std::abs(_lhs[0]) + std::abs(_lhs[1]) + std::abs(_lhs[2]) <
+                             std::abs(_rhs[0]) + std::abs(_rhs[1]) + std::abs(_rhs[2]);
+                         });
+
+        return value;
+      }
+
+      /**
+         \brief signed distance from a voxel of brick _id to the reference voxel it is predicted from,
+         0 if the shift of the brick would leave the stack
+
+      */
+      std::ptrdiff_t shift_offset(const brick_layout& _layout, std::size_t _id, const int* _shift) const {
+
+        const std::size_t offset = _layout.offset(_id);
+        const std::size_t first[3] = {offset/(_layout.shape[1]*_layout.shape[2]),
+                                      (offset/_layout.shape[2]) % _layout.shape[1],
+                                      offset % _layout.shape[2]};
+
+        std::ptrdiff_t value = 0;
+        std::ptrdiff_t stride = 1;
+        for(int d = 2;d>=0;--d){
+          const std::ptrdiff_t begin = std::ptrdiff_t(first[d]) + _shift[d];
+          if(begin < 0 || begin + std::ptrdiff_t(_layout.extent(_id, d)) > std::ptrdiff_t(_layout.shape[d]))
+            return 0;
+          value += _shift[d]*stride;
+          stride *= _layout.shape[d];
+        }
+
+        return value;
+      }
+
+      /**
+         \brief find the shift of every brick of _input against _reference, bricks are distributed among _nthreads threads
+
+         the search stops to sum the absolute differences of a candidate once they exceed the best one found so far
+
+      */
+      void estimate(const value_t* _input,
+                    const value_t* _reference,
+                    const std::vector<std::size_t>& _shape,
+                    int _nthreads = 1){
+
+        const brick_layout layout = layout_of(_shape);
+        const std::vector<std::array<int, 3> > shift_candidates = candidates();
+        const omp_size_type n_bricks = layout.size();
+
+        shifts.assign(3*n_bricks, 0);
+        std::int8_t* shifts_begin = shifts.data();
+
+#pragma omp parallel for                                \
+  shared(shifts_begin)                                  \
+  firstprivate(_input, _reference)                      \
+  schedule(dynamic)                                     \
+  num_threads(_nthreads)
+        for(omp_size_type b = 0;b<n_bricks;++b){
+
+          std::uint64_t best = ~std::uint64_t(0);
+          for(const std::array<int, 3>& candidate : shift_candidates){
+
+            const bool is_zero = !candidate[0] && !candidate[1] && !candidate[2];
+            const std::ptrdiff_t distance = shift_offset(layout, b, candidate.data());
+            if(!is_zero && !distance)
+              continue;
+
+            std::uint64_t cost = 0;
+            layout.for_each_row(b, [&](std::size_t _offset, std::size_t _len){
+                if(cost < best)
+                  cost += temporal::sad(_input + _offset, _reference + _offset + distance, _len);
+              });
+
+            if(cost < best){
+              best = cost;
+              std::copy(candidate.begin(), candidate.end(), shifts_begin + 3*b);
+            }
+          }
+        }
+      }
+
+      /**
+         \brief call _kernel(offset, distance, length) for every row of every brick, distance is the signed offset
+         to the row of the reference it is predicted from; bricks are distributed among _nthreads threads
+
+         \return false if shifts does not hold a shift for every brick of _shape
+      */
+      template <typename functor_t>
+      bool for_each_row(const std::vector<std::size_t>& _shape,
+                        functor_t&& _kernel,
+                        int _nthreads = 1) const {
+
+        const brick_layout layout = layout_of(_shape);
+        const omp_size_type n_bricks = layout.size();
+        if(shifts.size() != 3*std::size_t(n_bricks))
+          return false;
+
+#pragma omp parallel for                        \
+  shared(_kernel)                               \
+  num_threads(_nthreads)
+        for(omp_size_type b = 0;b<n_bricks;++b){
+
+          const int shift[3] = {shifts[3*b], shifts[3*b+1], shifts[3*b+2]};
+          const std::ptrdiff_t distance = shift_offset(layout, b, shift);
+
+          layout.for_each_row(b, [&](std::size_t _offset, std::size_t _len){
+              _kernel(_offset, distance, _len);
+            });
+        }
+
+        return true;
+      }
+
+      /**
+         \brief residuals of _input to the shifted _reference, _keep (if not nullptr) receives a copy of _input and must
+         not overlap _reference
+
+      */
+      bool residual(const value_t* _input,
+                    const value_t* _reference,
+                    const std::vector<std::size_t>& _shape,
+                    value_t* _output,
+                    value_t* _keep,
+                    int _nthreads = 1) const {
+
+        return for_each_row(_shape, [=](std::size_t _offset, std::ptrdiff_t _distance, std::size_t _len){
+            temporal::residual(_input + _offset, _reference + _offset + _distance, _len,
+                               _output + _offset, _keep ? _keep + _offset : nullptr);
+          }, _nthreads);
+      }
+
+      /**
+         \brief inverse of residual, _keep (if not nullptr) receives a copy of _output and must not overlap _reference
+
+      */
+      bool reconstruct(const value_t* _residuals,
+                       const value_t* _reference,
+                       const std::vector<std::size_t>& _shape,
+                       value_t* _output,
+                       value_t* _keep,
+                       int _nthreads = 1) const {
+
+        return for_each_row(_shape, [=](std::size_t _offset, std::ptrdiff_t _distance, std::size_t _len){
+            temporal::reconstruct(_residuals + _offset, _reference + _offset + _distance, _len,
+                                  _output + _offset, _keep ? _keep + _offset : nullptr);
+          }, _nthreads);
+      }
+    };
+
+  };
+
+};
+
+#endif /* _TEMPORAL_DIFF_UTILS_H_ */
@@ -10,6 +10,7 @@
 #include "string_parsers.hpp"
 
 #include "tile_shuffle_utils.hpp"
+#include "bitswap_scheme_impl.hpp"
 
 namespace sqeazy {
 
@@ -92,6 +93,46 @@ namespace sqeazy {
       return value;
     }
 
+    /**
+       \brief tile_shuffle followed by bitswap1 is done in one pass without writing the shuffled stack:
+       blocks of the shuffled stream are gathered into a thread-local buffer and their bitplanes
+       are written to the final position right away, the output is identical to running both stages
+
+       \return
+       \retval nullptr if _next is not a bitswap1 stage
+
+    */
+    compressed_type* encode_fused(const base_type& _next,
+                                  const raw_type* _input,
+                                  compressed_type* _output,
+                                  const std::vector<std::size_t>& _shape) override final {
+
+      typedef bitswap_scheme<raw_type,1> bitswap1_t;
+
+      const bitswap1_t* bitswap = dynamic_cast<const bitswap1_t*>(&_next);
+      if(!bitswap || _shape.size()!=3)
+        return nullptr;
+
+      //blocks of 16 kB fit into L1
+      static const std::size_t block_size = (std::max<std::size_t>)(bitswap1_t::block_alignment(),
+                                                                    (std::size_t(1) << 14)/sizeof(raw_type));
+
+      const std::size_t length = std::accumulate(_shape.begin(), _shape.end(), 1, std::multiplies<std::size_t>());
+
+      detail::tile_shuffle tiles_of(tile_size);
+      tiles_of.sort_tiles(_input, _shape, this->n_threads());
+
+      tiles_of.for_each_block_of_stream(_input, _shape, block_size,
+                                        [=](const raw_type* _block, std::size_t _offset, std::size_t _n){
+                                          bitswap->encode_block(_block, _offset, _n, _output, length);
+                                        },
+                                        this->n_threads());
+
+      serialized_reorder_map = parsing::range_to_verbatim(tiles_of.decode_map.begin(), tiles_of.decode_map.end());
+
+      return _output + length;
+    }
+
     int decode( const compressed_type* _input,
 		raw_type* _output,
 		const std::vector<std::size_t>& _ishape,
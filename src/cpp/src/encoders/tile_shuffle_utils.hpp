@@ -3,10 +3,13 @@
 
 #include <cstdint>
 #include <iterator>
+#include <algorithm>
 #include <boost/accumulators/accumulators.hpp>
 #include <boost/accumulators/statistics.hpp>
 #include "traits.hpp"
+#include "sqeazy_common.hpp"
 #include "sqeazy_algorithms.hpp"
+#include "brick_utils.hpp"
 
 namespace sqeazy {
 
@@ -44,8 +47,6 @@ namespace sqeazy {
 	   *  the input is rearranged so that small-median tiles are at the beginning of the output array
 	   *  large-median tiles are at the end of the output array
 	   *
-	   *  TODO: parallelize the sort if the compression ratio is enhanced
-	   *
 	   *  \param param
 	   *  \return return type
 	   */
@@ -62,9 +63,6 @@ namespace sqeazy {
 		typedef typename std::iterator_traits<out_iterator_t>::value_type out_value_type;
 		typedef typename std::remove_cv<out_value_type>::type out_value_t;
 
-		typedef typename std::iterator_traits<decltype(_shape.begin())>::value_type shape_value_type;
-		typedef typename std::remove_cv<shape_value_type>::type shape_value_t;
-
 		static_assert(sizeof(in_value_t) == sizeof(out_value_t), "[sqeazy::detail::tile_shuffle::encode] tile_shuffle received non-matching types");
 
 		if(_shape.size()!=3){
@@ -81,314 +79,177 @@ namespace sqeazy {
 		  return _out;
 		}
 
-		const shape_container_t rem = remainder(_shape);
-		const bool has_remainder = std::count_if(rem.begin(), rem.end(), [](shape_value_t el){ return el > 0;});
+		sort_tiles(_begin, _shape, _nthreads);
 
-		if(has_remainder)
-		  return encode_with_remainder(_begin,_end,_out,_shape,_nthreads);
-		else{
-		  return encode_full(_begin,_end,_out,_shape,_nthreads);
-		}
+		// every tile is copied exactly once from the input to its position in the sorted output,
+		// tiles at the upper border are cut to the stack and stored without padding
+		return gather_bricks(_begin, _out, tiles_of(_shape), decode_map, _nthreads);
 
 	  }
 
 	  /**
-		 \brief implementation where the input stack is assumed to yield only full tiles
+		 \brief partition of _shape into tiles of tile_size^3, tiles at the upper border may be cut
 
-		 \param[in]
+	  */
+	  template <typename shape_container_t>
+	  brick_layout tiles_of(const shape_container_t& _shape) const {
+		return brick_layout(_shape, std::vector<std::size_t>(_shape.size(), tile_size));
+	  }
 
-		 \return
-		 \retval
+	  /**
+		 \brief compute the metric of every tile in the stack and fill decode_map with the tile order of the shuffled stream
+
+		 full tiles are ranked by their mean, stacks with cut tiles at the upper border by the median of the voxels
+		 inside the stack; tiles with equal metric keep their order
 
 	  */
-	  template <typename in_iterator_t, typename out_iterator_t, typename shape_container_t>
-	  out_iterator_t encode_full(in_iterator_t _begin,
-								 in_iterator_t _end,
-								 out_iterator_t _out,
-								 const shape_container_t& _shape,
-								 int _nthreads = 1 ) {
+	  template <typename in_iterator_t, typename shape_container_t>
+	  void sort_tiles(in_iterator_t _begin,
+					  const shape_container_t& _shape,
+					  int _nthreads = 1 ) {
 
 		typedef typename std::iterator_traits<in_iterator_t>::value_type in_value_type;
 		typedef typename std::remove_cv<in_value_type>::type in_value_t;
 
 		typedef typename std::iterator_traits<decltype(_shape.begin())>::value_type shape_value_type;
 		typedef typename std::remove_cv<shape_value_type>::type shape_value_t;
+		typedef typename bacc::accumulator_set<in_value_t,
+											   bacc::stats<bacc::tag::median>
+											   > median_acc_t ;
 
 		const shape_container_t rem = remainder(_shape);
-		const std::size_t n_elements          = std::distance(_begin,_end);
-		const std::size_t n_elements_per_tile = std::pow(tile_size,_shape.size());
-		const std::size_t n_elements_per_tile_frame = std::pow(tile_size,_shape.size()-1);
-
-		shape_container_t n_full_tiles = _shape;
-
-		for(shape_value_t & n_tiles : n_full_tiles )
-		  n_tiles = n_tiles / tile_size;
-
-		const shape_value_t len_tiles = std::accumulate(n_full_tiles.begin(), n_full_tiles.end(),1,std::multiplies<shape_value_t>());
+		const bool has_remainder = std::count_if(rem.begin(), rem.end(), [](shape_value_t el){ return el > 0;});
 
-		// COLLECT TILE CONTENT /////////////////////////////////////////////////////////////////////////////////////////////////////
+		const std::size_t n_elements_per_tile = std::pow(tile_size,_shape.size());
+		const brick_layout tiles = tiles_of(_shape);
+		const omp_size_type len_tiles = tiles.size();
 
-		std::vector< std::vector<in_value_t> > tiles(len_tiles, std::vector<in_value_t>(n_elements_per_tile,0) );
-		auto ptiles = tiles.data();
-		auto pshape = _shape.data();
-		auto pn_full_tiles = n_full_tiles.data();
+		std::vector<in_value_t> metric(len_tiles,0.);
+		auto pmetric = metric.data();
+		const brick_layout* ptiles = &tiles;
 
+		if(!has_remainder){
+		  // use arithmetic mean for now, only the sum would do as well as this should only be an indicator for the signal activity inside the tile here
 #pragma omp parallel for												\
-  shared( _begin, ptiles)												\
-  firstprivate(pshape, pn_full_tiles)													\
+  shared( pmetric)														\
+  firstprivate(_begin, ptiles)											\
   num_threads(_nthreads)
-		for(omp_size_type z = 0;z<(omp_size_type)pshape[row_major::z];++z){
-		  std::size_t ztile = z / tile_size;
-		  std::size_t z_intile = z % tile_size;
-
-		  for(omp_size_type y = 0;y<(omp_size_type)pshape[row_major::y];++y){
-			std::size_t ytile = y / tile_size;
-			std::size_t y_intile = y % tile_size;
-
-			std::size_t linear_tile_id = ztile*pn_full_tiles[sqeazy::row_major::y]*pn_full_tiles[sqeazy::row_major::x]
-			  + ytile*pn_full_tiles[sqeazy::row_major::x]
-			  ;
-
-			auto acc_iter = _begin + z*pshape[row_major::y]*pshape[row_major::x] + y*pshape[row_major::x];
-
-			for(omp_size_type x = 0;x<(omp_size_type)pshape[row_major::x];x+=tile_size,++linear_tile_id,acc_iter+=tile_size){
-			  // xtile = x / tile_size;
-
-			  auto tiles_iter = tiles[linear_tile_id].begin();
+		  for(omp_size_type i = 0;i<len_tiles;++i){
 
-			  std::copy(acc_iter, acc_iter + tile_size,
-						tiles_iter + (z_intile*n_elements_per_tile_frame) + y_intile*tile_size);
+			float sum = 0;
+			ptiles->for_each_row(i,
+								 [&](std::size_t _offset, std::size_t _len){
+								   sum = std::accumulate(_begin + _offset, _begin + _offset + _len, sum, std::plus<float>());
+								 });
 
-
-			}
+			pmetric[i] = sum / n_elements_per_tile;
 		  }
 		}
-
-		// COLLECT STATISTICS /////////////////////////////////////////////////////////////////////////////////////////////////////
-		// use arithmetic mean for now, only the sum would do as well as this should only be an indicator for the signal activity inside the tile here
-
-		std::vector<in_value_t> metric(len_tiles,0.);
-		auto pmetric = metric.data();
-
+		else{
+		  // median plus stddev around median or take 75% quantile directly
 #pragma omp parallel for												\
   shared( pmetric)														\
-  firstprivate(ptiles)													\
+  firstprivate(_begin, ptiles)											\
   num_threads(_nthreads)
-		for(omp_size_type i = 0;i<(omp_size_type)len_tiles;++i){
+		  for(omp_size_type i = 0;i<len_tiles;++i){
+			median_acc_t acc;
 
+			ptiles->for_each_row(i,
+								 [&](std::size_t _offset, std::size_t _len){
+								   for(auto itr = _begin + _offset;itr!=(_begin + _offset + _len);++itr)
+									 acc(*itr);
+								 });
 
-		  float sum = std::accumulate(ptiles[i].cbegin(),
-									  ptiles[i].cend(),
-									  float(0),
-									  std::plus<float>());
-
-		  pmetric[i] = sum / n_elements_per_tile;
+			pmetric[i] = std::round(bacc::median(acc));
+		  }
 		}
 
-		// PERFORM SHUFFLE /////////////////////////////////////////////////////////////////////////////////////////////////////
+		// decode_map[i] is the original index of the tile written to position i
 		decode_map.resize(len_tiles);
-
-		auto sorted_metric = metric;
-		std::sort(sorted_metric.begin(), sorted_metric.end());
-
-		// WRITE TILES 2 OUTPUT ////////////////////////////////////////////////////////////////////////////////////////////////
-		// auto dst = _out;
-		auto pdecode_map = decode_map.data();
-		auto psorted_metric = sorted_metric.data();
-#pragma omp parallel for						\
-  shared( pdecode_map, _out)					\
-  firstprivate(ptiles,pmetric, psorted_metric)					\
-  num_threads(_nthreads)
-		for(omp_size_type i =0;i<(omp_size_type)metric.size();++i){
-		  auto original_index = std::find(pmetric, pmetric + len_tiles, psorted_metric[i]) - pmetric;
-
-		  pdecode_map[i] = original_index;
-		  std::copy(ptiles[original_index].begin(), ptiles[original_index].end(),
-					_out + i*n_elements_per_tile);
-		}
-
-
-		return _out + n_elements;
-
+		sqeazy::argsort(metric.begin(), metric.end(), decode_map.begin(), _nthreads);
 	  }
 
-
 	  /**
-		 \brief encode with the stack dimensions not fitting the tile shape in any way
+		 \brief call _functor(block, offset, length) for consecutive blocks of the shuffled stream without materializing it
 
-		 \param[in]
+		 decode_map must have been filled by sort_tiles; every block of at most _block_size items is gathered from the
+		 input stack into a buffer local to the calling thread, offset is the position of the block's first item
+		 in the shuffled stream; _block_size is expected to be a multiple of 16 items as the buffer is 32-byte aligned
 
 		 \return
 		 \retval
 
 	  */
-	  template <typename in_iterator_t, typename out_iterator_t, typename shape_container_t>
-	  out_iterator_t encode_with_remainder(in_iterator_t _begin,
-										   in_iterator_t _end,
-										   out_iterator_t _out,
-										   const shape_container_t& _shape,
-										   int _nthreads = 1)  {
-
+	  template <typename in_iterator_t, typename shape_container_t, typename functor_t>
+	  void for_each_block_of_stream(in_iterator_t _begin,
+									const shape_container_t& _shape,
+									std::size_t _block_size,
+									functor_t&& _functor,
+									int _nthreads = 1) const {
 
 		typedef typename std::iterator_traits<in_iterator_t>::value_type in_value_type;
 		typedef typename std::remove_cv<in_value_type>::type in_value_t;
 
-		typedef typename std::iterator_traits<decltype(_shape.begin())>::value_type shape_value_type;
-		typedef typename std::remove_cv<shape_value_type>::type shape_value_t;
-		typedef typename bacc::accumulator_set<in_value_t,
-											   bacc::stats<bacc::tag::median>
-											   > median_acc_t ;
-		// 75% quantile?
-		// typedef typename boost::accumulators::accumulator_set<double, stats<boost::accumulators::tag::pot_quantile<boost::right>(.75)> > quantile_acc_t;
-
-		const shape_container_t rem = remainder(_shape);
-		const std::size_t n_elements_per_tile = std::pow(tile_size,_shape.size());
-		// const std::size_t n_elements_per_tile_frame = std::pow(tile_size,_shape.size()-1);
-
-		shape_container_t n_full_tiles = _shape;
-
-		for(shape_value_t & tile_dim : n_full_tiles )
-		  tile_dim = tile_dim / tile_size;
+		const brick_layout tiles = tiles_of(_shape);
+		const std::size_t x_axis = tiles.rank() - 1;
 
-		shape_container_t n_tiles = n_full_tiles;
-		for(int i =0;i<(int)rem.size();++i)
-		  n_tiles[i] += rem[i] ? 1 : 0;
-
-		const shape_value_t len_tiles = std::accumulate(n_tiles.begin(), n_tiles.end(),1,std::multiplies<shape_value_t>());
-
-		// SETUP TILE CONTENT /////////////////////////////////////////////////////////////////////////////////////////////////////
-
-		std::vector< std::vector<in_value_t> > tiles(len_tiles, std::vector<in_value_t>(n_elements_per_tile,0));
-		auto ptiles = tiles.data();
-		auto pshape = _shape.data();
-		auto pn_tiles = n_tiles.data();
-
-		// COLLECT TILE CONTENT /////////////////////////////////////////////////////////////////////////////////////////////////////
-#pragma omp parallel for												\
-  shared( ptiles )														\
-  firstprivate(pshape, _begin,pn_tiles)									\
-  num_threads(_nthreads)
-		for(omp_size_type z = 0;z<(omp_size_type)pshape[row_major::z];++z){
-		  std::size_t ztile = z / tile_size;
-		  std::size_t z_intile = z % tile_size;
-		  std::size_t ztile_shape = (ztile+1)*tile_size > pshape[row_major::z] ? (pshape[row_major::z]-(ztile*tile_size)) : tile_size;
-
-		  for(omp_size_type y = 0;y<(omp_size_type)pshape[row_major::y];++y){
-			std::size_t ytile = y / tile_size;
-			std::size_t y_intile = y % tile_size;
-			std::size_t ytile_shape = (ytile+1)*tile_size > pshape[row_major::y] ? (pshape[row_major::y]-(ytile*tile_size)) : tile_size;
-			std::size_t tile_id = ztile*pn_tiles[sqeazy::row_major::y]*pn_tiles[sqeazy::row_major::x]
-			  + ytile*pn_tiles[sqeazy::row_major::x]
-			  ;
-
-			auto acc_iter = _begin + z*pshape[row_major::y]*pshape[row_major::x] + y*pshape[row_major::x];
-
-			for(omp_size_type x = 0;x<(omp_size_type)pshape[row_major::x];x+=tile_size, ++tile_id){
-			  std::size_t xtile = x / tile_size;
-			  std::size_t xtile_shape = (xtile+1)*tile_size > pshape[row_major::x] ? (pshape[row_major::x]-(xtile*tile_size)) : tile_size;
-			  #pragma omp critical
-			  {
-			  ptiles[tile_id].resize(ztile_shape*ytile_shape*xtile_shape);
-			  }
-
-			  auto tiles_iter = ptiles[tile_id].data();
-			  auto tiles_offset = (z_intile*xtile_shape*ytile_shape) + y_intile*xtile_shape;
-
-			  std::copy(acc_iter, acc_iter + xtile_shape,
-						tiles_iter + tiles_offset);
-
-			  acc_iter+=xtile_shape;
-
-			}
-		  }
+		if(decode_map.size() != tiles.size()){
+		  std::cerr << "[sqeazy::detail::tile_shuffle::for_each_block_of_stream] decode map does not match the number of tiles!\n";
+		  return;
 		}
 
-		// COLLECT STATISTICS /////////////////////////////////////////////////////////////////////////////////////////////////////
-		// median plus stddev around median or take 75% quantile directly
+		const std::vector<std::size_t> offsets = stream_offsets(tiles, decode_map, _nthreads);
+		const std::size_t len = offsets.back();
+		const omp_size_type n_blocks = (len + _block_size - 1)/_block_size;
 
-		std::vector<in_value_t> metric(len_tiles,0.);
-		auto pmetric = metric.data();
-
-#pragma omp parallel for												\
-  shared( pmetric)														\
-  firstprivate(ptiles)													\
+#pragma omp parallel													\
+  shared(offsets, tiles)												\
+  firstprivate(_begin)													\
   num_threads(_nthreads)
-		for(omp_size_type i = 0;i<(omp_size_type)len_tiles;++i){
-		  median_acc_t acc;
-
-		  for(std::size_t p = 0;p<n_elements_per_tile;++p){
-			acc(ptiles[i][p]);
-		  }
-
-		  pmetric[i] = std::round(bacc::median(acc));
-		}
-
-		// PERFORM SHUFFLE /////////////////////////////////////////////////////////////////////////////////////////////////////
-		decode_map.resize(len_tiles);
-
-		auto sorted_metric = metric;
-
-		//TODO: this sort is the bottleneck currently
-		std::sort(sorted_metric.begin(), sorted_metric.end());
-
-		// COMPUTE SHUFFLED-ORIGINAL INDEX MAP //////////////////////////////////////////////////////////////////////////////////
-		std::vector<char> tile_written(len_tiles,false);
-		auto ptile_written = tile_written.data();
-		auto psorted_metric = sorted_metric.data();
-		auto pdecode_map = decode_map.data();
-
-#pragma omp parallel for												\
-  shared( ptile_written,pdecode_map)										\
-  firstprivate(pmetric, psorted_metric)												\
-  num_threads(_nthreads)
-		for(omp_size_type i =0;i<(omp_size_type)metric.size();++i){
-		  auto original_index = std::find(pmetric, pmetric+len_tiles, psorted_metric[i]) - pmetric;
-
-		  #pragma omp critical
-		  {
-			while(ptile_written[original_index] == true)
-			  original_index++;
+		{
+		  sqeazy::vec_32algn_t<in_value_t> block(_block_size);
+
+#pragma omp for
+		  for(omp_size_type b = 0;b<n_blocks;++b){
+
+			const std::size_t first = b*_block_size;
+			const std::size_t n_items = (std::min)(_block_size, len - first);
+
+			// position of the tile holding the first item of this block in the shuffled stream
+			std::size_t pos = std::distance(offsets.begin(),
+											std::upper_bound(offsets.begin(), offsets.end(), first)) - 1;
+			std::size_t intile = first - offsets[pos];
+			std::size_t filled = 0;
+
+			while(filled < n_items){
+
+			  const std::size_t tile_id = decode_map[pos];
+			  const std::size_t row_length = tiles.extent(tile_id, x_axis);
+			  std::size_t col = intile % row_length;
+
+			  tiles.for_each_row(tile_id,
+								 [&](std::size_t _offset, std::size_t _len){
+								   const std::size_t n_copy = (std::min)(_len - col, n_items - filled);
+								   std::copy(_begin + _offset + col, _begin + _offset + col + n_copy, block.data() + filled);
+								   filled += n_copy;
+								   col = 0;
+								 },
+								 intile / row_length,
+								 (intile % row_length + n_items - filled + row_length - 1)/row_length);
+
+			  ++pos;
+			  intile = 0;
+			}
 
-			ptile_written[original_index] = true;
+			_functor(static_cast<const in_value_t*>(block.data()), first, n_items);
 		  }
-
-
-		  pdecode_map[i] = original_index;
-
 		}
 
-
-		// COMPUTE PREFIX SUM //////////////////////////////////////////////////////////////////////////////////
-		std::vector<std::size_t> prefix_sum(len_tiles,0);
-		prefix_sum_of(decode_map.begin(), decode_map.end(), prefix_sum.begin(),
-					  [&](const std::size_t& _index){ return ptiles[_index].size(); },
-					  _nthreads);
-
-		// STORE CONTENT TO OUTPUT //////////////////////////////////////////////////////////////////////////////////
-		auto pprefix_sum = prefix_sum.data();
-		auto len = std::distance(_begin,_end);
-		#pragma omp parallel for												\
-		  shared( _out)													\
-		  firstprivate(ptiles,pdecode_map,pprefix_sum)								\
-		  num_threads(_nthreads)
-		for(omp_size_type i =0;i<(omp_size_type)decode_map.size();++i){
-
-		  std::copy(ptiles[pdecode_map[i]].begin(),
-					ptiles[pdecode_map[i]].end(),
-					_out + pprefix_sum[i]
-			);
-
-		}
-
-
-		return _out + len;
 	  }
 
 	  /**
 	   *  \brief decode a tile_shuffled stack into it's original form
 	   *
-	   *  TODO: parallelize this!
-	   *
 	   *  \param param
 	   *  \return return type
 	   */
@@ -421,142 +282,19 @@ namespace sqeazy {
 		  return _out;
 		}
 
-		const shape_container_t rem = remainder(_shape);
-		// const bool has_remainder = std::count_if(rem.begin(), rem.end(), [](shape_value_t el){ return el > 0;});
-
-		return decode_with_remainder(_begin, _end, _out,_shape);
-
-	  }
-
-	  template <typename in_iterator_t, typename out_iterator_t, typename shape_container_t>
-	  out_iterator_t decode_with_remainder(in_iterator_t _begin,
-										   in_iterator_t _end,
-										   out_iterator_t _out,
-										   const shape_container_t& _shape,
-										   int _nthreads = 1) const {
-
-
-
-		typedef typename std::iterator_traits<in_iterator_t>::value_type in_value_type;
-		typedef typename std::remove_cv<in_value_type>::type in_value_t;
-
-		// typedef typename std::iterator_traits<out_iterator_t>::value_type out_value_type;
-		// typedef typename std::remove_cv<out_value_type>::type out_value_t;
-
-		typedef typename std::iterator_traits<decltype(_shape.begin())>::value_type shape_value_type;
-		typedef typename std::remove_cv<shape_value_type>::type shape_value_t;
-
-		const shape_container_t rem = remainder(_shape);
-		const std::size_t n_elements_per_tile = std::pow(tile_size,_shape.size());
-
-		auto value = _out;
-		shape_container_t n_full_tiles = _shape;
-
-		for(shape_value_t & tile_dim : n_full_tiles )
-		  tile_dim = tile_dim / tile_size;
-
-		shape_container_t n_tiles = n_full_tiles;
-		for(int i =0;i<(int)rem.size();++i)
-		  n_tiles[i] += rem[i] ? 1 : 0;
-
-		const shape_value_t len_tiles = std::accumulate(n_tiles.begin(), n_tiles.end(),1,std::multiplies<shape_value_t>());
-
-		// SETUP TILE CONTENT /////////////////////////////////////////////////////////////////////////////////////////////////////
-
-		std::vector< std::vector<in_value_t> > tiles(len_tiles, std::vector<in_value_t>(n_elements_per_tile,0));
-
-		std::size_t ztile = 0;
-		std::size_t ytile = 0;
-		std::size_t xtile = 0;
-
-		std::size_t ztile_shape = 0;
-		std::size_t ytile_shape = 0;
-		std::size_t xtile_shape = 0;
-
-		std::size_t tile_id = 0;
-
-		for(shape_value_t z = 0;z<_shape[row_major::z];z+=tile_size){
-		  ztile = z / tile_size;
-		  ztile_shape = (ztile+1)*tile_size > _shape[row_major::z] ? (_shape[row_major::z]-(ztile*tile_size)) : tile_size;
-
-		  for(shape_value_t y = 0;y<_shape[row_major::y];y+=tile_size){
-			ytile = y / tile_size;
-			ytile_shape = (ytile+1)*tile_size > _shape[row_major::y] ? (_shape[row_major::y]-(ytile*tile_size)) : tile_size;
-
-			tile_id = ztile*n_tiles[sqeazy::row_major::y]*n_tiles[sqeazy::row_major::x]
-			  + ytile*n_tiles[sqeazy::row_major::x]
-			  ;
-
-			for(shape_value_t x = 0;x<_shape[row_major::x];x+=tile_size, ++tile_id){
-			  xtile = x / tile_size;
-			  xtile_shape = (xtile+1)*tile_size > _shape[row_major::x] ? (_shape[row_major::x]-(xtile*tile_size)) : tile_size;
-
-			  tiles[tile_id].resize(ztile_shape*ytile_shape*xtile_shape);
-			}
-		  }
-		}
-
-		auto input = _begin;
-		std::size_t target_tile_index = 0;
-		for(std::size_t i = 0;i<len_tiles;++i){
-		  target_tile_index = decode_map[i];
-
-		  std::copy(input,input+tiles[target_tile_index].size(),
-					tiles[target_tile_index].begin());
-
-		  input += tiles[target_tile_index].size();
+		const brick_layout tiles = tiles_of(_shape);
+		const std::size_t len_tiles = tiles.size();
 
+		if(decode_map.size() != len_tiles ||
+		   std::count_if(decode_map.begin(), decode_map.end(), [=](std::size_t _index){ return _index >= len_tiles;})){
+		  std::cerr << "[sqeazy::detail::tile_shuffle::decode] decode map does not match the number of tiles!\n";
+		  return _out;
 		}
 
-		// DUMP TILE CONTENT /////////////////////////////////////////////////////////////////////////////////////////////////////
-		ztile = 0;
-		ytile = 0;
-		xtile = 0;
-
-		ztile_shape = 0;
-		ytile_shape = 0;
-		xtile_shape = 0;
-
-		tile_id = 0;
-
-
-		std::size_t z_intile = 0;
-		std::size_t y_intile = 0;
-
-
-		auto tiles_iter = tiles[0].begin();
-
-		for(shape_value_t z = 0;z<_shape[row_major::z];++z){
-		  ztile = z / tile_size;
-		  z_intile = z % tile_size;
-
-		  ztile_shape = (ztile+1)*tile_size > _shape[row_major::z] ? (_shape[row_major::z]-(ztile*tile_size)) : tile_size;
-
-		  for(shape_value_t y = 0;y<_shape[row_major::y];++y){
-			ytile = y / tile_size;
-			y_intile = y % tile_size;
-			ytile_shape = (ytile+1)*tile_size > _shape[row_major::y] ? (_shape[row_major::y]-(ytile*tile_size)) : tile_size;
-
-			tile_id = ztile*n_tiles[sqeazy::row_major::y]*n_tiles[sqeazy::row_major::x]
-			  + ytile*n_tiles[sqeazy::row_major::x]
-			  ;
-
-			for(shape_value_t x = 0;x<_shape[row_major::x];x+=tile_size, ++tile_id){
-			  xtile = x / tile_size;
-			  xtile_shape = (xtile+1)*tile_size > _shape[row_major::x] ? (_shape[row_major::x]-(xtile*tile_size)) : tile_size;
-
-			  tiles_iter = tiles[tile_id].begin() + (z_intile*xtile_shape*ytile_shape) + y_intile*xtile_shape;
-			  std::copy(tiles_iter,
-						tiles_iter + xtile_shape,
-						value);
-
-			  value+=xtile_shape;
-
-			}
-		  }
-		}
+		// the offset of every tile in the input is obtained by a prefix sum over the tile sizes in the order of decode_map,
+		// hence all tiles can be scattered to their original location concurrently
+		return scatter_bricks(_begin, _out, tiles, decode_map, _nthreads);
 
-		return value;
 	  }
 
 
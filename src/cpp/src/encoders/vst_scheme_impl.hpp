@@ -0,0 +1,245 @@
+#ifndef _VST_SCHEME_IMPL_H_
+#define _VST_SCHEME_IMPL_H_
+
+#include <sstream>
+#include <iomanip>
+#include <string>
+#include <functional>
+#include <numeric>
+#include <cstdint>
+
+#include "sqeazy_common.hpp"
+#include "traits.hpp"
+#include "dynamic_stage.hpp"
+#include "string_parsers.hpp"
+
+#include "vst_utils.hpp"
+#include "lut_utils.hpp"
+
+namespace sqeazy {
+
+
+  /**
+* @brief quantise after a generalized Anscombe (variance stabilising) transform for Poisson-Gaussian camera noise,
+* codes are spaced by a fixed step in units of the noise standard deviation so the quantisation error stays below
+* the noise at every intensity; encode and decode are 1 lookup per item in tables computed from the camera model,
+* no histogram of the input is needed
+*
+* bits=8 emits 1 byte per item, bits=16 emits 2 bytes per item; step defaults to the smallest value (but at least 1)
+* that maps the largest input value to a valid code
+*
+* this scheme is not reversable, the error is bounded by the step
+*
+*/
+  template<typename in_type,
+           typename out_type = char
+           >
+  struct vst_scheme : public sink<in_type,out_type> {
+
+    typedef sink<in_type,out_type> base_type;
+    typedef in_type raw_type;
+    typedef typename base_type::out_type compressed_type;
+
+    static const std::string description() { return std::string("quantise after generalized Anscombe (variance stabilising) transform for Poisson-Gaussian noise through lookup tables, no histogram needed; <gain|default = 1> ADU per photo electron, <offset|default = 0> camera offset in ADU, <read_noise|default = 0> standard deviation of the read noise in ADU, <step> distance of codes in units of the noise (default: fit the input range into the codes, at least 1), <bits|default = 8> 8 or 16 bits per code, <inverse|default = exact> exact (algebraic) inverse for decoding or the unbiased one of Makitalo and Foi for data that was denoised in between"); };
+
+    detail::generalized_anscombe transform;
+    double step;
+    int bits;
+    bool unbiased;
+
+    detail::vst_lut<raw_type, std::uint8_t> narrow;
+    detail::vst_lut<raw_type, std::uint16_t> wide;
+
+    vst_scheme(const std::string& _payload=""):
+      transform(),
+      step(0),
+      bits(8),
+      unbiased(false),
+      narrow(),
+      wide()
+      {
+
+        pipeline_parser p;
+        auto config_map = p.minors(_payload.begin(),_payload.end());
+
+        if(config_map.size()){
+
+          auto f_itr = config_map.find("gain");
+          if(f_itr!=config_map.end())
+            transform.gain = std::stod(f_itr->second);
+
+          f_itr = config_map.find("offset");
+          if(f_itr!=config_map.end())
+            transform.offset = std::stod(f_itr->second);
+
+          f_itr = config_map.find("read_noise");
+          if(f_itr!=config_map.end())
+            transform.read_noise = std::stod(f_itr->second);
+
+          f_itr = config_map.find("step");
+          if(f_itr!=config_map.end())
+            step = std::stod(f_itr->second);
+
+          f_itr = config_map.find("bits");
+          if(f_itr!=config_map.end()){
+            bits = std::stoi(f_itr->second);
+            if(bits != 8 && bits != 16){
+              std::cerr << "[vst_scheme] bits=" << f_itr->second << " is not supported, expected 8 or 16, using 8\n";
+              bits = 8;
+            }
+          }
+
+          f_itr = config_map.find("inverse");
+          if(f_itr!=config_map.end()){
+            if(f_itr->second == "unbiased")
+              unbiased = true;
+            else if(f_itr->second != "exact")
+              std::cerr << "[vst_scheme] inverse=" << f_itr->second << " is not supported, expected exact or unbiased, using exact\n";
+          }
+
+        }
+
+        if(!(transform.gain > 0)){
+          std::cerr << "[vst_scheme] gain=" << transform.gain << " is not supported, expected a positive value, using 1\n";
+          transform.gain = 1;
+        }
+
+        //the parameters are taken from config() when decoding, the tables must see the values that are written there
+        transform.gain = std::stod(as_string(transform.gain));
+        transform.offset = std::stod(as_string(transform.offset));
+        transform.read_noise = std::stod(as_string(transform.read_noise));
+
+        if(!(step > 0))
+          step = bits == 8 ? narrow.fitting_step(transform) : wide.fitting_step(transform);
+
+        step = std::stod(as_string(step));
+
+        if(bits == 8)
+          narrow.setup(transform, step, unbiased);
+        else
+          wide.setup(transform, step, unbiased);
+      }
+
+    static std::string as_string(double _value){
+
+      std::ostringstream msg;
+      msg << std::setprecision(9) << _value;
+      return msg.str();
+    }
+
+    ~vst_scheme() override final {}
+
+    std::string name() const override final {
+
+      return std::string("vst");
+
+    }
+
+    std::string config() const override final {
+
+      std::ostringstream msg;
+      msg << "gain=" << as_string(transform.gain)
+          << ",offset=" << as_string(transform.offset)
+          << ",read_noise=" << as_string(transform.read_noise)
+          << ",step=" << as_string(step)
+          << ",bits=" << bits
+          << ",inverse=" << (unbiased ? "unbiased" : "exact");
+      return msg.str();
+
+    }
+
+    std::size_t code_bytes() const {
+      return bits/CHAR_BIT;
+    }
+
+    std::intmax_t max_encoded_size(std::intmax_t _size_bytes) const override final {
+
+      return _size_bytes/sizeof(raw_type)*code_bytes();
+    }
+
+    std::string output_type() const final override {
+
+      return sqeazy::header_utils::represent<compressed_type>::as_string();
+
+    }
+
+    bool is_compressor() const final override {
+
+      return base_type::is_compressor;
+
+    }
+
+    compressed_type* encode( const raw_type* _in,
+                             compressed_type* _out,
+                             const std::vector<std::size_t>& _shape) override final {
+
+      const std::size_t length = std::accumulate(_shape.begin(), _shape.end(),1,std::multiplies<std::size_t>());
+
+      return encode(_in,_out,length);
+    }
+
+    compressed_type* encode( const raw_type* _in, compressed_type* _out, std::size_t _length) override final {
+
+      if(!_in || !_length)
+        return _out;
+
+      if(bits == 8)
+        detail::lut::apply(_in, _length,
+                           narrow.encode,
+                           reinterpret_cast<std::uint8_t*>(_out),
+                           this->n_threads());
+      else
+        detail::lut::apply(_in, _length,
+                           wide.encode,
+                           reinterpret_cast<std::uint16_t*>(_out),
+                           this->n_threads());
+
+      return _out + _length*code_bytes()/sizeof(compressed_type);
+    }
+
+    int decode( const compressed_type* _in,
+                raw_type* _out,
+                const std::vector<std::size_t>& _inshape,
+                std::vector<std::size_t> _outshape = std::vector<std::size_t>()
+                ) const override final {
+
+      if(_outshape.empty())
+        _outshape = _inshape;
+
+      std::size_t inlength = std::accumulate(_inshape.begin(), _inshape.end(),1,std::multiplies<std::size_t>());
+      std::size_t outlength = std::accumulate(_outshape.begin(), _outshape.end(),1,std::multiplies<std::size_t>());
+
+      return decode(_in,_out,inlength,outlength);
+
+    }
+
+    int decode( const compressed_type* _in, raw_type* _out,
+                std::size_t _inlength,
+                std::size_t _outlength = 0) const override final {
+
+      const std::size_t n_codes = _inlength*sizeof(compressed_type)/code_bytes();
+      if(!_outlength)
+        _outlength = n_codes;
+
+      const std::size_t size = (std::min)(n_codes, _outlength);
+
+      raw_type* end_ptr = nullptr;
+      if(bits == 8)
+        end_ptr = detail::lut::apply(reinterpret_cast<const std::uint8_t*>(_in), size,
+                                     narrow.decode,
+                                     _out,
+                                     this->n_threads());
+      else
+        end_ptr = detail::lut::apply(reinterpret_cast<const std::uint16_t*>(_in), size,
+                                     wide.decode,
+                                     _out,
+                                     this->n_threads());
+
+      return (end_ptr - _out) - _outlength;
+    }
+
+  };
+
+}
+
+#endif /* _VST_SCHEME_IMPL_H_ */
@@ -0,0 +1,133 @@
+#ifndef _VST_UTILS_H_
+#define _VST_UTILS_H_
+
+#include <cmath>
+#include <cstdint>
+#include <climits>
+#include <vector>
+#include <algorithm>
+#include <type_traits>
+
+#include "sqeazy_common.hpp"
+
+namespace sqeazy {
+
+  namespace detail {
+
+    /**
+       \brief generalized Anscombe transform (GAT) for Poisson-Gaussian noise
+
+       a pixel value x = gain*p + n with p Poisson distributed photo electrons and n Gaussian read noise
+       of mean offset and standard deviation read_noise (both in ADU) is mapped to
+       f(x) = 2*sqrt(max((x - offset)/gain + 3/8 + (read_noise/gain)^2, 0))
+       which has a noise standard deviation of about 1 whatever the intensity, see
+       F. Murtagh, J.-L. Starck, A. Bijaoui, "Image restoration with noise suppression using a multiresolution support",
+       Astron. Astrophys. Suppl. Ser. 112 (1995)
+
+    */
+    struct generalized_anscombe {
+
+      double gain;
+      double offset;
+      double read_noise;
+
+      generalized_anscombe(double _gain = 1., double _offset = 0., double _read_noise = 0.):
+        gain(_gain),
+        offset(_offset),
+        read_noise(_read_noise)
+      {}
+
+      double sigma() const {
+        return read_noise/gain;
+      }
+
+      double forward(double _x) const {
+
+        const double value = (_x - offset)/gain + 3./8. + sigma()*sigma();
+        return value > 0 ? 2.*std::sqrt(value) : 0.;
+      }
+
+      //inverse of forward, biased towards low values as the square root is concave
+      double algebraic_inverse(double _d) const {
+
+        return gain*(_d*_d/4. - 3./8. - sigma()*sigma()) + offset;
+      }
+
+      /**
+         \brief closed-form approximation of the exact unbiased inverse, i.e. the x whose expected stabilised value is _d,
+         see M. Makitalo, A. Foi, "Optimal inversion of the generalized Anscombe transformation for Poisson-Gaussian noise",
+         IEEE Trans. Image Process. 22(1) (2013)
+
+         the approximation diverges for small _d, the algebraic inverse is used below the stabilised value of the offset
+      */
+      double unbiased_inverse(double _d) const {
+
+        if(_d <= forward(offset))
+          return algebraic_inverse(_d);
+
+        static const double sqrt_3_2 = std::sqrt(1.5);
+        const double d2 = _d*_d;
+        const double value = d2/4. + sqrt_3_2/(4.*_d) - 11./(8.*d2) + 5.*sqrt_3_2/(8.*d2*_d) - 1./8. - sigma()*sigma();
+
+        return gain*(std::max)(value, 0.) + offset;
+      }
+    };
+
+    /**
+       \brief lookup tables that map raw_t values to code_t codes of the stabilised domain and back
+
+       code c covers the stabilised values [(c - 1/2)*step, (c + 1/2)*step), the quantisation error in the stabilised
+       domain therefore has a standard deviation of step/sqrt(12) (in units of the noise) for all intensities
+
+    */
+    template <typename raw_t, typename code_t>
+    struct vst_lut {
+
+      typedef typename std::make_unsigned<raw_t>::type raw_index_t;
+      typedef typename std::make_unsigned<code_t>::type code_index_t;
+
+      static const std::size_t n_raw = std::size_t(1) << (sizeof(raw_t)*CHAR_BIT);
+      static const std::size_t n_codes = std::size_t(1) << (sizeof(code_t)*CHAR_BIT);
+
+      std::vector<code_t> encode;
+      std::vector<raw_t> decode;
+
+      /**
+         \brief smallest step that is not finer than _min_step and still maps the largest raw value to a valid code
+
+      */
+      static double fitting_step(const generalized_anscombe& _transform, double _min_step = 1.){
+
+        const double largest = _transform.forward(double(n_raw - 1));
+        return (std::max)(_min_step, largest/double(n_codes - 1));
+      }
+
+      /**
+         \brief fill both tables, codes of raw values beyond the last code saturate
+
+      */
+      void setup(const generalized_anscombe& _transform, double _step, bool _unbiased){
+
+        encode.resize(n_raw);
+        decode.resize(n_codes);
+
+        const double max_code = double(n_codes - 1);
+        for(std::size_t x = 0;x<n_raw;++x){
+          const double code = std::round(_transform.forward(double(x))/_step);
+          encode[x] = code_t(code_index_t((std::min)(code, max_code)));
+        }
+
+        const double max_raw = double(n_raw - 1);
+        for(std::size_t c = 0;c<n_codes;++c){
+          const double d = double(c)*_step;
+          const double x = std::round(_unbiased ? _transform.unbiased_inverse(d) : _transform.algebraic_inverse(d));
+          decode[c] = raw_t(raw_index_t((std::max)(0., (std::min)(x, max_raw))));
+        }
+      }
+    };
+
+  };
+
+};
+
+#endif /* _VST_UTILS_H_ */
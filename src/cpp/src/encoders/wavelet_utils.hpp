@@ -0,0 +1,470 @@
+#ifndef _WAVELET_UTILS_H_
+#define _WAVELET_UTILS_H_
+
+#include <cstdint>
+#include <vector>
+#include <array>
+#include <algorithm>
+#include <type_traits>
+
+#include "sqeazy_common.hpp"
+#include "traits.hpp"
+#include "scalar_utils.hpp"
+
+namespace sqeazy {
+
+  namespace detail {
+
+    /**
+       \brief reversible integer 5/3 (LeGall, CDF 5/3) wavelet transform by lifting, as used by lossless JPEG 2000
+
+       every level splits a line of n items into (n+1)/2 low pass items followed by n/2 high pass items:
+       d[i] = x[2i+1] - floor((x[2i] + x[2i+2])/2) (predict), s[i] = x[2i] + floor((d[i-1] + d[i] + 2)/4) (update),
+       lines are extended symmetrically at both ends; a level transforms rows, then columns (then the z axis if volumetric)
+       of the low pass region of the level before, so the low pass of every level is a preview of the stack
+       at half the resolution of the level before (see lowpass_shape)
+
+       the coefficients are stored in raw_t: every lifting step is taken modulo the range of raw_t right away
+       (low pass items as raw_t, high pass items as its signed counterpart), so that the inverse sees exactly
+       the values the forward transform has used and the transform stays reversible; high pass items are
+       zig-zag mapped once all levels are done
+
+    */
+    template <typename raw_t>
+    struct lifting_53 {
+
+      static_assert(std::is_integral<raw_t>::value, "[sqeazy::detail::lifting_53] only integer types are supported");
+
+      typedef typename add_unsigned<raw_t>::type unsigned_t;
+      typedef typename remove_unsigned<unsigned_t>::type signed_t;
+      typedef typename std::conditional<(sizeof(raw_t) < sizeof(std::int32_t)),
+                                        std::int32_t,
+                                        std::int64_t>::type lane_t;
+
+      //number of neighboring columns that are lifted at once
+      static const std::size_t block_width = 32;
+
+      int levels;
+      bool volumetric;
+
+      lifting_53(int _levels = 2, bool _volumetric = false):
+        levels(_levels),
+        volumetric(_volumetric)
+      {}
+
+      /**
+         \brief extent of the low pass region after _level levels, (z,y,x)
+
+      */
+      template <typename shape_container_t>
+      std::array<std::size_t,3> lowpass_shape(const shape_container_t& _shape, int _level) const {
+
+        std::array<std::size_t,3> value = {{_shape[row_major::z], _shape[row_major::y], _shape[row_major::x]}};
+        for(int l = 0;l<_level;++l){
+          if(volumetric)
+            value[row_major::z] = (value[row_major::z] + 1)/2;
+          value[row_major::y] = (value[row_major::y] + 1)/2;
+          value[row_major::x] = (value[row_major::x] + 1)/2;
+        }
+
+        return value;
+      }
+
+      /**
+         \brief number of levels after which the smallest transformed extent of _shape is down to 1 item,
+         further levels leave the stack unchanged
+
+      */
+      template <typename shape_container_t>
+      int max_levels(const shape_container_t& _shape) const {
+
+        std::size_t smallest = (std::min)(_shape[row_major::y], _shape[row_major::x]);
+        if(volumetric)
+          smallest = (std::min)(smallest, std::size_t(_shape[row_major::z]));
+
+        int value = 0;
+        for(;smallest > 1;++value)
+          smallest = (smallest + 1)/2;
+
+        return value;
+      }
+
+      template <bool S>
+      static lane_t as_lane(raw_t _value){
+        return S ? lane_t(signed_t(_value)) : lane_t(_value);
+      }
+
+      /**
+         \brief lift W lines at once (_runtime_width if W is 0), item i of line w is found at _low[i*width + w]
+         (even items) and _high[i*width + w] (odd items); low pass items wrap like the input (signed_t if S),
+         high pass items as signed_t
+
+      */
+      template <std::size_t W, bool S>
+      static void forward_lines(lane_t* _low, lane_t* _high,
+                                std::size_t _n_low, std::size_t _n_high,
+                                std::size_t _runtime_width){
+
+        const std::size_t _width = W ? W : _runtime_width;
+        if(!_n_high)
+          return;
+
+        //predict, the item after the last even one mirrors to it
+        const std::size_t n_inner = std::min(_n_high, _n_low - 1);
+        for(std::size_t i = 0;i<n_inner;++i)
+          for(std::size_t w = 0;w<_width;++w)
+            _high[i*_width + w] = signed_t(_high[i*_width + w] - ((_low[i*_width + w] + _low[(i+1)*_width + w]) >> 1));
+
+        for(std::size_t i = n_inner;i<_n_high;++i)
+          for(std::size_t w = 0;w<_width;++w)
+            _high[i*_width + w] = signed_t(_high[i*_width + w] - _low[i*_width + w]);
+
+        //update, the first and last odd items mirror to the ones next to them
+        for(std::size_t w = 0;w<_width;++w)
+          _low[w] = as_lane<S>(raw_t(_low[w] + ((2*_high[w] + 2) >> 2)));
+
+        for(std::size_t i = 1;i<_n_high;++i)
+          for(std::size_t w = 0;w<_width;++w)
+            _low[i*_width + w] = as_lane<S>(raw_t(_low[i*_width + w] + ((_high[(i-1)*_width + w] + _high[i*_width + w] + 2) >> 2)));
+
+        for(std::size_t i = std::max<std::size_t>(_n_high, 1);i<_n_low;++i)
+          for(std::size_t w = 0;w<_width;++w)
+            _low[i*_width + w] = as_lane<S>(raw_t(_low[i*_width + w] + ((2*_high[(i-1)*_width + w] + 2) >> 2)));
+      }
+
+      //inverse of forward_lines
+      template <std::size_t W, bool S>
+      static void inverse_lines(lane_t* _low, lane_t* _high,
+                                std::size_t _n_low, std::size_t _n_high,
+                                std::size_t _runtime_width){
+
+        const std::size_t _width = W ? W : _runtime_width;
+        if(!_n_high)
+          return;
+
+        for(std::size_t w = 0;w<_width;++w)
+          _low[w] = as_lane<S>(raw_t(_low[w] - ((2*_high[w] + 2) >> 2)));
+
+        for(std::size_t i = 1;i<_n_high;++i)
+          for(std::size_t w = 0;w<_width;++w)
+            _low[i*_width + w] = as_lane<S>(raw_t(_low[i*_width + w] - ((_high[(i-1)*_width + w] + _high[i*_width + w] + 2) >> 2)));
+
+        for(std::size_t i = std::max<std::size_t>(_n_high, 1);i<_n_low;++i)
+          for(std::size_t w = 0;w<_width;++w)
+            _low[i*_width + w] = as_lane<S>(raw_t(_low[i*_width + w] - ((2*_high[(i-1)*_width + w] + 2) >> 2)));
+
+        const std::size_t n_inner = std::min(_n_high, _n_low - 1);
+        for(std::size_t i = 0;i<n_inner;++i)
+          for(std::size_t w = 0;w<_width;++w)
+            _high[i*_width + w] = as_lane<S>(raw_t(_high[i*_width + w] + ((_low[i*_width + w] + _low[(i+1)*_width + w]) >> 1)));
+
+        for(std::size_t i = n_inner;i<_n_high;++i)
+          for(std::size_t w = 0;w<_width;++w)
+            _high[i*_width + w] = as_lane<S>(raw_t(_high[i*_width + w] + _low[i*_width + w]));
+      }
+
+      /**
+         \brief transform (_forward) or invert W lines (_runtime_width if W is 0) of _n items at _data,
+         item i of line w is found at _data[i*_stride + w] and is interpreted as signed_t if S;
+         the low pass items go to the front, the high pass items behind them
+
+      */
+      template <std::size_t W, bool S>
+      static void lift(raw_t* _data,
+                       std::size_t _n,
+                       std::size_t _stride,
+                       std::size_t _runtime_width,
+                       bool _forward,
+                       std::vector<lane_t>& _buffer){
+
+        const std::size_t _width = W ? W : _runtime_width;
+        const std::size_t n_low = (_n + 1)/2;
+        const std::size_t n_high = _n/2;
+
+        if(!n_high)
+          return;
+
+        if(_buffer.size() < _n*_width)
+          _buffer.resize(_n*_width);
+
+        lane_t* low = _buffer.data();
+        lane_t* high = low + n_low*_width;
+
+        if(_forward){
+
+          for(std::size_t i = 0;i<n_low;++i)
+            for(std::size_t w = 0;w<_width;++w)
+              low[i*_width + w] = as_lane<S>(_data[2*i*_stride + w]);
+
+          for(std::size_t i = 0;i<n_high;++i)
+            for(std::size_t w = 0;w<_width;++w)
+              high[i*_width + w] = as_lane<S>(_data[(2*i+1)*_stride + w]);
+
+          forward_lines<W,S>(low, high, n_low, n_high, _width);
+
+          for(std::size_t i = 0;i<_n;++i)
+            for(std::size_t w = 0;w<_width;++w)
+              _data[i*_stride + w] = raw_t(low[i*_width + w]);
+        }
+        else{
+
+          for(std::size_t i = 0;i<n_low;++i)
+            for(std::size_t w = 0;w<_width;++w)
+              low[i*_width + w] = as_lane<S>(_data[i*_stride + w]);
+
+          for(std::size_t i = 0;i<n_high;++i)
+            for(std::size_t w = 0;w<_width;++w)
+              high[i*_width + w] = as_lane<true>(_data[(n_low + i)*_stride + w]);
+
+          inverse_lines<W,S>(low, high, n_low, n_high, _width);
+
+          for(std::size_t i = 0;i<n_low;++i)
+            for(std::size_t w = 0;w<_width;++w)
+              _data[2*i*_stride + w] = raw_t(low[i*_width + w]);
+
+          for(std::size_t i = 0;i<n_high;++i)
+            for(std::size_t w = 0;w<_width;++w)
+              _data[(2*i+1)*_stride + w] = raw_t(high[i*_width + w]);
+        }
+      }
+
+      //dispatch a block of columns (see column_blocks) to the lift instance that matches it
+      static void lift_columns(raw_t* _data,
+                               std::size_t _n,
+                               std::size_t _stride,
+                               std::size_t _width,
+                               bool _signed,
+                               bool _forward,
+                               std::vector<lane_t>& _buffer){
+
+        if(_width == block_width){
+          if(_signed)
+            lift<block_width,true>(_data, _n, _stride, _width, _forward, _buffer);
+          else
+            lift<block_width,false>(_data, _n, _stride, _width, _forward, _buffer);
+        }
+        else{
+          if(_signed)
+            lift<0,true>(_data, _n, _stride, _width, _forward, _buffer);
+          else
+            lift<0,false>(_data, _n, _stride, _width, _forward, _buffer);
+        }
+      }
+
+      //a single row, the lines are contiguous so that the loops run along them
+      static void lift_row(raw_t* _data, std::size_t _n, bool _forward, std::vector<lane_t>& _buffer){
+
+        const std::size_t n_low = (_n + 1)/2;
+        const std::size_t n_high = _n/2;
+
+        if(!n_high)
+          return;
+
+        if(_buffer.size() < _n)
+          _buffer.resize(_n);
+
+        lane_t* low = _buffer.data();
+        lane_t* high = low + n_low;
+
+        if(_forward){
+
+          for(std::size_t i = 0;i<n_high;++i){
+            low[i] = _data[2*i];
+            high[i] = _data[2*i+1];
+          }
+
+          if(n_low > n_high)
+            low[n_high] = _data[_n-1];
+
+          forward_lines<1,false>(low, high, n_low, n_high, 1);
+
+          for(std::size_t i = 0;i<_n;++i)
+            _data[i] = raw_t(low[i]);
+        }
+        else{
+
+          for(std::size_t i = 0;i<n_low;++i)
+            low[i] = _data[i];
+
+          for(std::size_t i = 0;i<n_high;++i)
+            high[i] = signed_t(_data[n_low + i]);
+
+          inverse_lines<1,false>(low, high, n_low, n_high, 1);
+
+          for(std::size_t i = 0;i<n_high;++i){
+            _data[2*i] = raw_t(low[i]);
+            _data[2*i+1] = raw_t(high[i]);
+          }
+
+          if(n_low > n_high)
+            _data[_n-1] = raw_t(low[n_high]);
+        }
+      }
+
+      /**
+         \brief blocks of at most block_width columns (x offset, width, signed) of [0, _len) that do not
+         straddle _split, the columns from _split on hold high pass items of the x pass
+
+      */
+      static std::vector<std::array<std::size_t,3> > column_blocks(std::size_t _len, std::size_t _split){
+
+        std::vector<std::array<std::size_t,3> > value;
+        for(std::size_t x = 0;x<_len;){
+          const std::size_t end = std::min(x < _split ? _split : _len, x + block_width);
+          value.push_back({{x, end - x, std::size_t(x >= _split)}});
+          x = end;
+        }
+
+        return value;
+      }
+
+      /**
+         \brief run the x, y (and z) passes of _level forwards or backwards on the stack at _data
+
+      */
+      template <typename shape_container_t>
+      void run_level(raw_t* _data,
+                     const shape_container_t& _shape,
+                     int _level,
+                     bool _forward,
+                     int _nthreads) const {
+
+        const std::size_t len_y = _shape[row_major::y];
+        const std::size_t len_x = _shape[row_major::x];
+        const std::size_t frame = len_y*len_x;
+
+        const std::array<std::size_t,3> region = lowpass_shape(_shape, _level);
+        const std::array<std::size_t,3> next = lowpass_shape(_shape, _level + 1);
+
+        const omp_size_type n_rows = region[row_major::z]*region[row_major::y];
+
+        const std::vector<std::array<std::size_t,3> > blocks = column_blocks(region[row_major::x], next[row_major::x]);
+        const omp_size_type n_blocks = blocks.size();
+        const omp_size_type n_plane_blocks = region[row_major::z]*n_blocks;
+        const omp_size_type n_row_blocks = region[row_major::y]*n_blocks;
+
+#pragma omp parallel                            \
+  shared(_data)                                 \
+  num_threads(_nthreads)
+        {
+          std::vector<lane_t> buffer;
+
+          auto x_pass = [&](){
+#pragma omp for schedule(static)
+            for(omp_size_type r = 0;r<n_rows;++r){
+              const std::size_t z = r / region[row_major::y];
+              const std::size_t y = r % region[row_major::y];
+              lift_row(_data + z*frame + y*len_x, region[row_major::x], _forward, buffer);
+            }
+          };
+
+          auto y_pass = [&](){
+#pragma omp for schedule(static)
+            for(omp_size_type b = 0;b<n_plane_blocks;++b){
+              const std::array<std::size_t,3>& block = blocks[b % n_blocks];
+              lift_columns(_data + (b / n_blocks)*frame + block[0],
+                           region[row_major::y], len_x, block[1], block[2], _forward, buffer);
+            }
+          };
+
+          auto z_pass = [&](){
+#pragma omp for schedule(static)
+            for(omp_size_type b = 0;b<n_row_blocks;++b){
+              const std::size_t y = b / n_blocks;
+              const std::array<std::size_t,3>& block = blocks[b % n_blocks];
+              lift_columns(_data + y*len_x + block[0],
+                           region[row_major::z], frame, block[1], block[2] || y >= next[row_major::y], _forward, buffer);
+            }
+          };
+
+          if(_forward){
+            x_pass();
+            y_pass();
+            if(volumetric)
+              z_pass();
+          }
+          else{
+            if(volumetric)
+              z_pass();
+            y_pass();
+            x_pass();
+          }
+        }
+      }
+
+      /**
+         \brief zig-zag map (or unmap) all items outside of the low pass region of the last level
+
+      */
+      template <typename shape_container_t>
+      void map_highpass(raw_t* _data,
+                        const shape_container_t& _shape,
+                        bool _forward,
+                        int _nthreads) const {
+
+        const std::size_t len_y = _shape[row_major::y];
+        const std::size_t len_x = _shape[row_major::x];
+        const omp_size_type n_rows = _shape[row_major::z]*len_y;
+
+        const std::array<std::size_t,3> lowpass = lowpass_shape(_shape, levels);
+
+#pragma omp parallel for                        \
+  shared(_data)                                 \
+  schedule(static)                              \
+  num_threads(_nthreads)
+        for(omp_size_type r = 0;r<n_rows;++r){
+
+          const std::size_t z = r / len_y;
+          const std::size_t y = r % len_y;
+          const std::size_t first = (z < lowpass[row_major::z] && y < lowpass[row_major::y]) ? lowpass[row_major::x] : 0;
+
+          raw_t* row = _data + r*len_x;
+          if(_forward)
+            for(std::size_t x = first;x<len_x;++x)
+              row[x] = raw_t(zigzag_encode<raw_t>(signed_t(row[x])));
+          else
+            for(std::size_t x = first;x<len_x;++x)
+              row[x] = raw_t(zigzag_decode(row[x]));
+        }
+      }
+
+      /**
+         \brief transform the stack at _data in place
+
+      */
+      template <typename shape_container_t>
+      void forward(raw_t* _data,
+                   const shape_container_t& _shape,
+                   int _nthreads = 1) const {
+
+        for(int l = 0;l<levels;++l)
+          run_level(_data, _shape, l, true, _nthreads);
+
+        map_highpass(_data, _shape, true, _nthreads);
+      }
+
+      /**
+         \brief invert forward in place, only the levels from the last one down to _stop_level are inverted;
+         the low pass of level _stop_level is then found in the lowpass_shape(_shape, _stop_level) items
+         at the front of every axis
+
+      */
+      template <typename shape_container_t>
+      void inverse(raw_t* _data,
+                   const shape_container_t& _shape,
+                   int _nthreads = 1,
+                   int _stop_level = 0) const {
+
+        map_highpass(_data, _shape, false, _nthreads);
+
+        for(int l = levels - 1;l>=_stop_level;--l)
+          run_level(_data, _shape, l, false, _nthreads);
+      }
+
+    };
+
+  };
+
+};
+
+#endif /* _WAVELET_UTILS_H_ */
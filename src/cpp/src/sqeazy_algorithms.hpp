@@ -8,6 +8,7 @@
 #include <cmath>
 #include <iterator>
 #include <numeric>
+#include <thread>
 
 namespace sqeazy {
 
@@ -414,6 +415,83 @@ namespace sqeazy {
     return _out + len;
   }
 
+  /**
+     \brief stable argsort, fills [_out, _out + distance(_begin,_end)) with the indices of the items in [_begin,_end)
+     ordered by ascending value; equal values keep their original order
+
+     the index range is split into one chunk per thread, the chunks are sorted concurrently and then merged pairwise
+
+     \param[in] _begin begin of the values (random access)
+     \param[in] _end end of the values
+     \param[out] _out begin of the index range (random access, integral value type)
+     \param[in] _nthreads number of threads to use
+
+     \return _out + distance(_begin,_end)
+     \retval
+
+  */
+  template <typename iter_t, typename out_iter_t>
+  out_iter_t argsort(iter_t _begin, iter_t _end,
+                     out_iter_t _out,
+                     int _nthreads = 1){
+
+    typedef typename std::iterator_traits<out_iter_t>::value_type index_t;
+
+    const omp_size_type len = std::distance(_begin,_end);
+
+    for(omp_size_type i = 0;i<len;++i)
+      *(_out + i) = i;
+
+    //ties are broken by the index, so that the result does not depend on the partitioning
+    auto less = [=](const index_t& _lhs, const index_t& _rhs){
+      const auto& lhs = *(_begin + _lhs);
+      const auto& rhs = *(_begin + _rhs);
+      return (lhs < rhs) || (!(rhs < lhs) && _lhs < _rhs);
+    };
+
+    if(_nthreads <= 0)
+      _nthreads = std::thread::hardware_concurrency();
+
+    if(len < 2*_nthreads)
+      _nthreads = 1;
+
+    if(_nthreads == 1){
+      std::sort(_out, _out + len, less);
+      return _out + len;
+    }
+
+    const omp_size_type n_chunks = _nthreads;
+    const omp_size_type chunk_size = (len + n_chunks - 1)/n_chunks;
+
+#pragma omp parallel for                        \
+  shared(_out)                                  \
+  firstprivate(less, chunk_size, len)           \
+  num_threads(_nthreads)
+    for(omp_size_type c = 0;c<n_chunks;++c){
+      const omp_size_type first = (std::min)(c*chunk_size,len);
+      const omp_size_type last = (std::min)(first+chunk_size,len);
+      std::sort(_out + first, _out + last, less);
+    }
+
+    for(omp_size_type width = chunk_size;width<len;width *= 2){
+
+      const omp_size_type n_merges = (len + 2*width - 1)/(2*width);
+
+#pragma omp parallel for                        \
+  shared(_out)                                  \
+  firstprivate(less, width, len)                \
+  num_threads(_nthreads)
+      for(omp_size_type m = 0;m<n_merges;++m){
+        const omp_size_type first = m*2*width;
+        const omp_size_type middle = (std::min)(first+width,len);
+        const omp_size_type last = (std::min)(first+2*width,len);
+        std::inplace_merge(_out + first, _out + middle, _out + last, less);
+      }
+    }
+
+    return _out + len;
+  }
+
 
 };
 
@@ -14,6 +14,14 @@
 #include <boost/align/aligned_delete.hpp>
 
 
+//function level target attributes, these allow to compile kernels for instruction sets beyond the global compiler flags
+//the caller has to make sure (with platform::has_simd or platform::widest_kernel) that the hardware supports them before calling such a function
+#if defined(__GNUC__) || defined(__clang__)
+#define SQY_TARGET(isa) __attribute__((target(isa)))
+#else
+#define SQY_TARGET(isa)
+#endif
+
 #ifdef _OPENMP
 #include "omp.h"
 typedef typename std::make_signed<std::size_t>::type omp_size_type;//boiler plate required for MS VS 14 2015 OpenMP implementation
@@ -84,6 +92,43 @@ namespace sqeazy {
       }
     };
 
+    /**
+       \brief true if the CPU supports feature_t and vectorisation is enabled
+
+       SIMD kernels are dispatched on every call, but cpuid is queried once per feature only: it traps in
+       virtual machines, which makes it too slow to be asked per call
+
+    */
+    template <typename feature_t>
+    bool has_simd(){
+
+      static const bool value = use_vectorisation::value && compass::runtime::has(feature_t());
+      return value;
+    }
+
+    /**
+       \brief the kernel for the widest instruction set available among SSE2, AVX2 and AVX-512BW, _scalar if none is
+       (kernels given as nullptr are skipped)
+
+    */
+    template <typename function_t>
+    function_t widest_kernel(function_t _scalar,
+                             function_t _sse2,
+                             function_t _avx2,
+                             function_t _avx512bw = nullptr){
+
+      if(_avx512bw && has_simd<ft::avx512bw>())
+        return _avx512bw;
+
+      if(_avx2 && has_simd<ft::avx2>())
+        return _avx2;
+
+      if(_sse2 && has_simd<ft::sse2>())
+        return _sse2;
+
+      return _scalar;
+    }
+
 
   };
 
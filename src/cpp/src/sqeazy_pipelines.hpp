@@ -4,10 +4,16 @@
 //import native filters/sinks
 #include "encoders/sqeazy_impl.hpp"
 #include "encoders/quantiser_scheme_impl.hpp"
+#include "encoders/vst_scheme_impl.hpp"
 #include "encoders/raster_reorder_scheme_impl.hpp"
 #include "encoders/zcurve_reorder_scheme_impl.hpp"
+#include "encoders/hilbert_reorder_scheme_impl.hpp"
 #include "encoders/tile_shuffle_scheme_impl.hpp"
 #include "encoders/frame_shuffle_scheme_impl.hpp"
+#include "encoders/med_predict_scheme_impl.hpp"
+#include "encoders/cdf53_wavelet_scheme_impl.hpp"
+#include "encoders/background_map_scheme_impl.hpp"
+#include "encoders/temporal_diff_scheme_impl.hpp"
 
 //import external filters/sinks
 #include "encoders/lz4.hpp"
@@ -31,16 +37,22 @@ namespace sqeazy {
     remove_background_scheme<T>,
     flatten_to_neighborhood_scheme<T>,
     remove_estimated_background_scheme<T>,
+    background_map_scheme<T>,
     raster_reorder_scheme<T>,
     tile_shuffle_scheme<T>,
     frame_shuffle_scheme<T>,
-    zcurve_reorder_scheme<T>
+    zcurve_reorder_scheme<T>,
+    hilbert_reorder_scheme<T>,
+    med_predict_scheme<T>,
+    cdf53_wavelet_scheme<T>,
+    temporal_diff_scheme<T>
     >;
 
   template <typename T>
   using encoders_factory = stage_factory<
     pass_through<T>,
     quantiser_scheme<T>,
+    vst_scheme<T>,
     #ifdef SQY_WITH_FFMPEG
     hevc_scheme<T>,
     h264_scheme<T>,
@@ -60,7 +72,10 @@ namespace sqeazy {
     raster_reorder_scheme<T>,
     tile_shuffle_scheme<T>,
     frame_shuffle_scheme<T>,
-    zcurve_reorder_scheme<T>
+    zcurve_reorder_scheme<T>,
+    hilbert_reorder_scheme<T>,
+    med_predict_scheme<T>,
+    cdf53_wavelet_scheme<T>
     >;
 
   template <typename T>
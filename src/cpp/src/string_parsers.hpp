@@ -471,6 +471,27 @@ namespace sqeazy {
   };
 
   namespace parsing {
+    /**
+       \brief number of bytes _nbytes of memory consume as verbatim string (base64 and the delimiters)
+
+    */
+    static std::size_t verbatim_bytes(std::size_t _nbytes){
+
+      return base64::encoded_bytes(_nbytes)+ignore_this_delimiters.first.size()+ignore_this_delimiters.second.size();
+
+    }
+
+    /**
+       \brief number of bytes a verbatim string of _nbytes of memory may consume inside the header: the header is
+       written as JSON, which escapes every '/' (part of the base64 alphabet and of the delimiters) as "\/"
+
+    */
+    static std::size_t verbatim_bytes_in_header(std::size_t _nbytes){
+
+      return 2*verbatim_bytes(_nbytes);
+
+    }
+
     /**
        \brief function estimate how many bytes a range may consume as verbatim string
 
@@ -486,8 +507,7 @@ namespace sqeazy {
       const std::size_t len = (std::size_t)std::distance(_begin, _end);
       const std::size_t bytes = len*sizeof(value_t);
 
-      const std::size_t exp_size = base64::encoded_bytes(bytes)+ignore_this_delimiters.first.size()+ignore_this_delimiters.second.size();
-      return exp_size;
+      return verbatim_bytes(bytes);
 
     }
 
@@ -5,6 +5,7 @@
 #include <map>
 #include <cstdlib>
 #include <ctime>
+#include <random>
 #include <boost/concept_check.hpp>
 
 namespace sqeazy {
@@ -141,6 +142,19 @@ struct array_fixture {
   };
 
 
+  //_len items drawn uniformly from [_min, _max] by a generator seeded with _seed
+  template <typename T>
+  std::vector<T> random_stack(std::size_t _len, int _min, int _max, unsigned _seed){
+
+    std::mt19937 gen(_seed);
+    std::uniform_int_distribution<int> dist(_min, _max);
+    std::vector<T> value(_len,0);
+    for(auto& v : value)
+      v = dist(gen);
+
+    return value;
+  }
+
 }//sqeazy namespace
 
 #endif
@@ -77,3 +77,53 @@ BOOST_AUTO_TEST_CASE( in_parallel_with_functor ){
     BOOST_CHECK_MESSAGE(psum[i] == psum[i-1]+2, i << "] prefix sum doesn't match [i]: " << psum[i] << " with previous one [i-1]: " << psum[i-1]+2);
 }
 BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE( argsort )
+
+BOOST_AUTO_TEST_CASE( works ){
+
+  std::vector<int> src = {3, 1, 2, 0};
+  std::vector<std::size_t> indices(src.size(), 0);
+
+  auto resitr = sqeazy::argsort(src.begin(),src.end(),indices.begin());
+
+  BOOST_CHECK(resitr == indices.end());
+  std::vector<std::size_t> expected = {3, 1, 2, 0};
+  BOOST_CHECK_EQUAL_COLLECTIONS(indices.begin(), indices.end(),
+                                expected.begin(), expected.end());
+}
+
+BOOST_AUTO_TEST_CASE( stable_on_ties ){
+
+  std::vector<int> src = {1, 0, 1, 0, 1, 0};
+  std::vector<std::size_t> indices(src.size(), 0);
+
+  sqeazy::argsort(src.begin(),src.end(),indices.begin());
+
+  std::vector<std::size_t> expected = {1, 3, 5, 0, 2, 4};
+  BOOST_CHECK_EQUAL_COLLECTIONS(indices.begin(), indices.end(),
+                                expected.begin(), expected.end());
+}
+
+BOOST_AUTO_TEST_CASE( in_parallel ){
+
+  std::vector<std::uint16_t> src(1 << 12, 0);
+  for(std::size_t i = 0;i<src.size();++i)
+    src[i] = (i*7919) % 13;
+
+  std::vector<std::size_t> serial(src.size(), 0);
+  sqeazy::argsort(src.begin(),src.end(),serial.begin());
+
+  for(int nthreads : {2, 3, 4, 7}){
+    std::vector<std::size_t> parallel(src.size(), 0);
+    auto resitr = sqeazy::argsort(src.begin(),src.end(),parallel.begin(), nthreads);
+
+    BOOST_CHECK(resitr == parallel.end());
+    BOOST_CHECK_EQUAL_COLLECTIONS(parallel.begin(), parallel.end(),
+                                  serial.begin(), serial.end());
+  }
+
+  BOOST_CHECK(std::is_sorted(serial.begin(), serial.end(),
+                             [&](std::size_t _lhs, std::size_t _rhs){ return src[_lhs] < src[_rhs]; }));
+}
+BOOST_AUTO_TEST_SUITE_END()
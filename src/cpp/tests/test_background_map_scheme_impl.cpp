@@ -0,0 +1,249 @@
+#define BOOST_TEST_MODULE TEST_BACKGROUND_MAP_SCHEME_IMPL
+#define BOOST_TEST_MAIN
+#include "boost/test/included/unit_test.hpp"
+#include <numeric>
+#include <vector>
+#include <random>
+#include <iostream>
+#include <algorithm>
+#include "array_fixtures.hpp"
+#include "encoders/background_map_scheme_impl.hpp"
+#include "sqeazy_pipelines.hpp"
+#include "traits.hpp"
+
+namespace sqy = sqeazy;
+namespace sqyd = sqy::detail;
+
+//percentile of every tile by sorting a copy of it
+template <typename T>
+std::vector<T> sorted_percentiles(const std::vector<T>& _input,
+                                  const std::vector<std::size_t>& _shape,
+                                  const sqyd::background_map<T>& _map){
+
+  const auto grid = _map.tiles_of(_shape);
+  std::vector<T> value;
+
+  for(std::size_t tz = 0;tz<grid[0];++tz)
+    for(std::size_t ty = 0;ty<grid[1];++ty)
+      for(std::size_t tx = 0;tx<grid[2];++tx){
+        std::vector<T> tile;
+        for(std::size_t z = tz*_map.tile_shape[0];z<std::min(_shape[0], (tz+1)*_map.tile_shape[0]);++z)
+          for(std::size_t y = ty*_map.tile_shape[1];y<std::min(_shape[1], (ty+1)*_map.tile_shape[1]);++y)
+            for(std::size_t x = tx*_map.tile_shape[2];x<std::min(_shape[2], (tx+1)*_map.tile_shape[2]);++x)
+              tile.push_back(_input[(z*_shape[1] + y)*_shape[2] + x]);
+        std::sort(tile.begin(), tile.end());
+        value.push_back(tile[_map.rank(tile.size())]);
+      }
+
+  return value;
+}
+
+BOOST_AUTO_TEST_SUITE( map )
+
+BOOST_AUTO_TEST_CASE( tile_percentiles_match_sorting )
+{
+
+  const std::vector<std::size_t> shape = {9,40,71};
+  const std::size_t len = 9*40*71;
+
+  const std::vector<std::uint16_t> input = sqy::random_stack<std::uint16_t>(len, 0, 65535, 42);
+  const std::vector<short> shorts = sqy::random_stack<short>(len, -32768, 32767, 7);
+  const std::vector<int> ints = sqy::random_stack<int>(len, -100000, 100000, 3);
+
+  for(float percentile : {0.f, .1f, .5f, 1.f}){
+    for(int nthreads : {1,3}){
+
+      sqyd::background_map<std::uint16_t> map({4,16,32}, percentile);
+      map.estimate(input.data(), shape, nthreads);
+      BOOST_CHECK(map.values == sorted_percentiles(input, shape, map));
+
+      sqyd::background_map<short> smap({4,16,32}, percentile);
+      smap.estimate(shorts.data(), shape, nthreads);
+      BOOST_CHECK(smap.values == sorted_percentiles(shorts, shape, smap));
+
+      sqyd::background_map<int> imap({4,16,32}, percentile);
+      imap.estimate(ints.data(), shape, nthreads);
+      BOOST_CHECK(imap.values == sorted_percentiles(ints, shape, imap));
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE( interpolation_hits_tile_centers )
+{
+
+  //tiles of odd size have a voxel at their center
+  const std::vector<std::size_t> shape = {9,15,35};
+  const std::vector<std::uint16_t> input = sqy::random_stack<std::uint16_t>(9*15*35, 100, 1000, 5);
+
+  sqyd::background_map<std::uint16_t> map({3,5,7}, .5f);
+  map.estimate(input.data(), shape);
+
+  std::vector<std::uint16_t> background(input.size(),0);
+  map.for_each_row(shape,
+                   [&](std::size_t _row, const std::uint16_t* _background){
+                     std::copy(_background, _background + shape[2], background.begin() + _row);
+                   },
+                   2);
+
+  const auto grid = map.tiles_of(shape);
+  for(std::size_t tz = 0;tz<grid[0];++tz)
+    for(std::size_t ty = 0;ty<grid[1];++ty)
+      for(std::size_t tx = 0;tx<grid[2];++tx){
+        const std::size_t z = tz*3 + 1;
+        const std::size_t y = ty*5 + 2;
+        const std::size_t x = tx*7 + 3;
+        BOOST_REQUIRE_EQUAL(background[(z*shape[1] + y)*shape[2] + x], map.values[(tz*grid[1] + ty)*grid[2] + tx]);
+      }
+
+  //in between centers the background stays within the range of the map
+  const auto minmax = std::minmax_element(map.values.begin(), map.values.end());
+  BOOST_CHECK_GE(*std::min_element(background.begin(), background.end()), *minmax.first);
+  BOOST_CHECK_LE(*std::max_element(background.begin(), background.end()), *minmax.second);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE( scheme )
+
+BOOST_AUTO_TEST_CASE( removes_varying_background )
+{
+
+  //background ramps from 100 to 1100 along x, a few bright spots on top
+  const std::vector<std::size_t> shape = {16,64,256};
+  const std::size_t len = 16*64*256;
+  std::vector<std::uint16_t> input(len,0);
+  for(std::size_t i = 0;i<len;++i)
+    input[i] = 100 + (i % 256)*1000/255;
+  for(std::size_t i = 0;i<len;i += 997)
+    input[i] += 5000;
+
+  sqy::background_map_scheme<std::uint16_t> local("tile_z=16,tile_y=32,tile_x=32,percentile=0.5");
+  BOOST_CHECK_EQUAL(local.name(), "rmbkrd_map");
+
+  std::vector<std::uint16_t> output(len,0);
+  std::uint16_t* end = local.encode(input.data(), output.data(), shape);
+  BOOST_REQUIRE(end == output.data() + len);
+
+  //the spots survive, the ramp is gone up to the interpolation error
+  std::size_t n_spots = 0;
+  for(std::size_t i = 0;i<len;++i){
+    if(i % 997 == 0){
+      n_spots += output[i] > 4900;
+      continue;
+    }
+    BOOST_REQUIRE_LE(output[i], 70);
+  }
+  BOOST_CHECK_EQUAL(n_spots, (len + 996)/997);
+
+  //a global threshold cannot do that
+  sqy::remove_background_scheme<std::uint16_t> global(*std::min_element(local.background.values.begin(), local.background.values.end()));
+  std::vector<std::uint16_t> global_output(len,0);
+  global.encode(input.data(), global_output.data(), shape);
+  BOOST_CHECK_GT(std::count(output.begin(), output.end(), 0), std::count(global_output.begin(), global_output.end(), 0));
+}
+
+BOOST_AUTO_TEST_CASE( restore_from_config )
+{
+
+  const std::vector<std::size_t> shape = {5,40,71};
+  const std::size_t len = 5*40*71;
+  const std::vector<std::uint16_t> input = sqy::random_stack<std::uint16_t>(len, 0, 4095, 13);
+
+  sqy::background_map_scheme<std::uint16_t> local("percentile=0.25,tile_y=16,tile_x=16,restore=1");
+  local.set_n_threads(3);
+  std::vector<std::uint16_t> encoded(len,0);
+  local.encode(input.data(), encoded.data(), shape);
+
+  //the decoder only sees the header
+  sqy::background_map_scheme<std::uint16_t> decoder(local.config());
+  BOOST_CHECK_EQUAL(decoder.config(), local.config());
+  BOOST_CHECK(decoder.background.values == local.background.values);
+
+  std::vector<std::uint16_t> decoded(len,0);
+  BOOST_REQUIRE_EQUAL(decoder.decode(encoded.data(), decoded.data(), shape, shape),0);
+
+  //values above the background are restored, the ones below end up on the background
+  std::vector<std::uint16_t> background(len,0);
+  local.background.for_each_row(shape,
+                                [&](std::size_t _row, const std::uint16_t* _background){
+                                  std::copy(_background, _background + shape[2], background.begin() + _row);
+                                });
+  std::size_t n_mismatches = 0;
+  for(std::size_t i = 0;i<len;++i)
+    n_mismatches += decoded[i] != std::max(input[i], background[i]);
+  BOOST_CHECK_EQUAL(n_mismatches, 0);
+
+  //without restore, decode copies
+  sqy::background_map_scheme<std::uint16_t> copier("percentile=0.25");
+  BOOST_REQUIRE_EQUAL(copier.decode(encoded.data(), decoded.data(), shape, shape),0);
+  BOOST_CHECK(decoded == encoded);
+}
+
+BOOST_AUTO_TEST_CASE( pipeline_roundtrip )
+{
+
+  const std::string spec = "rmbkrd_map(restore=1)->lz4";
+  BOOST_REQUIRE(sqy::dypeline<std::uint16_t>::can_be_built_from(spec));
+
+  auto pipe = sqy::dypeline<std::uint16_t>::from_string(spec);
+
+  std::vector<std::size_t> shape = {8,100,130};
+  const std::size_t len = 8*100*130;
+  const std::vector<std::uint16_t> input = sqy::random_stack<std::uint16_t>(len, 100, 4000, 3);
+
+  std::vector<char> encoded(pipe.max_encoded_size(len*sizeof(std::uint16_t)),0);
+  char* end = pipe.encode(input.data(), encoded.data(), shape);
+  BOOST_REQUIRE(end != nullptr);
+
+  std::vector<std::uint16_t> decoded(len,0);
+  BOOST_REQUIRE_EQUAL(pipe.decode(encoded.data(), decoded.data(), end - encoded.data()), 0);
+
+  sqy::background_map_scheme<std::uint16_t> local("restore=1");
+  std::vector<std::uint16_t> expected(len,0);
+  local.encode(input.data(), expected.data(), shape);
+  local.decode(expected.data(), expected.data(), shape, shape);
+
+  BOOST_CHECK(decoded == expected);
+}
+
+BOOST_AUTO_TEST_CASE( small_tiles_stay_within_max_encoded_size )
+{
+
+  const std::vector<std::size_t> shape = {16,128,128};
+  const std::size_t len = 16*128*128;
+  const std::vector<std::uint16_t> input = sqy::random_stack<std::uint16_t>(len, 0, 65535, 11);
+
+  for(const std::string spec : {"rmbkrd_map(tile_z=1,tile_y=4,tile_x=4)->pass_through",
+                                "rmbkrd_map(tile_z=1,tile_y=4,tile_x=4)->lz4",
+                                "rmbkrd_map(tile_z=1,tile_y=1,tile_x=1)->pass_through"}){
+
+    auto pipe = sqy::dypeline<std::uint16_t>::from_string(spec);
+    const std::intmax_t bound = pipe.max_encoded_size(len*sizeof(std::uint16_t));
+
+    //twice the bound, so that a violation is reported rather than overflowing the buffer
+    std::vector<char> encoded(2*bound,0);
+    char* end = pipe.encode(input.data(), encoded.data(), shape);
+    BOOST_REQUIRE(end != nullptr);
+    BOOST_CHECK_MESSAGE(end - encoded.data() <= bound,
+                        spec << " wrote " << (end - encoded.data()) << " bytes, max_encoded_size is " << bound);
+  }
+}
+
+
+BOOST_AUTO_TEST_CASE( header_growth_is_counted_once )
+{
+
+  const std::size_t len = 16*128*128;
+  const std::intmax_t len_bytes = len*sizeof(std::uint16_t);
+  const std::string config = "tile_z=1,tile_y=4,tile_x=4";
+
+  auto pipe = sqy::dypeline<std::uint16_t>::from_string("rmbkrd_map(" + config + ")->pass_through");
+  sqy::background_map_scheme<std::uint16_t> filter(config);
+  BOOST_REQUIRE_GT(filter.max_encoded_size(len_bytes), len_bytes);
+
+  //pass_through keeps the size, the bound of the filter already includes the background map
+  sqy::header hdr(std::uint16_t(), len_bytes, pipe.name());
+  BOOST_CHECK_EQUAL(pipe.max_encoded_size(len_bytes), 2*std::intmax_t(hdr.size()) + filter.max_encoded_size(len_bytes));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -61,6 +61,51 @@ BOOST_AUTO_TEST_CASE( selects_correct_plane_in_z )
 
 }
 
+BOOST_AUTO_TEST_CASE( histograms_darkest_face_without_copies )
+{
+
+    //the last z-x face is the darkest one
+    std::vector<std::size_t> shape = {7, 12, 33};
+    const std::size_t frame = 12*33;
+    std::vector<value_type> input(7*frame, 0);
+    boost::random::mt19937 rng;
+    boost::random::uniform_int_distribution<value_type> bright(200, 400);
+    boost::random::uniform_int_distribution<value_type> dark(10, 60);
+    for(value_type& _value : input)
+        _value = bright(rng);
+    for(std::size_t z = 0; z < shape[0]; ++z)
+        for(std::size_t x = 0; x < shape[2]; ++x)
+            input[z*frame + 11*33 + x] = dark(rng);
+
+    std::vector<value_type> face;
+    sqeazy::extract_darkest_face(input.data(), shape, face);
+    BOOST_REQUIRE_EQUAL(face.size(), 7*33);
+    BOOST_CHECK_EQUAL(face.back(), input.back());
+
+    sqeazy::histogram<value_type> expected(face.begin(), face.end());
+
+    for(int nthreads : {1, 3}) {
+        sqeazy::histogram<value_type> darkest;
+        auto found = sqeazy::darkest_face_histogram(input.data(), shape, darkest, .99f, nthreads);
+
+        BOOST_CHECK_EQUAL(found.offset, 11*33);
+        BOOST_CHECK_EQUAL(found.row_stride, frame);
+        BOOST_CHECK_EQUAL(darkest.num_entries, face.size());
+        BOOST_CHECK(darkest.bins == expected.bins);
+
+        //any percentile is available from the same histogram
+        for(float percentile : {.1f, .5f, .99f})
+            BOOST_CHECK_EQUAL(darkest.calc_support(percentile), expected.calc_support(percentile));
+    }
+
+    //a single plane has one z face only
+    sqeazy::histogram<value_type> plane;
+    std::vector<std::size_t> plane_shape = {1, 12, 33};
+    auto found = sqeazy::darkest_face_histogram(input.data(), plane_shape, plane);
+    BOOST_CHECK_EQUAL(found.offset, 11*33);
+    BOOST_CHECK_EQUAL(found.n_rows, 1);
+}
+
 BOOST_AUTO_TEST_CASE( crops_correct_values )
 {
     boost::random::mt19937 rng;
@@ -162,3 +207,204 @@ BOOST_AUTO_TEST_CASE( stamp_removal_fraction_newapi )
 }
 
 BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE( box_counts )
+
+BOOST_AUTO_TEST_CASE( match_count_neighbors_if_on_anisotropic_stack )
+{
+
+    typedef sqeazy::cube_neighborhood<5> nb_t;
+    typedef sqeazy::box_count_below<nb_t> counter_t;
+
+    std::vector<std::size_t> shape = {9, 21, 34};
+    const std::size_t len = 9*21*34;
+    const unsigned short threshold = 5;
+
+    std::vector<unsigned short> input(len, 0);
+    boost::random::mt19937 rng;
+    boost::random::uniform_int_distribution<unsigned short> values(0,10);
+    for(unsigned short& _value : input)
+        _value = values(rng);
+
+    for(int nthreads : {1, 3}) {
+
+        std::vector<int> counts(len, -1);
+        counter_t::for_each_row(input.data(), shape, threshold,
+                                [&](std::size_t _row, const counter_t::count_type* _counts, std::size_t _x_first, std::size_t _x_last) {
+                                    for(std::size_t x = _x_first; x < _x_last; ++x)
+                                        counts[_row + x] = _counts[x];
+                                },
+                                nthreads);
+
+        std::size_t n_counted = 0;
+        for(std::size_t z = 2; z < shape[0] - 2; ++z)
+            for(std::size_t y = 2; y < shape[1] - 2; ++y)
+                for(std::size_t x = 2; x < shape[2] - 2; ++x) {
+                    const std::size_t index = (z*shape[1] + y)*shape[2] + x;
+                    const unsigned expected = sqeazy::count_neighbors_if<nb_t>(&input[index], shape,
+                                                                             [&](unsigned short _el) { return _el < threshold; })
+                        + (input[index] < threshold ? 1 : 0);
+                    BOOST_REQUIRE_EQUAL(counts[index], expected);
+                    ++n_counted;
+                }
+
+        //the halo receives no counts
+        BOOST_CHECK_EQUAL(std::count_if(counts.begin(), counts.end(), [](int _el) { return _el >= 0; }), n_counted);
+    }
+}
+
+BOOST_AUTO_TEST_CASE( flatten_leaves_halo_untouched )
+{
+
+    std::vector<std::size_t> shape = {6, 7, 12};
+    const std::size_t len = 6*7*12;
+
+    //bright stack with one dark plane: only pixels next to it see enough dark neighbors
+    std::vector<unsigned short> input(len, 100);
+    std::fill(input.begin() + 3*7*12, input.begin() + 4*7*12, 0);
+    std::vector<unsigned short> output(len, 1);
+
+    sqeazy::flatten_to_neighborhood_scheme<unsigned short, sqeazy::cube_neighborhood<3> > flatten(42, 8/26.f);
+    flatten.encode(input.data(), output.data(), shape);
+
+    for(std::size_t z = 0; z < shape[0]; ++z)
+        for(std::size_t y = 0; y < shape[1]; ++y)
+            for(std::size_t x = 0; x < shape[2]; ++x) {
+                const std::size_t index = (z*shape[1] + y)*shape[2] + x;
+                const bool interior = z > 0 && z < shape[0] - 1 && y > 0 && y < shape[1] - 1 && x > 0 && x < shape[2] - 1;
+
+                if(!interior || input[index] < 42)
+                    BOOST_REQUIRE_EQUAL(output[index], 1);
+                else if(z == 2 || z == 4)
+                    BOOST_REQUIRE_EQUAL(output[index], 0);
+                else
+                    BOOST_REQUIRE_EQUAL(output[index], 100);
+            }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE( saturating_subtract )
+
+template <typename T>
+void check_kernels_against_scalar(T _threshold){
+
+    namespace sqyd = sqeazy::detail::saturating;
+
+    //longer than a block, so that several threads get work
+    const std::size_t len = sqyd::block_size + 1021;
+    std::vector<T> input(len + 64, 0);
+    boost::random::mt19937 rng;
+    boost::random::uniform_int_distribution<int> values(0, std::numeric_limits<T>::max());
+    for(T& _value : input)
+        _value = values(rng);
+
+    //misaligned begins and odd lengths exercise heads and tails of all kernels
+    for(std::size_t offset : {0, 1, 3, 17}) {
+        for(std::size_t n : {std::size_t(0), std::size_t(5), std::size_t(63), std::size_t(200), len - 17}) {
+
+            const T* in = input.data() + offset;
+            std::vector<T> expected(n + 64, 0);
+            sqyd::subtract_scalar(in, n, _threshold, expected.data() + offset);
+
+            for(int nthreads : {1, 3}) {
+                std::vector<T> output(n + 64, 0);
+                T* end = sqyd::subtract(in, n, _threshold, output.data() + offset, nthreads);
+                BOOST_REQUIRE(end == output.data() + offset + n);
+                BOOST_REQUIRE_MESSAGE(output == expected, "offset " << offset << ", length " << n << ", " << nthreads << " threads");
+            }
+
+            std::vector<T> output(n + 64, 0);
+            sqyd::subtract_sse2(in, n, _threshold, output.data() + offset);
+            BOOST_REQUIRE(output == expected);
+            if(compass::runtime::has(compass::feature::avx2())) {
+                sqyd::subtract_avx2(in, n, _threshold, output.data() + offset);
+                BOOST_REQUIRE(output == expected);
+            }
+            if(compass::runtime::has(compass::feature::avx512bw())) {
+                sqyd::subtract_avx512(in, n, _threshold, output.data() + offset);
+                BOOST_REQUIRE(output == expected);
+            }
+
+            //one threshold per item
+            std::vector<T> thresholds(input.rbegin(), input.rbegin() + n);
+            std::vector<T> expected_each(n + 64, 0);
+            sqyd::subtract_each_scalar(in, n, thresholds.data(), expected_each.data() + offset);
+            std::fill(output.begin(), output.end(), 0);
+            sqyd::subtract_each(in, n, thresholds.data(), output.data() + offset);
+            BOOST_REQUIRE(output == expected_each);
+            sqyd::subtract_each_sse2(in, n, thresholds.data(), output.data() + offset);
+            BOOST_REQUIRE(output == expected_each);
+            if(compass::runtime::has(compass::feature::avx2())) {
+                sqyd::subtract_each_avx2(in, n, thresholds.data(), output.data() + offset);
+                BOOST_REQUIRE(output == expected_each);
+            }
+            if(compass::runtime::has(compass::feature::avx512bw())) {
+                sqyd::subtract_each_avx512(in, n, thresholds.data(), output.data() + offset);
+                BOOST_REQUIRE(output == expected_each);
+            }
+
+            //in-place
+            std::vector<T> data(input.begin(), input.begin() + offset + n);
+            data.resize(n + 64, 0);
+            std::fill(data.begin(), data.begin() + offset, 0);
+            sqyd::subtract_inplace(data.data() + offset, n, _threshold, 3);
+            BOOST_REQUIRE(data == expected);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE( kernels_match_scalar )
+{
+    check_kernels_against_scalar<std::uint8_t>(42);
+    check_kernels_against_scalar<std::uint16_t>(1000);
+    check_kernels_against_scalar<short>(1000);
+}
+
+BOOST_AUTO_TEST_CASE( remove_background_inplace )
+{
+
+    std::vector<unsigned short> data = {0, 5, 10, 11, 65535};
+    sqeazy::remove_background_scheme<unsigned short>::static_encode_inplace(data.data(), data.size(), 10);
+
+    std::vector<unsigned short> expected = {0, 0, 0, 1, 65525};
+    BOOST_CHECK_EQUAL_COLLECTIONS(data.begin(), data.end(), expected.begin(), expected.end());
+}
+
+BOOST_AUTO_TEST_CASE( fused_flatten_matches_two_passes )
+{
+
+    std::vector<std::size_t> shape = {9, 21, 34};
+    const std::size_t len = 9*21*34;
+
+    std::vector<unsigned short> input(len, 0);
+    boost::random::mt19937 rng;
+    boost::random::uniform_int_distribution<unsigned short> values(0,20);
+    for(unsigned short& _value : input)
+        _value = values(rng);
+
+    //two passes: the copy of the input makes flatten_to_neighborhood_scheme::encode leave all untouched pixels
+    //in a state that remove_background_scheme then reduces
+    std::vector<unsigned short> expected(input);
+    sqeazy::flatten_to_neighborhood_scheme<unsigned short> flatten(10, .5);
+    flatten.encode(input.data(), expected.data(), shape);
+    sqeazy::remove_background_scheme<unsigned short>::static_encode_inplace(expected.data(), len, 10);
+
+    for(int nthreads : {1, 3}) {
+        std::vector<unsigned short> output(len, 1);
+        flatten.set_n_threads(nthreads);
+        unsigned short* end = flatten.encode_and_remove_background(input.data(), output.data(), shape);
+        BOOST_REQUIRE(end == output.data() + len);
+        BOOST_CHECK_MESSAGE(output == expected, nthreads << " threads");
+    }
+
+    //a stack without interior is reduced only
+    std::vector<std::size_t> flat_shape = {2, 21, 34};
+    std::vector<unsigned short> output(2*21*34, 1);
+    flatten.encode_and_remove_background(input.data(), output.data(), flat_shape);
+    expected.assign(input.begin(), input.begin() + output.size());
+    sqeazy::remove_background_scheme<unsigned short>::static_encode_inplace(expected.data(), expected.size(), 10);
+    BOOST_CHECK(output == expected);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
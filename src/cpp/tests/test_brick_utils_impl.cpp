@@ -0,0 +1,180 @@
+#define BOOST_TEST_MODULE TEST_BRICK_UTILS_IMPL
+#define BOOST_TEST_MAIN
+#include "boost/test/included/unit_test.hpp"
+#include <numeric>
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <iostream>
+#include "encoders/brick_utils.hpp"
+#include "traits.hpp"
+
+namespace sqy = sqeazy;
+namespace sqyd = sqy::detail;
+
+BOOST_AUTO_TEST_SUITE( layout )
+
+BOOST_AUTO_TEST_CASE( counts_cut_bricks )
+{
+
+  std::vector<std::size_t> shape = {5, 8, 7};
+  std::vector<std::size_t> brick = {4, 4, 4};
+
+  sqyd::brick_layout bricks(shape, brick);
+  BOOST_CHECK_EQUAL(bricks.size(), 2*2*2);
+  BOOST_CHECK_EQUAL(bricks.volume(0), 4*4*4);
+  BOOST_CHECK_EQUAL(bricks.volume(1), 4*4*3);
+  BOOST_CHECK_EQUAL(bricks.volume(7), 1*4*3);
+  BOOST_CHECK_EQUAL(bricks.extent(7, sqy::row_major::z), 1);
+  BOOST_CHECK_EQUAL(bricks.extent(7, sqy::row_major::x), 3);
+
+  std::size_t sum = 0;
+  for(std::size_t i = 0;i<bricks.size();++i)
+    sum += bricks.volume(i);
+
+  BOOST_CHECK_EQUAL(sum, 5*8*7);
+}
+
+BOOST_AUTO_TEST_CASE( rows_cover_4d_stack_once )
+{
+
+  std::vector<std::size_t> shape = {3, 5, 6, 7};
+  std::vector<std::size_t> brick = {2, 2, 4, 3};
+  const std::size_t len = 3*5*6*7;
+
+  sqyd::brick_layout bricks(shape, brick);
+  std::vector<int> hits(len, 0);
+
+  for(std::size_t i = 0;i<bricks.size();++i){
+    std::size_t n_visited = 0;
+    bricks.for_each_row(i, [&](std::size_t _offset, std::size_t _len){
+        for(std::size_t x = 0;x<_len;++x)
+          hits[_offset + x]++;
+        n_visited += _len;
+      });
+    BOOST_CHECK_EQUAL(n_visited, bricks.volume(i));
+  }
+
+  BOOST_CHECK(std::all_of(hits.begin(), hits.end(), [](int _el){ return _el == 1;}));
+}
+
+BOOST_AUTO_TEST_CASE( rows_from_the_middle )
+{
+
+  std::vector<std::size_t> shape = {4, 4, 4};
+  std::vector<std::size_t> brick = {4, 4, 2};
+
+  sqyd::brick_layout bricks(shape, brick);
+  std::vector<std::size_t> offsets;
+
+  bricks.for_each_row(1, [&](std::size_t _offset, std::size_t _len){
+      offsets.push_back(_offset);
+    }, 3, 3);
+
+  //rows 3, 4 and 5 of the second brick: (z=0,y=3), (z=1,y=0), (z=1,y=1) at x=2
+  std::vector<std::size_t> expected = {14, 18, 22};
+  BOOST_CHECK_EQUAL_COLLECTIONS(offsets.begin(), offsets.end(),
+                                expected.begin(), expected.end());
+}
+
+BOOST_AUTO_TEST_CASE( runs_merge_full_rows )
+{
+
+  std::vector<std::size_t> shape = {6, 4, 8};
+  std::vector<std::size_t> brick = {4, 4, 8};
+
+  sqyd::brick_layout bricks(shape, brick);
+  std::vector<std::size_t> lengths;
+
+  bricks.for_each_run(1, [&](std::size_t _offset, std::size_t _len){
+      BOOST_CHECK_EQUAL(_offset, 4*4*8);
+      lengths.push_back(_len);
+    });
+
+  BOOST_REQUIRE_EQUAL(lengths.size(), 1);
+  BOOST_CHECK_EQUAL(lengths.front(), 2*4*8);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE( permute )
+
+BOOST_AUTO_TEST_CASE( identity_roundtrip )
+{
+
+  std::vector<std::size_t> shape = {9, 10, 11};
+  std::vector<std::size_t> brick = {4, 4, 4};
+  const std::size_t len = 9*10*11;
+
+  std::vector<std::uint16_t> input(len, 0);
+  std::iota(input.begin(), input.end(), 0);
+  std::vector<std::uint16_t> stream(len, 0);
+  std::vector<std::uint16_t> output(len, 0);
+
+  sqyd::brick_layout bricks(shape, brick);
+  auto end = sqyd::gather_bricks(input.data(), stream.data(), bricks, std::vector<std::size_t>());
+  BOOST_REQUIRE(end == stream.data() + len);
+
+  //the first brick starts with the first 4 values of the first row, then the first 4 values of the second row
+  BOOST_CHECK_EQUAL(stream[3], 3);
+  BOOST_CHECK_EQUAL(stream[4], 11);
+
+  end = sqyd::scatter_bricks(stream.data(), output.data(), bricks, std::vector<std::size_t>());
+  BOOST_REQUIRE(end == output.data() + len);
+  BOOST_CHECK_EQUAL_COLLECTIONS(input.begin(), input.end(),
+                                output.begin(), output.end());
+}
+
+BOOST_AUTO_TEST_CASE( shuffled_roundtrip_for_any_thread_count )
+{
+
+  std::vector<std::size_t> shape = {65, 40, 47};
+  std::vector<std::size_t> brick = {8, 8, 8};
+  const std::size_t len = 65*40*47;
+
+  std::vector<std::uint16_t> input(len, 0);
+  std::iota(input.begin(), input.end(), 0);
+
+  sqyd::brick_layout bricks(shape, brick);
+  std::vector<std::size_t> order(bricks.size(), 0);
+  std::iota(order.begin(), order.end(), 0);
+  std::shuffle(order.begin(), order.end(), std::mt19937(42));
+
+  std::vector<std::uint16_t> expected(len, 0);
+  sqyd::gather_bricks(input.data(), expected.data(), bricks, order, 1);
+
+  const std::vector<std::size_t> offsets = sqyd::stream_offsets(bricks, order);
+  BOOST_REQUIRE_EQUAL(offsets.size(), bricks.size() + 1);
+  BOOST_CHECK_EQUAL(offsets.back(), len);
+
+  //the brick at stream position 1 starts at its stream offset
+  std::size_t first_voxel = len;
+  bricks.for_each_row(order[1], [&](std::size_t _offset, std::size_t){ first_voxel = _offset; }, 0, 1);
+  BOOST_CHECK_EQUAL(expected[offsets[1]], input[first_voxel]);
+
+  for(int nthreads : {2, 3, 5}){
+    std::vector<std::uint16_t> stream(len, 0);
+    std::vector<std::uint16_t> output(len, 0);
+
+    sqyd::gather_bricks(input.data(), stream.data(), bricks, order, nthreads);
+    BOOST_CHECK(stream == expected);
+
+    sqyd::scatter_bricks(stream.data(), output.data(), bricks, order, nthreads);
+    BOOST_CHECK(output == input);
+  }
+}
+
+BOOST_AUTO_TEST_CASE( rejects_mismatching_order )
+{
+
+  std::vector<std::size_t> shape = {8, 8, 8};
+  std::vector<std::size_t> brick = {4, 4, 4};
+  std::vector<std::uint16_t> input(512, 1);
+  std::vector<std::uint16_t> stream(512, 0);
+
+  sqyd::brick_layout bricks(shape, brick);
+  auto end = sqyd::gather_bricks(input.data(), stream.data(), bricks, std::vector<std::size_t>(3, 0));
+  BOOST_CHECK(end == stream.data());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,245 @@
+#define BOOST_TEST_MODULE TEST_CDF53_WAVELET_SCHEME_IMPL
+#define BOOST_TEST_MAIN
+#include "boost/test/included/unit_test.hpp"
+#include <numeric>
+#include <vector>
+#include <random>
+#include <iostream>
+#include <algorithm>
+#include "array_fixtures.hpp"
+#include "encoders/cdf53_wavelet_scheme_impl.hpp"
+#include "traits.hpp"
+
+typedef sqeazy::array_fixture<std::uint16_t> uint16_cube_of_8;
+
+namespace sqy = sqeazy;
+namespace sqyd = sqy::detail;
+
+BOOST_AUTO_TEST_SUITE( lifting )
+
+BOOST_AUTO_TEST_CASE( line_of_known_values )
+{
+
+  //x = 1 2 3 5: d0 = 2 - (1+3)/2 = 0, d1 = 5 - 3 = 2, s0 = 1 + (0+0+2)/4 = 1, s1 = 3 + (0+2+2)/4 = 4
+  std::vector<std::uint16_t> line = {1,2,3,5};
+  std::vector<sqyd::lifting_53<std::uint16_t>::lane_t> buffer;
+
+  sqyd::lifting_53<std::uint16_t>::lift_row(line.data(), line.size(), true, buffer);
+  std::vector<std::uint16_t> expected = {1,4,0,2};
+  BOOST_CHECK_EQUAL_COLLECTIONS(line.begin(), line.end(), expected.begin(), expected.end());
+
+  sqyd::lifting_53<std::uint16_t>::lift_row(line.data(), line.size(), false, buffer);
+  expected = {1,2,3,5};
+  BOOST_CHECK_EQUAL_COLLECTIONS(line.begin(), line.end(), expected.begin(), expected.end());
+}
+
+BOOST_AUTO_TEST_CASE( lowpass_shapes )
+{
+
+  const std::vector<std::size_t> shape = {9,40,71};
+
+  sqyd::lifting_53<std::uint16_t> planes(3, false);
+  auto ll = planes.lowpass_shape(shape, 2);
+  BOOST_CHECK_EQUAL(ll[sqy::row_major::z], 9);
+  BOOST_CHECK_EQUAL(ll[sqy::row_major::y], 10);
+  BOOST_CHECK_EQUAL(ll[sqy::row_major::x], 18);
+
+  sqyd::lifting_53<std::uint16_t> volume(3, true);
+  ll = volume.lowpass_shape(shape, 3);
+  BOOST_CHECK_EQUAL(ll[sqy::row_major::z], 2);
+  BOOST_CHECK_EQUAL(ll[sqy::row_major::y], 5);
+  BOOST_CHECK_EQUAL(ll[sqy::row_major::x], 9);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_FIXTURE_TEST_SUITE( rt_on_cube , uint16_cube_of_8 )
+
+BOOST_AUTO_TEST_CASE( scheme_defaults )
+{
+
+  sqy::cdf53_wavelet_scheme<value_type> wavelet;
+  BOOST_CHECK_EQUAL(wavelet.name(), "cdf53_wavelet");
+  BOOST_CHECK_EQUAL(wavelet.config(), "levels=2,mode=2d");
+
+  sqy::cdf53_wavelet_scheme<value_type> wavelet3d("levels=3,mode=3d");
+  BOOST_CHECK_EQUAL(wavelet3d.config(), "levels=3,mode=3d");
+}
+
+BOOST_AUTO_TEST_CASE( constant_stack_has_no_details )
+{
+
+  std::vector<std::size_t> shape(dims.begin(), dims.end());
+
+  for(const std::string mode : {"mode=2d", "mode=3d"}){
+    sqy::cdf53_wavelet_scheme<value_type> wavelet("levels=3," + mode);
+    auto rem = wavelet.encode(constant_cube.data(),
+                              to_play_with.data(),
+                              shape);
+    BOOST_REQUIRE(rem == to_play_with.data()+to_play_with.size());
+
+    //all low pass coefficients keep the constant, all high pass coefficients vanish
+    const auto ll = wavelet.transform.lowpass_shape(shape, 3);
+    const std::size_t n_lowpass = ll[0]*ll[1]*ll[2];
+    BOOST_CHECK_EQUAL(std::count(to_play_with.begin(), to_play_with.end(), 0), to_play_with.size() - n_lowpass);
+    BOOST_CHECK_EQUAL(to_play_with[0], constant_cube[0]);
+
+    std::vector<value_type> decoded(to_play_with.size(),0);
+    BOOST_REQUIRE_EQUAL(wavelet.decode(to_play_with.data(), decoded.data(), shape),0);
+    BOOST_CHECK(decoded == constant_cube);
+  }
+}
+
+BOOST_AUTO_TEST_CASE( roundtrip_ramp )
+{
+
+  std::vector<std::size_t> shape(dims.begin(), dims.end());
+
+  sqy::cdf53_wavelet_scheme<value_type> wavelet("levels=2,mode=3d");
+  wavelet.encode(incrementing_cube.data(),
+                 to_play_with.data(),
+                 shape);
+
+  auto res = wavelet.decode(to_play_with.data(),
+                            constant_cube.data(),
+                            shape);
+
+  BOOST_REQUIRE_EQUAL(res,0);
+  BOOST_CHECK_EQUAL_COLLECTIONS(constant_cube.begin(), constant_cube.end(),
+                                incrementing_cube.begin(), incrementing_cube.end());
+
+  //inplace
+  std::copy(incrementing_cube.begin(), incrementing_cube.end(), constant_cube.begin());
+  wavelet.encode(constant_cube.data(), constant_cube.data(), shape);
+  BOOST_CHECK_EQUAL_COLLECTIONS(constant_cube.begin(), constant_cube.end(),
+                                to_play_with.begin(), to_play_with.end());
+
+  res = wavelet.decode(constant_cube.data(), constant_cube.data(), shape);
+  BOOST_REQUIRE_EQUAL(res,0);
+  BOOST_CHECK_EQUAL_COLLECTIONS(constant_cube.begin(), constant_cube.end(),
+                                incrementing_cube.begin(), incrementing_cube.end());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE( odd_shapes )
+
+BOOST_AUTO_TEST_CASE( roundtrip_full_range_for_any_thread_count )
+{
+
+  const std::vector<std::size_t> shape = {9,40,71};
+  const std::vector<std::uint16_t> input = sqy::random_stack<std::uint16_t>(9*40*71, 0, 65535, 42);
+
+  for(const std::string mode : {"mode=2d", "mode=3d"}){
+    for(int levels : {1, 2, 3}){
+
+      std::vector<std::uint16_t> reference;
+      const std::string config = "levels=" + std::to_string(levels) + "," + mode;
+
+      for(int nthreads : {1, 3}){
+        sqy::cdf53_wavelet_scheme<std::uint16_t> wavelet(config);
+        wavelet.set_n_threads(nthreads);
+
+        std::vector<std::uint16_t> encoded(input.size(),0);
+        std::vector<std::uint16_t> decoded(input.size(),0);
+        wavelet.encode(input.data(), encoded.data(), shape);
+        BOOST_REQUIRE_EQUAL(wavelet.decode(encoded.data(), decoded.data(), shape),0);
+        BOOST_CHECK_MESSAGE(decoded == input, config << " with " << nthreads << " threads");
+
+        if(reference.empty())
+          reference = encoded;
+        else
+          BOOST_CHECK(encoded == reference);
+      }
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE( levels_are_capped_by_the_smallest_extent )
+{
+
+  const std::vector<std::size_t> shape = {9,40,71};
+  const std::vector<std::uint16_t> input = sqy::random_stack<std::uint16_t>(9*40*71, 0, 65535, 5);
+
+  //40 items along y take 6 levels, 9 planes along z take 4
+  for(const std::string mode : {"mode=2d", "mode=3d"}){
+
+    sqy::cdf53_wavelet_scheme<std::uint16_t> wavelet("levels=100," + mode);
+    std::vector<std::uint16_t> encoded(input.size(),0);
+    wavelet.encode(input.data(), encoded.data(), shape);
+    BOOST_CHECK_EQUAL(wavelet.transform.levels, mode == "mode=2d" ? 6 : 4);
+
+    sqy::cdf53_wavelet_scheme<std::uint16_t> decoder(wavelet.config());
+    std::vector<std::uint16_t> decoded(input.size(),0);
+    BOOST_REQUIRE_EQUAL(decoder.decode(encoded.data(), decoded.data(), shape),0);
+    BOOST_CHECK(decoded == input);
+  }
+
+  sqy::cdf53_wavelet_scheme<std::uint16_t> unknown("mode=4d");
+  BOOST_CHECK_EQUAL(unknown.config(), "levels=2,mode=2d");
+}
+
+BOOST_AUTO_TEST_CASE( roundtrip_signed_and_bytes )
+{
+
+  const std::vector<std::size_t> shape = {5,13,37};
+  const std::size_t len = 5*13*37;
+
+  const std::vector<short> shorts = sqy::random_stack<short>(len, -32768, 32767, 13);
+  const std::vector<std::uint8_t> bytes = sqy::random_stack<std::uint8_t>(len, 0, 255, 7);
+
+  for(const std::string mode : {"levels=3,mode=2d", "levels=3,mode=3d"}){
+
+    sqy::cdf53_wavelet_scheme<short> swavelet(mode);
+    std::vector<short> sencoded(len,0);
+    std::vector<short> sdecoded(len,0);
+    swavelet.encode(shorts.data(), sencoded.data(), shape);
+    BOOST_REQUIRE_EQUAL(swavelet.decode(sencoded.data(), sdecoded.data(), shape),0);
+    BOOST_CHECK(sdecoded == shorts);
+
+    sqy::cdf53_wavelet_scheme<std::uint8_t> bwavelet(mode);
+    std::vector<std::uint8_t> bencoded(len,0);
+    std::vector<std::uint8_t> bdecoded(len,0);
+    bwavelet.encode(bytes.data(), bencoded.data(), shape);
+    BOOST_REQUIRE_EQUAL(bwavelet.decode(bencoded.data(), bdecoded.data(), shape),0);
+    BOOST_CHECK(bdecoded == bytes);
+  }
+}
+
+BOOST_AUTO_TEST_CASE( partial_decode_yields_lowpass_of_level )
+{
+
+  const std::vector<std::size_t> shape = {6,30,43};
+  const std::vector<std::uint16_t> input = sqy::random_stack<std::uint16_t>(6*30*43, 0, 4095, 3);
+
+  for(const std::string mode : {"mode=2d", "mode=3d"}){
+
+    //the low pass of level 1 is the stack transformed by a single level
+    sqy::cdf53_wavelet_scheme<std::uint16_t> single("levels=1," + mode);
+    std::vector<std::uint16_t> expected(input.size(),0);
+    single.encode(input.data(), expected.data(), shape);
+    const auto ll = single.transform.lowpass_shape(shape, 1);
+
+    sqy::cdf53_wavelet_scheme<std::uint16_t> wavelet("levels=3," + mode);
+    std::vector<std::uint16_t> encoded(input.size(),0);
+    wavelet.encode(input.data(), encoded.data(), shape);
+
+    std::vector<std::uint16_t> preview(ll[0]*ll[1]*ll[2],0);
+    BOOST_REQUIRE_EQUAL(wavelet.decode_lowpass(encoded.data(), preview.data(), shape, 1),0);
+
+    std::size_t n_mismatches = 0;
+    for(std::size_t z = 0;z<ll[0];++z)
+      for(std::size_t y = 0;y<ll[1];++y)
+        for(std::size_t x = 0;x<ll[2];++x)
+          n_mismatches += preview[(z*ll[1] + y)*ll[2] + x] != expected[(z*shape[1] + y)*shape[2] + x];
+
+    BOOST_CHECK_EQUAL(n_mismatches, 0);
+
+    //level 0 is the stack itself
+    std::vector<std::uint16_t> full(input.size(),0);
+    BOOST_REQUIRE_EQUAL(wavelet.decode_lowpass(encoded.data(), full.data(), shape, 0),0);
+    BOOST_CHECK(full == input);
+  }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -160,3 +160,122 @@ BOOST_AUTO_TEST_CASE( unsigned_new_api )
 }
 
 BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE( wavefront_decode )
+
+BOOST_AUTO_TEST_CASE( ranges_follow_halo_geometry )
+{
+  const std::size_t axis_size = 8;
+  std::vector<std::size_t> shape(3,axis_size);
+
+  std::vector<std::size_t> offsets;
+  sqeazy::halo<sqeazy::last_plane_neighborhood<3> , std::size_t> geometry(axis_size,axis_size,axis_size);
+  geometry.compute_offsets_in_x(offsets);
+  const std::size_t halo_size_x = geometry.non_halo_end(0)-geometry.non_halo_begin(0);
+
+  std::vector<int> expected(axis_size*axis_size*axis_size,0);
+  for(std::size_t o : offsets)
+    for(std::size_t x = 0;x<halo_size_x;++x)
+      expected[o+x] = 1;
+
+  std::vector<int> found(expected.size(),0);
+  auto ranges = sqeazy::neighborhood_mean<sqeazy::last_plane_neighborhood<3> >::predicted_ranges(shape);
+  for(std::size_t r = 0;r<ranges.size();++r){
+    if(r)
+      BOOST_CHECK_LT(ranges[r-1].second, ranges[r].first);
+    for(std::size_t i = ranges[r].first;i<ranges[r].second;++i)
+      found[i] = 1;
+  }
+
+  BOOST_CHECK(found == expected);
+  BOOST_CHECK_EQUAL(sqeazy::neighborhood_mean<sqeazy::last_plane_neighborhood<3> >::causal_distance(shape),
+                    axis_size*axis_size - axis_size - 1);
+}
+
+BOOST_AUTO_TEST_CASE( roundtrip_on_odd_shapes_for_any_thread_count )
+{
+
+  for(const std::vector<std::size_t>& shape : {std::vector<std::size_t>({33,45,61}),
+        std::vector<std::size_t>({20,64,70})}){
+
+    const std::size_t len = std::accumulate(shape.begin(), shape.end(),1,std::multiplies<std::size_t>());
+    std::vector<unsigned short> input(len,0);
+    for(std::size_t i = 0;i<len;++i)
+      input[i] = (i*7919 + (i/shape[2])*31) % 4096;
+
+    sqeazy::diff_scheme<unsigned short> diff;
+    std::vector<unsigned short> encoded(len,0);
+    diff.encode(input.data(), encoded.data(), shape);
+
+    std::vector<unsigned short> reference;
+    for(int nthreads : {1, 3}){
+      diff.set_n_threads(nthreads);
+      std::vector<unsigned short> decoded(len,0);
+      BOOST_REQUIRE_EQUAL(diff.decode(encoded.data(), decoded.data(), shape),0);
+      BOOST_CHECK(decoded == input);
+
+      if(reference.empty())
+        reference = decoded;
+      else
+        BOOST_CHECK(decoded == reference);
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE( roundtrip_on_line )
+{
+
+  std::vector<std::size_t> shape = {5,17,29};
+  const std::size_t len = 5*17*29;
+  std::vector<short> input(len,0);
+  for(std::size_t i = 0;i<len;++i)
+    input[i] = short((i*131) % 2000) - 1000;
+
+  sqeazy::diff_scheme<short, sqeazy::last_pixels_on_line_neighborhood<> > diff;
+  std::vector<short> encoded(len,0);
+  std::vector<short> decoded(len,0);
+  diff.encode(input.data(), encoded.data(), shape);
+  BOOST_REQUIRE_EQUAL(diff.decode(encoded.data(), decoded.data(), shape),0);
+
+  BOOST_CHECK(decoded == input);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE( sliding_sums )
+
+BOOST_AUTO_TEST_CASE( encode_matches_naive_sum )
+{
+
+  typedef sqeazy::last_plane_neighborhood<3> neighborhood;
+  typedef sqeazy::diff_scheme<unsigned short, neighborhood> diff_type;
+
+  std::vector<std::size_t> shape = {20,64,70};
+  const std::size_t len = 20*64*70;
+  std::vector<unsigned short> input(len,0);
+  for(std::size_t i = 0;i<len;++i)
+    input[i] = (i*7919) % 65536;
+
+  //residuals as computed voxel by voxel
+  std::vector<unsigned short> expected(input);
+  short* signed_expected = reinterpret_cast<short*>(expected.data());
+  for(const auto& range : sqeazy::neighborhood_mean<neighborhood>::predicted_ranges(shape)){
+    for(std::size_t i = range.first;i<range.second;++i){
+      diff_type::sum_type local_sum = sqeazy::naive_sum<neighborhood>(input.data(), i,
+                                                                      shape[sqeazy::row_major::w],
+                                                                      shape[sqeazy::row_major::h],
+                                                                      shape[sqeazy::row_major::d]);
+      signed_expected[i] = input[i] - local_sum/sqeazy::num_traversed_pixels<neighborhood>();
+    }
+  }
+
+  for(int nthreads : {1, 3}){
+    diff_type diff;
+    diff.set_n_threads(nthreads);
+    std::vector<unsigned short> encoded(len,0);
+    diff.encode(input.data(), encoded.data(), shape);
+    BOOST_CHECK(encoded == expected);
+  }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -7,6 +7,8 @@
 #include <bitset>
 #include <map>
 #include <string>
+#include <random>
+#include <thread>
 
 #include "array_fixtures.hpp"
 
@@ -459,4 +461,120 @@ BOOST_AUTO_TEST_CASE( rt_with_alien_config )
 }
 
 
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE( frame_metric )
+
+BOOST_AUTO_TEST_CASE( simd_sum_matches_scalar_16bit )
+{
+
+  std::mt19937 gen(7);
+  std::uniform_int_distribution<std::uint16_t> dist(0,0xffff);
+
+  for(std::size_t len : {0u, 1u, 15u, 16u, 17u, 255u, 4099u}){
+    std::vector<std::uint16_t> values(len);
+    for(auto& v : values)
+      v = dist(gen);
+
+    BOOST_CHECK_EQUAL(sqyd::frame_metric::sum(values.data(), len),
+                      sqyd::frame_metric::sum_scalar(values.data(), len));
+  }
+
+  //more saturated items than fit into the 32-bit lanes of the kernels
+  std::vector<std::uint16_t> saturated((1 << 20) + 3, 0xffff);
+  BOOST_CHECK_EQUAL(sqyd::frame_metric::sum(saturated.data(), saturated.size()),
+                    std::uint64_t(saturated.size())*0xffff);
+
+}
+
+BOOST_AUTO_TEST_CASE( simd_sum_matches_scalar_8bit )
+{
+
+  std::mt19937 gen(7);
+  std::uniform_int_distribution<int> dist(0,0xff);
+
+  for(std::size_t len : {0u, 1u, 31u, 32u, 33u, 1025u}){
+    std::vector<std::uint8_t> values(len);
+    for(auto& v : values)
+      v = dist(gen);
+
+    BOOST_CHECK_EQUAL(sqyd::frame_metric::sum(values.data(), len),
+                      sqyd::frame_metric::sum_scalar(values.data(), len));
+  }
+
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_FIXTURE_TEST_SUITE( ranking , uint16_cube_of_8 )
+
+BOOST_AUTO_TEST_CASE( equal_frames_roundtrip )
+{
+
+  //frames 2*k and 2*k+1 carry the same values
+  const std::size_t frame_size = dims[sqy::row_major::y]*dims[sqy::row_major::x];
+  for(std::size_t i = 0;i<incrementing_cube.size();++i)
+    incrementing_cube[i] = (dims[sqy::row_major::z] - (i / frame_size)/2);
+
+  for(int nthreads : {1, int(std::thread::hardware_concurrency())}){
+
+    sqyd::frame_shuffle in_frames_of;
+    auto rem = in_frames_of.encode(incrementing_cube.cbegin(), incrementing_cube.cend(),
+                                   to_play_with.begin(),
+                                   dims,
+                                   nthreads);
+    BOOST_REQUIRE(rem == to_play_with.end());
+
+    std::vector<std::size_t> sorted_map = in_frames_of.decode_map;
+    std::sort(sorted_map.begin(), sorted_map.end());
+    for(std::size_t i = 0;i<sorted_map.size();++i)
+      BOOST_CHECK_EQUAL(sorted_map[i], i);
+
+    //equal frames keep their order
+    BOOST_CHECK_LT(in_frames_of.decode_map[0], in_frames_of.decode_map[1]);
+
+    std::fill(constant_cube.begin(), constant_cube.end(),0);
+    in_frames_of.decode(to_play_with.cbegin(), to_play_with.cend(),
+                        constant_cube.begin(),
+                        dims,
+                        nthreads);
+    BOOST_CHECK_EQUAL_COLLECTIONS(incrementing_cube.begin(), incrementing_cube.end(),
+                                  constant_cube.begin(), constant_cube.end());
+  }
+
+}
+
+BOOST_AUTO_TEST_CASE( metric_stride_roundtrip )
+{
+
+  label_stack_by_frame_reverse(incrementing_cube.begin(),dims,1);
+  auto expected = incrementing_cube;
+
+  sqy::frame_shuffle_scheme<std::uint16_t> scheme("metric_stride=3");
+  BOOST_CHECK_EQUAL(scheme.metric_stride, 3u);
+
+  std::vector<std::size_t> shape(dims.begin(), dims.end());
+  auto rem = scheme.encode(incrementing_cube.data(),
+                           to_play_with.data(),
+                           shape);
+  BOOST_REQUIRE(rem == (to_play_with.data()+to_play_with.size()));
+
+  //the frames are labelled in descending order, so sampling every 3rd row still reverses them
+  BOOST_CHECK_EQUAL(to_play_with.front(), expected.back());
+
+  std::string config = scheme.config();
+  BOOST_CHECK_NE(config.find("metric_stride=3"), std::string::npos);
+  sqy::frame_shuffle_scheme<std::uint16_t> another(config);
+  BOOST_CHECK_EQUAL(another.metric_stride, 3u);
+
+  auto dec_rem = another.decode(to_play_with.data(),
+                                incrementing_cube.data(),
+                                shape);
+
+  BOOST_REQUIRE_EQUAL(dec_rem, sqy::SUCCESS);
+  BOOST_CHECK_EQUAL_COLLECTIONS(expected.begin(), expected.end(),
+                                incrementing_cube.begin(), incrementing_cube.end());
+
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,179 @@
+#define BOOST_TEST_MODULE TEST_HILBERT_REORDER_SCHEME_IMPL
+#define BOOST_TEST_MAIN
+#include "boost/test/included/unit_test.hpp"
+#include <numeric>
+#include <vector>
+#include <iostream>
+#include <algorithm>
+#include <cstdlib>
+#include "array_fixtures.hpp"
+#include "encoders/hilbert_reorder_scheme_impl.hpp"
+#include "traits.hpp"
+
+typedef sqeazy::array_fixture<std::uint16_t> uint16_cube_of_8;
+
+namespace sqy = sqeazy;
+namespace sqyd = sqy::detail;
+
+BOOST_AUTO_TEST_SUITE( curve )
+
+BOOST_AUTO_TEST_CASE( visits_every_voxel_once )
+{
+
+  for(std::size_t ts : {2, 4, 8, 16}){
+    sqyd::hilbert curve_of(ts);
+    BOOST_REQUIRE_EQUAL(curve_of.curve.size(), ts*ts*ts);
+
+    std::vector<std::uint32_t> sorted = curve_of.curve;
+    std::sort(sorted.begin(), sorted.end());
+    for(std::size_t i = 0;i<sorted.size();++i)
+      BOOST_REQUIRE_EQUAL(sorted[i], i);
+  }
+}
+
+BOOST_AUTO_TEST_CASE( steps_to_neighbors_only )
+{
+
+  const std::size_t ts = 16;
+  sqyd::hilbert curve_of(ts);
+
+  BOOST_CHECK_EQUAL(curve_of.curve.front(), 0);
+
+  for(std::size_t i = 1;i<curve_of.curve.size();++i){
+    const int lhs = curve_of.curve[i-1];
+    const int rhs = curve_of.curve[i];
+
+    const int distance = std::abs(lhs / int(ts*ts) - rhs / int(ts*ts))
+      + std::abs((lhs / int(ts)) % int(ts) - (rhs / int(ts)) % int(ts))
+      + std::abs(lhs % int(ts) - rhs % int(ts));
+
+    BOOST_REQUIRE_EQUAL(distance, 1);
+  }
+}
+
+BOOST_AUTO_TEST_CASE( tile_size_is_power_of_2 )
+{
+
+  BOOST_CHECK_EQUAL(sqyd::hilbert(8).tile_size, 8);
+  BOOST_CHECK_EQUAL(sqyd::hilbert(12).tile_size, 8);
+  BOOST_CHECK_EQUAL(sqyd::hilbert(1).tile_size, 2);
+  BOOST_CHECK_EQUAL(sqyd::hilbert(1024).tile_size, 64);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_FIXTURE_TEST_SUITE( rt_on_ramp , uint16_cube_of_8 )
+
+BOOST_AUTO_TEST_CASE( scheme_defaults )
+{
+
+  sqy::hilbert_reorder_scheme<value_type> hilbert_of;
+  BOOST_CHECK_EQUAL(hilbert_of.tile_size, 16);
+  BOOST_CHECK_EQUAL(hilbert_of.config(), "tile_size=16");
+
+  sqy::hilbert_reorder_scheme<value_type> hilbert_of6("tile_size=6");
+  BOOST_CHECK_EQUAL(hilbert_of6.tile_size, 4);
+  BOOST_CHECK_EQUAL(hilbert_of6.config(), "tile_size=4");
+
+  sqy::hilbert_reorder_scheme<value_type> hilbert_of_negative("tile_size=-4");
+  BOOST_CHECK_EQUAL(hilbert_of_negative.tile_size, 16);
+  BOOST_CHECK_EQUAL(hilbert_of_negative.encoder.tile_size, 16);
+}
+
+BOOST_AUTO_TEST_CASE( tile_of_4 )
+{
+
+  std::vector<std::size_t> shape(dims.begin(), dims.end());
+
+  sqy::hilbert_reorder_scheme<value_type> hilbert_of("tile_size=4");
+  auto rem = hilbert_of.encode(incrementing_cube.data(),
+                               to_play_with.data(),
+                               shape);
+  BOOST_REQUIRE(rem != nullptr);
+  BOOST_REQUIRE_EQUAL(rem,to_play_with.data()+to_play_with.size());
+
+  //the first tile is stored along the curve
+  for(std::size_t i = 0;i<64;++i){
+    const std::uint32_t pos = hilbert_of.encoder.curve[i];
+    BOOST_REQUIRE_EQUAL(to_play_with[i], incrementing_cube[((pos / 16)*dims[sqy::row_major::y] + (pos / 4) % 4)*dims[sqy::row_major::x] + pos % 4]);
+  }
+
+  auto res = hilbert_of.decode(to_play_with.data(),
+                               constant_cube.data(),
+                               shape);
+
+  BOOST_REQUIRE_EQUAL(res,0);
+  BOOST_CHECK_EQUAL_COLLECTIONS(constant_cube.begin(), constant_cube.end(),
+                                incrementing_cube.begin(), incrementing_cube.end());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE( odd_shapes )
+
+BOOST_AUTO_TEST_CASE( anisotropic_with_cut_tiles )
+{
+
+  std::vector<std::size_t> shape = {9,40,70};
+  std::size_t len = std::accumulate(shape.begin(), shape.end(),
+                                    1.,
+                                    std::multiplies<std::size_t>()
+    );
+
+  std::vector<std::uint16_t> src(len,0);
+  std::iota(src.begin(), src.end(),0);
+
+  std::vector<std::uint16_t> enc(len,0);
+  std::vector<std::uint16_t> dec(len,0);
+
+  for(int nthreads : {1, 3}){
+    sqyd::hilbert hilbert_of(8);
+    auto rem = hilbert_of.encode(src.cbegin(), src.cend(),
+                                 enc.begin(),
+                                 shape,
+                                 nthreads);
+    BOOST_REQUIRE(rem == enc.end());
+
+    //the last tile in the first tile row is cut to 6 voxels in x, it starts with the first voxel of the curve
+    const std::size_t cut_tile_offset = 8*8*8*8;
+    BOOST_CHECK_EQUAL(enc[cut_tile_offset], src[64]);
+
+    std::fill(dec.begin(), dec.end(), 0);
+    auto res = hilbert_of.decode(enc.cbegin(), enc.cend(),
+                                 dec.begin(),
+                                 shape,
+                                 nthreads);
+    BOOST_REQUIRE(res == dec.end());
+    BOOST_CHECK_EQUAL_COLLECTIONS(src.begin(), src.end(),
+                                  dec.begin(), dec.end());
+  }
+}
+
+BOOST_AUTO_TEST_CASE( offsets_follow_the_shape )
+{
+
+  sqyd::hilbert hilbert_of(8);
+
+  for(const std::vector<std::size_t>& shape : {std::vector<std::size_t>{9,40,70},
+                                               std::vector<std::size_t>{9,40,70},
+                                               std::vector<std::size_t>{12,20,33}}){
+
+    const std::size_t len = std::accumulate(shape.begin(), shape.end(), std::size_t(1), std::multiplies<std::size_t>());
+    std::vector<std::uint16_t> src(len,0);
+    std::iota(src.begin(), src.end(),0);
+    std::vector<std::uint16_t> enc(len,0);
+    std::vector<std::uint16_t> dec(len,0);
+
+    const auto before = hilbert_of.cached_offsets;
+    hilbert_of.encode(src.cbegin(), src.cend(), enc.begin(), shape);
+    BOOST_CHECK(hilbert_of.cached_offsets->shape == shape);
+    if(before && before->shape == shape)
+      BOOST_CHECK(hilbert_of.cached_offsets == before);
+
+    hilbert_of.decode(enc.cbegin(), enc.cend(), dec.begin(), shape);
+    BOOST_CHECK_EQUAL_COLLECTIONS(src.begin(), src.end(),
+                                  dec.begin(), dec.end());
+  }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -87,3 +87,60 @@ BOOST_AUTO_TEST_CASE( ramp_with_2_threads ){
   BOOST_CHECK_EQUAL( serial_sum, parallel_sum);
 }
 BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE( sampled_fill )
+
+BOOST_AUTO_TEST_CASE( full_fraction_equals_parallel ){
+
+  std::vector<std::uint16_t> data(1 << 16,0);
+  std::uint32_t c = 0;
+  for( std::uint16_t& el : data)
+    el = c++ % 32;
+
+  auto expected = sqeazy::detail::parallel::create_histogram(data.begin(), data.end(),2);
+
+  std::vector<std::uint32_t> received(expected.size(),0);
+  sqeazy::detail::parallel::fill_histogram_sampled(data.begin(), data.end(), received.begin(), 1.f, false, 2);
+
+  BOOST_CHECK( std::equal(expected.begin(), expected.end(), received.begin()) );
+
+}
+
+BOOST_AUTO_TEST_CASE( fraction_of_ramp ){
+
+  const std::size_t block_size = 1 << 12;
+  std::vector<std::uint16_t> data(64*block_size,0);
+  std::uint32_t c = 0;
+  for( std::uint16_t& el : data)
+    el = c++ % 32;
+
+  for(bool random : {false, true}){
+    for(int nthreads : {1,2}){
+      std::vector<std::uint32_t> histo(1 << 16,0);
+      sqeazy::detail::parallel::fill_histogram_sampled(data.begin(), data.end(), histo.begin(),
+                                                       .25f, random, nthreads, block_size);
+
+      std::size_t sum = std::accumulate(histo.begin(), histo.end(), std::size_t(0));
+      BOOST_CHECK_EQUAL(sum, 16*block_size);
+
+      //every block contains the full ramp
+      for(int i = 0;i<32;++i)
+        BOOST_CHECK_EQUAL(histo[i], sum/32);
+    }
+  }
+
+}
+
+BOOST_AUTO_TEST_CASE( earth_movers_distance_of_shifted_histograms ){
+
+  std::vector<std::uint32_t> lhs(64,0);
+  std::vector<std::uint32_t> rhs(64,0);
+  lhs[10] = 5;
+  rhs[13] = 7;
+
+  BOOST_CHECK_CLOSE(sqeazy::detail::earth_movers_distance(lhs.begin(), lhs.end(), lhs.begin()), 0., 1e-6);
+  BOOST_CHECK_CLOSE(sqeazy::detail::earth_movers_distance(lhs.begin(), lhs.end(), rhs.begin()), 3., 1e-6);
+
+}
+BOOST_AUTO_TEST_SUITE_END()
+
@@ -0,0 +1,182 @@
+#define BOOST_TEST_MODULE TEST_MED_PREDICT_SCHEME_IMPL
+#define BOOST_TEST_MAIN
+#include "boost/test/included/unit_test.hpp"
+#include <numeric>
+#include <vector>
+#include <random>
+#include <iostream>
+#include <algorithm>
+#include "array_fixtures.hpp"
+#include "encoders/med_predict_scheme_impl.hpp"
+#include "traits.hpp"
+
+typedef sqeazy::array_fixture<std::uint16_t> uint16_cube_of_8;
+
+namespace sqy = sqeazy;
+namespace sqyd = sqy::detail;
+
+BOOST_AUTO_TEST_SUITE( predictor )
+
+BOOST_AUTO_TEST_CASE( zigzag_maps_small_magnitudes_first )
+{
+
+  BOOST_CHECK_EQUAL(sqyd::zigzag_encode<std::uint16_t>(0), 0);
+  BOOST_CHECK_EQUAL(sqyd::zigzag_encode<std::uint16_t>(-1), 1);
+  BOOST_CHECK_EQUAL(sqyd::zigzag_encode<std::uint16_t>(1), 2);
+  BOOST_CHECK_EQUAL(sqyd::zigzag_encode<std::uint16_t>(-2), 3);
+  BOOST_CHECK_EQUAL(sqyd::zigzag_encode<std::uint16_t>(65535), 1);
+
+  for(int i = 0;i<(1 << 16);++i){
+    const std::uint16_t value = i;
+    BOOST_REQUIRE_EQUAL(std::uint16_t(sqyd::zigzag_decode(sqyd::zigzag_encode<std::uint16_t>(value))), value);
+  }
+}
+
+BOOST_AUTO_TEST_CASE( median_edge_detector )
+{
+
+  //edge above: take the smaller neighbor
+  BOOST_CHECK_EQUAL(sqyd::med_of(10, 20, 30), 10);
+  //edge left: take the larger neighbor
+  BOOST_CHECK_EQUAL(sqyd::med_of(10, 20, 5), 20);
+  //smooth: plane through the neighbors
+  BOOST_CHECK_EQUAL(sqyd::med_of(10, 20, 15), 15);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_FIXTURE_TEST_SUITE( rt_on_ramp , uint16_cube_of_8 )
+
+BOOST_AUTO_TEST_CASE( scheme_defaults )
+{
+
+  sqy::med_predict_scheme<value_type> med;
+  BOOST_CHECK_EQUAL(med.name(), "med_predict");
+  BOOST_CHECK_EQUAL(med.config(), "mode=2d");
+
+  sqy::med_predict_scheme<value_type> med3d("mode=3d");
+  BOOST_CHECK_EQUAL(med3d.config(), "mode=3d");
+}
+
+BOOST_AUTO_TEST_CASE( ramp_leaves_constant_residuals )
+{
+
+  std::vector<std::size_t> shape(dims.begin(), dims.end());
+
+  sqy::med_predict_scheme<value_type> med;
+  auto rem = med.encode(incrementing_cube.data(),
+                        to_play_with.data(),
+                        shape);
+  BOOST_REQUIRE(rem == to_play_with.data()+to_play_with.size());
+
+  //the first voxel of every plane is stored as is; the upper left neighbor of any other voxel is smaller
+  //than the left and upper one, so the larger of them (the left one) is predicted and the residual is 1
+  const std::size_t len_x = dims[sqy::row_major::x];
+  const std::size_t frame = dims[sqy::row_major::y]*len_x;
+  for(std::size_t z = 0;z<dims[sqy::row_major::z];++z){
+    BOOST_CHECK_EQUAL(to_play_with[z*frame], sqyd::zigzag_encode<value_type>(incrementing_cube[z*frame]));
+    BOOST_CHECK_EQUAL(to_play_with[z*frame + len_x], sqyd::zigzag_encode<value_type>(len_x));
+    BOOST_CHECK_EQUAL(to_play_with[z*frame + len_x + 1], sqyd::zigzag_encode<value_type>(1));
+    BOOST_CHECK_EQUAL(to_play_with[(z+1)*frame - 1], sqyd::zigzag_encode<value_type>(1));
+  }
+
+  auto res = med.decode(to_play_with.data(),
+                        constant_cube.data(),
+                        shape);
+
+  BOOST_REQUIRE_EQUAL(res,0);
+  BOOST_CHECK_EQUAL_COLLECTIONS(constant_cube.begin(), constant_cube.end(),
+                                incrementing_cube.begin(), incrementing_cube.end());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE( odd_shapes )
+
+BOOST_AUTO_TEST_CASE( roundtrip_full_range_for_any_thread_count )
+{
+
+  std::vector<std::size_t> shape = {9,40,71};
+  const std::size_t len = 9*40*71;
+
+  std::mt19937 gen(42);
+  std::uniform_int_distribution<int> dist(0, 65535);
+  std::vector<std::uint16_t> input(len,0);
+  for(auto& v : input)
+    v = dist(gen);
+
+  for(const std::string mode : {"mode=2d", "mode=3d"}){
+
+    std::vector<std::uint16_t> reference;
+
+    for(int nthreads : {1, 3}){
+      sqy::med_predict_scheme<std::uint16_t> med(mode);
+      med.set_n_threads(nthreads);
+
+      std::vector<std::uint16_t> encoded(len,0);
+      std::vector<std::uint16_t> decoded(len,0);
+      med.encode(input.data(), encoded.data(), shape);
+      BOOST_REQUIRE_EQUAL(med.decode(encoded.data(), decoded.data(), shape),0);
+      BOOST_CHECK(decoded == input);
+
+      if(reference.empty())
+        reference = encoded;
+      else
+        BOOST_CHECK(encoded == reference);
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE( roundtrip_signed )
+{
+
+  std::vector<std::size_t> shape = {11,13,37};
+  const std::size_t len = 11*13*37;
+
+  std::mt19937 gen(13);
+  std::uniform_int_distribution<int> dist(-32768, 32767);
+  std::vector<short> input(len,0);
+  for(auto& v : input)
+    v = dist(gen);
+
+  for(const std::string mode : {"mode=2d", "mode=3d"}){
+    sqy::med_predict_scheme<short> med(mode);
+
+    std::vector<short> encoded(len,0);
+    std::vector<short> decoded(len,0);
+    med.encode(input.data(), encoded.data(), shape);
+    BOOST_REQUIRE_EQUAL(med.decode(encoded.data(), decoded.data(), shape),0);
+    BOOST_CHECK(decoded == input);
+  }
+}
+
+BOOST_AUTO_TEST_CASE( inter_plane_removes_static_background )
+{
+
+  std::vector<std::size_t> shape = {6,17,23};
+  const std::size_t frame = 17*23;
+  const std::size_t len = 6*frame;
+
+  std::mt19937 gen(7);
+  std::uniform_int_distribution<int> dist(0, 200);
+  std::vector<std::uint8_t> input(len,0);
+  for(std::size_t i = 0;i<frame;++i)
+    input[i] = dist(gen);
+  for(std::size_t z = 1;z<6;++z)
+    for(std::size_t i = 0;i<frame;++i)
+      input[z*frame + i] = input[i] + z;
+
+  sqy::med_predict_scheme<std::uint8_t> med("mode=3d");
+  std::vector<std::uint8_t> encoded(len,0);
+  std::vector<std::uint8_t> decoded(len,0);
+  med.encode(input.data(), encoded.data(), shape);
+
+  //planes differ by a constant, only the first voxel of every plane but the first carries a residual
+  for(std::size_t z = 1;z<6;++z)
+    BOOST_CHECK_EQUAL(std::count(encoded.begin() + z*frame + 1, encoded.begin() + (z+1)*frame, 0), frame - 1);
+
+  BOOST_REQUIRE_EQUAL(med.decode(encoded.data(), decoded.data(), shape),0);
+  BOOST_CHECK(decoded == input);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
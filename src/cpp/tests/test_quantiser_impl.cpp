@@ -146,15 +146,15 @@ BOOST_AUTO_TEST_CASE( embryo_roundtrip_2threads ){
 
 BOOST_AUTO_TEST_CASE( embryo_roundtrip_scheme_api ){
 
-  std::vector<uint8_t> encoded(embryo_.num_elements(),0);
-
   sqeazy::quantiser_scheme<uint16_t,uint8_t> shrinker;
-  shrinker.encode(embryo_.data(),&encoded[0],embryo_.num_elements());
+  std::vector<uint8_t> encoded(shrinker.max_encoded_size(embryo_.num_elements()*sizeof(uint16_t)),0);
+  uint8_t* end = shrinker.encode(embryo_.data(),&encoded[0],embryo_.num_elements());
 
-  std::vector<uint16_t> reconstructed(encoded.size(),0);
+  std::vector<uint16_t> reconstructed(embryo_.num_elements(),0);
   shrinker.decode(&encoded[0],
           &reconstructed[0],
-          encoded.size());
+          end - &encoded[0],
+          reconstructed.size());
 
   BOOST_CHECK_EQUAL_COLLECTIONS(reconstructed.begin(), reconstructed.end(),embryo_.data(),
                 embryo_.data()+ embryo_.num_elements());
@@ -162,16 +162,16 @@ BOOST_AUTO_TEST_CASE( embryo_roundtrip_scheme_api ){
 
 BOOST_AUTO_TEST_CASE( embryo_roundtrip_scheme_api_2_threads ){
 
-  std::vector<uint8_t> encoded(embryo_.num_elements(),0);
-
   sqeazy::quantiser_scheme<uint16_t,uint8_t> shrinker;
+  std::vector<uint8_t> encoded(shrinker.max_encoded_size(embryo_.num_elements()*sizeof(uint16_t)),0);
   shrinker.set_n_threads(2);
-  shrinker.encode(embryo_.data(),&encoded[0],embryo_.num_elements());
+  uint8_t* end = shrinker.encode(embryo_.data(),&encoded[0],embryo_.num_elements());
 
-  std::vector<uint16_t> reconstructed(encoded.size(),0);
+  std::vector<uint16_t> reconstructed(embryo_.num_elements(),0);
   shrinker.decode(&encoded[0],
           &reconstructed[0],
-          encoded.size());
+          end - &encoded[0],
+          reconstructed.size());
 
   BOOST_CHECK_EQUAL_COLLECTIONS(reconstructed.begin(), reconstructed.end(),embryo_.data(),
                 embryo_.data()+ embryo_.num_elements());
@@ -247,15 +247,15 @@ BOOST_AUTO_TEST_CASE( noisy_embryo_roundtrip_2threads ){
 
 BOOST_AUTO_TEST_CASE( noisy_embryo_roundtrip_scheme_api ){
 
-  std::vector<uint8_t> encoded(noisy_embryo_.num_elements(),0);
-
   sqeazy::quantiser_scheme<uint16_t,uint8_t> shrinker;
-  shrinker.encode(noisy_embryo_.data(),&encoded[0],noisy_embryo_.num_elements());
+  std::vector<uint8_t> encoded(shrinker.max_encoded_size(noisy_embryo_.num_elements()*sizeof(uint16_t)),0);
+  uint8_t* end = shrinker.encode(noisy_embryo_.data(),&encoded[0],noisy_embryo_.num_elements());
 
-  std::vector<uint16_t> reconstructed(encoded.size(),0);
+  std::vector<uint16_t> reconstructed(noisy_embryo_.num_elements(),0);
   shrinker.decode(&encoded[0],
           &reconstructed[0],
-          encoded.size());
+          end - &encoded[0],
+          reconstructed.size());
 
   double rms = sqeazy::rms(reconstructed.begin(), reconstructed.end(),noisy_embryo_.data());
 
@@ -277,6 +277,158 @@ BOOST_AUTO_TEST_CASE( noisy_embryo_roundtrip_scheme_api ){
 
 }
 
+BOOST_AUTO_TEST_CASE( noisy_embryo_roundtrip_sampled ){
+
+  const std::size_t len = noisy_embryo_.num_elements();
+  std::vector<uint16_t> reconstructed(len,0);
+
+  sqeazy::quantiser_scheme<uint16_t,uint8_t> full;
+  std::vector<uint8_t> encoded(full.max_encoded_size(len*sizeof(uint16_t)),0);
+  uint8_t* end = full.encode(noisy_embryo_.data(),&encoded[0],len);
+  full.decode(&encoded[0], &reconstructed[0], end - &encoded[0], len);
+  const double full_rms = sqeazy::rms(reconstructed.begin(), reconstructed.end(),noisy_embryo_.data());
+
+  for(const std::string cfg : {"sample=0.1", "sample=0.1,sample_mode=random"}){
+
+    sqeazy::quantiser_scheme<uint16_t,uint8_t> sampled(cfg);
+    BOOST_CHECK_CLOSE(sampled.shrinker.sample_fraction_, .1f, 1e-3);
+
+    end = sampled.encode(noisy_embryo_.data(),&encoded[0],len);
+    sampled.decode(&encoded[0], &reconstructed[0], end - &encoded[0], len);
+
+    std::size_t sampled_sum = std::accumulate(sampled.shrinker.histo_.begin(), sampled.shrinker.histo_.end(), std::size_t(0));
+    BOOST_CHECK_LT(sampled_sum, noisy_embryo_.num_elements());
+
+    const double sampled_rms = sqeazy::rms(reconstructed.begin(), reconstructed.end(),noisy_embryo_.data());
+    BOOST_CHECK_GT(sampled_rms,0);
+    BOOST_CHECK_LT(sampled_rms,2*full_rms);
+  }
+
+}
+
+BOOST_AUTO_TEST_CASE( reuse_lut_across_calls ){
+
+  const std::size_t len = noisy_embryo_.num_elements();
+  std::vector<uint16_t> first_decoded(len,0);
+  std::vector<uint16_t> second_decoded(len,0);
+
+  sqeazy::quantiser_scheme<uint16_t,uint8_t>::reset_reference();
+  sqeazy::quantiser_scheme<uint16_t,uint8_t> shrinker("reuse_lut=10");
+  std::vector<uint8_t> first_encoded(shrinker.max_encoded_size(len*sizeof(uint16_t)),0);
+  std::vector<uint8_t> second_encoded(first_encoded.size(),0);
+
+  uint8_t* first_end = shrinker.encode(noisy_embryo_.data(),&first_encoded[0],len);
+  const std::string first_config = shrinker.config();
+  BOOST_CHECK_NE(first_config.find("decode_lut_in_payload"),std::string::npos);
+  BOOST_CHECK_NE(first_config.find("decode_lut_hash"),std::string::npos);
+  BOOST_CHECK_GT(std::size_t(first_end - &first_encoded[0]),len);
+
+  //the reused LUT is not repeated in the payload
+  uint8_t* second_end = shrinker.encode(noisy_embryo_.data(),&second_encoded[0],len);
+  const std::string second_config = shrinker.config();
+  BOOST_CHECK_EQUAL(second_config.find("decode_lut_in_payload"),std::string::npos);
+  BOOST_CHECK_NE(second_config.find("decode_lut_hash"),std::string::npos);
+  BOOST_CHECK_EQUAL(std::size_t(second_end - &second_encoded[0]),len);
+  BOOST_CHECK(std::equal(first_end - len, first_end, &second_encoded[0]));
+
+  sqeazy::quantiser_scheme<uint16_t,uint8_t> first_decoder(first_config);
+  BOOST_CHECK_EQUAL(first_decoder.decode(&first_encoded[0],&first_decoded[0],first_end - &first_encoded[0],len),0);
+
+  sqeazy::quantiser_scheme<uint16_t,uint8_t> second_decoder(second_config);
+  BOOST_CHECK_EQUAL(second_decoder.decode(&second_encoded[0],&second_decoded[0],len),0);
+  BOOST_CHECK(first_decoded == second_decoded);
+
+  //a strong change of the intensity distribution triggers a new LUT
+  std::vector<uint16_t> shifted(noisy_embryo_.data(), noisy_embryo_.data()+len);
+  for(uint16_t& el : shifted)
+    el = el/2 + 1000;
+
+  shrinker.encode(shifted.data(),&second_encoded[0],len);
+  BOOST_CHECK_NE(shrinker.config().find("decode_lut_in_payload"),std::string::npos);
+
+}
+
+BOOST_AUTO_TEST_CASE( unknown_lut_hash_fails_to_decode ){
+
+  std::vector<uint8_t> encoded(16,0);
+  std::vector<uint16_t> decoded(16,0);
+
+  sqeazy::quantiser_scheme<uint16_t,uint8_t> decoder("decode_lut_hash=0000000000000000");
+  BOOST_CHECK_NE(decoder.decode(&encoded[0],&decoded[0],encoded.size()),0);
+
+}
+
+BOOST_AUTO_TEST_CASE( lut_registry_is_bounded ){
+
+  typedef sqeazy::lut_registry<uint16_t> registry_t;
+  typedef sqeazy::quantiser_scheme<uint16_t,uint8_t> scheme_t;
+
+  scheme_t::reset();
+  const std::size_t capacity = registry_t::capacity();
+  std::vector<uint16_t> lut(256,0);
+
+  for(std::size_t i = 0;i<2*capacity;++i){
+    lut[0] = i;
+    registry_t::store(std::to_string(i), lut);
+  }
+  BOOST_CHECK_EQUAL(registry_t::size(),capacity);
+
+  //the oldest LUTs were evicted, the newest are still there
+  BOOST_CHECK(!registry_t::load("0", lut));
+  BOOST_REQUIRE(registry_t::load(std::to_string(2*capacity-1), lut));
+  BOOST_CHECK_EQUAL(lut[0],2*capacity-1);
+
+  scheme_t::reset(std::to_string(2*capacity-1));
+  BOOST_CHECK(!registry_t::load(std::to_string(2*capacity-1), lut));
+  BOOST_CHECK_EQUAL(registry_t::size(),capacity-1);
+
+  scheme_t::reset();
+  BOOST_CHECK_EQUAL(registry_t::size(),0u);
+
+}
+
+BOOST_AUTO_TEST_CASE( binary_lut_roundtrip ){
+
+  typedef sqeazy::quantiser<uint16_t,uint8_t> quantiser_t;
+
+  quantiser_t shrinker(embryo_.data(),embryo_.data()+embryo_.num_elements());
+
+  std::vector<uint16_t> lut = shrinker.lut_decode_;
+  //deltas need not be positive
+  std::swap(lut[1],lut[lut.size()-2]);
+  lut.back() = 0;
+
+  std::vector<char> binary(shrinker.max_binary_lut_bytes(lut.size()),0);
+  const std::size_t written = shrinker.lut_to_binary(lut,binary.data());
+  BOOST_REQUIRE_GT(written,0u);
+  BOOST_CHECK_LE(written,binary.size());
+  BOOST_CHECK_LT(written,lut.size()*sizeof(uint16_t));
+
+  std::vector<uint16_t> reloaded;
+  BOOST_CHECK_EQUAL(shrinker.lut_from_binary(binary.data(),binary.data()+binary.size(),reloaded),written);
+  BOOST_CHECK(reloaded == lut);
+
+  //truncated sections are rejected
+  BOOST_CHECK_EQUAL(shrinker.lut_from_binary(binary.data(),binary.data()+written-2,reloaded),0u);
+}
+
+BOOST_AUTO_TEST_CASE( truncated_payload_lut_fails_to_decode ){
+
+  typedef sqeazy::quantiser<uint16_t,uint8_t> quantiser_t;
+
+  quantiser_t shrinker(embryo_.data(),embryo_.data()+embryo_.num_elements());
+  std::vector<uint16_t> lut(shrinker.lut_decode_.begin(), shrinker.lut_decode_.begin() + 16);
+
+  const std::size_t len = 64;
+  std::vector<uint8_t> encoded(shrinker.max_binary_lut_bytes(lut.size()) + len,255);
+  const std::size_t written = shrinker.lut_to_binary(lut,reinterpret_cast<char*>(&encoded[0]));
+  std::vector<uint16_t> decoded(len,0);
+
+  sqeazy::quantiser_scheme<uint16_t,uint8_t> decoder("decode_lut_in_payload=1");
+  BOOST_CHECK_NE(decoder.decode(&encoded[0],&decoded[0],written + len,len),0);
+
+}
+
 BOOST_AUTO_TEST_CASE( write_to_file ){
 
   std::stringstream lut_file;
@@ -754,20 +906,23 @@ BOOST_AUTO_TEST_CASE( realistic_roundtrip_scheme_api ){
 
   bfs::path tgt = lut_file.str();
   sqeazy::quantiser_scheme<uint16_t,uint8_t> shrinker;
-  std::vector<uint8_t> encoded(realistic_.size(),0);
+  std::vector<uint8_t> encoded(shrinker.max_encoded_size(realistic_.size()*sizeof(uint16_t)),0);
   auto end_ptr = shrinker.encode(&realistic_[0],&encoded[0],realistic_.size());
+  const std::size_t encoded_size = std::distance(&encoded[0],end_ptr);
 
   std::string shrinker_config = shrinker.config();
 
   BOOST_CHECK(end_ptr!=nullptr);
-  BOOST_CHECK_EQUAL(std::distance(&encoded[0],end_ptr),ptrdiff_t(realistic_.size()));
+  BOOST_CHECK_LE(encoded_size,encoded.size());
+  BOOST_CHECK_GT(encoded_size,realistic_.size());
 
-  std::vector<uint16_t> reconstructed(encoded.size(),0);
+  std::vector<uint16_t> reconstructed(realistic_.size(),0);
   sqeazy::quantiser_scheme<uint16_t,uint8_t> reloaded(shrinker_config);
 
   int err =reloaded.decode(&encoded[0],
                &reconstructed[0],
-               encoded.size());
+               encoded_size,
+               reconstructed.size());
 
   BOOST_CHECK_EQUAL(err,0);
 
@@ -805,17 +960,18 @@ BOOST_AUTO_TEST_CASE( reloading_decode_lut_scheme_api ){
 
   bfs::path tgt = lut_file.str();
   sqeazy::quantiser_scheme<uint16_t,uint8_t> shrinker;
-  std::vector<uint8_t> encoded(realistic_.size(),0);
+  std::vector<uint8_t> encoded(shrinker.max_encoded_size(realistic_.size()*sizeof(uint16_t)),0);
   auto end_ptr = shrinker.encode(&realistic_[0],&encoded[0],realistic_.size());
+  const std::size_t encoded_size = std::distance(&encoded[0],end_ptr);
 
   std::string shrinker_config = shrinker.config();
 
   BOOST_CHECK(end_ptr!=nullptr);
-  //BOOST_CHECK_EQUAL(end_ptr-&encoded[0],realistic_.size());
-  BOOST_CHECK_EQUAL(std::distance(&encoded[0],end_ptr),ptrdiff_t(realistic_.size()));
+  BOOST_CHECK_LE(encoded_size,encoded.size());
+  BOOST_CHECK_GT(encoded_size,realistic_.size());
 
-  std::vector<uint16_t> reconstructed(encoded.size(),0);
-  std::vector<uint16_t> reloaded_decoded(encoded.size(),0);
+  std::vector<uint16_t> reconstructed(realistic_.size(),0);
+  std::vector<uint16_t> reloaded_decoded(realistic_.size(),0);
 
   sqeazy::quantiser_scheme<uint16_t,uint8_t> reloaded(shrinker_config);
   std::string reloaded_config = reloaded.config();
@@ -824,13 +980,15 @@ BOOST_AUTO_TEST_CASE( reloading_decode_lut_scheme_api ){
 
   int err =reloaded.decode(&encoded[0],
                &reloaded_decoded[0],
-               encoded.size());
+               encoded_size,
+               reloaded_decoded.size());
 
   BOOST_CHECK_EQUAL(err,0);
 
   err =shrinker.decode(&encoded[0],
                &reconstructed[0],
-               encoded.size());
+               encoded_size,
+               reconstructed.size());
 
   BOOST_CHECK_EQUAL(err,0);
 
@@ -921,12 +1079,12 @@ BOOST_AUTO_TEST_CASE( normal_scheme_api ){
   for( uint16_t& _el : input )
     _el = value++;
 
-  std::vector<uint8_t> encoded(input.size(),0);
-
   sqeazy::quantiser_scheme<uint16_t,uint8_t> quant;
-  uint8_t* end = quant.encode(&input[0],&encoded[0], input.size());
+  std::vector<uint8_t> buffer(quant.max_encoded_size(input.size()*sizeof(uint16_t)),0);
+  uint8_t* end = quant.encode(&input[0],&buffer[0], input.size());
 
-  BOOST_CHECK(end!=nullptr);
+  BOOST_REQUIRE(end!=nullptr);
+  std::vector<uint8_t> encoded(end - input.size(), end);
   float raw_sum = std::accumulate(input.begin(), input.end(),0);
   float sum = std::accumulate(encoded.begin(), encoded.end(),0);
   BOOST_CHECK_NE(sum,0);
@@ -1595,3 +1753,199 @@ BOOST_AUTO_TEST_CASE( offset_power_capped_ramp_compare_weights ){
 
 }
 BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE( lut_application )
+
+BOOST_AUTO_TEST_CASE( encode_lut_matches_scalar ){
+
+  //not a multiple of the vectorized block or register width
+  const std::size_t len = 3*sqeazy::detail::lut::block_size + 17;
+
+  std::mt19937 gen(42);
+  std::uniform_int_distribution<std::uint32_t> dis(0,(std::numeric_limits<std::uint16_t>::max)());
+
+  std::vector<std::uint16_t> input(len,0);
+  for(std::uint16_t& el : input)
+    el = dis(gen);
+
+  std::vector<char> lut(1 << 16,0);
+  for(std::size_t i = 0;i<lut.size();++i)
+    lut[i] = char((i*7) >> 8);
+
+  std::vector<char> expected(len,0);
+  std::vector<char> received(len,0);
+
+  sqeazy::detail::lut::apply_scalar(input.data(), len, lut, expected.data());
+
+  for(int nthreads : {1,2}){
+    std::fill(received.begin(), received.end(),0);
+    auto end = sqeazy::detail::lut::apply(input.data(), len, lut, received.data(), nthreads);
+    BOOST_CHECK(end == received.data() + len);
+    BOOST_CHECK_EQUAL_COLLECTIONS(expected.begin(), expected.end(),
+                                  received.begin(), received.end());
+  }
+}
+
+BOOST_AUTO_TEST_CASE( decode_lut_matches_scalar ){
+
+  const std::size_t len = 3*sqeazy::detail::lut::block_size + 17;
+
+  std::mt19937 gen(42);
+  std::uniform_int_distribution<std::uint32_t> dis(0,255);
+
+  std::vector<char> input(len,0);
+  for(char& el : input)
+    el = char(dis(gen));
+
+  std::vector<std::uint16_t> lut(1 << 8,0);
+  for(std::size_t i = 0;i<lut.size();++i)
+    lut[i] = std::uint16_t(i*251 + 3);
+
+  std::vector<std::uint16_t> expected(len,0);
+  std::vector<std::uint16_t> received(len,0);
+
+  sqeazy::detail::lut::apply_scalar(input.data(), len, lut, expected.data());
+  BOOST_CHECK_EQUAL(expected[0], lut[static_cast<unsigned char>(input[0])]);
+
+  for(int nthreads : {1,2}){
+    std::fill(received.begin(), received.end(),0);
+    auto end = sqeazy::detail::lut::apply(input.data(), len, lut, received.data(), nthreads);
+    BOOST_CHECK(end == received.data() + len);
+    BOOST_CHECK_EQUAL_COLLECTIONS(expected.begin(), expected.end(),
+                                  received.begin(), received.end());
+  }
+}
+
+BOOST_AUTO_TEST_CASE( wide_lut_matches_scalar ){
+
+  const std::size_t len = 3*sqeazy::detail::lut::block_size + 17;
+
+  std::mt19937 gen(42);
+  std::uniform_int_distribution<std::uint32_t> dis(0,(std::numeric_limits<std::uint16_t>::max)());
+
+  std::vector<std::uint16_t> input(len,0);
+  for(std::uint16_t& el : input)
+    el = dis(gen);
+
+  std::vector<std::uint16_t> lut(1 << 16,0);
+  for(std::size_t i = 0;i<lut.size();++i)
+    lut[i] = std::uint16_t(65535 - i*3);
+
+  std::vector<std::uint16_t> expected(len,0);
+  std::vector<std::uint16_t> received(len,0);
+
+  sqeazy::detail::lut::apply_scalar(input.data(), len, lut, expected.data());
+
+  for(int nthreads : {1,2}){
+    std::fill(received.begin(), received.end(),0);
+    auto end = sqeazy::detail::lut::apply(input.data(), len, lut, received.data(), nthreads);
+    BOOST_CHECK(end == received.data() + len);
+    BOOST_CHECK_EQUAL_COLLECTIONS(expected.begin(), expected.end(),
+                                  received.begin(), received.end());
+  }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE( bit_packing )
+
+BOOST_AUTO_TEST_CASE( packed_codes_match_scalar ){
+
+  //not a multiple of the block size or of 8 codes
+  const std::size_t len = 2*sqeazy::detail::bitpack::block_size + 13;
+
+  std::mt19937 gen(42);
+  std::uniform_int_distribution<std::uint32_t> dis(0,(std::numeric_limits<std::uint16_t>::max)());
+
+  std::vector<std::uint16_t> input(len,0);
+  for(std::uint16_t& el : input)
+    el = dis(gen);
+
+  for(std::uint32_t bits : {1,4,6,10,12,16}){
+
+    const std::uint32_t mask = (1u << bits) - 1;
+
+    std::vector<std::uint16_t> lut_encode(1 << 16,0);
+    for(std::size_t i = 0;i<lut_encode.size();++i)
+      lut_encode[i] = std::uint16_t((i*7) & mask);
+
+    std::vector<std::uint16_t> lut_decode(std::size_t(1) << bits,0);
+    for(std::size_t i = 0;i<lut_decode.size();++i)
+      lut_decode[i] = std::uint16_t(i*3 + 1);
+
+    const std::size_t nbytes = sqeazy::detail::bitpack::packed_bytes(len,bits);
+    std::vector<char> expected(nbytes,0);
+    sqeazy::detail::bitpack::encode_scalar(input.data(), len, lut_encode.data(), bits, expected.data());
+
+    for(int nthreads : {1,2}){
+
+      std::vector<char> packed(nbytes,0);
+      char* end = sqeazy::detail::bitpack::encode(input.data(), len, lut_encode, bits, packed.data(), nthreads);
+      BOOST_CHECK(end == packed.data() + nbytes);
+      BOOST_CHECK_MESSAGE(packed == expected, "packing " << bits << " bits with " << nthreads << " threads");
+
+      std::vector<std::uint16_t> decoded(len,0);
+      sqeazy::detail::bitpack::decode(packed.data(), len, lut_decode, bits, decoded.data(), nthreads);
+
+      std::size_t mismatches = 0;
+      for(std::size_t i = 0;i<len;++i)
+        mismatches += decoded[i] != lut_decode[lut_encode[input[i]]];
+      BOOST_CHECK_MESSAGE(mismatches == 0u, "unpacking " << bits << " bits with " << nthreads << " threads");
+    }
+  }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_FIXTURE_TEST_SUITE( packed_scheme, sqeazy::volume_fixture<uint16_t> )
+
+BOOST_AUTO_TEST_CASE( roundtrip_bit_widths ){
+
+  const std::size_t len = noisy_embryo_.num_elements();
+  double last_mse = (std::numeric_limits<double>::max)();
+
+  for(std::uint32_t bits : {4,6,10,12}){
+
+    std::ostringstream cfg;
+    cfg << "bits=" << bits;
+    sqeazy::quantiser_scheme<uint16_t,uint8_t> shrinker(cfg.str());
+
+    std::vector<uint8_t> encoded(shrinker.max_encoded_size(len*sizeof(uint16_t)),0);
+    uint8_t* end = shrinker.encode(noisy_embryo_.data(),&encoded[0],len);
+    BOOST_REQUIRE(end != nullptr);
+
+    const std::size_t lut_bytes = shrinker.metadata_bytes(&encoded[0],end);
+    BOOST_CHECK_GT(lut_bytes,0u);
+    BOOST_CHECK_EQUAL(std::size_t(end - &encoded[0]) - lut_bytes, sqeazy::detail::bitpack::packed_bytes(len,bits));
+
+    sqeazy::quantiser_scheme<uint16_t,uint8_t> reloaded(shrinker.config());
+    std::vector<uint16_t> reconstructed(len,0);
+    BOOST_CHECK_EQUAL(reloaded.decode(&encoded[0],&reconstructed[0],end - &encoded[0],len),0);
+
+    const double mse = sqeazy::mse(reconstructed.begin(), reconstructed.end(), noisy_embryo_.data());
+    BOOST_TEST_MESSAGE(boost::unit_test::framework::current_test_case().p_name << ", " << bits << " bits, mse = " << mse);
+    BOOST_CHECK_LT(mse,last_mse);
+    last_mse = mse;
+  }
+}
+
+BOOST_AUTO_TEST_CASE( eight_bits_packed_equals_unpacked ){
+
+  const std::size_t len = noisy_embryo_.num_elements();
+
+  sqeazy::quantiser_scheme<uint16_t,uint8_t> unpacked;
+  sqeazy::quantiser_scheme<uint16_t,uint8_t> packed("bits=8");
+
+  std::vector<uint8_t> unpacked_encoded(unpacked.max_encoded_size(len*sizeof(uint16_t)),0);
+  std::vector<uint8_t> packed_encoded(packed.max_encoded_size(len*sizeof(uint16_t)),0);
+
+  uint8_t* unpacked_end = unpacked.encode(noisy_embryo_.data(),&unpacked_encoded[0],len);
+  uint8_t* packed_end = packed.encode(noisy_embryo_.data(),&packed_encoded[0],len);
+
+  BOOST_CHECK(packed.shrinker.lut_decode_ == unpacked.shrinker.lut_decode_ ||
+              packed.packing_shrinker->lut_decode_ == unpacked.shrinker.lut_decode_);
+  BOOST_CHECK(std::equal(packed_end - len, packed_end, unpacked_end - len));
+
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -377,6 +377,38 @@ BOOST_AUTO_TEST_CASE( tile_of_3 )
 
 }
 
+BOOST_AUTO_TEST_CASE( remainder_along_some_axes_only )
+{
+
+  //x and y fit the tile, z does not
+  std::vector<std::size_t> shape = {5, 8, 8};
+  const std::size_t len = std::accumulate(shape.begin(), shape.end(), std::size_t(1), std::multiplies<std::size_t>());
+  std::vector<std::uint16_t> input(len, 0);
+  std::iota(input.begin(), input.end(), 0);
+
+  std::vector<std::uint16_t> encoded(len, 0);
+  std::vector<std::uint16_t> decoded(len, 0);
+
+  sqyd::reorder in_tiles_of(4);
+  auto rem = in_tiles_of.encode(input.cbegin(), input.cend(),
+                                encoded.begin(),
+                                shape);
+  BOOST_REQUIRE(rem == encoded.end());
+
+  //the first tile holds the first 4 values of the first 4 rows of the first 4 planes
+  BOOST_CHECK_EQUAL(encoded[0], 0);
+  BOOST_CHECK_EQUAL(encoded[4], 8);
+  BOOST_CHECK_EQUAL(encoded[16], 64);
+
+  rem = in_tiles_of.decode(encoded.cbegin(),encoded.cend(),
+                           decoded.begin(),
+                           shape);
+  BOOST_REQUIRE(rem == decoded.end());
+  BOOST_CHECK_EQUAL_COLLECTIONS(input.begin(), input.end(),
+                                decoded.begin(), decoded.end());
+
+}
+
 BOOST_AUTO_TEST_CASE( scheme_tile_of_4 )
 {
 
@@ -432,6 +464,72 @@ BOOST_AUTO_TEST_CASE( tile_of_simd_fitted )
                 decoded.begin(), decoded.end());
 
 
+}
+
+BOOST_AUTO_TEST_CASE( wide_tiles_for_each_store_policy )
+{
+
+  for(std::size_t ts : {8u, 16u, 32u}){
+    for(auto policy : {sqyd::store_policy::automatic,
+                       sqyd::store_policy::cached,
+                       sqyd::store_policy::streaming}){
+
+      sqyd::reorder in_tiles_of(ts, policy);
+      std::fill(to_play_with.begin(), to_play_with.end(),0);
+      auto rem = in_tiles_of.encode(incrementing_cube.cbegin(), incrementing_cube.cend(),
+                                    to_play_with.begin(),
+                                    dims);
+      BOOST_REQUIRE(rem == to_play_with.end());
+
+      //the first run of the stream is the first row of the first tile
+      BOOST_CHECK_EQUAL_COLLECTIONS(to_play_with.begin(), to_play_with.begin()+ts,
+                                    incrementing_cube.begin(), incrementing_cube.begin()+ts);
+
+      auto decoded = constant_cube;
+      std::fill(decoded.begin(), decoded.end(),0);
+
+      rem = in_tiles_of.decode(to_play_with.cbegin(),to_play_with.cend(),
+                               decoded.begin(),
+                               dims);
+      BOOST_REQUIRE(rem == decoded.end());
+      BOOST_CHECK_MESSAGE(std::equal(incrementing_cube.begin(), incrementing_cube.end(),decoded.begin()),
+                          "roundtrip failed for tile_size " << ts << " and store policy " << int(policy));
+    }
+  }
+
+}
+
+BOOST_AUTO_TEST_CASE( scheme_with_streaming_stores )
+{
+
+  sqeazy::raster_reorder_scheme<value_type> scheme("tile_size=32,stores=streaming");
+  BOOST_CHECK(scheme.stores == sqyd::store_policy::streaming);
+  BOOST_CHECK_NE(scheme.config().find("stores=streaming"),std::string::npos);
+
+  sqeazy::raster_reorder_scheme<value_type> rebuilt(scheme.config());
+  BOOST_CHECK(rebuilt.stores == sqyd::store_policy::streaming);
+
+  sqeazy::raster_reorder_scheme<value_type> by_default("tile_size=32");
+  BOOST_CHECK(by_default.stores == sqyd::store_policy::automatic);
+  BOOST_CHECK_EQUAL(by_default.config().find("stores="),std::string::npos);
+
+  std::vector<std::size_t> shape(dims.begin(), dims.end());
+  auto rem = scheme.encode(incrementing_cube.data(),
+               to_play_with.data(),
+               shape);
+  BOOST_REQUIRE(rem == (to_play_with.data() + to_play_with.size()));
+
+  auto decoded = constant_cube;
+  std::fill(decoded.begin(), decoded.end(),0);
+
+  auto rv = scheme.decode(to_play_with.data(),
+              decoded.data(),
+              shape);
+
+  BOOST_REQUIRE(rv == 0);
+  BOOST_CHECK_EQUAL_COLLECTIONS(incrementing_cube.begin(), incrementing_cube.end(),
+                decoded.begin(), decoded.end());
+
 }
 BOOST_AUTO_TEST_SUITE_END()
 
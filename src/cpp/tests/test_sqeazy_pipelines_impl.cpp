@@ -397,6 +397,39 @@ BOOST_AUTO_TEST_CASE( roundtrip_quantiser ){
 
 }
 
+BOOST_AUTO_TEST_CASE( quantiser_reuses_lut_across_pipelines ){
+
+  const std::vector<std::size_t> shape = {16,64,64};
+  const std::size_t len = 16*64*64;
+  const std::string spec = "quantiser(reuse_lut=100,sequence=across_pipelines)";
+
+  //pipelines are built for every buffer, like the C API does
+  std::vector<std::string> headers;
+  std::vector<std::intmax_t> encoded_bytes;
+  for(unsigned seed : {1u, 2u}){
+
+    const std::vector<std::uint16_t> input = sqeazy::random_stack<std::uint16_t>(len, 100, 4000, seed);
+    auto pipe = sqeazy::dypeline<std::uint16_t>::from_string(spec);
+
+    std::vector<char> encoded(pipe.max_encoded_size(len*sizeof(std::uint16_t)),0);
+    char* end = pipe.encode(input.data(), encoded.data(), shape);
+    BOOST_REQUIRE(end != nullptr);
+
+    auto decoder = sqeazy::dypeline<std::uint16_t>::from_string(spec);
+    std::vector<std::uint16_t> decoded(len,0);
+    BOOST_CHECK_EQUAL(decoder.decode(encoded.data(), decoded.data(), end - encoded.data()), 0);
+
+    headers.push_back(sqeazy::header(encoded.data(), end).pipeline());
+    encoded_bytes.push_back(end - encoded.data());
+  }
+
+  BOOST_CHECK_NE(headers.front().find("decode_lut_in_payload"),std::string::npos);
+  BOOST_CHECK_EQUAL(headers.back().find("decode_lut_in_payload"),std::string::npos);
+  BOOST_CHECK_LT(encoded_bytes.back(),encoded_bytes.front());
+
+  sqeazy::quantiser_scheme<std::uint16_t,std::uint8_t>::reset_reference("across_pipelines");
+}
+
 BOOST_AUTO_TEST_CASE( roundtrip_quantiser2file ){
 
 
@@ -0,0 +1,377 @@
+#define BOOST_TEST_MODULE TEST_TEMPORAL_DIFF_SCHEME_IMPL
+#define BOOST_TEST_MAIN
+#include "boost/test/included/unit_test.hpp"
+#include <numeric>
+#include <vector>
+#include <random>
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+#include "array_fixtures.hpp"
+#include "encoders/temporal_diff_scheme_impl.hpp"
+#include "sqeazy_pipelines.hpp"
+#include "traits.hpp"
+
+namespace sqy = sqeazy;
+namespace sqyd = sqy::detail;
+
+//a static sample: the same structure at every timepoint plus a little noise
+std::vector<std::vector<std::uint16_t> > static_series(std::size_t _len, std::size_t _n_frames){
+
+  const std::vector<std::uint16_t> sample = sqy::random_stack<std::uint16_t>(_len, 100, 4000, 42);
+  std::vector<std::vector<std::uint16_t> > value;
+
+  for(std::size_t t = 0;t<_n_frames;++t){
+    std::vector<std::uint16_t> noise = sqy::random_stack<std::uint16_t>(_len, 0, 2, 100 + t);
+    for(std::size_t i = 0;i<_len;++i)
+      noise[i] += sample[i];
+    value.push_back(noise);
+  }
+
+  return value;
+}
+
+template <typename T>
+void check_kernels(std::size_t _len, int _max){
+
+  const std::vector<T> input = sqy::random_stack<T>(_len, 0, _max, 1);
+  const std::vector<T> prediction = sqy::random_stack<T>(_len, 0, _max, 2);
+
+  std::vector<T> expected(_len,0);
+  sqyd::temporal::residual_scalar(input.data(), prediction.data(), _len, expected.data(), (T*)nullptr);
+
+  std::vector<T> residuals(_len,0);
+  std::vector<T> kept(_len,0);
+  sqyd::temporal::residual(input.data(), prediction.data(), _len, residuals.data(), kept.data(), 2);
+  BOOST_CHECK(residuals == expected);
+  BOOST_CHECK(kept == input);
+
+  //in place: the residuals overwrite the input, the input overwrites the prediction
+  std::vector<T> inplace(input);
+  std::vector<T> reference(prediction);
+  sqyd::temporal::residual(inplace.data(), reference.data(), _len, inplace.data(), reference.data());
+  BOOST_CHECK(inplace == expected);
+  BOOST_CHECK(reference == input);
+
+  std::vector<T> decoded(_len,0);
+  reference = prediction;
+  sqyd::temporal::reconstruct(residuals.data(), reference.data(), _len, decoded.data(), reference.data(), 2);
+  BOOST_CHECK(decoded == input);
+  BOOST_CHECK(reference == input);
+}
+
+BOOST_AUTO_TEST_SUITE( kernels )
+
+BOOST_AUTO_TEST_CASE( kernels_match_scalar )
+{
+
+  //more than a block and a remainder that is not a multiple of any vector width
+  const std::size_t len = sqyd::temporal::block_size + 77;
+
+  check_kernels<std::uint8_t>(len, 255);
+  check_kernels<std::uint16_t>(len, 65535);
+  check_kernels<std::uint32_t>(len, (std::numeric_limits<int>::max)());
+}
+
+BOOST_AUTO_TEST_CASE( small_differences_give_small_residuals )
+{
+
+  const std::vector<std::uint16_t> prediction(64, 1000);
+  std::vector<std::uint16_t> input(prediction);
+  input[0] = 999;
+  input[1] = 1001;
+  input[2] = 998;
+
+  std::vector<std::uint16_t> residuals(64,42);
+  sqyd::temporal::residual(input.data(), prediction.data(), input.size(), residuals.data());
+
+  BOOST_CHECK_EQUAL(residuals[0], 1);
+  BOOST_CHECK_EQUAL(residuals[1], 2);
+  BOOST_CHECK_EQUAL(residuals[2], 3);
+  BOOST_CHECK_EQUAL(std::count(residuals.begin(), residuals.end(), 0), 61);
+}
+
+BOOST_AUTO_TEST_CASE( sad_matches_scalar )
+{
+
+  //long enough for the 16-bit kernels to flush their 32-bit sums
+  const std::size_t len = (1 << 18) + 1000 + 13;
+
+  const auto lhs8 = sqy::random_stack<std::uint8_t>(len, 0, 255, 3);
+  const auto rhs8 = sqy::random_stack<std::uint8_t>(len, 0, 255, 4);
+  const auto lhs16 = sqy::random_stack<std::uint16_t>(len, 0, 65535, 3);
+  const auto rhs16 = sqy::random_stack<std::uint16_t>(len, 0, 65535, 4);
+
+  for(std::size_t n : {std::size_t(0), std::size_t(7), std::size_t(33), len}){
+    BOOST_CHECK_EQUAL(sqyd::temporal::sad(lhs8.data(), rhs8.data(), n), sqyd::temporal::sad_scalar(lhs8.data(), rhs8.data(), n));
+    BOOST_CHECK_EQUAL(sqyd::temporal::sad(lhs16.data(), rhs16.data(), n), sqyd::temporal::sad_scalar(lhs16.data(), rhs16.data(), n));
+  }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+//a smooth sample that moves by _drift (z,y,x) items per timepoint
+std::vector<std::vector<std::uint16_t> > drifting_series(const std::vector<std::size_t>& _shape,
+                                                         const std::vector<int>& _drift,
+                                                         std::size_t _n_frames){
+
+  const std::size_t len = _shape[0]*_shape[1]*_shape[2];
+  std::vector<std::vector<std::uint16_t> > value;
+
+  for(std::size_t t = 0;t<_n_frames;++t){
+    std::vector<std::uint16_t> timepoint(len,0);
+    auto noise = sqy::random_stack<std::uint16_t>(len, 0, 1, 200 + t);
+
+    for(std::size_t z = 0;z<_shape[0];++z)
+      for(std::size_t y = 0;y<_shape[1];++y)
+        for(std::size_t x = 0;x<_shape[2];++x){
+          const double pz = double(z) - double(int(t)*_drift[0]);
+          const double py = double(y) - double(int(t)*_drift[1]);
+          const double px = double(x) - double(int(t)*_drift[2]);
+          const std::size_t i = (z*_shape[1] + y)*_shape[2] + x;
+          timepoint[i] = 1000 + 500*std::sin(.3*px + .1*pz)*std::cos(.2*py) + 300*std::sin(.05*px*py/8.) + noise[i];
+        }
+
+    value.push_back(timepoint);
+  }
+
+  return value;
+}
+
+BOOST_AUTO_TEST_SUITE( motion )
+
+BOOST_AUTO_TEST_CASE( shifts_follow_the_drift )
+{
+
+  const std::vector<std::size_t> shape = {8,48,64};
+  const std::vector<int> drift = {0,1,-2};
+  const auto series = drifting_series(shape, drift, 2);
+
+  sqyd::block_shift<std::uint16_t> motion(16, 3);
+  motion.estimate(series[1].data(), series[0].data(), shape);
+
+  const sqyd::brick_layout layout = motion.layout_of(shape);
+  BOOST_REQUIRE_EQUAL(motion.shifts.size(), 3*layout.size());
+
+  //the brick at t=1 is found where it was at t=0, the bricks at the border move out of the stack
+  std::size_t n_matches = 0;
+  for(std::size_t b = 0;b<layout.size();++b)
+    n_matches += motion.shifts[3*b] == -drift[0] && motion.shifts[3*b+1] == -drift[1] && motion.shifts[3*b+2] == -drift[2];
+
+  BOOST_CHECK_GE(n_matches, 4u);
+
+  std::vector<std::uint16_t> residuals(series[1].size(),0);
+  std::vector<std::uint16_t> kept(series[1].size(),0);
+  BOOST_REQUIRE(motion.residual(series[1].data(), series[0].data(), shape, residuals.data(), kept.data()));
+  BOOST_CHECK(kept == series[1]);
+
+  std::vector<std::uint16_t> decoded(series[1].size(),0);
+  BOOST_REQUIRE(motion.reconstruct(residuals.data(), series[0].data(), shape, decoded.data(), nullptr, 2));
+  BOOST_CHECK(decoded == series[1]);
+
+  //shifts of a different grid are rejected
+  const std::vector<std::size_t> other = {8,48,128};
+  BOOST_CHECK(!motion.reconstruct(residuals.data(), series[0].data(), other, decoded.data(), nullptr));
+}
+
+BOOST_AUTO_TEST_CASE( pipeline_roundtrip_with_motion )
+{
+
+  const std::vector<std::size_t> shape = {8,64,64};
+  const std::size_t len = 8*64*64;
+  const auto series = drifting_series(shape, {0,1,1}, 5);
+
+  std::size_t bytes[2] = {0,0};
+  for(int with_motion : {0,1}){
+
+    const std::string sequence = "drift" + std::to_string(with_motion);
+    sqy::temporal_diff_scheme<std::uint16_t>::reset(sequence);
+
+    const std::string spec = "temporal_diff(sequence=" + sequence + (with_motion ? ",brick=16,search=2" : "") + ")->lz4";
+    BOOST_REQUIRE(sqy::dypeline<std::uint16_t>::can_be_built_from(spec));
+    auto pipe = sqy::dypeline<std::uint16_t>::from_string(spec);
+    pipe.set_n_threads(2);
+
+    for(std::size_t t = 0;t<series.size();++t){
+      std::vector<char> encoded(pipe.max_encoded_size(len*sizeof(std::uint16_t)),0);
+      char* end = pipe.encode(series[t].data(), encoded.data(), shape);
+      BOOST_REQUIRE(end != nullptr);
+      if(t)
+        bytes[with_motion] += end - encoded.data();
+
+      //decoding right after encoding, from the header only
+      auto decoder = sqy::dypeline<std::uint16_t>::bootstrap(encoded.data(), end);
+      std::vector<std::uint16_t> decoded(len,0);
+      BOOST_REQUIRE_EQUAL(decoder.decode(encoded.data(), decoded.data(), end - encoded.data()), 0);
+      BOOST_CHECK_MESSAGE(decoded == series[t], "motion " << with_motion << ": timepoint " << t << " differs");
+    }
+  }
+
+  BOOST_CHECK_LT(bytes[1], bytes[0]);
+}
+
+BOOST_AUTO_TEST_CASE( shifts_stay_within_max_encoded_size )
+{
+
+  const std::vector<std::size_t> shape = {16,128,128};
+  const std::size_t len = 16*128*128;
+  const std::vector<std::vector<std::uint16_t> > series = {sqy::random_stack<std::uint16_t>(len, 0, 65535, 21),
+                                                           sqy::random_stack<std::uint16_t>(len, 0, 65535, 22)};
+
+  for(const std::string sink : {"pass_through", "lz4"}){
+
+    const std::string sequence = "bound_" + sink;
+    sqy::temporal_diff_scheme<std::uint16_t>::reset(sequence);
+
+    auto pipe = sqy::dypeline<std::uint16_t>::from_string("temporal_diff(sequence=" + sequence + ",brick=4,search=1)->" + sink);
+    const std::intmax_t bound = pipe.max_encoded_size(len*sizeof(std::uint16_t));
+
+    for(const std::vector<std::uint16_t>& timepoint : series){
+
+      //twice the bound, so that a violation is reported rather than overflowing the buffer
+      std::vector<char> encoded(2*bound,0);
+      char* end = pipe.encode(timepoint.data(), encoded.data(), shape);
+      BOOST_REQUIRE(end != nullptr);
+      BOOST_CHECK_MESSAGE(end - encoded.data() <= bound,
+                          sink << " wrote " << (end - encoded.data()) << " bytes, max_encoded_size is " << bound);
+    }
+  }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE( scheme )
+
+BOOST_AUTO_TEST_CASE( keyframes_every_interval )
+{
+
+  sqy::temporal_diff_scheme<std::uint16_t>::reset("keyframes");
+  sqy::temporal_diff_scheme<std::uint16_t> local("interval=3,sequence=keyframes");
+
+  const std::vector<std::size_t> shape = {4,16,32};
+  const std::size_t len = 4*16*32;
+  const auto series = static_series(len, 7);
+
+  std::vector<std::uint16_t> encoded(len,0);
+  for(std::size_t t = 0;t<series.size();++t){
+    local.encode(series[t].data(), encoded.data(), shape);
+    BOOST_CHECK_EQUAL(local.frame, t);
+    BOOST_CHECK_EQUAL(local.keyframe, t - t % 3);
+    BOOST_CHECK_EQUAL(local.is_keyframe(), t % 3 == 0);
+
+    if(local.is_keyframe())
+      BOOST_CHECK(encoded == series[t]);
+    else
+      BOOST_CHECK_LE(*std::max_element(encoded.begin(), encoded.end()), 4);
+  }
+
+  //a different shape starts a new chain
+  const std::vector<std::size_t> other = {2,16,32};
+  local.encode(series[0].data(), encoded.data(), other);
+  BOOST_CHECK(local.is_keyframe());
+
+  sqy::temporal_diff_scheme<std::uint16_t> decoder(local.config());
+  BOOST_CHECK_EQUAL(decoder.config(), local.config());
+}
+
+BOOST_AUTO_TEST_CASE( decode_chain_from_headers )
+{
+
+  for(const std::string reference : {"previous", "keyframe"}){
+
+    const std::string sequence = "chain_" + reference;
+    sqy::temporal_diff_scheme<std::uint16_t>::reset(sequence);
+
+    const std::string spec = "temporal_diff(interval=4,reference=" + reference + ",sequence=" + sequence + ")->lz4";
+    BOOST_REQUIRE(sqy::dypeline<std::uint16_t>::can_be_built_from(spec));
+    auto pipe = sqy::dypeline<std::uint16_t>::from_string(spec);
+    pipe.set_n_threads(2);
+
+    const std::vector<std::size_t> shape = {8,16,32};
+    const std::size_t len = 8*16*32;
+    const auto series = static_series(len, 6);
+
+    std::vector<std::vector<char> > buffers;
+    for(const auto& timepoint : series){
+      std::vector<char> encoded(pipe.max_encoded_size(len*sizeof(std::uint16_t)),0);
+      char* end = pipe.encode(timepoint.data(), encoded.data(), shape);
+      BOOST_REQUIRE(end != nullptr);
+      encoded.resize(end - encoded.data());
+      buffers.push_back(encoded);
+    }
+
+    //every buffer is decoded by a pipeline built from its own header, as SQY_Decode does
+    for(std::size_t t = 0;t<buffers.size();++t){
+      auto decoder = sqy::dypeline<std::uint16_t>::bootstrap(buffers[t].begin(), buffers[t].end());
+      std::vector<std::uint16_t> decoded(len,0);
+      BOOST_REQUIRE_EQUAL(decoder.decode(buffers[t].data(), decoded.data(), buffers[t].size()), 0);
+      BOOST_CHECK_MESSAGE(decoded == series[t], reference << ": timepoint " << t << " differs");
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE( missing_reference_is_reported )
+{
+
+  sqy::temporal_diff_scheme<std::uint16_t>::reset("gaps");
+
+  const std::vector<std::size_t> shape = {2,8,16};
+  const std::size_t len = 2*8*16;
+  const auto series = static_series(len, 4);
+
+  std::vector<std::vector<std::uint16_t> > encoded;
+  std::vector<std::string> configs;
+  sqy::temporal_diff_scheme<std::uint16_t> local("interval=0,sequence=gaps");
+  for(const auto& timepoint : series){
+    encoded.push_back(std::vector<std::uint16_t>(len,0));
+    local.encode(timepoint.data(), encoded.back().data(), shape);
+    configs.push_back(local.config());
+  }
+
+  std::vector<std::uint16_t> decoded(len,0);
+
+  //timepoint 2 without its predecessor
+  sqy::temporal_diff_scheme<std::uint16_t> skipping(configs[2]);
+  BOOST_CHECK_NE(skipping.decode(encoded[2].data(), decoded.data(), shape, shape), 0);
+
+  for(std::size_t t = 0;t<series.size();++t){
+    sqy::temporal_diff_scheme<std::uint16_t> decoder(configs[t]);
+    BOOST_REQUIRE_EQUAL(decoder.decode(encoded[t].data(), decoded.data(), shape, shape), 0);
+    BOOST_CHECK(decoded == series[t]);
+  }
+
+  //the chain has moved on, timepoint 1 cannot be decoded again
+  sqy::temporal_diff_scheme<std::uint16_t> repeating(configs[1]);
+  BOOST_CHECK_NE(repeating.decode(encoded[1].data(), decoded.data(), shape, shape), 0);
+}
+
+BOOST_AUTO_TEST_CASE( static_sample_compresses_better )
+{
+
+  const std::vector<std::size_t> shape = {8,32,64};
+  const std::size_t len = 8*32*64;
+  const auto series = static_series(len, 4);
+
+  sqy::temporal_diff_scheme<std::uint16_t>::reset("ratio");
+  auto temporal = sqy::dypeline<std::uint16_t>::from_string("temporal_diff(sequence=ratio)->lz4");
+  auto plain = sqy::dypeline<std::uint16_t>::from_string("lz4");
+
+  std::vector<char> encoded(temporal.max_encoded_size(len*sizeof(std::uint16_t)),0);
+  std::size_t temporal_bytes = 0;
+  std::size_t plain_bytes = 0;
+  for(std::size_t t = 0;t<series.size();++t){
+    const std::size_t temporal_size = temporal.encode(series[t].data(), encoded.data(), shape) - encoded.data();
+    const std::size_t plain_size = plain.encode(series[t].data(), encoded.data(), shape) - encoded.data();
+
+    //the keyframe is not predicted
+    if(t){
+      temporal_bytes += temporal_size;
+      plain_bytes += plain_size;
+    }
+  }
+
+  //only the noise of the sample is left to compress
+  BOOST_CHECK_LT(10*temporal_bytes, 6*plain_bytes);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -7,10 +7,13 @@
 #include <bitset>
 #include <map>
 #include <string>
+#include <random>
+#include <thread>
 
 #include "array_fixtures.hpp"
 
 #include "encoders/tile_shuffle_scheme_impl.hpp"
+#include "dynamic_stage_chain.hpp"
 #include "traits.hpp"
 
 typedef sqeazy::array_fixture<std::uint16_t> uint16_cube_of_8;
@@ -327,6 +330,29 @@ BOOST_AUTO_TEST_CASE( reverse_3 )
   BOOST_CHECK_GT(checksum_mid,checksum_start);
 }
 
+BOOST_AUTO_TEST_CASE( remainder_writes_every_voxel_once )
+{
+
+  label_stack_by_tile_reverse(incrementing_cube.begin(),dims,4);
+
+  sqyd::tile_shuffle in_tiles_of(3);
+
+  auto rem = in_tiles_of.encode(incrementing_cube.cbegin(), incrementing_cube.cend(),
+                                to_play_with.begin(),
+                                dims,
+                                4);
+  BOOST_REQUIRE(rem == to_play_with.end());
+  BOOST_REQUIRE_EQUAL(in_tiles_of.decode_map.size(), 27u);
+
+  auto sorted_input = incrementing_cube;
+  auto sorted_output = to_play_with;
+  std::sort(sorted_input.begin(), sorted_input.end());
+  std::sort(sorted_output.begin(), sorted_output.end());
+
+  BOOST_CHECK_EQUAL_COLLECTIONS(sorted_input.begin(), sorted_input.end(),
+                                sorted_output.begin(), sorted_output.end());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
 BOOST_FIXTURE_TEST_SUITE( roundtrips , uint16_cube_of_8 )
@@ -448,6 +474,32 @@ BOOST_AUTO_TEST_CASE( reverse )
 
 }
 
+BOOST_AUTO_TEST_CASE( equal_medians )
+{
+  //every tile has the same median, so the decode map must be the identity
+  auto expected = constant_cube;
+
+  sqyd::tile_shuffle in_tiles_of(2);
+
+  auto rem = in_tiles_of.encode(constant_cube.cbegin(), constant_cube.cend(),
+                                to_play_with.begin(),
+                                dims,
+                                4);
+  BOOST_REQUIRE(rem == to_play_with.end());
+
+  for(std::size_t i = 0;i<in_tiles_of.decode_map.size();++i)
+    BOOST_CHECK_EQUAL(in_tiles_of.decode_map[i], i);
+
+  auto dec_rem = in_tiles_of.decode(to_play_with.begin(), to_play_with.end(),
+                                    constant_cube.begin(),
+                                    dims,
+                                    4);
+
+  BOOST_REQUIRE(dec_rem == constant_cube.end());
+  BOOST_CHECK_EQUAL_COLLECTIONS(expected.begin(), expected.end(),
+                                constant_cube.begin(), constant_cube.end());
+}
+
 BOOST_AUTO_TEST_CASE( reverse_2 )
 {
 
@@ -589,4 +641,105 @@ BOOST_AUTO_TEST_CASE( scheme_rt_with_alien_config )
 }
 
 
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE( fused_with_bitswap )
+
+BOOST_AUTO_TEST_CASE( identical_to_both_stages )
+{
+
+  const std::vector<std::vector<std::size_t> > shapes = { {32,32,32}, {19,23,37}, {40,64,64}, {17,13,11} };
+
+  std::mt19937 gen(42);
+  std::uniform_int_distribution<std::uint16_t> dist(0,1 << 12);
+
+  for(const auto& shape : shapes){
+
+    const std::size_t len = std::accumulate(shape.begin(), shape.end(), 1, std::multiplies<std::size_t>());
+    std::vector<std::uint16_t> input(len);
+    for(auto& v : input)
+      v = dist(gen);
+
+    for(int nthreads : {1, int(std::thread::hardware_concurrency())}){
+
+      sqy::tile_shuffle_scheme<std::uint16_t> shuffle("tile_size=8");
+      sqy::bitswap_scheme<std::uint16_t> bitswap;
+      shuffle.set_n_threads(nthreads);
+      bitswap.set_n_threads(nthreads);
+
+      std::vector<std::uint16_t> shuffled(len,0);
+      std::vector<std::uint16_t> expected(len,0);
+      shuffle.encode(input.data(), shuffled.data(), shape);
+      bitswap.encode(shuffled.data(), expected.data(), shape);
+      const std::string expected_config = shuffle.config();
+
+      sqy::tile_shuffle_scheme<std::uint16_t> fused_shuffle("tile_size=8");
+      fused_shuffle.set_n_threads(nthreads);
+
+      std::vector<std::uint16_t> fused(len,0xffff);
+      auto rem = fused_shuffle.encode_fused(bitswap, input.data(), fused.data(), shape);
+      BOOST_REQUIRE(rem == fused.data() + len);
+
+      BOOST_CHECK_EQUAL(fused_shuffle.config(), expected_config);
+      BOOST_CHECK_MESSAGE(std::equal(expected.begin(), expected.end(), fused.begin()),
+                          "fused stream differs for shape " << shape[0] << "x" << shape[1] << "x" << shape[2]
+                          << " with " << nthreads << " threads");
+    }
+  }
+
+}
+
+BOOST_AUTO_TEST_CASE( not_fused_with_other_stages )
+{
+
+  std::vector<std::size_t> shape = {8,8,8};
+  std::vector<std::uint16_t> input(512,1);
+  std::vector<std::uint16_t> output(512,0);
+
+  sqy::tile_shuffle_scheme<std::uint16_t> shuffle("tile_size=4");
+  sqy::tile_shuffle_scheme<std::uint16_t> another("tile_size=4");
+
+  BOOST_CHECK(shuffle.encode_fused(another, input.data(), output.data(), shape) == nullptr);
+
+}
+
+BOOST_AUTO_TEST_CASE( chain_roundtrip )
+{
+
+  std::vector<std::size_t> shape = {19,23,37};
+  const std::size_t len = std::accumulate(shape.begin(), shape.end(), 1, std::multiplies<std::size_t>());
+
+  std::vector<std::uint16_t> input(len);
+  std::mt19937 gen(1);
+  std::uniform_int_distribution<std::uint16_t> dist(0,1 << 12);
+  for(auto& v : input)
+    v = dist(gen);
+
+  auto shuffle = std::make_shared<sqy::tile_shuffle_scheme<std::uint16_t> >("tile_size=8");
+  auto bitswap = std::make_shared<sqy::bitswap_scheme<std::uint16_t> >();
+
+  sqy::stage_chain<sqy::filter<std::uint16_t> > chain;
+  chain.add(shuffle);
+  chain.add(bitswap);
+
+  std::vector<std::uint16_t> encoded(len,0);
+  auto rem = chain.encode(input.data(), encoded.data(), shape);
+  BOOST_REQUIRE(rem == encoded.data() + len);
+
+  //the chain must yield the same stream as running the stages one after another
+  sqy::tile_shuffle_scheme<std::uint16_t> seq_shuffle("tile_size=8");
+  std::vector<std::uint16_t> shuffled(len,0);
+  std::vector<std::uint16_t> expected(len,0);
+  seq_shuffle.encode(input.data(), shuffled.data(), shape);
+  bitswap->encode(shuffled.data(), expected.data(), shape);
+  BOOST_CHECK(std::equal(expected.begin(), expected.end(), encoded.begin()));
+
+  std::vector<std::uint16_t> decoded(len,0);
+  auto rv = chain.decode(encoded.data(), decoded.data(), shape);
+  BOOST_REQUIRE_EQUAL(rv, 0);
+  BOOST_CHECK_EQUAL_COLLECTIONS(input.begin(), input.end(),
+                                decoded.begin(), decoded.end());
+
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,206 @@
+#define BOOST_TEST_MODULE TEST_VST_SCHEME_IMPL
+#define BOOST_TEST_MAIN
+#include "boost/test/included/unit_test.hpp"
+#include <numeric>
+#include <vector>
+#include <random>
+#include <cmath>
+#include <iostream>
+#include <algorithm>
+#include "encoders/vst_scheme_impl.hpp"
+#include "sqeazy_pipelines.hpp"
+#include "traits.hpp"
+
+namespace sqy = sqeazy;
+namespace sqyd = sqy::detail;
+
+BOOST_AUTO_TEST_SUITE( transform )
+
+BOOST_AUTO_TEST_CASE( algebraic_inverse_undoes_forward )
+{
+
+  const sqyd::generalized_anscombe gat(0.46, 100, 1.6);
+
+  for(double x : {100., 101., 150., 1000., 65535.})
+    BOOST_CHECK_CLOSE(gat.algebraic_inverse(gat.forward(x)), x, 1e-6);
+}
+
+BOOST_AUTO_TEST_CASE( noise_is_stabilised )
+{
+
+  const double gain = 0.46;
+  const double offset = 100;
+  const double read_noise = 1.6;
+  const sqyd::generalized_anscombe gat(gain, offset, read_noise);
+
+  std::mt19937 gen(42);
+  std::normal_distribution<double> readout(offset, read_noise);
+
+  //the standard deviation in ADU grows with the intensity, after the transform it is about 1 throughout
+  for(double photons : {10., 100., 1000., 10000.}){
+
+    std::poisson_distribution<int> shot(photons);
+    const int n_samples = 20000;
+
+    double sum = 0;
+    double sum_sq = 0;
+    for(int i = 0;i<n_samples;++i){
+      const double value = gat.forward(gain*shot(gen) + readout(gen));
+      sum += value;
+      sum_sq += value*value;
+    }
+
+    const double mean = sum/n_samples;
+    const double stddev = std::sqrt(sum_sq/n_samples - mean*mean);
+    BOOST_CHECK_MESSAGE(std::abs(stddev - 1.) < .05, photons << " photons: stabilised noise " << stddev);
+  }
+}
+
+BOOST_AUTO_TEST_CASE( unbiased_inverse_recovers_mean )
+{
+
+  const double gain = 0.46;
+  const double offset = 100;
+  const sqyd::generalized_anscombe gat(gain, offset, 1.6);
+
+  std::mt19937 gen(7);
+  std::normal_distribution<double> readout(offset, 1.6);
+
+  const double photons = 5;
+  std::poisson_distribution<int> shot(photons);
+  const int n_samples = 100000;
+
+  double mean_stabilised = 0;
+  for(int i = 0;i<n_samples;++i)
+    mean_stabilised += gat.forward(gain*shot(gen) + readout(gen));
+  mean_stabilised /= n_samples;
+
+  //inverting the mean of the stabilised values: the algebraic inverse underestimates at low counts
+  const double expected = offset + gain*photons;
+  const double unbiased_error = std::abs(gat.unbiased_inverse(mean_stabilised) - expected);
+  const double algebraic_error = std::abs(gat.algebraic_inverse(mean_stabilised) - expected);
+
+  BOOST_CHECK_LT(unbiased_error, algebraic_error);
+  BOOST_CHECK_LT(unbiased_error, .05*gain*photons);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE( scheme )
+
+BOOST_AUTO_TEST_CASE( defaults_fit_input_range )
+{
+
+  sqy::vst_scheme<std::uint16_t> vst;
+  BOOST_CHECK_EQUAL(vst.name(), "vst");
+  BOOST_CHECK_EQUAL(vst.bits, 8);
+  BOOST_CHECK_GE(vst.step, 1.);
+  BOOST_CHECK_EQUAL(vst.narrow.encode.back(), 255);
+  BOOST_CHECK(std::is_sorted(vst.narrow.encode.begin(), vst.narrow.encode.end()));
+
+  //the configuration reproduces the tables
+  sqy::vst_scheme<std::uint16_t> copy(vst.config());
+  BOOST_CHECK_EQUAL(copy.config(), vst.config());
+  BOOST_CHECK(copy.narrow.decode == vst.narrow.decode);
+}
+
+BOOST_AUTO_TEST_CASE( config_reproduces_tables_of_long_parameters )
+{
+
+  //more digits than config() writes, the tables must be built from the rounded values
+  sqy::vst_scheme<std::uint16_t> vst("gain=2.123456789012345,offset=99.98765432109876,read_noise=1.0000000001234567,step=0.7777777777777777");
+  sqy::vst_scheme<std::uint16_t> copy(vst.config());
+
+  BOOST_CHECK_EQUAL(copy.config(), vst.config());
+  BOOST_CHECK_EQUAL(copy.transform.gain, vst.transform.gain);
+  BOOST_CHECK_EQUAL(copy.transform.offset, vst.transform.offset);
+  BOOST_CHECK_EQUAL(copy.transform.read_noise, vst.transform.read_noise);
+  BOOST_CHECK(copy.narrow.encode == vst.narrow.encode);
+  BOOST_CHECK(copy.narrow.decode == vst.narrow.decode);
+}
+
+BOOST_AUTO_TEST_CASE( error_is_below_step_for_all_values )
+{
+
+  //all 16-bit values, more than a vectorized block
+  std::vector<std::uint16_t> input(1 << 16);
+  std::iota(input.begin(), input.end(), 0);
+
+  for(const std::string config : {"gain=0.46,offset=100,read_noise=1.6",
+                                  "gain=0.46,offset=100,read_noise=1.6,bits=16,step=0.5"}){
+
+    for(int nthreads : {1,2}){
+      sqy::vst_scheme<std::uint16_t> vst(config);
+      vst.set_n_threads(nthreads);
+
+      std::vector<char> encoded(vst.max_encoded_size(input.size()*sizeof(std::uint16_t)),0);
+      char* end = vst.encode(input.data(), encoded.data(), input.size());
+      BOOST_REQUIRE(end == encoded.data() + encoded.size());
+
+      std::vector<std::uint16_t> decoded(input.size(),0);
+      BOOST_REQUIRE_EQUAL(vst.decode(encoded.data(), decoded.data(), encoded.size(), decoded.size()),0);
+
+      //in the stabilised domain, the error is half a step at most (plus rounding to integers in raw space)
+      std::size_t n_exceeding = 0;
+      for(std::size_t i = 0;i<input.size();++i){
+        const double error = std::abs(vst.transform.forward(decoded[i]) - vst.transform.forward(input[i]));
+        const double slope = vst.transform.forward(input[i] + .5) - vst.transform.forward(input[i]);
+        n_exceeding += error > vst.step/2 + slope + 1e-9;
+      }
+
+      BOOST_CHECK_MESSAGE(n_exceeding == 0, config << " with " << nthreads << " threads: " << n_exceeding << " values exceed the bound");
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE( bytes_to_wide_codes )
+{
+
+  std::vector<std::uint8_t> input(256);
+  std::iota(input.begin(), input.end(), 0);
+
+  //the stabilised values of neighboring bytes are at least 2*(sqrt(255.375) - sqrt(254.375)) > 0.06 apart
+  sqy::vst_scheme<std::uint8_t> vst("bits=16,step=0.05");
+  std::vector<char> encoded(vst.max_encoded_size(input.size()),0);
+  vst.encode(input.data(), encoded.data(), input.size());
+
+  std::vector<std::uint8_t> decoded(input.size(),0);
+  BOOST_REQUIRE_EQUAL(vst.decode(encoded.data(), decoded.data(), encoded.size(), decoded.size()),0);
+
+  BOOST_CHECK(decoded == input);
+}
+
+BOOST_AUTO_TEST_CASE( pipeline_roundtrip )
+{
+
+  const std::string spec = "vst(gain=0.46,offset=100,read_noise=1.6)->lz4";
+  BOOST_REQUIRE(sqy::dypeline<std::uint16_t>::can_be_built_from(spec));
+
+  auto pipe = sqy::dypeline<std::uint16_t>::from_string(spec);
+
+  std::vector<std::size_t> shape = {8,16,32};
+  const std::size_t len = 8*16*32;
+
+  std::mt19937 gen(3);
+  std::uniform_int_distribution<int> dist(100, 4000);
+  std::vector<std::uint16_t> input(len,0);
+  for(auto& v : input)
+    v = dist(gen);
+
+  std::vector<char> encoded(pipe.max_encoded_size(len*sizeof(std::uint16_t)),0);
+  char* end = pipe.encode(input.data(), encoded.data(), shape);
+  BOOST_REQUIRE(end != nullptr);
+
+  std::vector<std::uint16_t> decoded(len,0);
+  BOOST_REQUIRE_EQUAL(pipe.decode(encoded.data(), decoded.data(), end - encoded.data()), 0);
+
+  sqy::vst_scheme<std::uint16_t> vst("gain=0.46,offset=100,read_noise=1.6");
+  std::vector<std::uint8_t> codes(len,0);
+  vst.encode(input.data(), reinterpret_cast<char*>(codes.data()), len);
+  std::vector<std::uint16_t> expected(len,0);
+  vst.decode(reinterpret_cast<const char*>(codes.data()), expected.data(), len, len);
+
+  BOOST_CHECK(decoded == expected);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
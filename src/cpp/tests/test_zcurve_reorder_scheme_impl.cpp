@@ -286,6 +286,79 @@ BOOST_AUTO_TEST_CASE( tile_of_2_prime )
 
 }
 
+BOOST_AUTO_TEST_CASE( tile_larger_than_common_power_of_2 )
+{
+
+  std::vector<std::size_t> shape = {8,16,32};
+  std::size_t len = std::accumulate(shape.begin(), shape.end(),
+                                    1.,
+                                    std::multiplies<std::size_t>()
+    );
+
+  std::vector<std::uint16_t> src(len,0);
+  std::iota(src.begin(), src.end(),0);
+
+  std::vector<std::uint16_t> enc(len,0);
+  std::vector<std::uint16_t> dec(len,0);
+
+  sqy::zcurve_reorder_scheme<std::uint16_t> morton_of("tile_size=16");
+  auto rem = morton_of.encode(src.data(),
+                              enc.data(),
+                              shape);
+  BOOST_REQUIRE_EQUAL(rem,enc.data()+enc.size());
+
+  auto res = morton_of.decode(enc.data(),
+                              dec.data(),
+                              shape);
+
+  BOOST_REQUIRE_EQUAL(res,0);
+  BOOST_CHECK_EQUAL_COLLECTIONS(src.begin(), src.end(),
+                                dec.begin(), dec.end());
+}
+
+BOOST_AUTO_TEST_CASE( anisotropic_with_cut_tiles )
+{
+
+  std::vector<std::size_t> shape = {9,40,70};
+  std::size_t len = std::accumulate(shape.begin(), shape.end(),
+                                    1.,
+                                    std::multiplies<std::size_t>()
+    );
+
+  std::vector<std::uint16_t> src(len,0);
+  std::iota(src.begin(), src.end(),0);
+
+  std::vector<std::uint16_t> enc(len,0);
+  std::vector<std::uint16_t> dec(len,0);
+
+  sqyd::zcurve morton_of(8);
+  auto rem = morton_of.encode(src.cbegin(), src.cend(),
+                              enc.begin(),
+                              shape,
+                              3);
+  BOOST_REQUIRE(rem == enc.end());
+
+  //first tile is full and stored in zcurve order
+  for(std::uint32_t z = 0;z<8;++z)
+    for(std::uint32_t y = 0;y<8;++y)
+      for(std::uint32_t x = 0;x<8;++x)
+        BOOST_REQUIRE_EQUAL(enc[sqyd::morton_at_ct<3>::from(z,y,x)], src[(z*40 + y)*70 + x]);
+
+  //the last tile in the first tile row is cut to 6 voxels in x and stored in row-major order
+  const std::size_t cut_tile_offset = 8*8*8*8;
+  BOOST_CHECK_EQUAL(enc[cut_tile_offset], src[64]);
+  BOOST_CHECK_EQUAL(enc[cut_tile_offset + 6], src[70 + 64]);
+  BOOST_CHECK_EQUAL(enc[cut_tile_offset + 6*8], src[40*70 + 64]);
+
+  auto res = morton_of.decode(enc.cbegin(), enc.cend(),
+                              dec.begin(),
+                              shape,
+                              3);
+  BOOST_REQUIRE(res == dec.end());
+  BOOST_CHECK_EQUAL_COLLECTIONS(src.begin(), src.end(),
+                                dec.begin(), dec.end());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
 BOOST_FIXTURE_TEST_SUITE( parallel_rt_on_ramp , uint16_cube_of_8 )
@@ -378,4 +451,37 @@ BOOST_AUTO_TEST_CASE( tile_of_8 )
 }
 
 
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE( morton_index )
+
+BOOST_AUTO_TEST_CASE( bmi2_matches_tables )
+{
+
+  if(!compass::runtime::has(compass::feature::bmi2())){
+    BOOST_TEST_MESSAGE("skipping morton_index/bmi2_matches_tables, no BMI2 on this CPU");
+    return;
+  }
+
+#ifdef COMPASS_CT_ARCH_X86
+  for(std::uint32_t z = 0;z<32;++z)
+    for(std::uint32_t y = 0;y<32;++y)
+      for(std::uint32_t x = 0;x<32;++x){
+
+        BOOST_REQUIRE_EQUAL(sqyd::morton_bmi2<1>::from(z,y,x), sqyd::morton_at_ct<1>::from(z,y,x));
+        BOOST_REQUIRE_EQUAL(sqyd::morton_bmi2<3>::from(z,y,x), sqyd::morton_at_ct<3>::from(z,y,x));
+        BOOST_REQUIRE_EQUAL(sqyd::morton_bmi2<5>::from(z,y,x), sqyd::morton_at_ct<5>::from(z,y,x));
+
+        std::uint32_t rz = 0, ry = 0, rx = 0;
+        sqyd::morton_bmi2<3>::to(sqyd::morton_at_ct<3>::from(z,y,x), rz, ry, rx);
+        BOOST_REQUIRE_EQUAL(rz, z);
+        BOOST_REQUIRE_EQUAL(ry, y);
+        BOOST_REQUIRE_EQUAL(rx, x);
+      }
+
+  BOOST_CHECK_EQUAL(sqyd::morton_bmi2<1>::from(255,129,3), sqyd::morton_at_ct<1>::from(255,129,3));
+  BOOST_CHECK_EQUAL(sqyd::morton_bmi2<2>::from(200,17,255), sqyd::morton_at_ct<2>::from(200,17,255));
+#endif
+}
+
 BOOST_AUTO_TEST_SUITE_END()